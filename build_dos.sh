@@ -98,12 +98,15 @@ case "${1:-dos}" in
             mkdir -p /src/$BUILD_DIR/obj &&
             echo 'Compiling individual source files...' &&
             g++ -c /src/source/Configuration.cpp -I/src/$BUILD_DIR/source-install/include -O3 -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/Configuration.o && \
+            g++ -c /src/source/FilterChain.cpp -I/src/$BUILD_DIR/source-install/include -O3 -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/FilterChain.o && \
             g++ -c /src/source/Emulation/APU.cpp -I/src/$BUILD_DIR/source-install/include -O3 -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/APU.o && \
             g++ -c /src/source/Emulation/AllegroMidi.cpp -I/src/$BUILD_DIR/source-install/include -O3 -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/AllegroMidi.o && \
             g++ -c /src/source/Emulation/Controller.cpp -I/src/$BUILD_DIR/source-install/include -O3 -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/Controller.o && \
             g++ -c /src/source/Emulation/PPU.cpp -I/src/$BUILD_DIR/source-install/include -O3 -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/PPU.o && \
             g++ -c /src/source/Emulation/WarpNES.cpp -I/src/$BUILD_DIR/source-install/include -DALLEGRO_BUILD -O3 -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/SMBEngine.o && \
             g++ -c /src/source/Emulation/Battery.cpp -I/src/$BUILD_DIR/source-install/include -O3 -DALLEGRO_BUILD -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/Battery.o && \
+            g++ -c /src/source/Emulation/ROMImage.cpp -I/src/$BUILD_DIR/source-install/include -O3 -DALLEGRO_BUILD -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/ROMImage.o && \
+            g++ -c /src/source/Emulation/AtomicFile.cpp -I/src/$BUILD_DIR/source-install/include -O3 -DALLEGRO_BUILD -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/AtomicFile.o && \
             g++ -c /src/source/Emulation/Instructions.cpp -I/src/$BUILD_DIR/source-install/include -O3 -DALLEGRO_BUILD -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/Instructions.o && \
             g++ -c /src/source/Emulation/GxROM.cpp -I/src/$BUILD_DIR/source-install/include -O3 -DALLEGRO_BUILD -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/GxROM.o && \
             g++ -c /src/source/Emulation/UxROM.cpp -I/src/$BUILD_DIR/source-install/include -O3 -DALLEGRO_BUILD -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/UxROM.o && \
@@ -173,12 +176,15 @@ case "${1:-dos}" in
             mkdir -p /src/$BUILD_DIR/obj &&
             echo 'Compiling individual source files...' &&
             g++ -c /src/source/Configuration.cpp -I/src/$BUILD_DIR/source-install/include -O3 -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/Configuration.o && \
+            g++ -c /src/source/FilterChain.cpp -I/src/$BUILD_DIR/source-install/include -O3 -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/FilterChain.o && \
             g++ -c /src/source/Emulation/APU.cpp -I/src/$BUILD_DIR/source-install/include -O3 -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/APU.o && \
             g++ -c /src/source/Emulation/AllegroMidi.cpp -I/src/$BUILD_DIR/source-install/include -O3 -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/AllegroMidi.o && \
             g++ -c /src/source/Emulation/Controller.cpp -I/src/$BUILD_DIR/source-install/include -O3 -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/Controller.o && \
             g++ -c /src/source/Emulation/PPU.cpp -I/src/$BUILD_DIR/source-install/include -O3 -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/PPU.o && \
             g++ -c /src/source/Emulation/WarpNES.cpp -I/src/$BUILD_DIR/source-install/include -O3 -DALLEGRO_BUILD -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/SMBEngine.o && \
             g++ -c /src/source/Emulation/Battery.cpp -I/src/$BUILD_DIR/source-install/include -O3 -DALLEGRO_BUILD -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/Battery.o && \
+            g++ -c /src/source/Emulation/ROMImage.cpp -I/src/$BUILD_DIR/source-install/include -O3 -DALLEGRO_BUILD -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/ROMImage.o && \
+            g++ -c /src/source/Emulation/AtomicFile.cpp -I/src/$BUILD_DIR/source-install/include -O3 -DALLEGRO_BUILD -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/AtomicFile.o && \
             g++ -c /src/source/Emulation/Instructions.cpp -I/src/$BUILD_DIR/source-install/include -O3 -DALLEGRO_BUILD -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/Instructions.o && \
             g++ -c /src/source/Emulation/GxROM.cpp -I/src/$BUILD_DIR/source-install/include -O3 -DALLEGRO_BUILD -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/GxROM.o && \
             g++ -c /src/source/Emulation/UxROM.cpp -I/src/$BUILD_DIR/source-install/include -O3 -DALLEGRO_BUILD -march=i586 -fomit-frame-pointer -ffast-math -funroll-loops -fpermissive -w -o /src/$BUILD_DIR/obj/UxROM.o && \
@@ -5,6 +5,9 @@
 #include <allegro.h>
 #include <cstdint>
 #include <string.h>
+#include <vector>
+
+#include "DirtyRows.hpp"
 
 // Forward declarations
 class SMBEngine;
@@ -240,36 +243,14 @@ private:
   bool toggleFullscreen();
 #endif
 
-  struct ScalingCache {
-    uint16_t *scaledBuffer;       // Pre-scaled buffer
-    int *sourceToDestX;           // X coordinate mapping table
-    int *sourceToDestY;           // Y coordinate mapping table
-    int scaleFactor;              // Current scale factor
-    int destWidth, destHeight;    // Destination dimensions
-    int destOffsetX, destOffsetY; // Centering offsets
-    bool isValid;                 // Cache validity flag
-
-    ScalingCache();
-    ~ScalingCache();
-    void cleanup();
-  };
-
-  ScalingCache scalingCache;
   uint32_t *lineStartOffsets; // Pre-calculated line start offsets
   bool useOptimizedScaling;   // Enable/disable optimization
 
-  // Scaling methods
-  void initializeScalingCache();
-  void updateScalingCache();
-  bool isScalingCacheValid();
-  void drawGameCached(BITMAP *target);
-  void drawGameFastScale(BITMAP *target);
+  bool gameOnScreen;                  // back_buffer and the screen hold the last game frame and nothing else
+  std::vector<RowBand> changedRows;   // Screen rows redrawn by the last game frame
 
-  // Optimized scaling methods
-  void drawGame1x1(uint16_t *nesBuffer, BITMAP *target);
-  void drawGame2x(uint16_t *nesBuffer, BITMAP *target);
-  void drawGame3x(uint16_t *nesBuffer, BITMAP *target);
-  void drawGameGenericScale(uint16_t *nesBuffer, BITMAP *target, int scale);
+  // Scaling methods, which go through WarpNES::renderScaled16
+  void drawGameCached(BITMAP *target);
 
 #ifdef __DJGPP__
   // DOS-specific optimizations
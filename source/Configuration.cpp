@@ -295,7 +295,11 @@ std::string Configuration::configFileName;
 std::list<ConfigurationOption*> Configuration::configurationOptions = {
     &Configuration::audioEnabled,
     &Configuration::audioFrequency,
+    &Configuration::audioStatsInterval,
+    &Configuration::audioTargetLatency,
+    &Configuration::audioMaxRateAdjustment,
     &Configuration::frameRate,
+    &Configuration::framePacing,
     &Configuration::paletteFileName,
     &Configuration::renderScale,
     &Configuration::romFileName,
@@ -306,6 +310,15 @@ std::list<ConfigurationOption*> Configuration::configurationOptions = {
     &Configuration::hqdn3dTemporalStrength,
     &Configuration::antiAliasingEnabled,
     &Configuration::antiAliasingMethod,
+    &Configuration::filterThreads,
+    &Configuration::filterChain,
+    &Configuration::qualityGovernorEnabled,
+    &Configuration::maxFrameSkip,
+    &Configuration::rewindEnabled,
+    &Configuration::rewindBufferSize,
+    &Configuration::rewindKeyframeInterval,
+    &Configuration::runAheadFrames,
+    &Configuration::netplayInputDelay,
     
     // Input configuration options
     &Configuration::player1KeyUp,
@@ -354,6 +367,28 @@ BasicConfigurationOption<int> Configuration::audioFrequency(
     "audio.frequency", 48000
 );
 
+/**
+ * Seconds between audio pipeline stats lines, 0 to disable.
+ */
+BasicConfigurationOption<int> Configuration::audioStatsInterval(
+    "audio.stats_interval", 0
+);
+
+/**
+ * Audio queue depth the frame pacer holds, in milliseconds.
+ */
+BasicConfigurationOption<int> Configuration::audioTargetLatency(
+    "audio.target_latency", 40
+);
+
+/**
+ * How far the pacer may stretch or squeeze the audio to hold the queue
+ * depth (0.005 = 0.5%, 0 to disable).
+ */
+BasicConfigurationOption<float> Configuration::audioMaxRateAdjustment(
+    "audio.max_rate_adjustment", 0.005f
+);
+
 /**
  * Frame rate (per second).
  */
@@ -361,6 +396,13 @@ BasicConfigurationOption<int> Configuration::frameRate(
     "game.frame_rate", 60
 );
 
+/**
+ * What frames are paced to: "timer", "display" or "audio".
+ */
+BasicConfigurationOption<std::string> Configuration::framePacing(
+    "game.pacing", "timer"
+);
+
 /**
  * The filename for a custom palette to use for rendering.
  */
@@ -432,6 +474,75 @@ BasicConfigurationOption<int> Configuration::antiAliasingMethod(
     "video.antialiasing_method", 0
 );
 
+/**
+ * Number of threads for the software video filters.
+ * 0 = automatic
+ */
+BasicConfigurationOption<int> Configuration::filterThreads(
+    "video.filter_threads", 0
+);
+
+/**
+ * Comma separated list of video filter stages, such as "hq2x,scanlines".
+ * Empty = show the frames unfiltered
+ */
+BasicConfigurationOption<std::string> Configuration::filterChain(
+    "video.filter_chain", ""
+);
+
+/**
+ * Whether expensive filters are turned off and frames skipped when the
+ * host can not keep up.
+ */
+BasicConfigurationOption<bool> Configuration::qualityGovernorEnabled(
+    "video.governor", true
+);
+
+/**
+ * Most frames the quality governor skips between presented ones.
+ */
+BasicConfigurationOption<int> Configuration::maxFrameSkip(
+    "video.max_frame_skip", 3
+);
+
+/**
+ * Whether a snapshot is kept of every frame so the game can be rewound.
+ * Off by default, as every frame then pays for a snapshot and its delta.
+ */
+BasicConfigurationOption<bool> Configuration::rewindEnabled(
+    "rewind.enabled", false
+);
+
+/**
+ * Memory the rewind snapshots may use, in megabytes.
+ */
+BasicConfigurationOption<int> Configuration::rewindBufferSize(
+    "rewind.buffer_size", 64
+);
+
+/**
+ * Frames between the rewind snapshots that are stored whole.
+ */
+BasicConfigurationOption<int> Configuration::rewindKeyframeInterval(
+    "rewind.keyframe_interval", 60
+);
+
+/**
+ * Frames emulated ahead of the one shown to hide the game's input lag,
+ * 0 to turn run-ahead off.
+ */
+BasicConfigurationOption<int> Configuration::runAheadFrames(
+    "input.run_ahead", 0
+);
+
+/**
+ * Frames between pressing a button and it being used in netplay. Both
+ * players must use the same delay.
+ */
+BasicConfigurationOption<int> Configuration::netplayInputDelay(
+    "netplay.input_delay", 2
+);
+
 /**
  * Player 1 keyboard mappings (using Allegro key constants)
  * Note: These default values should be updated to use Allegro KEY_* constants
@@ -617,11 +728,31 @@ int Configuration::getAudioFrequency()
     return audioFrequency.getValue();
 }
 
+int Configuration::getAudioStatsInterval()
+{
+    return audioStatsInterval.getValue();
+}
+
+int Configuration::getAudioTargetLatency()
+{
+    return audioTargetLatency.getValue();
+}
+
+float Configuration::getAudioMaxRateAdjustment()
+{
+    return audioMaxRateAdjustment.getValue();
+}
+
 int Configuration::getFrameRate()
 {
     return frameRate.getValue();
 }
 
+const std::string& Configuration::getFramePacing()
+{
+    return framePacing.getValue();
+}
+
 const std::string& Configuration::getPaletteFileName()
 {
     return paletteFileName.getValue();
@@ -672,6 +803,51 @@ int Configuration::getAntiAliasingMethod()
     return antiAliasingMethod.getValue();
 }
 
+int Configuration::getFilterThreads()
+{
+    return filterThreads.getValue();
+}
+
+const std::string& Configuration::getFilterChain()
+{
+    return filterChain.getValue();
+}
+
+bool Configuration::getQualityGovernorEnabled()
+{
+    return qualityGovernorEnabled.getValue();
+}
+
+int Configuration::getMaxFrameSkip()
+{
+    return maxFrameSkip.getValue();
+}
+
+bool Configuration::getRewindEnabled()
+{
+    return rewindEnabled.getValue();
+}
+
+int Configuration::getRewindBufferSize()
+{
+    return rewindBufferSize.getValue();
+}
+
+int Configuration::getRewindKeyframeInterval()
+{
+    return rewindKeyframeInterval.getValue();
+}
+
+int Configuration::getRunAheadFrames()
+{
+    return runAheadFrames.getValue();
+}
+
+int Configuration::getNetplayInputDelay()
+{
+    return netplayInputDelay.getValue();
+}
+
 // Player 1 keyboard getters and setters
 int Configuration::getPlayer1KeyUp() { return player1KeyUp.getValue(); }
 void Configuration::setPlayer1KeyUp(int value) { player1KeyUp.setValue(value); }
@@ -132,11 +132,31 @@ public:
    */
   static int getAudioFrequency();
 
+  /**
+   * Get how often audio pipeline stats are printed, in seconds (0 = never).
+   */
+  static int getAudioStatsInterval();
+
+  /**
+   * Get the audio queue depth the frame pacer holds, in milliseconds.
+   */
+  static int getAudioTargetLatency();
+
+  /**
+   * Get how far the audio rate may be adjusted to hold the queue depth.
+   */
+  static float getAudioMaxRateAdjustment();
+
   /**
    * Get the desired frame rate (per second).
    */
   static int getFrameRate();
 
+  /**
+   * Get what frames are paced to ("timer", "display" or "audio").
+   */
+  static const std::string &getFramePacing();
+
   /**
    * Get the filename for a custom palette to use for rendering.
    */
@@ -188,6 +208,54 @@ public:
    */
   static int getAntiAliasingMethod();
 
+  /**
+   * Get the number of threads for the software video filters.
+   * 0 = automatic
+   */
+  static int getFilterThreads();
+
+  /**
+   * Get the video filter stages, as a comma separated list of stage names.
+   * Empty = no filtering
+   */
+  static const std::string &getFilterChain();
+
+  /**
+   * Get whether quality is lowered when the host can not keep up.
+   */
+  static bool getQualityGovernorEnabled();
+
+  /**
+   * Get the most frames skipped between presented ones when the host can
+   * not keep up.
+   */
+  static int getMaxFrameSkip();
+
+  /**
+   * Get whether frames are kept so the game can be rewound.
+   */
+  static bool getRewindEnabled();
+
+  /**
+   * Get the memory the rewind buffer may use, in megabytes.
+   */
+  static int getRewindBufferSize();
+
+  /**
+   * Get the number of frames between whole rewind snapshots.
+   */
+  static int getRewindKeyframeInterval();
+
+  /**
+   * Get the number of frames emulated ahead of the one shown.
+   */
+  static int getRunAheadFrames();
+
+  /**
+   * Get the number of frames netplay delays the local buttons.
+   */
+  static int getNetplayInputDelay();
+
   /**
    * Get Player 1 keyboard mapping for UP button
    */
@@ -303,7 +371,11 @@ public:
 private:
   static BasicConfigurationOption<bool> audioEnabled;
   static BasicConfigurationOption<int> audioFrequency;
+  static BasicConfigurationOption<int> audioStatsInterval;
+  static BasicConfigurationOption<int> audioTargetLatency;
+  static BasicConfigurationOption<float> audioMaxRateAdjustment;
   static BasicConfigurationOption<int> frameRate;
+  static BasicConfigurationOption<std::string> framePacing;
   static BasicConfigurationOption<std::string> paletteFileName;
   static BasicConfigurationOption<int> renderScale;
   static BasicConfigurationOption<std::string> romFileName;
@@ -314,6 +386,15 @@ private:
   static BasicConfigurationOption<float> hqdn3dTemporalStrength;
   static BasicConfigurationOption<bool> antiAliasingEnabled;
   static BasicConfigurationOption<int> antiAliasingMethod;
+  static BasicConfigurationOption<int> filterThreads;
+  static BasicConfigurationOption<std::string> filterChain;
+  static BasicConfigurationOption<bool> qualityGovernorEnabled;
+  static BasicConfigurationOption<int> maxFrameSkip;
+  static BasicConfigurationOption<bool> rewindEnabled;
+  static BasicConfigurationOption<int> rewindBufferSize;
+  static BasicConfigurationOption<int> rewindKeyframeInterval;
+  static BasicConfigurationOption<int> runAheadFrames;
+  static BasicConfigurationOption<int> netplayInputDelay;
 
   // Player 1 keyboard mappings (Allegro key constants stored as int)
   static BasicConfigurationOption<int> player1KeyUp;
@@ -0,0 +1,116 @@
+#ifndef DIRTY_ROWS_HPP
+#define DIRTY_ROWS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/**
+ * A range of rows [first, last).
+ */
+struct RowBand {
+    int first;
+    int last;
+};
+
+/**
+ * Set of the 240 NES scanlines that changed in a frame.
+ */
+class DirtyRows {
+public:
+    static const int ROWS = 240;
+
+    DirtyRows()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        std::fill(bits, bits + WORDS, 0);
+    }
+
+    void setAll()
+    {
+        std::fill(bits, bits + WORDS, ~0ULL);
+        bits[WORDS - 1] = (1ULL << (ROWS % 64)) - 1;
+    }
+
+    void set(int row)
+    {
+        bits[row >> 6] |= 1ULL << (row & 63);
+    }
+
+    bool test(int row) const
+    {
+        return (bits[row >> 6] >> (row & 63)) & 1;
+    }
+
+    bool any() const
+    {
+        for (int i = 0; i < WORDS; i++) {
+            if (bits[i]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    DirtyRows& operator|=(const DirtyRows& other)
+    {
+        for (int i = 0; i < WORDS; i++) {
+            bits[i] |= other.bits[i];
+        }
+        return *this;
+    }
+
+    /**
+     * Get the runs of changed rows, in order.
+     */
+    void getBands(std::vector<RowBand>& bands) const
+    {
+        bands.clear();
+        int row = 0;
+        while (row < ROWS) {
+            if (!test(row)) {
+                row++;
+                continue;
+            }
+            int first = row;
+            while (row < ROWS && test(row)) {
+                row++;
+            }
+            bands.push_back({ first, row });
+        }
+    }
+
+private:
+    static const int WORDS = (ROWS + 63) / 64;
+
+    uint64_t bits[WORDS];
+};
+
+/**
+ * Sort bands and merge the ones that overlap or touch.
+ */
+inline void mergeRowBands(std::vector<RowBand>& bands)
+{
+    std::sort(bands.begin(), bands.end(), [](const RowBand& a, const RowBand& b) {
+        return a.first < b.first;
+    });
+
+    size_t count = 0;
+    for (const RowBand& band : bands) {
+        if (band.first >= band.last) {
+            continue;
+        }
+        if (count > 0 && band.first <= bands[count - 1].last) {
+            bands[count - 1].last = std::max(bands[count - 1].last, band.last);
+        } else {
+            bands[count++] = band;
+        }
+    }
+    bands.resize(count);
+}
+
+#endif // DIRTY_ROWS_HPP
@@ -1,4 +1,6 @@
+#include <chrono>
 #include <cmath>
+#include <cstdio>
 #include <cstring>
 #include <iostream>
 
@@ -13,9 +15,7 @@
 #include "../Configuration.hpp"
 #include "APU.hpp"
 #include "AllegroMidi.hpp"
-
-    APU::MixCache APU::outputCache[256];
-    int APU::cacheIndex = 0;
+#include "SaveState.hpp"
 
 
 static const uint8_t lengthTable[] = {
@@ -39,6 +39,60 @@ static const uint16_t noiseTable[] = {
     4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068
 };
 
+// CPU cycle (since the last $4017 write) of each frame sequencer step
+static const uint32_t frameStepCycles[2][5] = {
+    {7457, 14913, 22371, 29829, 0},     // 4-step sequence
+    {7457, 14913, 22371, 29829, 37281}  // 5-step sequence
+};
+
+// CPU cycles emulated per video frame, used to pace sample output
+static const uint32_t CPU_CYCLES_PER_FRAME = 29780;
+
+// Fixed point scale of the sample step, fine enough for rate adjustments
+// of a few parts per million
+static const uint64_t SAMPLE_STEP_SCALE = 1 << 16;
+
+// Upper limit of the first bucket of each audio stats histogram
+static const uint64_t BUFFERED_BUCKET_SAMPLES = 64;
+static const uint64_t JITTER_BUCKET_US = 500;
+static const uint64_t SYNTHESIS_BUCKET_US = 50;
+
+static uint64_t monotonicMicros()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Find the power-of-two histogram bucket a value falls into.
+ */
+static int histogramBucket(uint64_t value, uint64_t firstLimit)
+{
+    int bucket = 0;
+    uint64_t limit = firstLimit;
+    while (bucket < AUDIO_STATS_BUCKETS - 1 && value >= limit) {
+        bucket++;
+        limit <<= 1;
+    }
+    return bucket;
+}
+
+template <typename T>
+static void storeMax(std::atomic<T>& target, T value)
+{
+    T current = target.load(std::memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+template <typename T>
+static void storeMin(std::atomic<T>& target, T value)
+{
+    T current = target.load(std::memory_order_relaxed);
+    while (value < current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
 /**
  * Pulse waveform generator.
  */
@@ -104,17 +158,17 @@ public:
         dutyValue = 0;
     }
 
-    void stepTimer()
+    void stepTimer(uint32_t ticks)
     {
-        if (timerValue == 0)
-        {
-            timerValue = timerPeriod;
-            dutyValue = (dutyValue + 1) % 8;
-        }
-        else
+        if (ticks <= timerValue)
         {
-            timerValue--;
+            timerValue -= ticks;
+            return;
         }
+        ticks -= timerValue + 1;
+        uint32_t period = (uint32_t)timerPeriod + 1;
+        dutyValue = (dutyValue + 1 + ticks / period) % 8;
+        timerValue = timerPeriod - ticks % period;
     }
 
     void stepEnvelope()
@@ -221,6 +275,54 @@ public:
         }
     }
 
+    void saveState(StateWriter& writer) const
+    {
+        writer.write(enabled);
+        writer.write(lengthEnabled);
+        writer.write(lengthValue);
+        writer.write(timerPeriod);
+        writer.write(timerValue);
+        writer.write(dutyMode);
+        writer.write(dutyValue);
+        writer.write(sweepReload);
+        writer.write(sweepEnabled);
+        writer.write(sweepNegate);
+        writer.write(sweepShift);
+        writer.write(sweepPeriod);
+        writer.write(sweepValue);
+        writer.write(envelopeEnabled);
+        writer.write(envelopeLoop);
+        writer.write(envelopeStart);
+        writer.write(envelopePeriod);
+        writer.write(envelopeValue);
+        writer.write(envelopeVolume);
+        writer.write(constantVolume);
+    }
+
+    void loadState(StateReader& reader)
+    {
+        reader.read(enabled);
+        reader.read(lengthEnabled);
+        reader.read(lengthValue);
+        reader.read(timerPeriod);
+        reader.read(timerValue);
+        reader.read(dutyMode);
+        reader.read(dutyValue);
+        reader.read(sweepReload);
+        reader.read(sweepEnabled);
+        reader.read(sweepNegate);
+        reader.read(sweepShift);
+        reader.read(sweepPeriod);
+        reader.read(sweepValue);
+        reader.read(envelopeEnabled);
+        reader.read(envelopeLoop);
+        reader.read(envelopeStart);
+        reader.read(envelopePeriod);
+        reader.read(envelopeValue);
+        reader.read(envelopeVolume);
+        reader.read(constantVolume);
+    }
+
 private:
     bool enabled;
     uint8_t channel;
@@ -284,20 +386,20 @@ public:
         counterReload = true;
     }
 
-    void stepTimer()
+    void stepTimer(uint32_t ticks)
     {
-        if (timerValue == 0)
+        if (ticks <= timerValue)
         {
-            timerValue = timerPeriod;
-            if (lengthValue > 0 && counterValue > 0)
-            {
-                dutyValue = (dutyValue + 1) % 32;
-            }
+            timerValue -= ticks;
+            return;
         }
-        else
+        ticks -= timerValue + 1;
+        uint32_t period = (uint32_t)timerPeriod + 1;
+        if (lengthValue > 0 && counterValue > 0)
         {
-            timerValue--;
+            dutyValue = (dutyValue + 1 + ticks / period) % 32;
         }
+        timerValue = timerPeriod - ticks % period;
     }
 
     void stepLength()
@@ -338,6 +440,32 @@ void stepCounter()
         return triangleTable[dutyValue];
     }
 
+    void saveState(StateWriter& writer) const
+    {
+        writer.write(enabled);
+        writer.write(lengthEnabled);
+        writer.write(lengthValue);
+        writer.write(timerPeriod);
+        writer.write(timerValue);
+        writer.write(dutyValue);
+        writer.write(counterPeriod);
+        writer.write(counterValue);
+        writer.write(counterReload);
+    }
+
+    void loadState(StateReader& reader)
+    {
+        reader.read(enabled);
+        reader.read(lengthEnabled);
+        reader.read(lengthValue);
+        reader.read(timerPeriod);
+        reader.read(timerValue);
+        reader.read(dutyValue);
+        reader.read(counterPeriod);
+        reader.read(counterValue);
+        reader.read(counterReload);
+    }
+
 private:
     bool enabled;
     bool lengthEnabled;
@@ -394,29 +522,31 @@ public:
         envelopeStart = true;
     }
 
-    void stepTimer()
+    void stepTimer(uint32_t ticks)
     {
-        if (timerValue == 0)
+        if (ticks <= timerValue)
+        {
+            timerValue -= ticks;
+            return;
+        }
+        ticks -= timerValue + 1;
+        uint32_t period = (uint32_t)timerPeriod + 1;
+        uint32_t reloads = 1 + ticks / period;
+        timerValue = timerPeriod - ticks % period;
+
+        // The shift register only matters while the channel is audible
+        if (!enabled || lengthValue == 0)
+        {
+            return;
+        }
+        uint8_t shift = mode ? 6 : 1;
+        for (uint32_t i = 0; i < reloads; i++)
         {
-            timerValue = timerPeriod;
-            uint8_t shift;
-            if (mode)
-            {
-                shift = 6;
-            }
-            else
-            {
-                shift = 1;
-            }
             uint16_t b1 = shiftRegister & 1;
             uint16_t b2 = (shiftRegister >> shift) & 1;
             shiftRegister >>= 1;
             shiftRegister |= (b1 ^ b2) << 14;
         }
-        else
-        {
-            timerValue--;
-        }
     }
 
     void stepEnvelope()
@@ -477,6 +607,42 @@ public:
         }
     }
 
+    void saveState(StateWriter& writer) const
+    {
+        writer.write(enabled);
+        writer.write(mode);
+        writer.write(shiftRegister);
+        writer.write(lengthEnabled);
+        writer.write(lengthValue);
+        writer.write(timerPeriod);
+        writer.write(timerValue);
+        writer.write(envelopeEnabled);
+        writer.write(envelopeLoop);
+        writer.write(envelopeStart);
+        writer.write(envelopePeriod);
+        writer.write(envelopeValue);
+        writer.write(envelopeVolume);
+        writer.write(constantVolume);
+    }
+
+    void loadState(StateReader& reader)
+    {
+        reader.read(enabled);
+        reader.read(mode);
+        reader.read(shiftRegister);
+        reader.read(lengthEnabled);
+        reader.read(lengthValue);
+        reader.read(timerPeriod);
+        reader.read(timerValue);
+        reader.read(envelopeEnabled);
+        reader.read(envelopeLoop);
+        reader.read(envelopeStart);
+        reader.read(envelopePeriod);
+        reader.read(envelopeValue);
+        reader.read(envelopeVolume);
+        reader.read(constantVolume);
+    }
+
 private:
     bool enabled;
     bool mode;
@@ -494,10 +660,26 @@ private:
     uint8_t constantVolume;
 };
 
-APU::APU()
+APU::APU(bool playback) : playback(playback)
 {
-    frameValue = 0;
+    cycle = 0;
+    frameCounterCycle = 0;
+    frameStep = 0;
+    frameMode = 0;
+    frameIRQInhibit = false;
+    frameIRQ = false;
+    sampleAccumulator = 0;
+    rateAdjustment = 1.0;
+    sampleOutput = true;
     audioBufferLength = 0;
+    cacheIndex = 0;
+    memset(outputCache, 0, sizeof(outputCache));
+
+    lastCallbackUs = 0;
+    lastSample = 0;
+    synthesisTiming = Configuration::getAudioStatsInterval() > 0;
+    frameSynthesisUs = 0;
+    resetStats();
 
     // Initialize pointers to null first for safety
     pulse1 = nullptr;
@@ -515,14 +697,16 @@ APU::APU()
         triangle = new Triangle;
         noise = new Noise;
         
-        // Initialize the enhanced audio system
-        gameAudio = new AllegroMIDIAudioSystem(this);
-        
-        #ifdef __DJGPP__
-        printf("APU initialized for DOS - all objects created successfully\n");
-        #else
-        printf("APU initialized for Linux\n");
-        #endif
+        if (playback) {
+            // Initialize the enhanced audio system
+            gameAudio = new AllegroMIDIAudioSystem(this);
+
+            #ifdef __DJGPP__
+            printf("APU initialized for DOS - all objects created successfully\n");
+            #else
+            printf("APU initialized for Linux\n");
+            #endif
+        }
     } catch (...) {
         printf("ERROR: Failed to create APU objects\n");
         // Clean up any partially created objects
@@ -605,6 +789,31 @@ APU::~APU()
 
 void APU::output(uint8_t* buffer, int len)
 {
+    // Callback timing: compare the time since the last callback with the
+    // time the previous request took to play
+    uint64_t now = monotonicMicros();
+    int buffered = audioBufferLength;
+    int frequency = Configuration::getAudioFrequency();
+
+    if (lastCallbackUs != 0 && frequency > 0) {
+        uint64_t interval = now - lastCallbackUs;
+        uint64_t expected = (uint64_t)len * 1000000 / frequency;
+        uint32_t jitter = (uint32_t)(interval > expected ? interval - expected : expected - interval);
+
+        statIntervalTotalUs += interval;
+        statIntervals++;
+        statJitterTotalUs += jitter;
+        storeMax(statJitterMaxUs, jitter);
+        statJitterHistogram[histogramBucket(jitter, JITTER_BUCKET_US)]++;
+    }
+    lastCallbackUs = now;
+
+    statCallbacks++;
+    statBufferedTotal += buffered;
+    storeMin(statBufferedMin, buffered);
+    storeMax(statBufferedMax, buffered);
+    statBufferedHistogram[histogramBucket(buffered, BUFFERED_BUCKET_SAMPLES)]++;
+
     // CHANGE FROM: if (gameAudio && gameAudio->isMIDIMode()) {
     // CHANGE TO:   if (gameAudio && gameAudio->isFMMode()) {
     if (gameAudio && gameAudio->isFMMode()) {
@@ -612,92 +821,326 @@ void APU::output(uint8_t* buffer, int len)
         gameAudio->generateAudio(buffer, len);
     } else {
         // Use original APU output
-        len = (len > audioBufferLength) ? audioBufferLength : len;
-        if (len > audioBufferLength)
-        {
-            memcpy(buffer, audioBuffer, audioBufferLength);
-            audioBufferLength = 0;
+        int count = (len > buffered) ? buffered : len;
+        memcpy(buffer, audioBuffer, count);
+        audioBufferLength -= count;
+        memmove(audioBuffer, audioBuffer + count, audioBufferLength);
+
+        if (count > 0) {
+            lastSample = buffer[count - 1];
         }
-        else
-        {
-            memcpy(buffer, audioBuffer, len);
-            audioBufferLength -= len;
-            memcpy(audioBuffer, audioBuffer + len, audioBufferLength);
+        if (count < len) {
+            // Underrun: hold the last level, as dropping to silence from
+            // wherever the wave was clicks. The device is signed 8-bit, so
+            // silence before anything was played is 0
+            memset(buffer + count, lastSample, len - count);
+            statUnderruns++;
+            statUnderrunSamples += len - count;
         }
     }
 }
 
 
-void APU::stepFrame()
+int APU::getBufferedSampleCount() const
+{
+    return audioBufferLength;
+}
+
+void APU::setRateAdjustment(double ratio)
+{
+    rateAdjustment = ratio;
+}
+
+void APU::setSampleOutput(bool enabled)
+{
+    sampleOutput = enabled;
+}
+
+AudioStats APU::getStats() const
+{
+    AudioStats stats;
+    stats.callbacks = statCallbacks;
+    stats.underruns = statUnderruns;
+    stats.underrunSamples = statUnderrunSamples;
+    stats.overruns = statOverruns;
+    stats.frames = statFrames;
+
+    stats.bufferedMin = stats.callbacks ? statBufferedMin.load() : 0;
+    stats.bufferedMax = statBufferedMax;
+    stats.bufferedAverage = stats.callbacks ? (double)statBufferedTotal / stats.callbacks : 0.0;
+
+    uint64_t intervals = statIntervals;
+    stats.intervalAverageMs = intervals ? statIntervalTotalUs / 1000.0 / intervals : 0.0;
+    stats.jitterAverageMs = intervals ? statJitterTotalUs / 1000.0 / intervals : 0.0;
+    stats.jitterMaxMs = statJitterMaxUs / 1000.0;
+
+    stats.synthesisAverageUs = stats.frames ? (double)statSynthesisTotalUs / stats.frames : 0.0;
+    stats.synthesisMaxUs = statSynthesisMaxUs;
+
+    for (int i = 0; i < AUDIO_STATS_BUCKETS; i++) {
+        stats.bufferedHistogram[i] = statBufferedHistogram[i];
+        stats.jitterHistogram[i] = statJitterHistogram[i];
+        stats.synthesisHistogram[i] = statSynthesisHistogram[i];
+    }
+    return stats;
+}
+
+void APU::resetStats()
+{
+    statCallbacks = 0;
+    statUnderruns = 0;
+    statUnderrunSamples = 0;
+    statOverruns = 0;
+    statFrames = 0;
+    statBufferedMin = AUDIO_BUFFER_LENGTH;
+    statBufferedMax = 0;
+    statBufferedTotal = 0;
+    statIntervalTotalUs = 0;
+    statIntervals = 0;
+    statJitterTotalUs = 0;
+    statJitterMaxUs = 0;
+    statSynthesisTotalUs = 0;
+    statSynthesisMaxUs = 0;
+    for (int i = 0; i < AUDIO_STATS_BUCKETS; i++) {
+        statBufferedHistogram[i] = 0;
+        statJitterHistogram[i] = 0;
+        statSynthesisHistogram[i] = 0;
+    }
+}
+
+void APU::setSynthesisTimingEnabled(bool enabled)
+{
+    synthesisTiming = enabled;
+    frameSynthesisUs = 0;
+}
+
+void AudioStats::print() const
+{
+    printf("Audio: %llu callbacks, buffered %d/%.0f/%d (min/avg/max), "
+           "%llu underruns (%llu samples), %llu overruns, "
+           "interval %.2fms, jitter %.2fms avg %.2fms max",
+           (unsigned long long)callbacks, bufferedMin, bufferedAverage, bufferedMax,
+           (unsigned long long)underruns, (unsigned long long)underrunSamples,
+           (unsigned long long)overruns, intervalAverageMs, jitterAverageMs, jitterMaxMs);
+    if (synthesisMaxUs > 0.0) {
+        printf(", synthesis %.0fus avg %.0fus max", synthesisAverageUs, synthesisMaxUs);
+    }
+    printf("\n");
+}
+
+void APU::stepFrame(uint64_t cpuCycle)
+{
+    // Samples are produced as the APU catches up, so all that is left at
+    // the end of a frame is to account for the time since the last access.
+    catchUp(cpuCycle);
+
+    statFrames++;
+    if (synthesisTiming) {
+        statSynthesisTotalUs += frameSynthesisUs;
+        storeMax(statSynthesisMaxUs, (uint32_t)frameSynthesisUs);
+        statSynthesisHistogram[histogramBucket(frameSynthesisUs, SYNTHESIS_BUCKET_US)]++;
+        frameSynthesisUs = 0;
+    }
+}
+
+void APU::catchUp(uint64_t cpuCycle)
 {
     // Safety check - if objects aren't created, don't crash
     if (!pulse1 || !pulse2 || !triangle || !noise) {
         return;
     }
 
-    // Step the frame counter 4 times per frame, for 240Hz (same as SDL)
-    for (int i = 0; i < 4; i++)
-    {
-        frameValue = (frameValue + 1) % 5;
-        switch (frameValue)
-        {
-        case 1:
-        case 3:
-            stepEnvelope();
-            break;
-        case 0:
-        case 2:
-            stepEnvelope();
-            stepSweep();
-            stepLength();
-            break;
+    if (cpuCycle <= cycle) {
+        // The CPU counter went backwards (reset or state load), resync to it
+        cycle = cpuCycle;
+        return;
+    }
+
+    uint64_t startUs = synthesisTiming ? monotonicMicros() : 0;
+
+    bool audioEnabled = (Configuration::getAudioEnabled() || !playback) && sampleOutput;
+    // A sample is due every time the accumulator passes the threshold
+    uint64_t sampleStep = (uint64_t)(Configuration::getAudioFrequency() * rateAdjustment * SAMPLE_STEP_SCALE + 0.5);
+    uint64_t sampleThreshold = (uint64_t)CPU_CYCLES_PER_FRAME * Configuration::getFrameRate() * SAMPLE_STEP_SCALE;
+
+    // Run in spans between events (sequencer steps and output samples) so the
+    // cost depends on how much happens rather than on how many cycles pass
+    while (cycle < cpuCycle) {
+        uint64_t span = cpuCycle - cycle;
+
+        uint32_t untilStep = frameStepCycles[frameMode][frameStep] - frameCounterCycle;
+        if (untilStep < span) {
+            span = untilStep;
         }
 
-        // Calculate the number of samples needed per 1/4 frame (same as SDL)
-        int frequency = Configuration::getAudioFrequency();
-        int samplesToWrite = frequency / (Configuration::getFrameRate() * 4);
-        if (i == 3)
-        {
-            // Handle the remainder on the final tick of the frame counter
-            samplesToWrite = (frequency / Configuration::getFrameRate()) - 3 * (frequency / (Configuration::getFrameRate() * 4));
+        if (sampleStep > 0) {
+            uint64_t untilSample = (sampleThreshold - sampleAccumulator + sampleStep - 1) / sampleStep;
+            if (untilSample < span) {
+                span = untilSample;
+            }
         }
-        
-        // Bounds check
-        if (samplesToWrite <= 0 || audioBufferLength + samplesToWrite >= AUDIO_BUFFER_LENGTH) {
-            continue;
+
+        stepTimers((uint32_t)span);
+        frameCounterCycle += (uint32_t)span;
+
+        if (frameCounterCycle == frameStepCycles[frameMode][frameStep]) {
+            stepFrameCounter();
         }
-        
-#ifndef __DJGPP__
-        // Audio locking for thread safety (like SDL's SDL_LockAudio)
-        //static pthread_mutex_t audio_mutex = PTHREAD_MUTEX_INITIALIZER;
-        //pthread_mutex_lock(&audio_mutex);
-#endif
 
-        // Step the timer ~3729 times per quarter frame (same as SDL)
-        int j = 0;
-        for (int stepIndex = 0; stepIndex < 3729 && j < samplesToWrite; stepIndex++)
-        {
-            if ((stepIndex / 3729.0) > (j / (double)samplesToWrite))
-            {
-                uint8_t sample = getOutput();
-                audioBuffer[audioBufferLength + j] = sample;
-                j++;
+        if (sampleStep > 0) {
+            sampleAccumulator += span * sampleStep;
+            if (sampleAccumulator >= sampleThreshold) {
+                sampleAccumulator -= sampleThreshold;
+                if (audioEnabled) {
+                    if (audioBufferLength < AUDIO_BUFFER_LENGTH) {
+                        audioBuffer[audioBufferLength++] = getOutput();
+                    } else {
+                        statOverruns++;
+                    }
+                }
             }
+        }
+    }
+
+    if (synthesisTiming) {
+        frameSynthesisUs += monotonicMicros() - startUs;
+    }
+}
 
-            pulse1->stepTimer();
-            pulse2->stepTimer();
-            noise->stepTimer();
-            triangle->stepTimer();
-            triangle->stepTimer(); // Triangle steps twice like in SDL
+void APU::stepTimers(uint32_t cpuCycles)
+{
+    // Pulse and noise timers are clocked on every other CPU cycle,
+    // the triangle timer on every CPU cycle
+    uint32_t apuCycles = (uint32_t)(((cycle + cpuCycles + 1) >> 1) - ((cycle + 1) >> 1));
+
+    pulse1->stepTimer(apuCycles);
+    pulse2->stepTimer(apuCycles);
+    noise->stepTimer(apuCycles);
+    triangle->stepTimer(cpuCycles);
+
+    cycle += cpuCycles;
+}
+
+void APU::stepFrameCounter()
+{
+    int lastStep = (frameMode == 0) ? 3 : 4;
+
+    // Step 4 of the 5-step sequence does nothing
+    if (frameMode == 0 || frameStep != 3) {
+        stepEnvelope();
+        if (frameStep == 1 || frameStep == lastStep) {
+            stepSweep();
+            stepLength();
         }
-        audioBufferLength += j; // Use j instead of samplesToWrite
-        
-#ifndef __DJGPP__
-        //pthread_mutex_unlock(&audio_mutex);
-#endif        
+    }
+
+    if (frameMode == 0 && frameStep == lastStep && !frameIRQInhibit) {
+        frameIRQ = true;
+    }
+
+    if (frameStep == lastStep) {
+        frameStep = 0;
+        frameCounterCycle = 0;
+    } else {
+        frameStep++;
+    }
+}
+
+void APU::writeFrameCounter(uint8_t value)
+{
+    frameMode = (value & 0x80) ? 1 : 0;
+    frameIRQInhibit = (value & 0x40) != 0;
+    if (frameIRQInhibit) {
+        frameIRQ = false;
+    }
+
+    frameStep = 0;
+    frameCounterCycle = 0;
+
+    // Selecting the 5-step sequence clocks the units immediately
+    if (frameMode == 1) {
+        stepEnvelope();
+        stepSweep();
+        stepLength();
     }
 }
 
+uint8_t APU::readStatus()
+{
+    uint8_t status = 0;
+    if (pulse1 && pulse1->lengthValue > 0) status |= 0x01;
+    if (pulse2 && pulse2->lengthValue > 0) status |= 0x02;
+    if (triangle && triangle->lengthValue > 0) status |= 0x04;
+    if (noise && noise->lengthValue > 0) status |= 0x08;
+    if (frameIRQ) status |= 0x40;
+
+    frameIRQ = false;
+    return status;
+}
+
+bool APU::isIRQPending() const
+{
+    return frameIRQ;
+}
+
+uint64_t APU::getNextIRQCycle() const
+{
+    if (frameMode != 0 || frameIRQInhibit || frameIRQ) {
+        return UINT64_MAX;
+    }
+    return cycle + (frameStepCycles[0][3] - frameCounterCycle);
+}
+
+void APU::saveState(StateWriter& writer) const
+{
+    writer.write(cycle);
+    writer.write(frameCounterCycle);
+    writer.write(frameStep);
+    writer.write(frameMode);
+    writer.write(frameIRQInhibit);
+    writer.write(frameIRQ);
+    // Field by field, as padding would make states of the same frame differ
+    pulse1->saveState(writer);
+    pulse2->saveState(writer);
+    triangle->saveState(writer);
+    noise->saveState(writer);
+}
+
+void APU::loadState(StateReader& reader)
+{
+    reader.read(cycle);
+    reader.read(frameCounterCycle);
+    reader.read(frameStep);
+    reader.read(frameMode);
+    reader.read(frameIRQInhibit);
+    reader.read(frameIRQ);
+    pulse1->loadState(reader);
+    pulse2->loadState(reader);
+    triangle->loadState(reader);
+    noise->loadState(reader);
+}
+
+void APU::saveOutputState(StateWriter& writer) const
+{
+    writer.write(sampleAccumulator);
+}
+
+void APU::loadOutputState(StateReader& reader)
+{
+    reader.read(sampleAccumulator);
+}
+
+size_t APU::getMemoryUsed() const
+{
+    size_t bytes = sizeof(APU);
+    bytes += pulse1 ? sizeof(Pulse) : 0;
+    bytes += pulse2 ? sizeof(Pulse) : 0;
+    bytes += triangle ? sizeof(Triangle) : 0;
+    bytes += noise ? sizeof(Noise) : 0;
+    bytes += gameAudio ? sizeof(AllegroMIDIAudioSystem) : 0;
+    return bytes;
+}
+
 
 void APU::stepEnvelope()
 {
@@ -798,9 +1241,7 @@ void APU::writeRegister(uint16_t address, uint8_t value)
         writeControl(value);
         break;
     case 0x4017:
-        stepEnvelope();
-        stepSweep();
-        stepLength();
+        writeFrameCounter(value);
         break;
     default:
         break;
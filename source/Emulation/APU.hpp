@@ -1,14 +1,54 @@
 #ifndef APU_HPP
 #define APU_HPP
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 
 #define AUDIO_BUFFER_LENGTH 4096
+#define AUDIO_STATS_BUCKETS 8
 
 class Pulse;
 class Triangle;
 class Noise;
 class AllegroMIDIAudioSystem; // Forward declaration
+class StateReader;
+class StateWriter;
+
+/**
+ * Snapshot of the audio pipeline counters since the last reset.
+ *
+ * Histogram buckets are powers of two: bucket 0 holds values below the
+ * first bucket's limit, each following bucket doubles the limit and the
+ * last bucket holds everything above.
+ */
+struct AudioStats {
+    uint64_t callbacks;        /**< Audio device callbacks served */
+    uint64_t underruns;        /**< Callbacks that asked for more than was buffered */
+    uint64_t underrunSamples;  /**< Samples padded in by underruns */
+    uint64_t overruns;         /**< Samples dropped because the buffer was full */
+    uint64_t frames;           /**< Video frames synthesized */
+
+    int bufferedMin;           /**< Fewest samples buffered at a callback */
+    int bufferedMax;           /**< Most samples buffered at a callback */
+    double bufferedAverage;    /**< Average samples buffered at a callback */
+
+    double intervalAverageMs;  /**< Average time between callbacks */
+    double jitterAverageMs;    /**< Average distance of the interval from the expected one */
+    double jitterMaxMs;        /**< Largest distance of the interval from the expected one */
+
+    double synthesisAverageUs; /**< Average time spent synthesizing a frame (if timing is enabled) */
+    double synthesisMaxUs;     /**< Longest time spent synthesizing a frame (if timing is enabled) */
+
+    uint32_t bufferedHistogram[AUDIO_STATS_BUCKETS];  /**< Buffered samples, first limit 64 */
+    uint32_t jitterHistogram[AUDIO_STATS_BUCKETS];    /**< Callback jitter in us, first limit 500 */
+    uint32_t synthesisHistogram[AUDIO_STATS_BUCKETS]; /**< Synthesis time in us, first limit 50 */
+
+    /**
+     * Print the stats as a single line.
+     */
+    void print() const;
+};
 
 /**
  * Audio processing unit emulator.
@@ -16,13 +56,45 @@ class AllegroMIDIAudioSystem; // Forward declaration
 class APU
 {
 public:
-    APU();
+    /**
+     * @param playback false for an APU that is not played through the
+     * sound device, such as one rendered or analyzed offline. It creates
+     * no FM synthesis system, prints nothing, and makes samples whatever
+     * audio.enabled is set to.
+     */
+    explicit APU(bool playback = true);
     ~APU();
 
     /**
-     * Step the APU by one frame.
+     * Bring the APU up to date at the end of a video frame.
+     * @param cpuCycle Current CPU cycle count
      */
-    void stepFrame();
+    void stepFrame(uint64_t cpuCycle);
+
+    /**
+     * Run the APU forward until it reaches the given CPU cycle.
+     * Must be called before any register access so that writes and
+     * status reads land at the right point in time.
+     * @param cpuCycle Current CPU cycle count
+     */
+    void catchUp(uint64_t cpuCycle);
+
+    /**
+     * Read the status register ($4015). Clears the frame IRQ flag.
+     * @return Length counter status in bits 0-3, frame IRQ in bit 6
+     */
+    uint8_t readStatus();
+
+    /**
+     * Check if the frame counter is asserting the IRQ line.
+     */
+    bool isIRQPending() const;
+
+    /**
+     * Get the CPU cycle at which the frame counter will next raise an IRQ.
+     * @return The cycle, or UINT64_MAX if no IRQ is scheduled
+     */
+    uint64_t getNextIRQCycle() const;
 
     /**
      * Output audio samples to the provided buffer.
@@ -38,6 +110,66 @@ public:
      */
     void writeRegister(uint16_t address, uint8_t value);
 
+    /**
+     * Get the number of samples waiting to be output.
+     */
+    int getBufferedSampleCount() const;
+
+    /**
+     * Scale the number of samples made per emulated frame, so a frontend
+     * pacing frames to another clock can keep the queue at a steady depth.
+     * @param ratio Samples made relative to the audio frequency, around 1.0
+     */
+    void setRateAdjustment(double ratio);
+
+    /**
+     * Turn making samples on or off. The channels keep running either
+     * way, only nothing is added to the buffer.
+     */
+    void setSampleOutput(bool enabled);
+
+    /**
+     * Write the frame sequencer and channel state to a save state chunk.
+     */
+    void saveState(StateWriter& writer) const;
+
+    /**
+     * Restore the state written by saveState(). Samples already buffered
+     * for the device are kept.
+     */
+    void loadState(StateReader& reader);
+
+    /**
+     * Write where the APU is between output samples to a save state chunk.
+     * It follows the host's sample rate and pacing rather than the game,
+     * so it is kept apart from the emulated state.
+     */
+    void saveOutputState(StateWriter& writer) const;
+
+    void loadOutputState(StateReader& reader);
+
+    /**
+     * Get the memory the APU and its channels take up.
+     */
+    size_t getMemoryUsed() const;
+
+    /**
+     * Get a snapshot of the audio pipeline counters.
+     * Safe to call while the audio callback is running.
+     */
+    AudioStats getStats() const;
+
+    /**
+     * Reset the audio pipeline counters.
+     */
+    void resetStats();
+
+    /**
+     * Enable timing of sample synthesis. Counters are always kept, this
+     * only controls the clock reads around the synthesis work.
+     */
+    void setSynthesisTimingEnabled(bool enabled);
+
     /**
      * Toggle between APU and MIDI audio modes.
      */
@@ -59,7 +191,16 @@ private:
     uint8_t audioBuffer[AUDIO_BUFFER_LENGTH];
     int audioBufferLength;      /**< Amount of data currently in buffer */
 
-    int frameValue; /**< The value of the frame counter. */
+    uint64_t cycle;             /**< CPU cycle the APU has been run up to */
+    uint32_t frameCounterCycle; /**< CPU cycles since the frame sequencer was reset */
+    int frameStep;              /**< Next step of the frame sequencer */
+    int frameMode;              /**< 0 = 4-step sequence, 1 = 5-step sequence */
+    bool frameIRQInhibit;       /**< IRQ inhibit flag from $4017 */
+    bool frameIRQ;              /**< Frame IRQ flag, cleared by reading $4015 */
+    uint64_t sampleAccumulator; /**< Fractional position of the next output sample */
+    double rateAdjustment;      /**< Resampling ratio set by the frontend's pacing */
+    bool sampleOutput;          /**< Whether samples are added to the buffer */
+    bool playback;              /**< Played through the sound device, see APU() */
 
     Pulse* pulse1;
     Pulse* pulse2;
@@ -68,6 +209,30 @@ private:
 
     AllegroMIDIAudioSystem* gameAudio;  /**< Enhanced audio system */
 
+    // Audio pipeline counters, written from both the emulation and audio threads
+    std::atomic<uint64_t> statCallbacks;
+    std::atomic<uint64_t> statUnderruns;
+    std::atomic<uint64_t> statUnderrunSamples;
+    std::atomic<uint64_t> statOverruns;
+    std::atomic<uint64_t> statFrames;
+    std::atomic<int> statBufferedMin;
+    std::atomic<int> statBufferedMax;
+    std::atomic<uint64_t> statBufferedTotal;
+    std::atomic<uint64_t> statIntervalTotalUs;
+    std::atomic<uint64_t> statIntervals;
+    std::atomic<uint64_t> statJitterTotalUs;
+    std::atomic<uint32_t> statJitterMaxUs;
+    std::atomic<uint64_t> statSynthesisTotalUs;
+    std::atomic<uint32_t> statSynthesisMaxUs;
+    std::atomic<uint32_t> statBufferedHistogram[AUDIO_STATS_BUCKETS];
+    std::atomic<uint32_t> statJitterHistogram[AUDIO_STATS_BUCKETS];
+    std::atomic<uint32_t> statSynthesisHistogram[AUDIO_STATS_BUCKETS];
+
+    uint64_t lastCallbackUs;    /**< Time of the last callback, only touched by the audio thread */
+    uint8_t lastSample;         /**< Last sample handed to the device, only touched by the audio thread */
+    bool synthesisTiming;       /**< Whether catchUp() is timed */
+    uint64_t frameSynthesisUs;  /**< Synthesis time accumulated during the current frame */
+
     /**
      * Get the current mixed audio output sample.
      * @return 8-bit unsigned audio sample (0-255, 128=silence)
@@ -77,7 +242,10 @@ private:
     void stepEnvelope();
     void stepSweep();
     void stepLength();
+    void stepTimers(uint32_t cpuCycles);
+    void stepFrameCounter();
     void writeControl(uint8_t value);
+    void writeFrameCounter(uint8_t value);
     
     struct MixCache {
         uint8_t pulse1_val;
@@ -88,8 +256,8 @@ private:
         bool valid;
     };
     
-    static MixCache outputCache[256];  // Cache recent calculations
-    static int cacheIndex;
+    MixCache outputCache[256];  // Cache recent calculations
+    int cacheIndex;
 };
 
 #endif // APU_HPP
@@ -0,0 +1,48 @@
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "AtomicFile.hpp"
+
+bool writeFileAtomically(const std::string& filename, const uint8_t* data, size_t size)
+{
+#ifdef __DJGPP__
+    // 8.3 names, so the extension is replaced rather than added to
+    std::string tempFilename = filename.substr(0, filename.find_last_of('.')) + ".tmp";
+#else
+    std::string tempFilename = filename + ".tmp";
+#endif
+
+    FILE* file = fopen(tempFilename.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool written = fwrite(data, 1, size, file) == size && fflush(file) == 0;
+#ifdef _WIN32
+    written = written && _commit(_fileno(file)) == 0;
+#else
+    written = written && fsync(fileno(file)) == 0;
+#endif
+    if (fclose(file) != 0 || !written) {
+        remove(tempFilename.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    if (!MoveFileExA(tempFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+#else
+    if (rename(tempFilename.c_str(), filename.c_str()) != 0) {
+#endif
+        remove(tempFilename.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,16 @@
+#ifndef ATOMIC_FILE_HPP
+#define ATOMIC_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Write a file so that a crash leaves either the old file or the new one:
+ * to a temporary file next to it first, flushed to disk and then renamed
+ * over the old one. Safe to call from any thread.
+ * @return false if the file could not be written, the old one is kept
+ */
+bool writeFileAtomically(const std::string& filename, const uint8_t* data, size_t size);
+
+#endif // ATOMIC_FILE_HPP
@@ -1,6 +1,7 @@
 #include "WarpNES.hpp"
 #include "../Configuration.hpp"
 #include "APU.hpp"
+#include "AtomicFile.hpp"
 #ifdef ALLEGRO_BUILD
 #include "Controller.hpp"
 #else
@@ -10,6 +11,7 @@
 #include "../Zapper.hpp"
 #include <chrono>
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <iostream>
@@ -28,6 +30,7 @@ void WarpNES::initializeSRAM() {
   memset(sram, 0, sramSize);  // Initialize to zero
   sramEnabled = true;
   sramDirty = false;
+  sramDirtyPages = 0;
   
   printf("SRAM: Initialized %d bytes for battery save\n", sramSize);
   
@@ -35,13 +38,19 @@ void WarpNES::initializeSRAM() {
   loadSRAM();
 }
 
+std::string WarpNES::getSRAMFileName() const {
+  if (!nesHeader.battery || romBaseName.empty()) {
+    return std::string();
+  }
+  return romBaseName + ".srm";
+}
+
 void WarpNES::loadSRAM() {
   if (!sram || !nesHeader.battery || romBaseName.empty()) {
     return;
   }
   
-  // Create battery save filename with .srm extension
-  std::string saveFilename = romBaseName + ".srm";
+  std::string saveFilename = getSRAMFileName();
   
   std::ifstream file(saveFilename, std::ios::binary);
   if (!file.is_open()) {
@@ -61,21 +70,22 @@ void WarpNES::saveSRAM() {
     return;
   }
   
-  // Create battery save filename with .srm extension
-  std::string saveFilename = romBaseName + ".srm";
-  
-  std::ofstream file(saveFilename, std::ios::binary);
-  if (!file.is_open()) {
+  std::string saveFilename = getSRAMFileName();
+  if (!writeFileAtomically(saveFilename, sram, sramSize)) {
     printf("SRAM: Error - Could not save battery data to %s\n", saveFilename.c_str());
     return;
   }
   
-  // Write SRAM data
-  file.write(reinterpret_cast<const char*>(sram), sramSize);
-  file.close();
-  
   printf("SRAM: Saved battery data to %s\n", saveFilename.c_str());
   sramDirty = false;
+  sramDirtyPages = 0;
+}
+
+uint32_t WarpNES::takeSRAMWrites() {
+  uint32_t pages = sramDirtyPages;
+  sramDirtyPages = 0;
+  sramDirty = false;
+  return pages;
 }
 
 void WarpNES::cleanupSRAM() {
@@ -86,6 +96,7 @@ void WarpNES::cleanupSRAM() {
   sramSize = 0;
   sramEnabled = false;
   sramDirty = false;
+  sramDirtyPages = 0;
 }
 
 // Add public method to manually save (good for clean shutdown):
@@ -2,6 +2,7 @@
 #include <iostream>
 #include <cstring>
 #include "Controller.hpp"
+#include "SaveState.hpp"
 
 Controller::Controller(int playerNumber) 
     : playerNumber(playerNumber), joystickAvailable(false), joystickIndex(-1), controllerLatch(0), shiftRegister(0)
@@ -184,6 +185,18 @@ void Controller::writeByte(uint8_t value)
     controllerLatch = value;
 }
 
+void Controller::saveState(StateWriter& writer) const
+{
+    writer.write(controllerLatch);
+    writer.write(shiftRegister);
+}
+
+void Controller::loadState(StateReader& reader)
+{
+    reader.read(controllerLatch);
+    reader.read(shiftRegister);
+}
+
 void Controller::printButtonStates() const
 {
     std::cout << "Player " << playerNumber << " Controller State: ";
@@ -7,6 +7,9 @@
 #include <allegro.h>
 #include "../Configuration.hpp"
 
+class StateReader;
+class StateWriter;
+
 // Player constants for NES controller emulation
 #define PLAYER_1 1
 #define PLAYER_2 2
@@ -96,6 +99,17 @@ public:
      */
     void writeByte(uint8_t value);
 
+    /**
+     * Write the latch and shift register to a save state chunk. The
+     * buttons are input and are not saved.
+     */
+    void saveState(StateWriter& writer) const;
+
+    /**
+     * Restore the state written by saveState().
+     */
+    void loadState(StateReader& reader);
+
     /**
      * Print current button states for debugging
      */
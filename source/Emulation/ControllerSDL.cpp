@@ -1,4 +1,5 @@
 #include "ControllerSDL.hpp"
+#include "SaveState.hpp"
 #include "../Configuration.hpp"
 #include <iostream>
 
@@ -231,6 +232,18 @@ void Controller::writeByte(uint8_t value)
     strobe = value;
 }
 
+void Controller::saveState(StateWriter& writer) const
+{
+    writer.write(strobe);
+    writer.write(buttonIndex);
+}
+
+void Controller::loadState(StateReader& reader)
+{
+    reader.read(strobe);
+    reader.read(buttonIndex);
+}
+
 // Backward compatibility methods
 void Controller::setButtonState(ControllerButton button, bool state)
 {
@@ -37,6 +37,9 @@ enum Player
 #endif // PLAYER_ENUM_DEFINED
 #endif // CONTROLLER_ENUMS_INCLUDED
 
+class StateReader;
+class StateWriter;
+
 /**
  * Emulates NES game controller devices for two players.
  * Supports keyboard input and SDL joystick/gamepad input.
@@ -74,6 +77,17 @@ public:
      */
     void writeByte(uint8_t value);
 
+    /**
+     * Write the strobe and the position of both players' reads to a save
+     * state chunk. The buttons are input and are not saved.
+     */
+    void saveState(StateWriter& writer) const;
+
+    /**
+     * Restore the state written by saveState().
+     */
+    void loadState(StateReader& reader);
+
     // Backward compatibility methods for existing code
     /**
      * Set button state for Player 1 (backward compatibility)
@@ -457,7 +457,7 @@ uint8_t* GameGenie::getPRGROMPointer() {
     if (!nesEmulator) {
         return nullptr;
     }
-    return nesEmulator->getPRGROM();
+    return nesEmulator->getWritablePRGROM();
 }
 
 void GameGenie::reapplyAllCodes() {
@@ -53,23 +53,14 @@ void WarpNES::checkMMC3IRQ(int scanline, int cycle) {
 }
 
 void WarpNES::stepMMC3A12Transition(bool a12High) {
-  static bool lastA12 = false;
-  static int filterCounter = 0;
-
-  // CRITICAL FIX: Proper edge detection with filtering
-  if (a12High != lastA12) {
-    filterCounter++;
-    if (filterCounter >= 1) { // Reduced filter requirement
-      if (a12High && !lastA12) {
-        // Rising edge detected - clock the IRQ counter
-        stepMMC3IRQ();
-      }
-      lastA12 = a12High;
-      filterCounter = 0;
-    }
-  } else {
-    filterCounter = 0;
+  // The last A12 level is kept per engine so clones and save states see it
+  bool &lastA12 = ppuCycleState.lastA12State;
+
+  if (a12High && !lastA12) {
+    // Rising edge detected - clock the IRQ counter
+    stepMMC3IRQ();
   }
+  lastA12 = a12High;
 }
 
 void WarpNES::writeMMC3Register(uint16_t address, uint8_t value) {
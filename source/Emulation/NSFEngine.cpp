@@ -0,0 +1,624 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "NSFEngine.hpp"
+#include "APU.hpp"
+#include "../Configuration.hpp"
+
+// 6502 instruction cycle counts
+const uint8_t NSFEngine::instructionCycles[256] = {
+    // 0x00-0x0F
+    7, 6, 0, 8, 3, 3, 5, 5, 3, 2, 2, 2, 4, 4, 6, 6,
+    // 0x10-0x1F
+    2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
+    // 0x20-0x2F
+    6, 6, 0, 8, 3, 3, 5, 5, 4, 2, 2, 2, 4, 4, 6, 6,
+    // 0x30-0x3F
+    2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
+    // 0x40-0x4F
+    6, 6, 0, 8, 3, 3, 5, 5, 3, 2, 2, 2, 3, 4, 6, 6,
+    // 0x50-0x5F
+    2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
+    // 0x60-0x6F
+    6, 6, 0, 8, 3, 3, 5, 5, 4, 2, 2, 2, 5, 4, 6, 6,
+    // 0x70-0x7F
+    2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
+    // 0x80-0x8F
+    2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4,
+    // 0x90-0x9F
+    2, 6, 0, 6, 4, 4, 4, 4, 2, 5, 2, 5, 5, 5, 5, 5,
+    // 0xA0-0xAF
+    2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4,
+    // 0xB0-0xBF
+    2, 5, 0, 5, 4, 4, 4, 4, 2, 4, 2, 4, 4, 4, 4, 4,
+    // 0xC0-0xCF
+    2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6,
+    // 0xD0-0xDF
+    2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
+    // 0xE0-0xEF
+    2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6,
+    // 0xF0-0xFF
+    2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7};
+
+// FNV-1a parameters for the register write fingerprint
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+static const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+NSFEngine::NSFEngine(bool offline)
+    : offline(offline), loaded(false), currentSong(1), regA(0), regX(0), regY(0), regSP(0xFD),
+      regP(0x24), regPC(0), totalCycles(0), instructionCount(0), bankCount(0),
+      bankswitched(false), apu(nullptr), playPeriod(CYCLES_PER_FRAME),
+      nextPlayCycle(0), frameEndCycle(0), routineOverrun(false), jammed(false),
+      writeHash(FNV_OFFSET_BASIS) {
+  memset(&header, 0, sizeof(header));
+  memset(reportedOpcodes, 0, sizeof(reportedOpcodes));
+  memset(ram, 0, sizeof(ram));
+  memset(workRAM, 0, sizeof(workRAM));
+  memset(banks, 0, sizeof(banks));
+
+  apu = new APU(!offline);
+}
+
+NSFEngine::~NSFEngine() {
+  delete apu;
+}
+
+bool NSFEngine::loadNSF(const std::string &filename, uint8_t song) {
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (!file) {
+    std::cerr << "NSF: Could not open " << filename << std::endl;
+    return false;
+  }
+
+  if (fread(&header, sizeof(header), 1, file) != 1) {
+    std::cerr << "NSF: Could not read header" << std::endl;
+    fclose(file);
+    return false;
+  }
+
+  if (strncmp(header.magic, "NESM\x1A", 5) != 0) {
+    std::cerr << "NSF: Invalid file format" << std::endl;
+    fclose(file);
+    return false;
+  }
+
+  fseek(file, 0, SEEK_END);
+  long dataSize = ftell(file) - (long)sizeof(header);
+  fseek(file, sizeof(header), SEEK_SET);
+
+  if (dataSize <= 0) {
+    std::cerr << "NSF: File contains no program data" << std::endl;
+    fclose(file);
+    return false;
+  }
+
+  bankswitched = false;
+  for (int i = 0; i < 8; i++) {
+    if (header.bankswitch[i] != 0) {
+      bankswitched = true;
+    }
+  }
+
+  // Bankswitched files are laid out from the start of the 4KB bank that
+  // contains the load address, others from $8000
+  uint32_t padding;
+  if (bankswitched) {
+    padding = header.load_addr & 0x0FFF;
+  } else {
+    if (header.load_addr < 0x8000) {
+      std::cerr << "NSF: Load address $" << std::hex << header.load_addr
+                << std::dec << " is below $8000" << std::endl;
+      fclose(file);
+      return false;
+    }
+    padding = header.load_addr - 0x8000;
+  }
+
+  uint32_t imageSize = padding + (uint32_t)dataSize;
+  bankCount = (imageSize + 0x0FFF) / 0x1000;
+  if (!bankswitched && bankCount > 8) {
+    bankCount = 8;
+  }
+
+  rom.assign(bankCount * 0x1000, 0);
+  size_t toRead = rom.size() - padding;
+  if (toRead > (size_t)dataSize) {
+    toRead = (size_t)dataSize;
+  }
+  if (fread(&rom[padding], 1, toRead, file) != toRead) {
+    std::cerr << "NSF: Could not read program data" << std::endl;
+    fclose(file);
+    return false;
+  }
+  fclose(file);
+
+  // Play rate in CPU cycles, on the same clock the APU paces samples with
+  uint64_t clockRate = (uint64_t)CYCLES_PER_FRAME * Configuration::getFrameRate();
+  if (header.ntsc_speed != 0) {
+    playPeriod = (uint32_t)((clockRate * header.ntsc_speed) / 1000000);
+  }
+  if (playPeriod == 0 || header.ntsc_speed == 0) {
+    playPeriod = CYCLES_PER_FRAME;
+  }
+
+  if (!offline) {
+    printf("NSF: Loaded %u bytes in %u banks%s, play every %u cycles\n",
+           (unsigned)dataSize, bankCount, bankswitched ? " (bankswitched)" : "",
+           playPeriod);
+  }
+
+  loaded = true;
+
+  if (song == 0) {
+    song = header.starting_song;
+  }
+  if (song == 0) {
+    song = 1;
+  }
+  return initSong(song);
+}
+
+bool NSFEngine::initSong(uint8_t songNumber) {
+  if (!loaded || songNumber < 1 || songNumber > header.total_songs) {
+    return false;
+  }
+
+  currentSong = songNumber;
+  routineOverrun = false;
+  jammed = false;
+
+  // Clear memory
+  memset(ram, 0, sizeof(ram));
+  memset(workRAM, 0, sizeof(workRAM));
+
+  // Initial bank layout
+  for (int i = 0; i < 8; i++) {
+    banks[i] = bankswitched ? header.bankswitch[i] : i;
+  }
+
+  // Silence the sound registers the way the NSF spec expects
+  for (uint16_t address = 0x4000; address <= 0x4013; address++) {
+    writeByte(address, 0x00);
+  }
+  writeByte(0x4015, 0x00);
+  writeByte(0x4015, 0x0F);
+  writeByte(0x4017, 0x40);
+
+  regA = songNumber - 1; // 0-based song number
+  regX = 0;              // NTSC
+  regY = 0;
+  regSP = 0xFD;
+  regP = 0x24;
+
+  // Give init up to a second to run
+  bool finished = callRoutine(header.init_addr, (uint64_t)CYCLES_PER_FRAME * 60);
+  if (!finished && !offline) {
+    printf("NSF: Init routine for song %d did not return\n", songNumber);
+  }
+
+  nextPlayCycle = totalCycles;
+  frameEndCycle = totalCycles;
+  return finished;
+}
+
+void NSFEngine::update() {
+  if (!loaded) {
+    return;
+  }
+
+  frameEndCycle += CYCLES_PER_FRAME;
+  playWriteHashes.clear();
+
+  // The CPU is idle between play calls, so skip straight to each one. A
+  // jammed CPU makes no more calls, the APU just plays on
+  while (nextPlayCycle < frameEndCycle && !jammed) {
+    if (totalCycles < nextPlayCycle) {
+      totalCycles = nextPlayCycle;
+    }
+
+    writeHash = FNV_OFFSET_BASIS;
+    if (!callRoutine(header.play_addr, (uint64_t)CYCLES_PER_FRAME * 4) &&
+        !routineOverrun && !jammed) {
+      if (!offline) {
+        printf("NSF: Play routine did not return\n");
+      }
+      routineOverrun = true;
+    }
+    playWriteHashes.push_back(writeHash);
+
+    nextPlayCycle += playPeriod;
+    if (nextPlayCycle < totalCycles) {
+      // Play routine ran long, call it again as soon as it's done
+      nextPlayCycle = totalCycles;
+    }
+  }
+
+  if (totalCycles < frameEndCycle) {
+    totalCycles = frameEndCycle;
+  }
+
+  apu->stepFrame(totalCycles);
+}
+
+void NSFEngine::audioCallback(uint8_t *stream, int length) {
+  apu->output(stream, length);
+}
+
+bool NSFEngine::callRoutine(uint16_t address, uint64_t maxCycles) {
+  uint8_t savedSP = regSP;
+
+  // Simulate JSR into the routine, its final RTS returns to the sentinel
+  pushWord(SENTINEL_ADDRESS - 1);
+  regPC = address;
+
+  uint64_t limit = totalCycles + maxCycles;
+  while (regPC != SENTINEL_ADDRESS) {
+    if (totalCycles >= limit || jammed) {
+      regSP = savedSP;
+      return false;
+    }
+    executeInstruction();
+  }
+
+  regSP = savedSP;
+  return true;
+}
+
+// Memory access
+uint8_t NSFEngine::readByte(uint16_t address) {
+  if (address < 0x2000) {
+    return ram[address & 0x7FF];
+  } else if (address >= 0x8000) {
+    uint32_t bank = banks[(address - 0x8000) >> 12] % bankCount;
+    return rom[bank * 0x1000 + (address & 0x0FFF)];
+  } else if (address >= 0x6000) {
+    return workRAM[address - 0x6000];
+  } else if (address == 0x4015) {
+    apu->catchUp(totalCycles);
+    return apu->readStatus();
+  }
+  return 0;
+}
+
+void NSFEngine::writeByte(uint16_t address, uint8_t value) {
+  if (address < 0x2000) {
+    ram[address & 0x7FF] = value;
+  } else if (address >= 0x6000 && address < 0x8000) {
+    workRAM[address - 0x6000] = value;
+  } else if (address >= 0x4000 && address <= 0x4017) {
+    writeHash = (writeHash ^ (address & 0xFF)) * FNV_PRIME;
+    writeHash = (writeHash ^ value) * FNV_PRIME;
+
+    apu->catchUp(totalCycles);
+    apu->writeRegister(address, value);
+  } else if (address >= 0x5FF8 && address <= 0x5FFF) {
+    if (bankswitched) {
+      banks[address - 0x5FF8] = value;
+    }
+  }
+}
+
+uint16_t NSFEngine::readWord(uint16_t address) {
+  return readByte(address) | (readByte(address + 1) << 8);
+}
+
+void NSFEngine::pushByte(uint8_t value) {
+  ram[0x100 + regSP] = value;
+  regSP--;
+}
+
+uint8_t NSFEngine::pullByte() {
+  regSP++;
+  return ram[0x100 + regSP];
+}
+
+void NSFEngine::pushWord(uint16_t value) {
+  pushByte(value >> 8);
+  pushByte(value & 0xFF);
+}
+
+uint16_t NSFEngine::pullWord() {
+  uint8_t lo = pullByte();
+  uint8_t hi = pullByte();
+  return lo | (hi << 8);
+}
+
+uint8_t NSFEngine::fetchByte() { return readByte(regPC++); }
+
+uint16_t NSFEngine::fetchWord() {
+  uint16_t value = readWord(regPC);
+  regPC += 2;
+  return value;
+}
+
+// Flags
+void NSFEngine::setFlag(uint8_t flag, bool value) {
+  if (value) {
+    regP |= flag;
+  } else {
+    regP &= ~flag;
+  }
+}
+
+void NSFEngine::updateZN(uint8_t value) {
+  setFlag(FLAG_ZERO, value == 0);
+  setFlag(FLAG_NEGATIVE, (value & 0x80) != 0);
+}
+
+// Addressing modes
+uint16_t NSFEngine::addrZeroPage() { return fetchByte(); }
+
+uint16_t NSFEngine::addrZeroPageX() { return (fetchByte() + regX) & 0xFF; }
+
+uint16_t NSFEngine::addrZeroPageY() { return (fetchByte() + regY) & 0xFF; }
+
+uint16_t NSFEngine::addrAbsolute() { return fetchWord(); }
+
+uint16_t NSFEngine::addrAbsoluteX() { return fetchWord() + regX; }
+
+uint16_t NSFEngine::addrAbsoluteY() { return fetchWord() + regY; }
+
+uint16_t NSFEngine::addrIndirect() {
+  uint16_t addr = fetchWord();
+  // 6502 bug: if address is $xxFF, high byte is fetched from $xx00
+  return readByte(addr) | (readByte((addr & 0xFF00) | ((addr + 1) & 0xFF)) << 8);
+}
+
+uint16_t NSFEngine::addrIndirectX() {
+  uint8_t addr = (fetchByte() + regX) & 0xFF;
+  return ram[addr] | (ram[(addr + 1) & 0xFF] << 8);
+}
+
+uint16_t NSFEngine::addrIndirectY() {
+  uint8_t addr = fetchByte();
+  uint16_t base = ram[addr] | (ram[(addr + 1) & 0xFF] << 8);
+  return base + regY;
+}
+
+// Instruction helpers
+void NSFEngine::ADC(uint8_t value) {
+  uint16_t sum = regA + value + (getFlag(FLAG_CARRY) ? 1 : 0);
+  setFlag(FLAG_CARRY, sum > 0xFF);
+  setFlag(FLAG_OVERFLOW, (~(regA ^ value) & (regA ^ sum) & 0x80) != 0);
+  regA = sum & 0xFF;
+  updateZN(regA);
+}
+
+void NSFEngine::SBC(uint8_t value) { ADC(value ^ 0xFF); }
+
+void NSFEngine::compare(uint8_t reg, uint8_t value) {
+  setFlag(FLAG_CARRY, reg >= value);
+  updateZN(reg - value);
+}
+
+uint8_t NSFEngine::ASL(uint8_t value) {
+  setFlag(FLAG_CARRY, (value & 0x80) != 0);
+  value <<= 1;
+  updateZN(value);
+  return value;
+}
+
+uint8_t NSFEngine::LSR(uint8_t value) {
+  setFlag(FLAG_CARRY, (value & 0x01) != 0);
+  value >>= 1;
+  updateZN(value);
+  return value;
+}
+
+uint8_t NSFEngine::ROL(uint8_t value) {
+  bool carry = getFlag(FLAG_CARRY);
+  setFlag(FLAG_CARRY, (value & 0x80) != 0);
+  value = (value << 1) | (carry ? 1 : 0);
+  updateZN(value);
+  return value;
+}
+
+uint8_t NSFEngine::ROR(uint8_t value) {
+  bool carry = getFlag(FLAG_CARRY);
+  setFlag(FLAG_CARRY, (value & 0x01) != 0);
+  value = (value >> 1) | (carry ? 0x80 : 0);
+  updateZN(value);
+  return value;
+}
+
+void NSFEngine::branch(bool condition) {
+  int8_t offset = (int8_t)fetchByte();
+  if (condition) {
+    regPC += offset;
+    totalCycles++;
+  }
+}
+
+void NSFEngine::executeInstruction() {
+  uint8_t opcode = fetchByte();
+  uint16_t addr;
+  uint8_t value;
+
+  instructionCount++;
+  totalCycles += instructionCycles[opcode];
+
+  // ORA/AND/EOR/ADC/STA/LDA/CMP/SBC share one encoding: aaabbb01
+  if ((opcode & 0x03) == 0x01) {
+    switch ((opcode >> 2) & 0x07) {
+    case 0: addr = addrIndirectX(); break;
+    case 1: addr = addrZeroPage(); break;
+    case 2: addr = regPC++; break; // Immediate
+    case 3: addr = addrAbsolute(); break;
+    case 4: addr = addrIndirectY(); break;
+    case 5: addr = addrZeroPageX(); break;
+    case 6: addr = addrAbsoluteY(); break;
+    default: addr = addrAbsoluteX(); break;
+    }
+
+    switch (opcode >> 5) {
+    case 0: regA |= readByte(addr); updateZN(regA); break;   // ORA
+    case 1: regA &= readByte(addr); updateZN(regA); break;   // AND
+    case 2: regA ^= readByte(addr); updateZN(regA); break;   // EOR
+    case 3: ADC(readByte(addr)); break;                      // ADC
+    case 4: if (opcode != 0x89) writeByte(addr, regA); break; // STA
+    case 5: regA = readByte(addr); updateZN(regA); break;    // LDA
+    case 6: compare(regA, readByte(addr)); break;            // CMP
+    default: SBC(readByte(addr)); break;                     // SBC
+    }
+    return;
+  }
+
+  switch (opcode) {
+  // Loads and stores
+  case 0xA2: regX = fetchByte(); updateZN(regX); break;
+  case 0xA6: regX = readByte(addrZeroPage()); updateZN(regX); break;
+  case 0xB6: regX = readByte(addrZeroPageY()); updateZN(regX); break;
+  case 0xAE: regX = readByte(addrAbsolute()); updateZN(regX); break;
+  case 0xBE: regX = readByte(addrAbsoluteY()); updateZN(regX); break;
+  case 0xA0: regY = fetchByte(); updateZN(regY); break;
+  case 0xA4: regY = readByte(addrZeroPage()); updateZN(regY); break;
+  case 0xB4: regY = readByte(addrZeroPageX()); updateZN(regY); break;
+  case 0xAC: regY = readByte(addrAbsolute()); updateZN(regY); break;
+  case 0xBC: regY = readByte(addrAbsoluteX()); updateZN(regY); break;
+  case 0x86: writeByte(addrZeroPage(), regX); break;
+  case 0x96: writeByte(addrZeroPageY(), regX); break;
+  case 0x8E: writeByte(addrAbsolute(), regX); break;
+  case 0x84: writeByte(addrZeroPage(), regY); break;
+  case 0x94: writeByte(addrZeroPageX(), regY); break;
+  case 0x8C: writeByte(addrAbsolute(), regY); break;
+
+  // Compares
+  case 0xE0: compare(regX, fetchByte()); break;
+  case 0xE4: compare(regX, readByte(addrZeroPage())); break;
+  case 0xEC: compare(regX, readByte(addrAbsolute())); break;
+  case 0xC0: compare(regY, fetchByte()); break;
+  case 0xC4: compare(regY, readByte(addrZeroPage())); break;
+  case 0xCC: compare(regY, readByte(addrAbsolute())); break;
+
+  // BIT
+  case 0x24:
+  case 0x2C:
+    value = readByte(opcode == 0x24 ? addrZeroPage() : addrAbsolute());
+    setFlag(FLAG_ZERO, (regA & value) == 0);
+    setFlag(FLAG_OVERFLOW, (value & 0x40) != 0);
+    setFlag(FLAG_NEGATIVE, (value & 0x80) != 0);
+    break;
+
+  // Increments and decrements
+  case 0xE6: addr = addrZeroPage(); value = readByte(addr) + 1; writeByte(addr, value); updateZN(value); break;
+  case 0xF6: addr = addrZeroPageX(); value = readByte(addr) + 1; writeByte(addr, value); updateZN(value); break;
+  case 0xEE: addr = addrAbsolute(); value = readByte(addr) + 1; writeByte(addr, value); updateZN(value); break;
+  case 0xFE: addr = addrAbsoluteX(); value = readByte(addr) + 1; writeByte(addr, value); updateZN(value); break;
+  case 0xC6: addr = addrZeroPage(); value = readByte(addr) - 1; writeByte(addr, value); updateZN(value); break;
+  case 0xD6: addr = addrZeroPageX(); value = readByte(addr) - 1; writeByte(addr, value); updateZN(value); break;
+  case 0xCE: addr = addrAbsolute(); value = readByte(addr) - 1; writeByte(addr, value); updateZN(value); break;
+  case 0xDE: addr = addrAbsoluteX(); value = readByte(addr) - 1; writeByte(addr, value); updateZN(value); break;
+  case 0xE8: regX++; updateZN(regX); break;
+  case 0xC8: regY++; updateZN(regY); break;
+  case 0xCA: regX--; updateZN(regX); break;
+  case 0x88: regY--; updateZN(regY); break;
+
+  // Shifts and rotates
+  case 0x0A: regA = ASL(regA); break;
+  case 0x4A: regA = LSR(regA); break;
+  case 0x2A: regA = ROL(regA); break;
+  case 0x6A: regA = ROR(regA); break;
+  case 0x06: addr = addrZeroPage(); writeByte(addr, ASL(readByte(addr))); break;
+  case 0x16: addr = addrZeroPageX(); writeByte(addr, ASL(readByte(addr))); break;
+  case 0x0E: addr = addrAbsolute(); writeByte(addr, ASL(readByte(addr))); break;
+  case 0x1E: addr = addrAbsoluteX(); writeByte(addr, ASL(readByte(addr))); break;
+  case 0x46: addr = addrZeroPage(); writeByte(addr, LSR(readByte(addr))); break;
+  case 0x56: addr = addrZeroPageX(); writeByte(addr, LSR(readByte(addr))); break;
+  case 0x4E: addr = addrAbsolute(); writeByte(addr, LSR(readByte(addr))); break;
+  case 0x5E: addr = addrAbsoluteX(); writeByte(addr, LSR(readByte(addr))); break;
+  case 0x26: addr = addrZeroPage(); writeByte(addr, ROL(readByte(addr))); break;
+  case 0x36: addr = addrZeroPageX(); writeByte(addr, ROL(readByte(addr))); break;
+  case 0x2E: addr = addrAbsolute(); writeByte(addr, ROL(readByte(addr))); break;
+  case 0x3E: addr = addrAbsoluteX(); writeByte(addr, ROL(readByte(addr))); break;
+  case 0x66: addr = addrZeroPage(); writeByte(addr, ROR(readByte(addr))); break;
+  case 0x76: addr = addrZeroPageX(); writeByte(addr, ROR(readByte(addr))); break;
+  case 0x6E: addr = addrAbsolute(); writeByte(addr, ROR(readByte(addr))); break;
+  case 0x7E: addr = addrAbsoluteX(); writeByte(addr, ROR(readByte(addr))); break;
+
+  // Jumps and subroutines
+  case 0x4C: regPC = addrAbsolute(); break;
+  case 0x6C: regPC = addrIndirect(); break;
+  case 0x20:
+    addr = fetchWord();
+    pushWord(regPC - 1);
+    regPC = addr;
+    break;
+  case 0x60: regPC = pullWord() + 1; break;
+  case 0x40:
+    regP = (pullByte() & ~FLAG_BREAK) | FLAG_UNUSED;
+    regPC = pullWord();
+    break;
+  case 0x00:
+    regPC++;
+    pushWord(regPC);
+    pushByte(regP | FLAG_BREAK);
+    setFlag(FLAG_INTERRUPT, true);
+    regPC = readWord(0xFFFE);
+    break;
+
+  // Branches
+  case 0x10: branch(!getFlag(FLAG_NEGATIVE)); break;
+  case 0x30: branch(getFlag(FLAG_NEGATIVE)); break;
+  case 0x50: branch(!getFlag(FLAG_OVERFLOW)); break;
+  case 0x70: branch(getFlag(FLAG_OVERFLOW)); break;
+  case 0x90: branch(!getFlag(FLAG_CARRY)); break;
+  case 0xB0: branch(getFlag(FLAG_CARRY)); break;
+  case 0xD0: branch(!getFlag(FLAG_ZERO)); break;
+  case 0xF0: branch(getFlag(FLAG_ZERO)); break;
+
+  // Flags
+  case 0x18: setFlag(FLAG_CARRY, false); break;
+  case 0x38: setFlag(FLAG_CARRY, true); break;
+  case 0x58: setFlag(FLAG_INTERRUPT, false); break;
+  case 0x78: setFlag(FLAG_INTERRUPT, true); break;
+  case 0xB8: setFlag(FLAG_OVERFLOW, false); break;
+  case 0xD8: setFlag(FLAG_DECIMAL, false); break;
+  case 0xF8: setFlag(FLAG_DECIMAL, true); break;
+
+  // Transfers
+  case 0xAA: regX = regA; updateZN(regX); break;
+  case 0xA8: regY = regA; updateZN(regY); break;
+  case 0xBA: regX = regSP; updateZN(regX); break;
+  case 0x8A: regA = regX; updateZN(regA); break;
+  case 0x9A: regSP = regX; break;
+  case 0x98: regA = regY; updateZN(regA); break;
+
+  // Stack
+  case 0x48: pushByte(regA); break;
+  case 0x68: regA = pullByte(); updateZN(regA); break;
+  case 0x08: pushByte(regP | FLAG_BREAK | FLAG_UNUSED); break;
+  case 0x28: regP = (pullByte() & ~FLAG_BREAK) | FLAG_UNUSED; break;
+
+  // NOPs, including the unofficial ones some drivers use
+  case 0xEA:
+  case 0x1A: case 0x3A: case 0x5A: case 0x7A: case 0xDA: case 0xFA:
+    break;
+  case 0x80: case 0x82: case 0xC2: case 0xE2:
+  case 0x04: case 0x44: case 0x64:
+  case 0x14: case 0x34: case 0x54: case 0x74: case 0xD4: case 0xF4:
+    regPC++;
+    break;
+  case 0x0C:
+  case 0x1C: case 0x3C: case 0x5C: case 0x7C: case 0xDC: case 0xFC:
+    regPC += 2;
+    break;
+
+  // Unofficial SBC immediate
+  case 0xEB: SBC(fetchByte()); break;
+
+  default:
+    // KIL and the unofficial opcodes not handled above. The CPU stops
+    // here rather than run on through data, and each opcode is reported
+    // once so a tune that hits one every frame doesn't flood the console
+    if (!offline && !(reportedOpcodes[opcode >> 6] & (1ULL << (opcode & 63)))) {
+      reportedOpcodes[opcode >> 6] |= 1ULL << (opcode & 63);
+      std::cerr << "NSF: Unknown opcode: $" << std::hex << (int)opcode
+                << " at PC=$" << (regPC - 1) << std::dec
+                << ", stopping song " << (int)currentSong << std::endl;
+    }
+    regPC--;
+    jammed = true;
+    break;
+  }
+}
@@ -0,0 +1,165 @@
+#ifndef NSF_ENGINE_HPP
+#define NSF_ENGINE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class APU;
+
+// NSF file structure
+struct NSFHeader {
+  char magic[5];         // "NESM" + 0x1A
+  uint8_t version;       // Version number
+  uint8_t total_songs;   // Total number of songs
+  uint8_t starting_song; // Starting song (1-based)
+  uint16_t load_addr;    // Load address
+  uint16_t init_addr;    // Init address
+  uint16_t play_addr;    // Play address
+  char title[32];        // Song title
+  char artist[32];       // Artist name
+  char copyright[32];    // Copyright info
+  uint16_t ntsc_speed;   // NTSC speed (1/1000000 sec ticks)
+  uint8_t bankswitch[8]; // Bankswitch init values
+  uint16_t pal_speed;    // PAL speed
+  uint8_t pal_ntsc_bits; // PAL/NTSC bits
+  uint8_t extra_sound;   // Extra sound chip support
+  uint8_t expansion[4];  // Expansion (reserved)
+  // ROM data follows...
+};
+
+/**
+ * Standalone NSF player core
+ * Runs only the 6502 and the APU: no PPU, no controllers, no mappers.
+ * The CPU sits idle between play routine calls, so the cost of playback
+ * is the cost of the init/play code itself plus audio synthesis.
+ */
+class NSFEngine {
+public:
+  // An offline engine, for scanning and rendering, prints nothing and
+  // makes samples even with audio disabled in the configuration
+  explicit NSFEngine(bool offline = false);
+  ~NSFEngine();
+
+  // File loading
+  bool loadNSF(const std::string &filename, uint8_t song = 0); // Inits song, 0 for the starting one
+  bool isLoaded() const { return loaded; }
+  const NSFHeader &getHeader() const { return header; }
+
+  // Playback control
+  bool initSong(uint8_t songNumber); // 1-based, runs the init routine
+  void update();                     // Emulate one video frame worth of time
+  uint8_t getCurrentSong() const { return currentSong; }
+
+  // Audio
+  void audioCallback(uint8_t *stream, int length);
+  APU *getAPU() { return apu; }
+
+  // Statistics
+  uint64_t getTotalCycles() const { return totalCycles; }
+  uint64_t getInstructionCount() const { return instructionCount; }
+  uint32_t getPlayPeriod() const { return playPeriod; }
+
+  // Fingerprints of the APU register writes made by each play call
+  // during the last update()
+  const std::vector<uint64_t> &getPlayWriteHashes() const { return playWriteHashes; }
+
+  // Timing
+  static const int CYCLES_PER_FRAME = 29780; // NTSC timing
+
+private:
+  // Return address pushed before calling init/play; RTS lands here
+  static const uint16_t SENTINEL_ADDRESS = 0x4100;
+
+  // Status flags
+  enum {
+    FLAG_CARRY = 0x01,
+    FLAG_ZERO = 0x02,
+    FLAG_INTERRUPT = 0x04,
+    FLAG_DECIMAL = 0x08,
+    FLAG_BREAK = 0x10,
+    FLAG_UNUSED = 0x20,
+    FLAG_OVERFLOW = 0x40,
+    FLAG_NEGATIVE = 0x80
+  };
+
+  static const uint8_t instructionCycles[256];
+
+  NSFHeader header;
+  bool offline;
+  bool loaded;
+  uint8_t currentSong;
+
+  // CPU state
+  uint8_t regA, regX, regY, regSP, regP;
+  uint16_t regPC;
+  uint64_t totalCycles;
+  uint64_t instructionCount;
+
+  // Memory
+  uint8_t ram[0x800];       // 2KB internal RAM
+  uint8_t workRAM[0x2000];  // $6000-$7FFF
+  std::vector<uint8_t> rom; // NSF data padded to 4KB banks
+  uint32_t bankCount;
+  uint8_t banks[8];         // 4KB bank mapped at $8000 + n * $1000
+  bool bankswitched;
+
+  APU *apu;
+
+  // Play routine scheduling
+  uint32_t playPeriod;     // CPU cycles between play calls
+  uint64_t nextPlayCycle;  // Cycle of the next play call
+  uint64_t frameEndCycle;  // Cycle the current frame ends at
+  bool routineOverrun;
+  bool jammed;             // Hit an opcode it can't run, stopped until the next init
+
+  // Unknown opcodes already reported, one bit each
+  uint64_t reportedOpcodes[4];
+
+  // APU write fingerprints
+  uint64_t writeHash;
+  std::vector<uint64_t> playWriteHashes;
+
+  // Memory access
+  uint8_t readByte(uint16_t address);
+  void writeByte(uint16_t address, uint8_t value);
+  uint16_t readWord(uint16_t address);
+  void pushByte(uint8_t value);
+  uint8_t pullByte();
+  void pushWord(uint16_t value);
+  uint16_t pullWord();
+  uint8_t fetchByte();
+  uint16_t fetchWord();
+
+  // Routine calls
+  bool callRoutine(uint16_t address, uint64_t maxCycles);
+  void executeInstruction();
+
+  // Flags
+  void setFlag(uint8_t flag, bool value);
+  bool getFlag(uint8_t flag) const { return (regP & flag) != 0; }
+  void updateZN(uint8_t value);
+
+  // Addressing modes
+  uint16_t addrZeroPage();
+  uint16_t addrZeroPageX();
+  uint16_t addrZeroPageY();
+  uint16_t addrAbsolute();
+  uint16_t addrAbsoluteX();
+  uint16_t addrAbsoluteY();
+  uint16_t addrIndirect();
+  uint16_t addrIndirectX();
+  uint16_t addrIndirectY();
+
+  // Instruction helpers
+  void ADC(uint8_t value);
+  void SBC(uint8_t value);
+  void compare(uint8_t reg, uint8_t value);
+  uint8_t ASL(uint8_t value);
+  uint8_t LSR(uint8_t value);
+  uint8_t ROL(uint8_t value);
+  uint8_t ROR(uint8_t value);
+  void branch(bool condition);
+};
+
+#endif // NSF_ENGINE_HPP
@@ -4,6 +4,7 @@
 #include "WarpNES.hpp"
 
 #include "PPU.hpp"
+#include "../DirtyRows.hpp"
 
 /*#include <cstdint>
 #include <vector>
@@ -34,6 +35,8 @@ struct FlipCacheEntry {
 };
 
 class WarpNES;  // Forward declaration
+class StateReader;
+class StateWriter;
 
 /**
  * Emulates the NES Picture Processing Unit.
@@ -54,6 +57,34 @@ public:
 
     void writeRegister(uint16_t address, uint8_t value);
     void render16(uint16_t* buffer);
+
+    /**
+     * Render scanlines straight into an external buffer instead of the
+     * internal one, saving the render16() copy. Every visible pixel is
+     * written each frame, so the buffer may change between frames.
+     * @param buffer 256x240 RGB565 buffer, or nullptr for the internal one
+     */
+    void setOutputBuffer(uint16_t* buffer);
+
+    /**
+     * Get the rows of the last completed frame that differ from the frame
+     * before it.
+     */
+    const DirtyRows& getDirtyRows() const { return dirtyRows; }
+
+    /**
+     * Turn drawing frames on or off. Frames emulated without it are not
+     * counted and leave the frame buffer and the dirty rows alone, so a
+     * consumer sees the next drawn frame as following the last one.
+     */
+    void setVideoOutput(bool enabled);
+    bool getVideoOutput() const;
+
+    /**
+     * Get the number of frames completed, so a consumer can tell whether
+     * it missed one and the dirty rows no longer cover its last frame.
+     */
+    uint64_t getFrameNumber() const { return frameNumber; }
     
     // Getter methods
     uint8_t* getVRAM() { return nametable; }
@@ -86,10 +117,19 @@ public:
     void setVRAMAddress(uint16_t val) { currentAddress = val; }
     void setWriteToggle(bool val) { writeToggle = val; }
     void setDataBuffer(uint8_t val) { vramBuffer = val; }
-    
-    // Scaling methods
-    void renderScaled(uint16_t* buffer, int screenWidth, int screenHeight);
-    void renderScaled32(uint32_t* buffer, int screenWidth, int screenHeight);
+
+    /**
+     * Write the registers, memory, timing and per-scanline scroll state to
+     * a save state chunk.
+     */
+    void saveState(StateWriter& writer) const;
+
+    /**
+     * Restore the state written by saveState(). The frame buffer and the
+     * change tracking are left alone, so the next frame is compared with
+     * the last one shown.
+     */
+    void loadState(StateReader& reader);
     
     // PPU state methods
     void setVBlankFlag(bool flag);
@@ -121,27 +161,21 @@ private:
 
     uint8_t spritePriorityMask[256 * 240];
 
-    struct ScalingCache {
-        uint16_t* scaledBuffer;
-        int* sourceToDestX;
-        int* sourceToDestY;
-        int scaleFactor;
-        int destWidth, destHeight;
-        int destOffsetX, destOffsetY;
-        int screenWidth, screenHeight;
-        bool isValid;        
-        ScalingCache();
-        ~ScalingCache();
-        void cleanup();
-    };
-
     uint8_t scanlineScrollX[240];   // Scroll X value for each scanline
     uint8_t scanlineCtrl[240];      // Control register value for each scanline
     uint8_t backgroundMask[256 * 240];
     // Scanline-based rendering state
-    uint16_t frameBuffer[256 * 240];
+    uint16_t frameStorage[256 * 240];
+    uint16_t* frameBuffer;          // Where scanlines are rendered, frameStorage unless redirected
     int currentRenderScanline;
     bool frameComplete;
+
+    // Change tracking against the previous frame
+    uint16_t previousFrame[256 * 240];
+    DirtyRows pendingDirtyRows;     // Rows changed so far in the frame being rendered
+    DirtyRows dirtyRows;            // Rows changed in the last completed frame
+    uint64_t frameNumber;
+    bool videoOutput;               // Whether frames are drawn
     
     // Scanline rendering methods
     void renderScanline(int scanline, int mapper);
@@ -151,22 +185,6 @@ private:
 
     void clearScanline(int scanline);
     void checkSprite0HitScanline(int scanline);
-    
-    static ScalingCache g_scalingCache;
-    
-    // Scaling methods
-    void initializeScalingCache(int screenWidth, int screenHeight);
-    void updateScalingCache(int screenWidth, int screenHeight);
-    bool isScalingCacheValid(int screenWidth, int screenHeight);
-    
-    // Optimized scaling implementations
-    void renderScaled1x1(uint16_t* nesBuffer, uint16_t* screenBuffer, int screenWidth, int screenHeight);
-    void renderScaled2x(uint16_t* nesBuffer, uint16_t* screenBuffer, int screenWidth, int screenHeight);
-    void renderScaled3x(uint16_t* nesBuffer, uint16_t* screenBuffer, int screenWidth, int screenHeight);
-    void renderScaledGeneric(uint16_t* nesBuffer, uint16_t* screenBuffer, int screenWidth, int screenHeight, int scale);
-    
-    // Color conversion
-    void convertNESToScreen32(uint16_t* nesBuffer, uint32_t* screenBuffer, int screenWidth, int screenHeight);
 
     // PPU registers
     uint8_t ppuCtrl; /**< $2000 */
@@ -0,0 +1,251 @@
+#include <fstream>
+#include <map>
+#include <tuple>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#ifndef __DJGPP__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#endif
+
+#ifndef __DJGPP__
+#include <mutex>
+#endif
+
+#include "ROMImage.hpp"
+
+/**
+ * Tells files apart without reading them. The same key is the same file,
+ * unchanged since it was opened.
+ */
+struct ROMFileKey {
+    uint64_t device;
+    uint64_t index;         /**< The inode, or the file index on Windows */
+    uint64_t size;
+    int64_t modified;
+
+    bool operator<(const ROMFileKey& other) const
+    {
+        return std::tie(device, index, size, modified) <
+               std::tie(other.device, other.index, other.size, other.modified);
+    }
+};
+
+// Open images by file. They are only weakly held so an image goes away
+// with the last engine using it.
+static std::map<ROMFileKey, std::weak_ptr<const ROMImage>> openImages;
+#ifndef __DJGPP__
+static std::mutex openImagesMutex;
+#endif
+
+static bool getFileKey(const std::string& filename, ROMFileKey& key)
+{
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(filename.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    BY_HANDLE_FILE_INFORMATION info;
+    bool ok = GetFileInformationByHandle(file, &info) != 0;
+    CloseHandle(file);
+    if (!ok) {
+        return false;
+    }
+    key.device = info.dwVolumeSerialNumber;
+    key.index = ((uint64_t)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+    key.size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    key.modified = (int64_t)(((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) |
+                             info.ftLastWriteTime.dwLowDateTime);
+    return true;
+#else
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0) {
+        return false;
+    }
+    key.device = (uint64_t)info.st_dev;
+    key.index = (uint64_t)info.st_ino;
+    key.size = (uint64_t)info.st_size;
+    key.modified = (int64_t)info.st_mtime;
+    return true;
+#endif
+}
+
+ROMImage::ROMImage() :
+    data(nullptr), size(0), mapped(false)
+{
+#ifdef _WIN32
+    mapping = nullptr;
+#endif
+}
+
+ROMImage::~ROMImage()
+{
+    unmap();
+}
+
+std::shared_ptr<const ROMImage> ROMImage::open(const std::string& filename)
+{
+    ROMFileKey key;
+    if (!getFileKey(filename, key)) {
+        return nullptr;
+    }
+
+    // Held while opening, so two engines opening the same file at once
+    // still share one image
+#ifndef __DJGPP__
+    std::lock_guard<std::mutex> lock(openImagesMutex);
+#endif
+    auto found = openImages.find(key);
+    if (found != openImages.end()) {
+        std::shared_ptr<const ROMImage> existing = found->second.lock();
+        if (existing) {
+            return existing;
+        }
+    }
+
+    std::shared_ptr<ROMImage> image(new ROMImage());
+    if (!image->map(filename) && !image->read(filename)) {
+        return nullptr;
+    }
+
+    // Drop the entries of images that are gone while here
+    for (auto it = openImages.begin(); it != openImages.end();) {
+        if (it->second.expired()) {
+            it = openImages.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    openImages[key] = image;
+    return image;
+}
+
+const uint8_t* ROMImage::getData() const
+{
+    return data;
+}
+
+size_t ROMImage::getSize() const
+{
+    return size;
+}
+
+bool ROMImage::isMapped() const
+{
+    return mapped;
+}
+
+void ROMImage::getOpenImages(size_t& count, size_t& bytes)
+{
+#ifndef __DJGPP__
+    std::lock_guard<std::mutex> lock(openImagesMutex);
+#endif
+    count = 0;
+    bytes = 0;
+    for (const auto& entry : openImages) {
+        std::shared_ptr<const ROMImage> image = entry.second.lock();
+        if (image) {
+            count++;
+            bytes += image->size;
+        }
+    }
+}
+
+bool ROMImage::map(const std::string& filename)
+{
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0) {
+        CloseHandle(file);
+        return false;
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) {
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        mapping = nullptr;
+        return false;
+    }
+    data = static_cast<const uint8_t*>(view);
+    size = (size_t)fileSize.QuadPart;
+    mapped = true;
+    return true;
+#elif !defined(__DJGPP__)
+    int file = ::open(filename.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(file, &info) != 0 || info.st_size <= 0) {
+        close(file);
+        return false;
+    }
+    void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    data = static_cast<const uint8_t*>(view);
+    size = (size_t)info.st_size;
+    mapped = true;
+    return true;
+#else
+    (void)filename;
+    return false;
+#endif
+}
+
+bool ROMImage::read(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::streamoff length = file.tellg();
+    if (length <= 0) {
+        return false;
+    }
+    buffer.resize((size_t)length);
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(buffer.data()), buffer.size())) {
+        return false;
+    }
+    data = buffer.data();
+    size = buffer.size();
+    mapped = false;
+    return true;
+}
+
+void ROMImage::unmap()
+{
+    if (!mapped) {
+        return;
+    }
+#if defined(_WIN32)
+    UnmapViewOfFile(data);
+    CloseHandle(mapping);
+    mapping = nullptr;
+#elif !defined(__DJGPP__)
+    munmap(const_cast<uint8_t*>(data), size);
+#endif
+    data = nullptr;
+    mapped = false;
+}
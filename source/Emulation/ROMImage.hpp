@@ -0,0 +1,63 @@
+#ifndef ROM_IMAGE_HPP
+#define ROM_IMAGE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * A ROM file loaded once and shared read-only by every engine that loads
+ * the same file.
+ *
+ * The file is memory-mapped where the system allows it, so only the pages
+ * a game actually touches are read from disk and the page cache is shared
+ * with other processes running the same ROM. On DOS, or if mapping fails,
+ * the file is read into memory instead. Images are found again by the
+ * file's device, inode, size and modification time, so opening a ROM that
+ * is already open reads nothing, and one that has changed since gets a
+ * new image. The image is freed when the last engine holding it lets go.
+ */
+class ROMImage {
+public:
+    ~ROMImage();
+
+    /**
+     * Open a ROM file, or get the image already open of the same file.
+     * @return the image, or nullptr if the file can not be read or is empty
+     */
+    static std::shared_ptr<const ROMImage> open(const std::string& filename);
+
+    const uint8_t* getData() const;
+    size_t getSize() const;
+
+    /**
+     * Check whether the image is a mapping of the file rather than a copy.
+     */
+    bool isMapped() const;
+
+    /**
+     * Get the number of images open and the bytes they hold.
+     */
+    static void getOpenImages(size_t& count, size_t& bytes);
+
+private:
+    ROMImage();
+    ROMImage(const ROMImage&) = delete;
+    ROMImage& operator=(const ROMImage&) = delete;
+
+    bool map(const std::string& filename);
+    bool read(const std::string& filename);
+    void unmap();
+
+    const uint8_t* data;
+    size_t size;
+    bool mapped;
+    std::vector<uint8_t> buffer;   /**< The contents when not mapped */
+#ifdef _WIN32
+    void* mapping;
+#endif
+};
+
+#endif // ROM_IMAGE_HPP
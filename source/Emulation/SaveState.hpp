@@ -0,0 +1,192 @@
+#ifndef SAVE_STATE_HPP
+#define SAVE_STATE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * Save states are a header followed by chunks. Each chunk is a four
+ * character id, a payload size and the payload, so a reader can skip
+ * chunks it does not know and fields appended to the end of a chunk it
+ * does. Values are stored in host byte order.
+ *
+ * A chunk whose layout changes gets a new id, and the old id is still
+ * read, so older states keep loading. The version only changes for what
+ * chunks can not handle, and a reader accepts any version up to its own.
+ * Version 1 states came before chunks and are read by WarpNES on its own.
+ */
+static const char STATE_MAGIC[8] = { 'N', 'E', 'S', 'S', 'A', 'V', 'E', '\0' };
+static const uint32_t STATE_VERSION = 2;
+static const uint32_t STATE_FIRST_VERSION = 2;  /**< The first chunked version */
+static const uint8_t STATE_LEGACY_VERSION = 1;  /**< One struct, its version a single byte */
+static const size_t STATE_HEADER_SIZE = sizeof(STATE_MAGIC) + sizeof(uint32_t);
+static const size_t STATE_CHUNK_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+constexpr uint32_t stateChunkId(char a, char b, char c, char d)
+{
+    return (uint32_t)(uint8_t)a | ((uint32_t)(uint8_t)b << 8) | ((uint32_t)(uint8_t)c << 16) | ((uint32_t)(uint8_t)d << 24);
+}
+
+/**
+ * Writes a save state into a caller's buffer. With no buffer it only
+ * counts, which gives the size a buffer needs.
+ */
+class StateWriter {
+public:
+    StateWriter(uint8_t* buffer, size_t capacity) :
+        buffer(buffer), capacity(capacity), position(0), chunkStart(0), overflow(false)
+    {
+        writeBytes(STATE_MAGIC, sizeof(STATE_MAGIC));
+        write(STATE_VERSION);
+    }
+
+    void beginChunk(uint32_t id)
+    {
+        write(id);
+        chunkStart = position;
+        write((uint32_t)0);
+    }
+
+    void endChunk()
+    {
+        uint32_t size = (uint32_t)(position - chunkStart - sizeof(uint32_t));
+        if (buffer && !overflow) {
+            memcpy(buffer + chunkStart, &size, sizeof(size));
+        }
+    }
+
+    template <typename T>
+    void write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "save state values must be plain data");
+        writeBytes(&value, sizeof(T));
+    }
+
+    void writeBytes(const void* data, size_t length)
+    {
+        if (buffer) {
+            if (overflow || length > capacity - position) {
+                overflow = true;
+                return;
+            }
+            memcpy(buffer + position, data, length);
+        }
+        position += length;
+    }
+
+    /**
+     * Get the bytes written, or needed when counting.
+     */
+    size_t getSize() const { return position; }
+
+    /**
+     * Check whether everything fit in the buffer.
+     */
+    bool ok() const { return !overflow; }
+
+private:
+    uint8_t* buffer;
+    size_t capacity;
+    size_t position;
+    size_t chunkStart;
+    bool overflow;
+};
+
+/**
+ * Reads a save state written by StateWriter. Reads past the end of a
+ * chunk fail and leave the value zeroed, so a chunk from an older version
+ * loads with defaults for the fields it does not have.
+ */
+class StateReader {
+public:
+    StateReader(const uint8_t* data, size_t size) :
+        data(data), size(size), position(0), chunkEnd(0), valid(false), truncated(false)
+    {
+        if (size >= STATE_HEADER_SIZE && memcmp(data, STATE_MAGIC, sizeof(STATE_MAGIC)) == 0) {
+            memcpy(&version, data + sizeof(STATE_MAGIC), sizeof(version));
+            valid = version >= STATE_FIRST_VERSION && version <= STATE_VERSION;
+            position = STATE_HEADER_SIZE;
+            chunkEnd = position;
+        } else {
+            version = 0;
+        }
+    }
+
+    /**
+     * Check whether the data starts with a save state header of a version
+     * this reader understands.
+     */
+    bool isValid() const { return valid; }
+
+    uint32_t getVersion() const { return version; }
+
+    /**
+     * Move to the next chunk, skipping whatever was not read of this one.
+     * @return false at the end of the data
+     */
+    bool nextChunk(uint32_t& id)
+    {
+        position = chunkEnd;
+        if (!valid || size - position < STATE_CHUNK_HEADER_SIZE) {
+            return false;
+        }
+
+        uint32_t length;
+        memcpy(&id, data + position, sizeof(id));
+        memcpy(&length, data + position + sizeof(id), sizeof(length));
+        position += STATE_CHUNK_HEADER_SIZE;
+        if (length > size - position) {
+            truncated = true;
+            chunkEnd = size;
+            return false;
+        }
+        chunkEnd = position + length;
+        return true;
+    }
+
+    template <typename T>
+    void read(T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "save state values must be plain data");
+        readBytes(&value, sizeof(T));
+    }
+
+    void readBytes(void* out, size_t length)
+    {
+        if (length > chunkEnd - position) {
+            memset(out, 0, length);
+            position = chunkEnd;
+            return;
+        }
+        memcpy(out, data + position, length);
+        position += length;
+    }
+
+    /**
+     * Get the unread bytes left in the current chunk.
+     */
+    size_t getChunkRemaining() const { return chunkEnd - position; }
+
+    /**
+     * Get the unread bytes of the current chunk, getChunkRemaining() long.
+     */
+    const uint8_t* getChunkData() const { return data + position; }
+
+    /**
+     * Check whether a chunk ran past the end of the data.
+     */
+    bool isTruncated() const { return truncated; }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t position;
+    size_t chunkEnd;
+    uint32_t version;
+    bool valid;
+    bool truncated;
+};
+
+#endif // SAVE_STATE_HPP
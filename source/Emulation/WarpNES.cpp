@@ -1,11 +1,17 @@
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <string>
 
 #include "WarpNES.hpp"
 #include "../Configuration.hpp"
+#include "../FilterChain.hpp"
 #include "../Emulation/APU.hpp"
+#include "../Emulation/AtomicFile.hpp"
 #include "../Emulation/PPU.hpp"
+#include "../Emulation/ROMImage.hpp"
+#include "../Emulation/SaveState.hpp"
 
 #ifdef ALLEGRO_BUILD
 #include "../Emulation/Controller.hpp"
@@ -50,18 +56,19 @@ const uint8_t WarpNES::instructionCycles[256] = {
     // 0xF0-0xFF
     2, 5, 0, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7};
 
-WarpNES::WarpNES()
+WarpNES::WarpNES(bool playback)
     : regA(0), regX(0), regY(0), regSP(0xFF), regPC(0), regP(0x24),
       totalCycles(0), frameCycles(0), prgROM(nullptr), chrROM(nullptr),
-      prgSize(0), chrSize(0), romLoaded(false), masterCycles(0), ppuCycles(0),
+      prgPrivate(false), prgSize(0), chrSize(0), romLoaded(false), masterCycles(0), ppuCycles(0),
       nmiPending(false), sram(nullptr), sramSize(0), sramEnabled(false),
-      sramDirty(false) {
+      sramDirty(false), sramDirtyPages(0) {
   // Initialize RAM
   memset(ram, 0, sizeof(ram));
   memset(&nesHeader, 0, sizeof(nesHeader));
+  memset(&ppuCycleState, 0, sizeof(ppuCycleState));
 
   // Create components - they'll get CHR data when ROM is loaded
-  apu = new APU();
+  apu = new APU(playback);
   ppu = new PPU(*this);
 
   controller1 = new Controller();
@@ -144,8 +151,8 @@ void WarpNES::writeCHRData(uint16_t address, uint8_t value) {
     break;
 
   case 2: // UxROM
-    // UxROM always uses CHR-RAM
-    if (address < chrSize) {
+    // UxROM almost always uses CHR-RAM, CHR-ROM is never written
+    if (nesHeader.chrROMPages == 0 && address < chrSize) {
       chrROM[address] = value; // chrROM is actually CHR-RAM for UxROM
 
       static int uxromChrWriteCount = 0;
@@ -220,7 +227,7 @@ void WarpNES::writeCHRData(uint16_t address, uint8_t value) {
     break;
   case 7: // AxROM
     // AxROM typically uses CHR-RAM
-    if (address < chrSize) {
+    if (nesHeader.chrROMPages == 0 && address < chrSize) {
       chrROM[address] = value;
 
       static int axromChrWriteCount = 0;
@@ -262,7 +269,7 @@ void WarpNES::writeCHRData(uint16_t address, uint8_t value) {
 
   case 13: // CPROM
     // CPROM uses CHR-RAM
-    if (address < chrSize) {
+    if (nesHeader.chrROMPages == 0 && address < chrSize) {
       chrROM[address] = value;
 
       static int cpromChrWriteCount = 0;
@@ -276,7 +283,7 @@ void WarpNES::writeCHRData(uint16_t address, uint8_t value) {
   case 28: // Action 53
   case 30: // UNROM 512
     // These modern homebrew mappers often use CHR-RAM
-    if (address < chrSize) {
+    if (nesHeader.chrROMPages == 0 && address < chrSize) {
       chrROM[address] = value;
 
       static int homebrewChrWriteCount = 0;
@@ -316,9 +323,29 @@ void WarpNES::writeCHRData(uint16_t address, uint8_t value) {
 }
 
 // Modify loadROM to initialize SRAM:
+/**
+ * Allocate ROM storage that clones can share.
+ */
+static uint8_t *allocateROM(std::shared_ptr<uint8_t> &storage, uint32_t size) {
+  storage.reset(new uint8_t[size], std::default_delete<uint8_t[]>());
+  return storage.get();
+}
+
+/**
+ * Point ROM storage into a ROM image, keeping the image alive.
+ */
+static uint8_t *shareROM(std::shared_ptr<uint8_t> &storage,
+                         const std::shared_ptr<const ROMImage> &image,
+                         size_t offset) {
+  // Never written, see getWritablePRGROM()
+  storage = std::shared_ptr<uint8_t>(
+      image, const_cast<uint8_t *>(image->getData() + offset));
+  return storage.get();
+}
+
 bool WarpNES::loadROM(const std::string &filename) {
-  std::ifstream file(filename, std::ios::binary);
-  if (!file.is_open()) {
+  std::shared_ptr<const ROMImage> image = ROMImage::open(filename);
+  if (!image) {
     std::cerr << "Failed to open ROM file: " << filename << std::endl;
     return false;
   }
@@ -336,34 +363,40 @@ bool WarpNES::loadROM(const std::string &filename) {
   romBaseName = filename.substr(lastSlash, lastDot - lastSlash);
 
   // Parse NES header
-  if (!parseNESHeader(file)) {
+  if (image->getSize() < 16 || !parseNESHeader(image->getData())) {
     std::cerr << "Invalid NES ROM header" << std::endl;
     return false;
   }
 
   // Skip trainer if present
+  size_t offset = 16;
   if (nesHeader.trainer) {
-    file.seekg(512, std::ios::cur);
+    offset += 512;
   }
 
   // Load PRG ROM
-  if (!loadPRGROM(file)) {
+  if (!loadPRGROM(image, offset)) {
     std::cerr << "Failed to load PRG ROM" << std::endl;
     return false;
   }
+  offset += prgSize;
 
   // Load CHR ROM
-  if (!loadCHRROM(file)) {
+  if (!loadCHRROM(image, offset)) {
     std::cerr << "Failed to load CHR ROM" << std::endl;
     return false;
   }
 
-  file.close();
   romLoaded = true;
 
+  size_t imageCount, imageBytes;
+  ROMImage::getOpenImages(imageCount, imageBytes);
   std::cout << "ROM loaded successfully: " << filename << std::endl;
   std::cout << "PRG ROM: " << (prgSize / 1024)
             << "KB, CHR ROM: " << (chrSize / 1024) << "KB" << std::endl;
+  std::cout << "ROM image: " << (image->isMapped() ? "mapped" : "read")
+            << ", " << imageCount << " image(s) open in all ("
+            << (imageBytes / 1024) << "KB)" << std::endl;
   std::cout << "Mapper: " << (int)nesHeader.mapper << ", Mirroring: "
             << (nesHeader.mirroring ? "Vertical" : "Horizontal") << std::endl;
 
@@ -377,68 +410,78 @@ bool WarpNES::loadROM(const std::string &filename) {
 }
 
 void WarpNES::unloadROM() {
-  if (prgROM) {
-    delete[] prgROM;
-    prgROM = nullptr;
-  }
-  if (chrROM) {
-    delete[] chrROM;
-    chrROM = nullptr;
-  }
+  prgData.reset();
+  chrData.reset();
+  prgROM = nullptr;
+  chrROM = nullptr;
+  prgPrivate = false;
   prgSize = chrSize = 0;
   romLoaded = false;
 }
 
-bool WarpNES::parseNESHeader(std::ifstream &file) {
-  uint8_t header[16];
-  file.read(reinterpret_cast<char *>(header), 16);
-
-  if (!file.good())
-    return false;
-
+bool WarpNES::readNESHeader(const uint8_t *header, NESHeader &info,
+                            bool *isINES2) {
   // Check "NES\x1A" signature
   if (header[0] != 'N' || header[1] != 'E' || header[2] != 'S' ||
       header[3] != 0x1A) {
-    std::cout << "Invalid NES signature" << std::endl;
     return false;
   }
 
   // Detect iNES format version
-  bool isINES2 = false;
-  if ((header[7] & 0x0C) == 0x08) {
-    isINES2 = true;
-    std::cout << "ROM Format: iNES 2.0" << std::endl;
-  } else if ((header[7] & 0x0C) == 0x00) {
-    // Check if bytes 12-15 are zero (archaic iNES vs iNES 1.0)
-    bool hasTrailingZeros = (header[12] == 0 && header[13] == 0 &&
-                             header[14] == 0 && header[15] == 0);
-    if (hasTrailingZeros) {
-      std::cout << "ROM Format: iNES 1.0" << std::endl;
-    } else {
-      std::cout << "ROM Format: Archaic iNES" << std::endl;
-    }
-  } else {
-    std::cout << "ROM Format: Unknown/Invalid" << std::endl;
+  bool ines2 = (header[7] & 0x0C) == 0x08;
+  if (!ines2 && (header[7] & 0x0C) != 0x00) {
     return false;
   }
 
   // Parse basic header info
-  nesHeader.prgROMPages = header[4];
-  nesHeader.chrROMPages = header[5];
+  info.prgROMPages = header[4];
+  info.chrROMPages = header[5];
 
   // Parse mapper number
-  if (isINES2) {
+  if (ines2) {
     // iNES 2.0 mapper parsing (12-bit mapper number)
-    nesHeader.mapper =
+    info.mapper =
         (header[6] >> 4) | (header[7] & 0xF0) | ((header[8] & 0x0F) << 8);
   } else {
     // iNES 1.0 mapper parsing (8-bit mapper number)
-    nesHeader.mapper = (header[6] >> 4) | (header[7] & 0xF0);
+    info.mapper = (header[6] >> 4) | (header[7] & 0xF0);
   }
 
-  nesHeader.mirroring = header[6] & 0x01;
-  nesHeader.battery = (header[6] & 0x02) != 0;
-  nesHeader.trainer = (header[6] & 0x04) != 0;
+  info.mirroring = header[6] & 0x01;
+  info.battery = (header[6] & 0x02) != 0;
+  info.trainer = (header[6] & 0x04) != 0;
+
+  if (isINES2) {
+    *isINES2 = ines2;
+  }
+  return true;
+}
+
+bool WarpNES::parseNESHeader(const uint8_t *header) {
+  bool isINES2 = false;
+  if (!readNESHeader(header, nesHeader, &isINES2)) {
+    if (header[0] != 'N' || header[1] != 'E' || header[2] != 'S' ||
+        header[3] != 0x1A) {
+      std::cout << "Invalid NES signature" << std::endl;
+    } else {
+      std::cout << "ROM Format: Unknown/Invalid" << std::endl;
+    }
+    return false;
+  }
+
+  // Detect iNES format version
+  if (isINES2) {
+    std::cout << "ROM Format: iNES 2.0" << std::endl;
+  } else {
+    // Check if bytes 12-15 are zero (archaic iNES vs iNES 1.0)
+    bool hasTrailingZeros = (header[12] == 0 && header[13] == 0 &&
+                             header[14] == 0 && header[15] == 0);
+    if (hasTrailingZeros) {
+      std::cout << "ROM Format: iNES 1.0" << std::endl;
+    } else {
+      std::cout << "ROM Format: Archaic iNES" << std::endl;
+    }
+  }
 
   // Print detailed header info
   std::cout << "=== ROM Header Info ===" << std::endl;
@@ -497,23 +540,39 @@ bool WarpNES::parseNESHeader(std::ifstream &file) {
   return true;
 }
 
-bool WarpNES::loadPRGROM(std::ifstream &file) {
+bool WarpNES::loadPRGROM(const std::shared_ptr<const ROMImage> &image,
+                         size_t offset) {
   prgSize = nesHeader.prgROMPages * 16384; // 16KB pages
-  if (prgSize == 0)
+  if (prgSize == 0 || offset + prgSize > image->getSize())
     return false;
 
-  prgROM = new uint8_t[prgSize];
-  file.read(reinterpret_cast<char *>(prgROM), prgSize);
+  prgROM = shareROM(prgData, image, offset);
+  prgPrivate = false;
 
-  return file.good();
+  return true;
 }
 
-bool WarpNES::loadCHRROM(std::ifstream &file) {
+uint8_t *WarpNES::getWritablePRGROM() {
+  if (!prgROM) {
+    return nullptr;
+  }
+  if (!prgPrivate || prgData.use_count() > 1) {
+    // Copy on write, whoever else holds the original keeps it
+    std::shared_ptr<uint8_t> original = prgData;
+    prgROM = allocateROM(prgData, prgSize);
+    memcpy(prgROM, original.get(), prgSize);
+    prgPrivate = true;
+  }
+  return prgROM;
+}
+
+bool WarpNES::loadCHRROM(const std::shared_ptr<const ROMImage> &image,
+                         size_t offset) {
   printf("LoadCHRROM\n");
   chrSize = nesHeader.chrROMPages * 8192; // 8KB pages
   if (chrSize == 0) {
     chrSize = 8192;
-    chrROM = new uint8_t[chrSize];
+    chrROM = allocateROM(chrData, chrSize);
     memset(chrROM, 0, chrSize);
 
     // METROID FIX: Initialize tile 255 as a proper blank tile
@@ -532,8 +591,10 @@ bool WarpNES::loadCHRROM(std::ifstream &file) {
   }
 
   printf("LoadCHRROM2\n");
-  chrROM = new uint8_t[chrSize];
-  file.read(reinterpret_cast<char *>(chrROM), chrSize);
+  if (offset + chrSize > image->getSize()) {
+    return false;
+  }
+  chrROM = shareROM(chrData, image, offset);
 
   printf("Loaded CHR ROM: %d bytes for mapper %d\n", chrSize, nesHeader.mapper);
 
@@ -551,7 +612,7 @@ bool WarpNES::loadCHRROM(std::ifstream &file) {
   }
   printf("=== END CHR DEBUG ===\n");
 
-  return file.good();
+  return true;
 }
 
 void WarpNES::handleNMI() {
@@ -630,8 +691,8 @@ void WarpNES::callNSFPlayRoutine() {
 }
 
 bool WarpNES::loadNSF(const char* filename) {
-    FILE* file = fopen(filename, "rb");
-    if (!file) {
+    std::shared_ptr<const ROMImage> image = ROMImage::open(filename);
+    if (!image) {
         return false;
     }
     
@@ -655,13 +716,12 @@ bool WarpNES::loadNSF(const char* filename) {
         uint8_t expansion[4];
     } header;
     
-    if (fread(&header, sizeof(header), 1, file) != 1) {
-        fclose(file);
+    if (image->getSize() < sizeof(header)) {
         return false;
     }
+    memcpy(&header, image->getData(), sizeof(header));
     
     if (strncmp(header.magic, "NESM\x1A", 5) != 0) {
-        fclose(file);
         return false;
     }
     
@@ -669,22 +729,16 @@ bool WarpNES::loadNSF(const char* filename) {
     memset(ram, 0, sizeof(ram));
     
     // Allocate standard NES ROM space
-    if (prgROM) {
-        delete[] prgROM;
-    }
     prgSize = 0x8000; // 32KB
-    prgROM = new uint8_t[prgSize];
+    prgROM = allocateROM(prgData, prgSize);
+    prgPrivate = true;
     memset(prgROM, 0, prgSize);
     
-    // Read NSF data
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    long rom_size = file_size - sizeof(header);
+    // NSF data follows the header
+    long rom_size = image->getSize() - sizeof(header);
     
     if (rom_size > 0) {
-        fseek(file, sizeof(header), SEEK_SET);
-        uint8_t* rom_data = new uint8_t[rom_size];
-        fread(rom_data, 1, rom_size, file);
+        const uint8_t* rom_data = image->getData() + sizeof(header);
         
         // Load NSF data into ROM starting from load_addr
         uint16_t load_addr = header.load_addr;
@@ -708,12 +762,8 @@ bool WarpNES::loadNSF(const char* filename) {
         // IRQ vector points to play routine  
         prgROM[0x7FFE] = header.play_addr & 0xFF;
         prgROM[0x7FFF] = (header.play_addr >> 8) & 0xFF;
-        
-        delete[] rom_data;
     }
     
-    fclose(file);
-    
     // Set up as regular NES ROM
     isNSF = true;
     nsf_init_addr = header.init_addr;
@@ -841,7 +891,7 @@ void WarpNES::updateFrameBased() {
 
   // Advance audio frame
   if (Configuration::getAudioEnabled()) {
-    apu->stepFrame();
+    apu->stepFrame(totalCycles);
   }
 }
 
@@ -926,6 +976,15 @@ void WarpNES::updateCycleAccurate() {
         // Execute CPU instruction
         uint64_t cyclesBefore = totalCycles;
         executeInstruction();
+
+        // APU frame counter IRQ, only synced when one is due
+        if (totalCycles >= apu->getNextIRQCycle()) {
+          apu->catchUp(totalCycles);
+        }
+        if (apu->isIRQPending()) {
+          checkAPUIRQ();
+        }
+
         uint64_t cyclesUsed = totalCycles - cyclesBefore;
 
         // Account for multi-cycle instructions
@@ -944,7 +1003,7 @@ void WarpNES::updateCycleAccurate() {
 
   // Audio frame advance
   if (Configuration::getAudioEnabled()) {
-    apu->stepFrame();
+    apu->stepFrame(totalCycles);
   }
 }
 
@@ -2030,6 +2089,23 @@ void WarpNES::catchUpPPU() {
   ppuCycles = ppu->getCurrentCycles();
 }
 
+void WarpNES::checkAPUIRQ() {
+  // The frame counter IRQ is level triggered, it stays asserted until the
+  // game acknowledges it through $4015 or $4017
+  if (getFlag(FLAG_INTERRUPT)) {
+    return;
+  }
+
+  pushWord(regPC);
+  pushByte(regP & ~FLAG_BREAK);
+  setFlag(FLAG_INTERRUPT, true);
+
+  regPC = readWord(0xFFFE);
+
+  totalCycles += 7; // IRQ takes 7 cycles
+  frameCycles += 7;
+}
+
 void WarpNES::checkPendingInterrupts() {
   // Handle MMC3 IRQ
   if (nesHeader.mapper == 40 && mapper40.irqPending) {
@@ -2075,6 +2151,9 @@ uint8_t WarpNES::readByte(uint16_t address) {
     // APU and I/O registers
 
     switch (address) {
+    case 0x4015:
+      apu->catchUp(totalCycles);
+      return apu->readStatus();
     case 0x4016:
       return controller1->readByte(PLAYER_1);
     case 0x4017: {
@@ -2272,6 +2351,7 @@ void WarpNES::writeByte(uint16_t address, uint8_t value) {
             break;
 
         default:
+            apu->catchUp(totalCycles);
             apu->writeRegister(address, value);
             break;
         }
@@ -2282,6 +2362,7 @@ void WarpNES::writeByte(uint16_t address, uint8_t value) {
             if (sramAddr < sramSize) {
                 sram[sramAddr] = value;
                 sramDirty = true;
+                sramDirtyPages |= 1u << ((sramAddr / SRAM_PAGE_SIZE) & 31);
             }
         }
     } else if (address >= 0x8000) {
@@ -2305,48 +2386,75 @@ void WarpNES::writeByte(uint16_t address, uint8_t value) {
     }
 }
 
+// Largest integer scale that fits, centred on black
+static FilterChain &getFitChain(int screenWidth, int screenHeight) {
+  static FilterChain chain;
+  if (chain.isEmpty()) {
+    chain.setStages("fit");
+  }
+  chain.setTargetSize(screenWidth, screenHeight);
+  return chain;
+}
+
 void WarpNES::scaleBuffer16(uint16_t *nesBuffer, uint16_t *screenBuffer,
                             int screenWidth, int screenHeight) {
-  // Clear screen with black
-  for (int i = 0; i < screenWidth * screenHeight; i++) {
-    screenBuffer[i] = 0x0000;
-  }
-
-  // Calculate scaling
-  int scale_x = screenWidth / 256;
-  int scale_y = screenHeight / 240;
-  int scale = (scale_x < scale_y) ? scale_x : scale_y;
-  if (scale < 1)
-    scale = 1;
-
-  int dest_w = 256 * scale;
-  int dest_h = 240 * scale;
-  int dest_x = (screenWidth - dest_w) / 2;
-  int dest_y = (screenHeight - dest_h) / 2;
-
-  // Simple scaling
-  for (int y = 0; y < 240; y++) {
-    for (int x = 0; x < 256; x++) {
-      uint16_t pixel = nesBuffer[y * 256 + x];
-
-      // Draw scale x scale block
-      for (int sy = 0; sy < scale; sy++) {
-        for (int sx = 0; sx < scale; sx++) {
-          int screen_x = dest_x + x * scale + sx;
-          int screen_y = dest_y + y * scale + sy;
-
-          if (screen_x >= 0 && screen_x < screenWidth && screen_y >= 0 &&
-              screen_y < screenHeight) {
-            screenBuffer[screen_y * screenWidth + screen_x] = pixel;
-          }
-        }
-      }
-    }
-  }
+  FilterFrame input(nesBuffer, 256, 240, 256 * sizeof(uint16_t),
+                    PixelFormat::RGB565);
+  FilterFrame output(screenBuffer, screenWidth, screenHeight,
+                     screenWidth * sizeof(uint16_t), PixelFormat::RGB565);
+  getFitChain(screenWidth, screenHeight).process(input, output);
 }
 
 void WarpNES::render16(uint16_t *buffer) { ppu->render16(buffer); }
 
+void WarpNES::setFrameOutputBuffer(uint16_t *buffer) {
+  ppu->setOutputBuffer(buffer);
+}
+
+void WarpNES::setVideoOutput(bool enabled) { ppu->setVideoOutput(enabled); }
+
+bool WarpNES::getVideoOutput() const { return ppu->getVideoOutput(); }
+
+const DirtyRows &WarpNES::getDirtyRows() const { return ppu->getDirtyRows(); }
+
+uint64_t WarpNES::getFrameNumber() const { return ppu->getFrameNumber(); }
+
+void WarpNES::renderScaledChanged16(uint16_t *buffer, int screenWidth,
+                                    int screenHeight, bool wholeFrame,
+                                    std::vector<RowBand> &changedRows) {
+  static uint16_t nesBuffer[256 * 240];
+  static uint64_t lastFrame = 0;
+  static std::vector<RowBand> nesRows;
+
+  uint64_t frame = ppu->getFrameNumber();
+  bool sameFrame = frame == lastFrame;
+  bool missedFrame = !sameFrame && frame != lastFrame + 1;
+  lastFrame = frame;
+
+  // The zapper crosshair is drawn over the picture, so it redraws it all
+  if (wholeFrame || missedFrame || (zapperEnabled && zapper)) {
+    renderScaled16(buffer, screenWidth, screenHeight);
+    changedRows.assign(1, {0, screenHeight});
+    return;
+  }
+
+  if (sameFrame) {
+    nesRows.clear();
+  } else {
+    ppu->getDirtyRows().getBands(nesRows);
+  }
+
+  ppu->render16(nesBuffer);
+  FilterFrame input(nesBuffer, 256, 240, 256 * sizeof(uint16_t),
+                    PixelFormat::RGB565);
+  FilterFrame output(buffer, screenWidth, screenHeight,
+                     screenWidth * sizeof(uint16_t), PixelFormat::RGB565);
+  if (!getFitChain(screenWidth, screenHeight)
+           .process(input, output, nesRows, changedRows)) {
+    changedRows.clear();
+  }
+}
+
 void WarpNES::renderScaled16(uint16_t *buffer, int screenWidth,
                              int screenHeight) {
   // First render the game using PPU scaling
@@ -2422,6 +2530,20 @@ bool WarpNES::isUsingMIDIAudio() const { return apu->isUsingMIDI(); }
 
 void WarpNES::debugAudioChannels() { apu->debugAudio(); }
 
+AudioStats WarpNES::getAudioStats() const { return apu->getStats(); }
+
+void WarpNES::resetAudioStats() { apu->resetStats(); }
+
+int WarpNES::getBufferedAudioSamples() const {
+  return apu->getBufferedSampleCount();
+}
+
+void WarpNES::setAudioRateAdjustment(double ratio) {
+  apu->setRateAdjustment(ratio);
+}
+
+void WarpNES::setAudioOutput(bool enabled) { apu->setSampleOutput(enabled); }
+
 // Controller access
 Controller &WarpNES::getController1() { return *controller1; }
 
@@ -2449,175 +2571,361 @@ void WarpNES::writeMemory(uint16_t address, uint8_t value) {
 }
 
 // Save states
-void WarpNES::saveState(const std::string &filename) {
+static const uint32_t STATE_CHUNK_INFO = stateChunkId('I', 'N', 'F', 'O');
+static const uint32_t STATE_CHUNK_CPU = stateChunkId('C', 'P', 'U', ' ');
+static const uint32_t STATE_CHUNK_RAM = stateChunkId('R', 'A', 'M', ' ');
+static const uint32_t STATE_CHUNK_PPU = stateChunkId('P', 'P', 'U', ' ');
+static const uint32_t STATE_CHUNK_APU = stateChunkId('A', 'P', 'U', 'C');
+static const uint32_t STATE_CHUNK_AUDIO_OUTPUT = stateChunkId('A', 'O', 'U', 'T');
+static const uint32_t STATE_CHUNK_MAPPER = stateChunkId('M', 'A', 'P', 'R');
+static const uint32_t STATE_CHUNK_SRAM = stateChunkId('S', 'R', 'A', 'M');
+static const uint32_t STATE_CHUNK_CHR_RAM = stateChunkId('C', 'H', 'R', 'R');
+static const uint32_t STATE_CHUNK_CONTROLLERS = stateChunkId('C', 'T', 'R', 'L');
+
+bool WarpNES::isHostStateChunk(uint32_t id) {
+  return id == STATE_CHUNK_AUDIO_OUTPUT;
+}
+
+size_t WarpNES::getStateSize() const {
   if (!romLoaded) {
-    std::cerr << "Error: Cannot save state - no ROM loaded" << std::endl;
-    return;
+    return 0;
   }
+  StateWriter counter(nullptr, 0);
+  writeState(counter);
+  return counter.getSize();
+}
 
-  // Use the existing EmulatorSaveState structure but add mapper data to
-  // reserved space
-  EmulatorSaveState state;
-  memset(&state, 0, sizeof(state));
-
-  // Header
-  strcpy(state.header, "NESSAVE");
-  state.version = 1; // Keep version 1 for compatibility
-
-  // CPU state
-  state.cpu_A = regA;
-  state.cpu_X = regX;
-  state.cpu_Y = regY;
-  state.cpu_SP = regSP;
-  state.cpu_P = regP;
-  state.cpu_PC = regPC;
-  state.cpu_cycles = totalCycles;
-
-  // RAM
-  memcpy(state.ram, ram, sizeof(ram));
-
-  // Save PPU state
-  if (ppu) {
-    state.ppu_registers[0] = ppu->getControl();
-    state.ppu_registers[1] = ppu->getMask();
-    state.ppu_registers[2] = ppu->getStatus();
-    state.ppu_registers[3] = ppu->getOAMAddr();
-    state.ppu_registers[4] = ppu->getScrollX();
-    state.ppu_registers[5] = ppu->getScrollY();
-    state.ppu_registers[6] = (ppu->getVRAMAddress() >> 8) & 0xFF;
-    state.ppu_registers[7] = ppu->getVRAMAddress() & 0xFF;
-
-    // Save PPU memory
-    memcpy(state.ppu_nametable, ppu->getVRAM(), 2048);
-    memcpy(state.ppu_oam, ppu->getOAM(), 256);
-    memcpy(state.ppu_palette, ppu->getPaletteRAM(), 32);
-  }
-
-  // Create appropriate filename
-  std::string actualFilename;
-#ifdef __DJGPP__
-  std::string baseName = filename;
-  size_t dotPos = baseName.find_last_of('.');
-  if (dotPos != std::string::npos) {
-    baseName = baseName.substr(0, dotPos);
+size_t WarpNES::saveState(uint8_t *buffer, size_t capacity) const {
+  if (!romLoaded || !ppu || !apu) {
+    return 0;
   }
-  if (baseName.length() > 8) {
-    baseName = baseName.substr(0, 8);
+  StateWriter writer(buffer, capacity);
+  writeState(writer);
+  return writer.ok() ? writer.getSize() : 0;
+}
+
+bool WarpNES::loadState(const uint8_t *data, size_t size) {
+  if (!romLoaded || !ppu || !apu) {
+    std::cerr << "Error: Cannot load state - no ROM loaded" << std::endl;
+    return false;
   }
-  actualFilename = baseName + ".SAV";
-#else
-  actualFilename = filename;
-#endif
 
-  std::ofstream file(actualFilename, std::ios::binary);
-  if (file.is_open()) {
-    file.write(reinterpret_cast<const char *>(&state), sizeof(state));
-
-    // Write extended PPU state
-    if (ppu) {
-      // Write additional PPU timing state
-      uint64_t ppuCycles = ppu->getCurrentCycles();
-      int currentScanline = ppu->getCurrentScanline();
-      int currentCycle = ppu->getCurrentCycle();
-      bool inVBlank = ppu->isInVBlank();
-      bool frameComplete = ppu->isFrameComplete();
-
-      file.write(reinterpret_cast<const char *>(&ppuCycles), sizeof(ppuCycles));
-      file.write(reinterpret_cast<const char *>(&currentScanline),
-                 sizeof(currentScanline));
-      file.write(reinterpret_cast<const char *>(&currentCycle),
-                 sizeof(currentCycle));
-      file.write(reinterpret_cast<const char *>(&inVBlank), sizeof(inVBlank));
-      file.write(reinterpret_cast<const char *>(&frameComplete),
-                 sizeof(frameComplete));
-    }
+  if (size > sizeof(STATE_MAGIC) &&
+      memcmp(data, STATE_MAGIC, sizeof(STATE_MAGIC)) == 0 &&
+      data[sizeof(STATE_MAGIC)] == STATE_LEGACY_VERSION) {
+    return loadLegacyState(data, size);
+  }
 
-    // Write mapper-specific data separately
-    switch (nesHeader.mapper) {
-    case 1:
-      file.write(reinterpret_cast<const char *>(&mmc1), sizeof(mmc1));
-      break;
-    case 2:
-      file.write(reinterpret_cast<const char *>(&uxrom), sizeof(uxrom));
-      break;
-    case 3:
-      file.write(reinterpret_cast<const char *>(&cnrom), sizeof(cnrom));
-      break;
-    case 4:
-      file.write(reinterpret_cast<const char *>(&mmc3), sizeof(mmc3));
-      break;
-    case 9:
-      file.write(reinterpret_cast<const char *>(&mmc2), sizeof(mmc2));
-      break;
-    case 66:
-      file.write(reinterpret_cast<const char *>(&gxrom), sizeof(gxrom));
-      break;
+  StateReader reader(data, size);
+  if (!reader.isValid()) {
+    if (reader.getVersion() != 0) {
+      std::cerr << "Error: Save state version " << reader.getVersion()
+                << " is not supported" << std::endl;
+    } else {
+      std::cerr << "Error: Invalid save state" << std::endl;
     }
-
-    file.close();
-    std::cout << "Save state written to: " << actualFilename << std::endl;
-  } else {
-    std::cerr << "Error: Could not save state to: " << actualFilename
-              << std::endl;
+    return false;
   }
+  if (!checkState(reader)) {
+    return false;
+  }
+
+  readState(reader);
+  return true;
 }
 
-bool WarpNES::loadState(const std::string &filename) {
-  if (!romLoaded) {
-    std::cerr << "Error: Cannot load state - no ROM loaded" << std::endl;
-    return false;
+void WarpNES::writeState(StateWriter &writer) const {
+  // What the state belongs to, checked before anything is loaded
+  writer.beginChunk(STATE_CHUNK_INFO);
+  writer.write(nesHeader.mapper);
+  writer.write(prgSize);
+  writer.write(chrSize);
+  writer.endChunk();
+
+  writer.beginChunk(STATE_CHUNK_CPU);
+  writer.write(regA);
+  writer.write(regX);
+  writer.write(regY);
+  writer.write(regSP);
+  writer.write(regP);
+  writer.write(regPC);
+  writer.write(totalCycles);
+  writer.write(frameCycles);
+  writer.write(masterCycles);
+  writer.write(ppuCycles);
+  writer.write(nmiPending);
+  writer.write(nmiDelay);
+  writer.write(ppuCycleState.scanline);
+  writer.write(ppuCycleState.cycle);
+  writer.write(ppuCycleState.renderingEnabled);
+  writer.write(ppuCycleState.inVBlank);
+  writer.write(ppuCycleState.sprite0HitPending);
+  writer.write(ppuCycleState.sprite0HitCycle);
+  writer.write(ppuCycleState.sprite0HitScanline);
+  writer.write(ppuCycleState.frameEven);
+  writer.write(ppuCycleState.cpuCycleCounter);
+  writer.write(ppuCycleState.lastA12State);
+  writer.endChunk();
+
+  writer.beginChunk(STATE_CHUNK_RAM);
+  writer.writeBytes(ram, sizeof(ram));
+  writer.endChunk();
+
+  writer.beginChunk(STATE_CHUNK_PPU);
+  ppu->saveState(writer);
+  writer.endChunk();
+
+  writer.beginChunk(STATE_CHUNK_APU);
+  apu->saveState(writer);
+  writer.endChunk();
+
+  writer.beginChunk(STATE_CHUNK_AUDIO_OUTPUT);
+  apu->saveOutputState(writer);
+  writer.endChunk();
+
+  writer.beginChunk(STATE_CHUNK_CONTROLLERS);
+  controller1->saveState(writer);
+  controller2->saveState(writer);
+  writer.endChunk();
+
+  // Every mapper's registers, they are only a few bytes
+  writer.beginChunk(STATE_CHUNK_MAPPER);
+  writer.write(mmc1.shiftRegister);
+  writer.write(mmc1.shiftCount);
+  writer.write(mmc1.control);
+  writer.write(mmc1.chrBank0);
+  writer.write(mmc1.chrBank1);
+  writer.write(mmc1.prgBank);
+  writer.write(mmc1.currentPRGBank);
+  writer.write(mmc1.currentCHRBank0);
+  writer.write(mmc1.currentCHRBank1);
+  writer.write(uxrom.prgBank);
+  writer.write(cnrom.chrBank);
+  writer.write(mmc3.bankSelect);
+  writer.write(mmc3.bankData);
+  writer.write(mmc3.mirroring);
+  writer.write(mmc3.prgRamProtect);
+  writer.write(mmc3.irqLatch);
+  writer.write(mmc3.irqCounter);
+  writer.write(mmc3.irqEnable);
+  writer.write(mmc3.irqReload);
+  writer.write(mmc3.irqPending);
+  writer.write(mmc3.currentPRGBanks);
+  writer.write(mmc3.currentCHRBanks);
+  writer.write(mmc2.prgBank);
+  writer.write(mmc2.chrBank0FD);
+  writer.write(mmc2.chrBank0FE);
+  writer.write(mmc2.chrBank1FD);
+  writer.write(mmc2.chrBank1FE);
+  writer.write(mmc2.latch0);
+  writer.write(mmc2.latch1);
+  writer.write(mmc2.mirroring);
+  writer.write(mmc2.currentCHRBank0);
+  writer.write(mmc2.currentCHRBank1);
+  writer.write(mapper40.irqCounter);
+  writer.write(mapper40.irqEnable);
+  writer.write(mapper40.irqPending);
+  writer.write(mapper40.prgBank);
+  writer.write(gxrom.prgBank);
+  writer.write(gxrom.chrBank);
+  writer.endChunk();
+
+  if (sram && sramSize > 0) {
+    writer.beginChunk(STATE_CHUNK_SRAM);
+    writer.write(sramEnabled);
+    writer.writeBytes(sram, sramSize);
+    writer.endChunk();
+  }
+
+  if (nesHeader.chrROMPages == 0 && chrROM) {
+    writer.beginChunk(STATE_CHUNK_CHR_RAM);
+    writer.writeBytes(chrROM, chrSize);
+    writer.endChunk();
   }
+}
 
-  // Safety checks
-  if (!ppu) {
-    std::cerr << "Error: PPU not initialized" << std::endl;
+bool WarpNES::checkState(StateReader reader) const {
+  uint32_t id;
+  if (!reader.nextChunk(id) || id != STATE_CHUNK_INFO) {
+    std::cerr << "Error: Save state has no ROM information" << std::endl;
     return false;
   }
 
-  if (!apu) {
-    std::cerr << "Error: APU not initialized" << std::endl;
+  uint8_t mapper;
+  uint32_t statePRGSize;
+  uint32_t stateCHRSize;
+  reader.read(mapper);
+  reader.read(statePRGSize);
+  reader.read(stateCHRSize);
+  if (mapper != nesHeader.mapper || statePRGSize != prgSize ||
+      stateCHRSize != chrSize) {
+    std::cerr << "Error: Save state is from a different ROM" << std::endl;
     return false;
   }
 
-  std::string actualFilename;
-#ifdef __DJGPP__
-  std::string baseName = filename;
-  size_t dotPos = baseName.find_last_of('.');
-  if (dotPos != std::string::npos) {
-    baseName = baseName.substr(0, dotPos);
+  while (reader.nextChunk(id)) {
   }
-  if (baseName.length() > 8) {
-    baseName = baseName.substr(0, 8);
-  }
-  actualFilename = baseName + ".SAV";
-#else
-  actualFilename = filename;
-#endif
-
-  std::ifstream file(actualFilename, std::ios::binary);
-  if (!file.is_open()) {
-    std::cerr << "Error: Could not open save state: " << actualFilename
-              << std::endl;
+  if (reader.isTruncated()) {
+    std::cerr << "Error: Save state is truncated" << std::endl;
     return false;
   }
+  return true;
+}
 
-  EmulatorSaveState state;
-  file.read(reinterpret_cast<char *>(&state), sizeof(state));
+void WarpNES::readState(StateReader &reader) {
+  uint32_t id;
+  while (reader.nextChunk(id)) {
+    switch (id) {
+    case STATE_CHUNK_CPU:
+      reader.read(regA);
+      reader.read(regX);
+      reader.read(regY);
+      reader.read(regSP);
+      reader.read(regP);
+      reader.read(regPC);
+      reader.read(totalCycles);
+      reader.read(frameCycles);
+      reader.read(masterCycles);
+      reader.read(ppuCycles);
+      reader.read(nmiPending);
+      reader.read(nmiDelay);
+      reader.read(ppuCycleState.scanline);
+      reader.read(ppuCycleState.cycle);
+      reader.read(ppuCycleState.renderingEnabled);
+      reader.read(ppuCycleState.inVBlank);
+      reader.read(ppuCycleState.sprite0HitPending);
+      reader.read(ppuCycleState.sprite0HitCycle);
+      reader.read(ppuCycleState.sprite0HitScanline);
+      reader.read(ppuCycleState.frameEven);
+      reader.read(ppuCycleState.cpuCycleCounter);
+      reader.read(ppuCycleState.lastA12State);
+      break;
 
-  if (!file.good()) {
-    std::cerr << "Error: Failed to read save state" << std::endl;
-    file.close();
-    return false;
+    case STATE_CHUNK_RAM:
+      reader.readBytes(ram, sizeof(ram));
+      break;
+
+    case STATE_CHUNK_PPU:
+      ppu->loadState(reader);
+      break;
+
+    case STATE_CHUNK_APU:
+      apu->loadState(reader);
+      break;
+
+    case STATE_CHUNK_AUDIO_OUTPUT:
+      apu->loadOutputState(reader);
+      break;
+
+    case STATE_CHUNK_CONTROLLERS:
+      controller1->loadState(reader);
+      controller2->loadState(reader);
+      break;
+
+    case STATE_CHUNK_MAPPER:
+      reader.read(mmc1.shiftRegister);
+      reader.read(mmc1.shiftCount);
+      reader.read(mmc1.control);
+      reader.read(mmc1.chrBank0);
+      reader.read(mmc1.chrBank1);
+      reader.read(mmc1.prgBank);
+      reader.read(mmc1.currentPRGBank);
+      reader.read(mmc1.currentCHRBank0);
+      reader.read(mmc1.currentCHRBank1);
+      reader.read(uxrom.prgBank);
+      reader.read(cnrom.chrBank);
+      reader.read(mmc3.bankSelect);
+      reader.read(mmc3.bankData);
+      reader.read(mmc3.mirroring);
+      reader.read(mmc3.prgRamProtect);
+      reader.read(mmc3.irqLatch);
+      reader.read(mmc3.irqCounter);
+      reader.read(mmc3.irqEnable);
+      reader.read(mmc3.irqReload);
+      reader.read(mmc3.irqPending);
+      reader.read(mmc3.currentPRGBanks);
+      reader.read(mmc3.currentCHRBanks);
+      reader.read(mmc2.prgBank);
+      reader.read(mmc2.chrBank0FD);
+      reader.read(mmc2.chrBank0FE);
+      reader.read(mmc2.chrBank1FD);
+      reader.read(mmc2.chrBank1FE);
+      reader.read(mmc2.latch0);
+      reader.read(mmc2.latch1);
+      reader.read(mmc2.mirroring);
+      reader.read(mmc2.currentCHRBank0);
+      reader.read(mmc2.currentCHRBank1);
+      reader.read(mapper40.irqCounter);
+      reader.read(mapper40.irqEnable);
+      reader.read(mapper40.irqPending);
+      reader.read(mapper40.prgBank);
+      reader.read(gxrom.prgBank);
+      reader.read(gxrom.chrBank);
+      break;
+
+    case STATE_CHUNK_SRAM:
+      if (sram && sramSize > 0) {
+        // Only a real change has to reach the battery file, compared in
+        // place as this runs for every rewind and netplay rollback
+        reader.read(sramEnabled);
+        const uint8_t *saved = reader.getChunkData();
+        if (reader.getChunkRemaining() >= sramSize &&
+            memcmp(sram, saved, sramSize) != 0) {
+          memcpy(sram, saved, sramSize);
+          sramDirty = true;
+          sramDirtyPages = 0xFFFFFFFF;
+        }
+      }
+      break;
+
+    case STATE_CHUNK_CHR_RAM:
+      if (nesHeader.chrROMPages == 0 && chrROM) {
+        reader.readBytes(chrROM, chrSize);
+      }
+      break;
+    }
   }
 
-  // Validate header
-  if (strcmp(state.header, "NESSAVE") != 0) {
-    std::cerr << "Error: Invalid save state file" << std::endl;
-    file.close();
+  switch (nesHeader.mapper) {
+  case 1:
+    updateMMC1Banks();
+    break;
+  case 4:
+    updateMMC3Banks();
+    break;
+  case 9:
+    updateMMC2Banks();
+    break;
+  }
+}
+
+// Version 1 states, written as this struct's memory followed by the PPU
+// timing and the raw registers of the ROM's mapper
+struct LegacySaveState {
+  char header[8];
+  uint8_t version;
+  uint8_t cpu_A, cpu_X, cpu_Y, cpu_SP, cpu_P;
+  uint16_t cpu_PC;
+  uint64_t cpu_cycles;
+  uint8_t ram[0x2000];
+  uint8_t ppu_registers[8];
+  uint8_t ppu_nametable[2048];
+  uint8_t ppu_oam[256];
+  uint8_t ppu_palette[32];
+  uint8_t apu_registers[24]; // Never filled in
+  uint8_t reserved[64];
+};
+static const size_t LEGACY_PPU_TIMING_SIZE =
+    sizeof(uint64_t) + 2 * sizeof(int) + 2 * sizeof(bool);
+
+bool WarpNES::loadLegacyState(const uint8_t *data, size_t size) {
+  if (size < sizeof(LegacySaveState) + LEGACY_PPU_TIMING_SIZE) {
+    std::cerr << "Error: Save state is truncated" << std::endl;
     return false;
   }
+  LegacySaveState state;
+  memcpy(&state, data, sizeof(state));
 
-  // Restore CPU state
   regA = state.cpu_A;
   regX = state.cpu_X;
   regY = state.cpu_Y;
@@ -2625,120 +2933,328 @@ bool WarpNES::loadState(const std::string &filename) {
   regP = state.cpu_P;
   regPC = state.cpu_PC;
   totalCycles = state.cpu_cycles;
-  frameCycles = 0; // Reset frame cycles
-
-  // Restore RAM
+  frameCycles = 0;
   memcpy(ram, state.ram, sizeof(ram));
 
-  // Restore PPU state
-  if (ppu) {
-    ppu->setControl(state.ppu_registers[0]);
-    ppu->setMask(state.ppu_registers[1]);
-    ppu->setStatus(state.ppu_registers[2]);
-    ppu->setOAMAddr(state.ppu_registers[3]);
-    ppu->setScrollX(state.ppu_registers[4]);
-    ppu->setScrollY(state.ppu_registers[5]);
-
-    uint16_t vramAddr = (state.ppu_registers[6] << 8) | state.ppu_registers[7];
-    ppu->setVRAMAddress(vramAddr);
-
-    // Restore PPU memory
-    ppu->setVRAM(state.ppu_nametable);
-    ppu->setOAM(state.ppu_oam);
-    ppu->setPaletteRAM(state.ppu_palette);
-
-    // Reset PPU state variables
-    ppu->setWriteToggle(false);
-    ppu->setDataBuffer(0);
-    ppu->setSprite0Hit(false);
-  }
-
-  // Load extended PPU state
-  if (ppu) {
-    // Read additional PPU timing state
-    uint64_t ppuCycles;
-    int currentScanline;
-    int currentCycle;
-    bool inVBlank;
-    bool frameComplete;
-
-    if (file.read(reinterpret_cast<char *>(&ppuCycles), sizeof(ppuCycles))) {
-      file.read(reinterpret_cast<char *>(&currentScanline),
-                sizeof(currentScanline));
-      file.read(reinterpret_cast<char *>(&currentCycle), sizeof(currentCycle));
-      file.read(reinterpret_cast<char *>(&inVBlank), sizeof(inVBlank));
-      file.read(reinterpret_cast<char *>(&frameComplete),
-                sizeof(frameComplete));
-
-      ppu->setCycles(ppuCycles);
-      // Note: PPU doesn't have public setters for scanline/cycle state
-      // We'll reset PPU timing state below instead
-    }
-  }
+  ppu->setControl(state.ppu_registers[0]);
+  ppu->setMask(state.ppu_registers[1]);
+  ppu->setStatus(state.ppu_registers[2]);
+  ppu->setOAMAddr(state.ppu_registers[3]);
+  ppu->setScrollX(state.ppu_registers[4]);
+  ppu->setScrollY(state.ppu_registers[5]);
+  ppu->setVRAMAddress((state.ppu_registers[6] << 8) | state.ppu_registers[7]);
+  ppu->setVRAM(state.ppu_nametable);
+  ppu->setOAM(state.ppu_oam);
+  ppu->setPaletteRAM(state.ppu_palette);
+  ppu->setWriteToggle(false);
+  ppu->setDataBuffer(0);
+  ppu->setSprite0Hit(false);
 
-  // Load mapper-specific data
+  size_t offset = sizeof(LegacySaveState);
+  uint64_t statePPUCycles;
+  memcpy(&statePPUCycles, data + offset, sizeof(statePPUCycles));
+  ppu->setCycles(statePPUCycles);
+  offset += LEGACY_PPU_TIMING_SIZE;
+
+  // Only the ROM's own mapper was written
+  void *mapperState = nullptr;
+  size_t mapperSize = 0;
   switch (nesHeader.mapper) {
   case 1:
-    if (file.read(reinterpret_cast<char *>(&mmc1), sizeof(mmc1))) {
-      updateMMC1Banks();
-    } else {
-      std::cerr << "Warning: Could not read MMC1 state" << std::endl;
-    }
+    mapperState = &mmc1;
+    mapperSize = sizeof(mmc1);
     break;
   case 2:
-    if (file.read(reinterpret_cast<char *>(&uxrom), sizeof(uxrom))) {
-      // UxROM banks are already set in uxrom state
-    } else {
-      std::cerr << "Warning: Could not read UxROM state" << std::endl;
-    }
+    mapperState = &uxrom;
+    mapperSize = sizeof(uxrom);
     break;
   case 3:
-    if (file.read(reinterpret_cast<char *>(&cnrom), sizeof(cnrom))) {
-      // CNROM banks are already set in cnrom state
-    } else {
-      std::cerr << "Warning: Could not read CNROM state" << std::endl;
-    }
+    mapperState = &cnrom;
+    mapperSize = sizeof(cnrom);
     break;
   case 4:
-    if (file.read(reinterpret_cast<char *>(&mmc3), sizeof(mmc3))) {
-      updateMMC3Banks();
-    } else {
-      std::cerr << "Warning: Could not read MMC3 state" << std::endl;
-    }
+    mapperState = &mmc3;
+    mapperSize = sizeof(mmc3);
     break;
   case 9:
-    if (file.read(reinterpret_cast<char *>(&mmc2), sizeof(mmc2))) {
-      updateMMC2Banks();
-    } else {
-      std::cerr << "Warning: Could not read MMC2 state" << std::endl;
-    }
+    mapperState = &mmc2;
+    mapperSize = sizeof(mmc2);
     break;
   case 66:
-    if (file.read(reinterpret_cast<char *>(&gxrom), sizeof(gxrom))) {
-      // GxROM banks are already set in gxrom state
+    mapperState = &gxrom;
+    mapperSize = sizeof(gxrom);
+    break;
+  }
+  if (mapperState) {
+    if (size - offset >= mapperSize) {
+      memcpy(mapperState, data + offset, mapperSize);
     } else {
-      std::cerr << "Warning: Could not read GxROM state" << std::endl;
+      std::cerr << "Warning: Save state has no mapper " << (int)nesHeader.mapper
+                << " registers" << std::endl;
     }
+  }
+  switch (nesHeader.mapper) {
+  case 1:
+    updateMMC1Banks();
+    break;
+  case 4:
+    updateMMC3Banks();
+    break;
+  case 9:
+    updateMMC2Banks();
     break;
   }
 
-  file.close();
-
-  // Reset interrupt state
+  // Version 1 kept no interrupt or PPU timing state, so both start over
   nmiPending = false;
+  nmiDelay = 0;
   masterCycles = totalCycles;
-  ppuCycles = totalCycles * 3; // Rough PPU sync
-
-  // Reset PPU cycle state
+  ppuCycles = totalCycles * 3;
   ppuCycleState.scanline = 0;
   ppuCycleState.cycle = 0;
   ppuCycleState.inVBlank = false;
   ppuCycleState.renderingEnabled = false;
+  return true;
+}
+
+/**
+ * Get the file a save state is kept in, 8.3 names on DOS.
+ */
+static std::string getStateFileName(const std::string &filename) {
+#ifdef __DJGPP__
+  std::string baseName = filename;
+  size_t dotPos = baseName.find_last_of('.');
+  if (dotPos != std::string::npos) {
+    baseName = baseName.substr(0, dotPos);
+  }
+  if (baseName.length() > 8) {
+    baseName = baseName.substr(0, 8);
+  }
+  return baseName + ".SAV";
+#else
+  return filename;
+#endif
+}
+
+void WarpNES::saveState(const std::string &filename) {
+  if (!romLoaded) {
+    std::cerr << "Error: Cannot save state - no ROM loaded" << std::endl;
+    return;
+  }
+
+  std::vector<uint8_t> state(getStateSize());
+  size_t size = saveState(state.data(), state.size());
+
+  std::string actualFilename = getStateFileName(filename);
+  if (size > 0 && writeFileAtomically(actualFilename, state.data(), size)) {
+    std::cout << "Save state written to: " << actualFilename << std::endl;
+  } else {
+    std::cerr << "Error: Could not save state to: " << actualFilename
+              << std::endl;
+  }
+}
+
+bool WarpNES::loadState(const std::string &filename) {
+  if (!romLoaded) {
+    std::cerr << "Error: Cannot load state - no ROM loaded" << std::endl;
+    return false;
+  }
+
+  std::string actualFilename = getStateFileName(filename);
+  std::ifstream file(actualFilename, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    std::cerr << "Error: Could not open save state: " << actualFilename
+              << std::endl;
+    return false;
+  }
+
+  std::streamoff size = file.tellg();
+  std::vector<uint8_t> state(size > 0 ? (size_t)size : 0);
+  file.seekg(0);
+  if (size <= 0 ||
+      !file.read(reinterpret_cast<char *>(state.data()), state.size())) {
+    std::cerr << "Error: Failed to read save state" << std::endl;
+    return false;
+  }
+
+  if (!loadState(state.data(), state.size())) {
+    return false;
+  }
 
   std::cout << "Save state loaded from: " << actualFilename << std::endl;
   return true;
 }
 
+void WarpNES::benchmarkStates(int frames) {
+  if (!romLoaded || frames <= 0) {
+    std::cerr << "Error: Cannot benchmark save states - no ROM loaded"
+              << std::endl;
+    return;
+  }
+
+  size_t size = getStateSize();
+  std::vector<uint8_t> state(size);
+  std::vector<uint8_t> check(size);
+  double saveTotalUs = 0.0, saveMaxUs = 0.0;
+  double loadTotalUs = 0.0, loadMaxUs = 0.0;
+  int mismatches = 0;
+
+  for (int i = 0; i < frames; i++) {
+    update();
+
+    auto start = std::chrono::steady_clock::now();
+    saveState(state.data(), state.size());
+    auto saved = std::chrono::steady_clock::now();
+    loadState(state.data(), state.size());
+    auto loaded = std::chrono::steady_clock::now();
+
+    double saveUs = std::chrono::duration<double, std::micro>(saved - start).count();
+    double loadUs = std::chrono::duration<double, std::micro>(loaded - saved).count();
+    saveTotalUs += saveUs;
+    saveMaxUs = std::max(saveMaxUs, saveUs);
+    loadTotalUs += loadUs;
+    loadMaxUs = std::max(loadMaxUs, loadUs);
+
+    // A loaded state has to save back to the same bytes
+    saveState(check.data(), check.size());
+    if (state != check) {
+      mismatches++;
+    }
+  }
+
+  printf("Save state benchmark: %d frames, %zu bytes per state\n", frames, size);
+  printf("  save %.1fus avg %.1fus max, load %.1fus avg %.1fus max, %d round trip mismatches\n",
+         saveTotalUs / frames, saveMaxUs, loadTotalUs / frames, loadMaxUs, mismatches);
+}
+
+WarpNES *WarpNES::clone() const {
+  if (!romLoaded || isNSF) {
+    std::cerr << "Error: Cannot clone - no ROM loaded" << std::endl;
+    return nullptr;
+  }
+
+  std::vector<uint8_t> state(getStateSize());
+  size_t size = saveState(state.data(), state.size());
+  if (size == 0) {
+    return nullptr;
+  }
+
+  WarpNES *copy = new WarpNES(false);
+  copy->nesHeader = nesHeader;
+  copy->prgData = prgData;
+  copy->prgROM = prgROM;
+  copy->prgPrivate = prgPrivate;
+  copy->prgSize = prgSize;
+  copy->chrSize = chrSize;
+  if (nesHeader.chrROMPages > 0) {
+    copy->chrData = chrData;
+    copy->chrROM = chrROM;
+  } else {
+    // CHR-RAM, its contents come with the state
+    copy->chrROM = allocateROM(copy->chrData, chrSize);
+  }
+  if (sram) {
+    // No romBaseName, so the battery file is left alone
+    copy->sramSize = sramSize;
+    copy->sram = new uint8_t[sramSize];
+    memset(copy->sram, 0, sramSize);
+  }
+  copy->zapperEnabled = zapperEnabled;
+  copy->romLoaded = true;
+
+  copy->reset();
+  if (!copy->loadState(state.data(), size)) {
+    delete copy;
+    return nullptr;
+  }
+  copy->setAudioOutput(false);
+  return copy;
+}
+
+void WarpNES::benchmarkClones(int count) {
+  if (!romLoaded || isNSF || count <= 0) {
+    std::cerr << "Error: Cannot benchmark clones - no ROM loaded" << std::endl;
+    return;
+  }
+
+  // Get into the game so there is some state worth copying
+  for (int i = 0; i < 120; i++) {
+    update();
+  }
+
+  std::vector<WarpNES *> clones;
+  clones.reserve(count);
+  double totalUs = 0.0, maxUs = 0.0;
+  for (int i = 0; i < count; i++) {
+    auto start = std::chrono::steady_clock::now();
+    WarpNES *copy = clone();
+    auto end = std::chrono::steady_clock::now();
+    if (!copy) {
+      break;
+    }
+    clones.push_back(copy);
+
+    double us = std::chrono::duration<double, std::micro>(end - start).count();
+    totalUs += us;
+    maxUs = std::max(maxUs, us);
+  }
+  if (clones.empty()) {
+    std::cerr << "Error: Could not clone the engine" << std::endl;
+    return;
+  }
+
+  size_t cloneBytes = clones[0]->getMemoryUsed();
+  size_t sharedBytes = prgSize + (nesHeader.chrROMPages > 0 ? chrSize : 0);
+
+  // A clone has to run exactly like the engine it was copied from
+  size_t size = getStateSize();
+  std::vector<uint8_t> expected(size);
+  std::vector<uint8_t> actual(size);
+  setAudioOutput(false);
+  setVideoOutput(false);
+  for (int i = 0; i < 60; i++) {
+    update();
+  }
+  setAudioOutput(true);
+  setVideoOutput(true);
+  saveState(expected.data(), size);
+
+  int checked = std::min<int>((int)clones.size(), 8);
+  int mismatches = 0;
+  for (int i = 0; i < checked; i++) {
+    clones[i]->setAudioOutput(false);
+    clones[i]->setVideoOutput(false);
+    for (int j = 0; j < 60; j++) {
+      clones[i]->update();
+    }
+    clones[i]->saveState(actual.data(), size);
+    if (actual != expected) {
+      mismatches++;
+    }
+  }
+
+  for (WarpNES *copy : clones) {
+    delete copy;
+  }
+
+  printf("Clone benchmark: %zu clones, %.1fus avg %.1fus max per clone\n",
+         clones.size(), totalUs / clones.size(), maxUs);
+  printf("  %.1fKB per clone, %.1fKB of ROM shared, %d of %d clones diverged after 60 frames\n",
+         cloneBytes / 1024.0, sharedBytes / 1024.0, mismatches, checked);
+}
+
+size_t WarpNES::getMemoryUsed() const {
+  size_t bytes = sizeof(WarpNES) + sizeof(PPU) + apu->getMemoryUsed() +
+                 2 * sizeof(Controller) + sizeof(Zapper) + sramSize;
+  if (romLoaded && nesHeader.chrROMPages == 0) {
+    bytes += chrSize;
+  }
+  if (prgPrivate && prgData.use_count() == 1) {
+    bytes += prgSize;
+  }
+  return bytes;
+}
+
 // CHR ROM access for PPU
 uint8_t *WarpNES::getCHR() { return chrROM; }
 
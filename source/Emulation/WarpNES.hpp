@@ -4,8 +4,12 @@
 #include <cstdint>
 #include <cstring>
 #include <fstream>
+#include <memory>
 #include <string>
+#include <vector>
+#include "../DirtyRows.hpp"
 #include "../Zapper.hpp"
+#include "APU.hpp"
 #include "PPU.hpp"
 
 
@@ -15,6 +19,9 @@ class PPU;
 class PPUCycleAccurate;
 
 class Controller;
+class ROMImage;
+class StateReader;
+class StateWriter;
 
 /**
  * Dynamic 6502 CPU emulator for NES/SMB
@@ -22,11 +29,21 @@ class Controller;
  */
 class WarpNES {
 public:
-  WarpNES();
+  /**
+   * @param playback false for an engine whose sound is never played, such
+   * as a clone: its APU creates no FM synthesis system and prints nothing
+   */
+  explicit WarpNES(bool playback = true);
   ~WarpNES();
   uint8_t getMMC2Mirroring() const { return mmc2.mirroring; }
 
-  uint8_t* getPRGROM() { return prgROM; }
+  const uint8_t* getPRGROM() const { return prgROM; }
+
+  /**
+   * Get PRG-ROM for patching. The first call gives this engine its own
+   * copy, the ROM file and other engines keep the original.
+   */
+  uint8_t* getWritablePRGROM();
   uint32_t getPRGSize() const { return prgSize; }
 
 
@@ -55,6 +72,16 @@ public:
 
   // Rendering
   void renderScaled16(uint16_t *buffer, int screenWidth, int screenHeight);
+
+  /**
+   * Like renderScaled16(), but only redraws the screen rows whose NES rows
+   * changed since the previous call. The buffer has to still hold that
+   * call's output unless wholeFrame is set.
+   * @param changedRows Receives the screen rows that were drawn
+   */
+  void renderScaledChanged16(uint16_t *buffer, int screenWidth,
+                             int screenHeight, bool wholeFrame,
+                             std::vector<RowBand> &changedRows);
 #ifndef __DJGPP__
   void render(uint32_t *buffer);
   void renderScaled32(uint32_t *buffer, int screenWidth, int screenHeight);
@@ -64,21 +91,112 @@ public:
 #endif
   void renderDirectFast(uint16_t *buffer, int screenWidth, int screenHeight);
   void render16(uint16_t *buffer);
+  void setFrameOutputBuffer(uint16_t *buffer);
+
+  /**
+   * Turn drawing frames on or off. Frames run without it are not counted
+   * by getFrameNumber() and leave the dirty rows alone.
+   */
+  void setVideoOutput(bool enabled);
+  bool getVideoOutput() const;
+
+  /**
+   * Get the rows of the last frame that differ from the frame before it.
+   */
+  const DirtyRows &getDirtyRows() const;
+
+  /**
+   * Get the number of frames rendered so far. When it moved on by more
+   * than one since a frontend's last frame, getDirtyRows() does not cover
+   * everything that changed.
+   */
+  uint64_t getFrameNumber() const;
 
   // Audio
   void audioCallback(uint8_t *stream, int length);
   void toggleAudioMode();
   bool isUsingMIDIAudio() const;
   void debugAudioChannels();
+  AudioStats getAudioStats() const;
+  void resetAudioStats();
+  int getBufferedAudioSamples() const;
+  void setAudioRateAdjustment(double ratio);
+
+  /**
+   * Turn making audio samples on or off. The sound channels keep running.
+   */
+  void setAudioOutput(bool enabled);
 
   // Controllers
   Controller &getController1();
   Controller &getController2();
 
   // Save states
+  /**
+   * Get the size of a save state of the loaded ROM. It only changes when
+   * another ROM is loaded.
+   */
+  size_t getStateSize() const;
+
+  /**
+   * Write a save state into a buffer. Cheap enough to do every frame.
+   * @return the bytes written, or 0 if no ROM is loaded or the buffer is
+   * smaller than getStateSize()
+   */
+  size_t saveState(uint8_t *buffer, size_t capacity) const;
+
+  /**
+   * Restore a save state written by saveState(), or by the version 1
+   * saveState(filename). Nothing is changed if the state is damaged or
+   * from another ROM, which version 1 states can not tell.
+   */
+  bool loadState(const uint8_t *data, size_t size);
+
   void saveState(const std::string &filename);
   bool loadState(const std::string &filename);
 
+  /**
+   * Check whether a save state chunk holds host state rather than game
+   * state, such as where the audio output is between samples. Two engines
+   * that ran the same frames differ only in these chunks.
+   */
+  static bool isHostStateChunk(uint32_t id);
+
+  /**
+   * Time saving and loading a state after each of a number of frames of
+   * the loaded ROM, and print the latency and the state size.
+   */
+  void benchmarkStates(int frames);
+
+  /**
+   * Make an independent copy of the running game, for exploring many
+   * branches of it at once, each clone on its own thread if need be.
+   * PRG-ROM and CHR-ROM are shared with the copy. Game Genie codes
+   * applied before cloning carry over, codes applied after only change
+   * the engine they are applied to. RAM, VRAM, OAM, the
+   * palette, CHR-RAM, SRAM, the mapper and the APU are copied. A clone
+   * never reads or writes the battery save file. It has no sound device
+   * of its own and starts with audio output off, setAudioOutput() turns
+   * it on to read its samples.
+   * @return a new engine to delete when done, or nullptr if no ROM is
+   * loaded or it is an NSF
+   */
+  WarpNES *clone() const;
+
+  /**
+   * Time cloning the loaded ROM a number of times, check the clones run
+   * the same as the original, and print the latency and the memory each
+   * clone takes up beside the ROM they share.
+   */
+  void benchmarkClones(int count);
+
+  /**
+   * Get the memory the engine holds for itself: the engine with its RAM,
+   * the PPU, APU, controllers, SRAM, CHR-RAM and any private copy of
+   * PRG-ROM. ROM shared with other engines is not counted.
+   */
+  size_t getMemoryUsed() const;
+
   // CPU state access (for debugging)
   struct CPUState {
     uint8_t A, X, Y, SP; // Registers
@@ -105,6 +223,25 @@ public:
   void checkMMC3IRQ();        // Check for MMC3 IRQ timing
   void forceSRAMSave();
 
+  // Battery saves
+  static const uint32_t SRAM_PAGE_SIZE = 256;
+
+  const uint8_t *getSRAM() const { return sram; }
+  uint32_t getSRAMSize() const { return sramSize; }
+
+  /**
+   * Get the battery save file, empty if the game has no battery or the
+   * engine is a clone.
+   */
+  std::string getSRAMFileName() const;
+
+  /**
+   * Get the SRAM pages written since the last call and mark the SRAM as
+   * saved, for a frontend that writes the battery file itself.
+   * @return bit n set for each SRAM_PAGE_SIZE page n written
+   */
+  uint32_t takeSRAMWrites();
+
   struct PPUCycleState {
     int scanline;
     int cycle;
@@ -137,6 +274,14 @@ public:
     bool battery;        // Battery-backed RAM
     bool trainer;        // 512-byte trainer present
   } nesHeader;
+
+  /**
+   * Read the 16-byte header of an iNES file without printing anything.
+   * @param isINES2 If not null, set when the header is iNES 2.0
+   * @return false if it is not an iNES header
+   */
+  static bool readNESHeader(const uint8_t *header, NESHeader &info,
+                            bool *isINES2 = nullptr);
   PPU* getPPU() { return ppu; }
   const std::string& getROMBaseName() const { return romBaseName; }
 
@@ -177,6 +322,9 @@ private:
   uint8_t ram[0x2000]; // 8KB RAM (mirrored)
   uint8_t *prgROM;     // PRG ROM data
   uint8_t *chrROM;     // CHR ROM data
+  std::shared_ptr<uint8_t> prgData;   // Owns prgROM, shared with clones
+  std::shared_ptr<uint8_t> chrData;   // Owns chrROM, shared with clones unless it is CHR-RAM
+  bool prgPrivate;     // prgROM is a copy that can be written, not the ROM image
   uint32_t prgSize;    // PRG ROM size
   uint32_t chrSize;    // CHR ROM size
   bool romLoaded;
@@ -288,9 +436,9 @@ private:
   void ROR_ACC();
 
   // ROM file parsing
-  bool parseNESHeader(std::ifstream &file);
-  bool loadPRGROM(std::ifstream &file);
-  bool loadCHRROM(std::ifstream &file);
+  bool parseNESHeader(const uint8_t *header);
+  bool loadPRGROM(const std::shared_ptr<const ROMImage> &image, size_t offset);
+  bool loadCHRROM(const std::shared_ptr<const ROMImage> &image, size_t offset);
 
   // Interrupt handling
   void handleNMI();
@@ -319,30 +467,11 @@ private:
   void AXS(uint16_t addr); // (A & X) - immediate
   void KIL();
 
-  // Save state structure
-  struct EmulatorSaveState {
-    char header[8];  // "NESSAVE\0"
-    uint8_t version; // Save state version
-
-    // CPU state
-    uint8_t cpu_A, cpu_X, cpu_Y, cpu_SP, cpu_P;
-    uint16_t cpu_PC;
-    uint64_t cpu_cycles;
-
-    // RAM
-    uint8_t ram[0x2000];
-
-    // PPU state (will be expanded)
-    uint8_t ppu_registers[8];
-    uint8_t ppu_nametable[2048];
-    uint8_t ppu_oam[256];
-    uint8_t ppu_palette[32];
-
-    // APU state (basic)
-    uint8_t apu_registers[24];
-
-    uint8_t reserved[64]; // Future expansion
-  };
+  // Save state chunks
+  void writeState(StateWriter &writer) const;
+  bool checkState(StateReader reader) const;
+  void readState(StateReader &reader);
+  bool loadLegacyState(const uint8_t *data, size_t size);
 
   struct MMC1State {
     uint8_t shiftRegister;
@@ -460,10 +589,12 @@ private:
 
   void catchUpPPU();
   void checkPendingInterrupts();
+  void checkAPUIRQ();
   uint8_t *sram;           // 8KB SRAM for battery saves
   uint32_t sramSize;       // SRAM size (usually 8KB)
   bool sramEnabled;        // SRAM read/write enabled
   bool sramDirty;          // SRAM has been written to
+  uint32_t sramDirtyPages; // SRAM pages written to, see takeSRAMWrites()
   std::string romBaseName; // Base ROM filename for save files
 
   struct MMC2State {
@@ -0,0 +1,659 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <sstream>
+
+#include "FilterChain.hpp"
+
+static uint64_t monotonicMicros()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//---------------------------------------------------------------------------
+// FilterFrame
+//---------------------------------------------------------------------------
+
+FilterFrame::FilterFrame() :
+    pixels(nullptr), width(0), height(0), pitch(0), format(PixelFormat::RGB565)
+{
+}
+
+FilterFrame::FilterFrame(void* pixels, int width, int height, int pitch, PixelFormat format) :
+    pixels(pixels), width(width), height(height), pitch(pitch), format(format)
+{
+}
+
+bool FilterFrame::isPacked() const
+{
+    return pitch == width * bytesPerPixel(format);
+}
+
+int FilterFrame::bytesPerPixel(PixelFormat format)
+{
+    return format == PixelFormat::ARGB8888 ? 4 : 2;
+}
+
+//---------------------------------------------------------------------------
+// Built in stages
+//---------------------------------------------------------------------------
+
+/**
+ * RGB565 to ARGB8888 conversion, rounding each channel to the nearest 8-bit value.
+ */
+class ConvertStage : public FilterStage {
+public:
+    ConvertStage()
+    {
+        for (int i = 0; i < 32; i++) {
+            red[i] = ((i * 255 + 15) / 31) << 16;
+            blue[i] = (i * 255 + 15) / 31;
+        }
+        for (int i = 0; i < 64; i++) {
+            green[i] = ((i * 255 + 31) / 63) << 8;
+        }
+    }
+
+    const char* getName() const override
+    {
+        return "rgb32";
+    }
+
+    bool configure(int inputWidth, int inputHeight, PixelFormat inputFormat, int, int,
+                   int& outputWidth, int& outputHeight, PixelFormat& outputFormat) override
+    {
+        outputWidth = inputWidth;
+        outputHeight = inputHeight;
+        outputFormat = PixelFormat::ARGB8888;
+        return inputFormat == PixelFormat::RGB565;
+    }
+
+    void process(const FilterFrame& input, const FilterFrame& output) override
+    {
+        convert(input, output, 0, input.height);
+    }
+
+    bool processRows(const FilterFrame& input, const FilterFrame& output, int& firstRow, int& lastRow) override
+    {
+        convert(input, output, firstRow, lastRow);
+        return true;
+    }
+
+private:
+    void convert(const FilterFrame& input, const FilterFrame& output, int firstRow, int lastRow)
+    {
+        for (int y = firstRow; y < lastRow; y++) {
+            const uint16_t* src = input.row<uint16_t>(y);
+            uint32_t* dst = output.row<uint32_t>(y);
+            for (int x = 0; x < input.width; x++) {
+                uint16_t color = src[x];
+                dst[x] = 0xFF000000 | red[color >> 11] | green[(color >> 5) & 0x3F] | blue[color & 0x1F];
+            }
+        }
+    }
+
+    uint32_t red[32];
+    uint32_t green[64];
+    uint32_t blue[32];
+};
+
+/**
+ * Nearest neighbour scaling of either pixel format. The destination
+ * column of every output pixel is precomputed when the stage is
+ * configured, and repeated rows are copied instead of scaled again.
+ */
+class ScaleStage : public FilterStage {
+public:
+    enum Mode {
+        FIXED,    /**< Fixed integer factor */
+        FIT,      /**< Largest integer factor inside the target, centred */
+        STRETCH   /**< Fill the target keeping the aspect ratio, centred */
+    };
+
+    ScaleStage(const char* name, Mode mode, int factor = 1) :
+        name(name), mode(mode), factor(factor)
+    {
+    }
+
+    const char* getName() const override
+    {
+        return name;
+    }
+
+    bool configure(int inputWidth, int inputHeight, PixelFormat inputFormat,
+                   int targetWidth, int targetHeight,
+                   int& outputWidth, int& outputHeight, PixelFormat& outputFormat) override
+    {
+        outputFormat = inputFormat;
+        if (mode == FIXED || targetWidth <= 0 || targetHeight <= 0) {
+            outputWidth = inputWidth * factor;
+            outputHeight = inputHeight * factor;
+            imageWidth = outputWidth;
+            imageHeight = outputHeight;
+        } else {
+            outputWidth = targetWidth;
+            outputHeight = targetHeight;
+            if (mode == FIT) {
+                int scale = std::max(1, std::min(targetWidth / inputWidth, targetHeight / inputHeight));
+                imageWidth = inputWidth * scale;
+                imageHeight = inputHeight * scale;
+            } else if ((int64_t)targetWidth * inputHeight < (int64_t)targetHeight * inputWidth) {
+                imageWidth = targetWidth;
+                imageHeight = std::max(1, targetWidth * inputHeight / inputWidth);
+            } else {
+                imageWidth = std::max(1, targetHeight * inputWidth / inputHeight);
+                imageHeight = targetHeight;
+            }
+        }
+
+        // An image larger than the target is cropped around the centre
+        offsetX = (outputWidth - imageWidth) / 2;
+        offsetY = (outputHeight - imageHeight) / 2;
+
+        sourceX.resize(outputWidth);
+        for (int x = 0; x < outputWidth; x++) {
+            int imageX = x - offsetX;
+            sourceX[x] = (imageX >= 0 && imageX < imageWidth) ? (int)((int64_t)imageX * inputWidth / imageWidth) : -1;
+        }
+        sourceY.resize(outputHeight);
+        for (int y = 0; y < outputHeight; y++) {
+            int imageY = y - offsetY;
+            sourceY[y] = (imageY >= 0 && imageY < imageHeight) ? (int)((int64_t)imageY * inputHeight / imageHeight) : -1;
+        }
+        return true;
+    }
+
+    void process(const FilterFrame& input, const FilterFrame& output) override
+    {
+        scaleRows(input, output, 0, output.height);
+    }
+
+    bool processRows(const FilterFrame& input, const FilterFrame& output, int& firstRow, int& lastRow) override
+    {
+        // Source rows only grow down the frame, so the output rows of a
+        // band are contiguous. The border never changes.
+        int outputFirst = output.height;
+        int outputLast = 0;
+        for (int y = 0; y < output.height; y++) {
+            if (sourceY[y] >= firstRow && sourceY[y] < lastRow) {
+                outputFirst = std::min(outputFirst, y);
+                outputLast = y + 1;
+            }
+        }
+
+        if (outputFirst >= outputLast) {
+            firstRow = lastRow = 0;
+            return true;
+        }
+        scaleRows(input, output, outputFirst, outputLast);
+        firstRow = outputFirst;
+        lastRow = outputLast;
+        return true;
+    }
+
+private:
+    const char* name;
+    Mode mode;
+    int factor;
+    int imageWidth, imageHeight;
+    int offsetX, offsetY;
+    std::vector<int> sourceX;   /**< Source column of each output column, -1 for the border */
+    std::vector<int> sourceY;   /**< Source row of each output row, -1 for the border */
+
+    void scaleRows(const FilterFrame& input, const FilterFrame& output, int firstRow, int lastRow)
+    {
+        if (input.format == PixelFormat::ARGB8888) {
+            scale<uint32_t>(input, output, 0xFF000000, firstRow, lastRow);
+        } else {
+            scale<uint16_t>(input, output, 0x0000, firstRow, lastRow);
+        }
+    }
+
+    /**
+     * Scale output rows [firstRow, lastRow).
+     */
+    template <typename T>
+    void scale(const FilterFrame& input, const FilterFrame& output, T border, int firstRow, int lastRow)
+    {
+        int rowBytes = output.width * sizeof(T);
+        int previousY = -2;
+        const T* previousRow = nullptr;
+
+        for (int y = firstRow; y < lastRow; y++) {
+            T* dst = output.row<T>(y);
+            int srcY = sourceY[y];
+
+            if (srcY < 0) {
+                std::fill(dst, dst + output.width, border);
+            } else if (srcY == previousY) {
+                memcpy(dst, previousRow, rowBytes);
+            } else {
+                const T* src = input.row<T>(srcY);
+                for (int x = 0; x < output.width; x++) {
+                    int srcX = sourceX[x];
+                    dst[x] = (srcX < 0) ? border : src[srcX];
+                }
+            }
+
+            if (srcY >= 0) {
+                previousY = srcY;
+                previousRow = dst;
+            }
+        }
+    }
+};
+
+/**
+ * Darkens every other row to 75% brightness.
+ */
+class ScanlineStage : public FilterStage {
+public:
+    const char* getName() const override
+    {
+        return "scanlines";
+    }
+
+    bool configure(int inputWidth, int inputHeight, PixelFormat inputFormat, int, int,
+                   int& outputWidth, int& outputHeight, PixelFormat& outputFormat) override
+    {
+        outputWidth = inputWidth;
+        outputHeight = inputHeight;
+        outputFormat = inputFormat;
+        return true;
+    }
+
+    void process(const FilterFrame& input, const FilterFrame& output) override
+    {
+        darken(input, output, 0, input.height);
+    }
+
+    bool processRows(const FilterFrame& input, const FilterFrame& output, int& firstRow, int& lastRow) override
+    {
+        darken(input, output, firstRow, lastRow);
+        return true;
+    }
+
+private:
+    void darken(const FilterFrame& input, const FilterFrame& output, int firstRow, int lastRow)
+    {
+        int rowBytes = input.width * FilterFrame::bytesPerPixel(input.format);
+        for (int y = firstRow; y < lastRow; y++) {
+            if (!(y & 1)) {
+                memcpy(output.row<uint8_t>(y), input.row<uint8_t>(y), rowBytes);
+                continue;
+            }
+
+            if (input.format == PixelFormat::ARGB8888) {
+                const uint32_t* src = input.row<uint32_t>(y);
+                uint32_t* dst = output.row<uint32_t>(y);
+                for (int x = 0; x < input.width; x++) {
+                    uint32_t p = src[x];
+                    dst[x] = 0xFF000000 | (((p >> 1) & 0x7F7F7F) + ((p >> 2) & 0x3F3F3F));
+                }
+            } else {
+                const uint16_t* src = input.row<uint16_t>(y);
+                uint16_t* dst = output.row<uint16_t>(y);
+                for (int x = 0; x < input.width; x++) {
+                    uint16_t p = src[x];
+                    dst[x] = ((p >> 1) & 0x7BEF) + ((p >> 2) & 0x39E7);
+                }
+            }
+        }
+    }
+};
+
+//---------------------------------------------------------------------------
+// Registry
+//---------------------------------------------------------------------------
+
+static std::map<std::string, FilterStageFactory>& getRegistry()
+{
+    static std::map<std::string, FilterStageFactory> registry = {
+        { "rgb32", []() -> FilterStage* { return new ConvertStage(); } },
+        { "2x", []() -> FilterStage* { return new ScaleStage("2x", ScaleStage::FIXED, 2); } },
+        { "3x", []() -> FilterStage* { return new ScaleStage("3x", ScaleStage::FIXED, 3); } },
+        { "4x", []() -> FilterStage* { return new ScaleStage("4x", ScaleStage::FIXED, 4); } },
+        { "fit", []() -> FilterStage* { return new ScaleStage("fit", ScaleStage::FIT); } },
+        { "stretch", []() -> FilterStage* { return new ScaleStage("stretch", ScaleStage::STRETCH); } },
+        { "scanlines", []() -> FilterStage* { return new ScanlineStage(); } }
+    };
+    return registry;
+}
+
+void FilterChain::registerStage(const std::string& name, FilterStageFactory factory)
+{
+    getRegistry()[name] = factory;
+}
+
+//---------------------------------------------------------------------------
+// FilterChain
+//---------------------------------------------------------------------------
+
+FilterChain::FilterChain() :
+    targetWidth(0), targetHeight(0), inputWidth(0), inputHeight(0),
+    inputFormat(PixelFormat::RGB565), prepared(false), valid(false), hasOutput(false)
+{
+}
+
+FilterChain::~FilterChain()
+{
+    clear();
+}
+
+bool FilterChain::setStages(const std::string& spec)
+{
+    clear();
+
+    std::stringstream stream(spec);
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+        // Trim surrounding spaces
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
+        if (name.empty()) {
+            continue;
+        }
+
+        auto factory = getRegistry().find(name);
+        if (factory == getRegistry().end()) {
+            printf("Unknown video filter stage \"%s\"\n", name.c_str());
+            clear();
+            return false;
+        }
+        addStage(factory->second());
+    }
+    return true;
+}
+
+void FilterChain::addStage(FilterStage* stage)
+{
+    stages.push_back(stage);
+    stats.push_back({ stage->getName(), 0, 0, 0 });
+    prepared = false;
+}
+
+void FilterChain::clear()
+{
+    for (FilterStage* stage : stages) {
+        delete stage;
+    }
+    stages.clear();
+    stats.clear();
+    buffers.clear();
+    frames.clear();
+    prepared = false;
+}
+
+bool FilterChain::isEmpty() const
+{
+    return stages.empty();
+}
+
+void FilterChain::setTargetSize(int width, int height)
+{
+    if (width != targetWidth || height != targetHeight) {
+        targetWidth = width;
+        targetHeight = height;
+        prepared = false;
+    }
+}
+
+bool FilterChain::prepare(int width, int height, PixelFormat format)
+{
+    inputWidth = width;
+    inputHeight = height;
+    inputFormat = format;
+    prepared = true;
+    valid = false;
+    hasOutput = false;
+
+    buffers.resize(stages.size());
+    frames.resize(stages.size());
+
+    for (size_t i = 0; i < stages.size(); i++) {
+        int outputWidth, outputHeight;
+        PixelFormat outputFormat;
+        if (!stages[i]->configure(width, height, format, targetWidth, targetHeight,
+                                  outputWidth, outputHeight, outputFormat)) {
+            printf("Video filter stage \"%s\" can not take %s input\n", stages[i]->getName(),
+                   format == PixelFormat::RGB565 ? "RGB565" : "ARGB8888");
+            return false;
+        }
+
+        int pitch = outputWidth * FilterFrame::bytesPerPixel(outputFormat);
+        buffers[i].resize((size_t)pitch * outputHeight);
+        frames[i] = FilterFrame(buffers[i].data(), outputWidth, outputHeight, pitch, outputFormat);
+
+        width = outputWidth;
+        height = outputHeight;
+        format = outputFormat;
+    }
+
+    valid = true;
+    return true;
+}
+
+int FilterChain::getOutputWidth() const
+{
+    return frames.empty() ? inputWidth : frames.back().width;
+}
+
+int FilterChain::getOutputHeight() const
+{
+    return frames.empty() ? inputHeight : frames.back().height;
+}
+
+PixelFormat FilterChain::getOutputFormat() const
+{
+    return frames.empty() ? inputFormat : frames.back().format;
+}
+
+bool FilterChain::ensurePrepared(const FilterFrame& input)
+{
+    if (!prepared || input.width != inputWidth || input.height != inputHeight || input.format != inputFormat) {
+        prepare(input.width, input.height, input.format);
+    }
+    return valid;
+}
+
+void FilterChain::runStages(const FilterFrame& input, const FilterFrame& output)
+{
+    FilterFrame current = input;
+    for (size_t i = 0; i < stages.size(); i++) {
+        const FilterFrame& target = (i + 1 == stages.size()) ? output : frames[i];
+
+        uint64_t start = monotonicMicros();
+        stages[i]->process(current, target);
+        uint64_t elapsed = monotonicMicros() - start;
+
+        stats[i].frames++;
+        stats[i].totalUs += elapsed;
+        stats[i].maxUs = std::max(stats[i].maxUs, elapsed);
+
+        current = target;
+    }
+    hasOutput = true;
+}
+
+void FilterChain::runStages(const FilterFrame& input, const FilterFrame& output,
+                            const std::vector<RowBand>& changedRows, std::vector<RowBand>& outputRows)
+{
+    // Until the buffers hold a whole frame there is nothing to update
+    bool wholeFrames = !hasOutput;
+    bands = changedRows;
+
+    FilterFrame current = input;
+    for (size_t i = 0; i < stages.size(); i++) {
+        const FilterFrame& target = (i + 1 == stages.size()) ? output : frames[i];
+
+        uint64_t start = monotonicMicros();
+        if (!wholeFrames) {
+            // An unchanged frame still has to reach the stages that need
+            // to see every frame
+            if (bands.empty()) {
+                bands.push_back({ 0, 0 });
+            }
+            nextBands.clear();
+            for (const RowBand& band : bands) {
+                int firstRow = band.first;
+                int lastRow = band.last;
+                if (!stages[i]->processRows(current, target, firstRow, lastRow)) {
+                    wholeFrames = true;
+                    break;
+                }
+                nextBands.push_back({ firstRow, lastRow });
+            }
+            mergeRowBands(nextBands);
+            bands.swap(nextBands);
+        }
+        if (wholeFrames) {
+            stages[i]->process(current, target);
+        }
+        uint64_t elapsed = monotonicMicros() - start;
+
+        stats[i].frames++;
+        stats[i].totalUs += elapsed;
+        stats[i].maxUs = std::max(stats[i].maxUs, elapsed);
+
+        current = target;
+    }
+
+    if (wholeFrames) {
+        outputRows.assign(1, { 0, output.height });
+    } else {
+        outputRows = bands;
+    }
+    hasOutput = true;
+}
+
+bool FilterChain::process(const FilterFrame& input, const FilterFrame& output)
+{
+    if (stages.empty()) {
+        if (input.width != output.width || input.height != output.height || input.format != output.format) {
+            return false;
+        }
+        int rowBytes = input.width * FilterFrame::bytesPerPixel(input.format);
+        for (int y = 0; y < input.height; y++) {
+            memcpy(output.row<uint8_t>(y), input.row<uint8_t>(y), rowBytes);
+        }
+        return true;
+    }
+
+    if (!ensurePrepared(input)) {
+        return false;
+    }
+
+    const FilterFrame& last = frames.back();
+    if (output.width != last.width || output.height != last.height || output.format != last.format) {
+        return false;
+    }
+
+    runStages(input, output);
+    return true;
+}
+
+FilterFrame FilterChain::process(const FilterFrame& input)
+{
+    if (stages.empty()) {
+        return input;
+    }
+
+    if (!ensurePrepared(input)) {
+        return FilterFrame();
+    }
+
+    runStages(input, frames.back());
+    return frames.back();
+}
+
+bool FilterChain::process(const FilterFrame& input, const FilterFrame& output,
+                          const std::vector<RowBand>& changedRows, std::vector<RowBand>& outputRows)
+{
+    if (stages.empty()) {
+        if (input.width != output.width || input.height != output.height || input.format != output.format) {
+            return false;
+        }
+        int rowBytes = input.width * FilterFrame::bytesPerPixel(input.format);
+        for (const RowBand& band : changedRows) {
+            for (int y = band.first; y < band.last; y++) {
+                memcpy(output.row<uint8_t>(y), input.row<uint8_t>(y), rowBytes);
+            }
+        }
+        outputRows = changedRows;
+        return true;
+    }
+
+    if (!ensurePrepared(input)) {
+        return false;
+    }
+
+    const FilterFrame& last = frames.back();
+    if (output.width != last.width || output.height != last.height || output.format != last.format) {
+        return false;
+    }
+
+    runStages(input, output, changedRows, outputRows);
+    return true;
+}
+
+FilterFrame FilterChain::process(const FilterFrame& input, const std::vector<RowBand>& changedRows,
+                                 std::vector<RowBand>& outputRows)
+{
+    if (stages.empty()) {
+        outputRows = changedRows;
+        return input;
+    }
+
+    if (!ensurePrepared(input)) {
+        return FilterFrame();
+    }
+
+    runStages(input, frames.back(), changedRows, outputRows);
+    return frames.back();
+}
+
+std::string FilterChain::getDescription() const
+{
+    std::string description;
+    for (FilterStage* stage : stages) {
+        if (!description.empty()) {
+            description += " > ";
+        }
+        description += stage->getName();
+    }
+    return description.empty() ? "none" : description;
+}
+
+std::vector<FilterChain::StageStats> FilterChain::getStats() const
+{
+    return stats;
+}
+
+void FilterChain::resetStats()
+{
+    for (StageStats& stage : stats) {
+        stage.frames = 0;
+        stage.totalUs = 0;
+        stage.maxUs = 0;
+    }
+}
+
+void FilterChain::printStats() const
+{
+    if (stats.empty()) {
+        return;
+    }
+
+    double totalMs = 0.0;
+    printf("Filters: %dx%d -> %dx%d\n", inputWidth, inputHeight, getOutputWidth(), getOutputHeight());
+    for (const StageStats& stage : stats) {
+        double averageMs = stage.frames ? stage.totalUs / 1000.0 / stage.frames : 0.0;
+        printf("  %-12s %7.3fms avg %7.3fms max (%llu frames)\n", stage.name.c_str(),
+               averageMs, stage.maxUs / 1000.0, (unsigned long long)stage.frames);
+        totalMs += averageMs;
+    }
+    printf("  %-12s %7.3fms avg\n", "total", totalMs);
+}
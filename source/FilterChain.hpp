@@ -0,0 +1,219 @@
+#ifndef FILTER_CHAIN_HPP
+#define FILTER_CHAIN_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "DirtyRows.hpp"
+
+enum class PixelFormat {
+    RGB565,
+    ARGB8888
+};
+
+/**
+ * A frame of pixels, with rows pitch bytes apart.
+ */
+struct FilterFrame {
+    void* pixels;
+    int width;
+    int height;
+    int pitch;
+    PixelFormat format;
+
+    FilterFrame();
+    FilterFrame(void* pixels, int width, int height, int pitch, PixelFormat format);
+
+    template <typename T>
+    T* row(int y) const
+    {
+        return (T*)((uint8_t*)pixels + y * pitch);
+    }
+
+    /**
+     * Check whether the rows are packed without padding.
+     */
+    bool isPacked() const;
+
+    static int bytesPerPixel(PixelFormat format);
+};
+
+/**
+ * One step of a filter chain.
+ */
+class FilterStage {
+public:
+    virtual ~FilterStage() {}
+
+    virtual const char* getName() const = 0;
+
+    /**
+     * Work out the output frame for a given input frame.
+     * @param targetWidth Width the frontend will display at, for the stages that fit to it
+     * @param targetHeight Height the frontend will display at
+     * @return false if the stage can not take the input format
+     */
+    virtual bool configure(int inputWidth, int inputHeight, PixelFormat inputFormat,
+                           int targetWidth, int targetHeight,
+                           int& outputWidth, int& outputHeight, PixelFormat& outputFormat) = 0;
+
+    /**
+     * Process a frame. The frames have the sizes and formats agreed on by
+     * the last configure() call.
+     */
+    virtual void process(const FilterFrame& input, const FilterFrame& output) = 0;
+
+    /**
+     * Process only what depends on input rows [firstRow, lastRow), for a
+     * frame whose other rows did not change since the last call. The
+     * output still holds the result of that call. The range is empty for
+     * a frame that did not change at all.
+     * @param firstRow In: first changed input row. Out: first output row written
+     * @param lastRow In: end of the changed input rows. Out: end of the output rows written
+     * @return false if the stage can only process whole frames
+     */
+    virtual bool processRows(const FilterFrame&, const FilterFrame&, int&, int&)
+    {
+        return false;
+    }
+};
+
+typedef std::function<FilterStage*()> FilterStageFactory;
+
+/**
+ * Chain of video filter stages shared by the frontends.
+ *
+ * Stages are created by name from a registry, so a chain can come from a
+ * configuration string such as "scale2x,scanlines". The intermediate
+ * buffers are allocated when the chain is prepared and reused for every
+ * frame, and the last stage writes straight into the frontend's frame.
+ * When only some rows of the input changed, the stages that support it
+ * redo just the rows that depend on them. The time spent in each stage is
+ * recorded for profiling.
+ *
+ * Built in stages:
+ *   rgb32      RGB565 to ARGB8888
+ *   2x, 3x, 4x nearest neighbour integer scaling
+ *   fit        largest integer scale that fits the target size, centred
+ *   stretch    nearest neighbour scale to fill the target size, keeping the aspect ratio
+ *   scanlines  darken every other row
+ */
+class FilterChain {
+public:
+    struct StageStats {
+        std::string name;
+        uint64_t frames;
+        uint64_t totalUs;
+        uint64_t maxUs;
+    };
+
+    FilterChain();
+    ~FilterChain();
+
+    /**
+     * Register a stage under a name, replacing any stage with the same name.
+     */
+    static void registerStage(const std::string& name, FilterStageFactory factory);
+
+    /**
+     * Replace the stages with a comma separated list of stage names.
+     * @return false if a name is unknown, in which case the chain is empty
+     */
+    bool setStages(const std::string& spec);
+
+    /**
+     * Append a stage. The chain takes ownership of it.
+     */
+    void addStage(FilterStage* stage);
+
+    void clear();
+    bool isEmpty() const;
+
+    /**
+     * Set the size the frontend displays at, used by the fitting stages.
+     */
+    void setTargetSize(int width, int height);
+
+    /**
+     * Configure every stage for an input frame and allocate the
+     * intermediate buffers. Called by process() when the input changes.
+     * @return false if the stages do not fit together
+     */
+    bool prepare(int width, int height, PixelFormat format);
+
+    int getOutputWidth() const;
+    int getOutputHeight() const;
+    PixelFormat getOutputFormat() const;
+
+    /**
+     * Run the chain into a frame provided by the caller, which must match
+     * the output size and format.
+     * @return false if the chain could not run
+     */
+    bool process(const FilterFrame& input, const FilterFrame& output);
+
+    /**
+     * Run the chain into the chain's own output buffer.
+     * @return the output frame, or an empty frame if the chain could not run
+     */
+    FilterFrame process(const FilterFrame& input);
+
+    /**
+     * Run the chain for a frame where only some rows changed since the
+     * last run, into a frame that still holds that run's output. From the
+     * first stage that can only take whole frames on, everything is
+     * processed.
+     * @param changedRows Input rows that changed
+     * @param outputRows Receives the output rows that changed, empty if the output is unchanged
+     * @return false if the chain could not run
+     */
+    bool process(const FilterFrame& input, const FilterFrame& output,
+                 const std::vector<RowBand>& changedRows, std::vector<RowBand>& outputRows);
+
+    /**
+     * Run the chain for a frame where only some rows changed, into the
+     * chain's own output buffer.
+     * @return the output frame, or an empty frame if the chain could not run
+     */
+    FilterFrame process(const FilterFrame& input, const std::vector<RowBand>& changedRows,
+                        std::vector<RowBand>& outputRows);
+
+    /**
+     * Get the stage names joined by " > ".
+     */
+    std::string getDescription() const;
+
+    std::vector<StageStats> getStats() const;
+    void resetStats();
+
+    /**
+     * Print the average and worst time of each stage since the last reset.
+     */
+    void printStats() const;
+
+private:
+    std::vector<FilterStage*> stages;
+    std::vector<StageStats> stats;
+    std::vector<std::vector<uint8_t> > buffers;  /**< Output of every stage, the last one only used by process(input) */
+    std::vector<FilterFrame> frames;             /**< Frames over the buffers */
+
+    int targetWidth;
+    int targetHeight;
+    int inputWidth;
+    int inputHeight;
+    PixelFormat inputFormat;
+    bool prepared;
+    bool valid;
+    bool hasOutput;                              /**< The buffers hold a whole processed frame */
+    std::vector<RowBand> bands;
+    std::vector<RowBand> nextBands;
+
+    bool ensurePrepared(const FilterFrame& input);
+    void runStages(const FilterFrame& input, const FilterFrame& output);
+    void runStages(const FilterFrame& input, const FilterFrame& output,
+                   const std::vector<RowBand>& changedRows, std::vector<RowBand>& outputRows);
+};
+
+#endif // FILTER_CHAIN_HPP
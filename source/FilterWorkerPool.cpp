@@ -0,0 +1,121 @@
+#include <algorithm>
+
+#include "FilterWorkerPool.hpp"
+
+// Filters are memory bound, beyond this many threads they stop scaling
+static const int MAX_AUTO_THREADS = 4;
+
+FilterWorkerPool::FilterWorkerPool(int threads)
+    : currentJob(nullptr), currentRows(0), generation(0), pending(0), stopping(false)
+{
+    setThreadCount(threads);
+}
+
+FilterWorkerPool::~FilterWorkerPool()
+{
+    stopWorkers();
+}
+
+void FilterWorkerPool::setThreadCount(int threads)
+{
+    if (threads <= 0) {
+        threads = std::min((int)std::thread::hardware_concurrency(), MAX_AUTO_THREADS);
+    }
+    threads = std::max(1, threads);
+
+    if (threads == getThreadCount()) {
+        return;
+    }
+
+    stopWorkers();
+    startWorkers(threads);
+}
+
+int FilterWorkerPool::getThreadCount() const
+{
+    return (int)workers.size() + 1;
+}
+
+void FilterWorkerPool::startWorkers(int threads)
+{
+    stopping = false;
+    for (int i = 1; i < threads; i++) {
+        workers.emplace_back(&FilterWorkerPool::workerLoop, this, i, generation);
+    }
+}
+
+void FilterWorkerPool::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    startCondition.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void FilterWorkerPool::runStripe(int index, int rows, const std::function<void(int, int)>& job) const
+{
+    int threads = getThreadCount();
+    int firstRow = rows * index / threads;
+    int lastRow = rows * (index + 1) / threads;
+    if (firstRow < lastRow) {
+        job(firstRow, lastRow);
+    }
+}
+
+void FilterWorkerPool::run(int rows, const std::function<void(int, int)>& job)
+{
+    if (workers.empty()) {
+        job(0, rows);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentJob = &job;
+        currentRows = rows;
+        pending = (int)workers.size();
+        generation++;
+    }
+    startCondition.notify_all();
+
+    runStripe(0, rows, job);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [this]() { return pending == 0; });
+    currentJob = nullptr;
+}
+
+void FilterWorkerPool::workerLoop(int index, unsigned seenGeneration)
+{
+    while (true) {
+        const std::function<void(int, int)>* job;
+        int rows;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            startCondition.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+            if (stopping) {
+                return;
+            }
+            seenGeneration = generation;
+            job = currentJob;
+            rows = currentRows;
+        }
+
+        runStripe(index, rows, *job);
+
+        bool last;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            last = (--pending == 0);
+        }
+        if (last) {
+            doneCondition.notify_one();
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef FILTER_WORKER_POOL_HPP
+#define FILTER_WORKER_POOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Small persistent thread pool that splits a frame into row stripes.
+ * The calling thread processes the first stripe itself, so a pool of one
+ * thread runs everything inline without any synchronization.
+ */
+class FilterWorkerPool {
+public:
+    /**
+     * @param threads Number of threads including the caller (0 = automatic)
+     */
+    FilterWorkerPool(int threads = 0);
+    ~FilterWorkerPool();
+
+    /**
+     * Change the number of threads (0 = automatic, up to 4).
+     */
+    void setThreadCount(int threads);
+
+    /**
+     * Get the number of threads including the caller.
+     */
+    int getThreadCount() const;
+
+    /**
+     * Run a job over rows [0, rows), one contiguous stripe per thread.
+     * Returns once every stripe is done.
+     * @param rows Number of rows to split
+     * @param job Called with the first row and one past the last row of a stripe
+     */
+    void run(int rows, const std::function<void(int, int)>& job);
+
+private:
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable startCondition;
+    std::condition_variable doneCondition;
+    const std::function<void(int, int)>* currentJob;
+    int currentRows;
+    unsigned generation;  /**< Bumped for every job so workers can tell a new one from a spurious wakeup */
+    int pending;          /**< Worker stripes of the current job still running */
+    bool stopping;
+
+    void startWorkers(int threads);
+    void stopWorkers();
+    void workerLoop(int index, unsigned seenGeneration);
+    void runStripe(int index, int rows, const std::function<void(int, int)>& job) const;
+};
+
+#endif // FILTER_WORKER_POOL_HPP
@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+#include "FramePacer.hpp"
+
+// How far the last stretch of a wait is spun instead of slept, since a
+// sleep can overshoot by about a scheduler tick
+static const uint64_t SPIN_US = 1000;
+
+// Frames the schedule may fall behind before it restarts from now instead
+// of running frames back to back to catch up
+static const uint64_t MAX_BEHIND_FRAMES = 4;
+
+// How far the refresh rate may be from the frame rate for the display mode.
+// Close enough that the rate control still keeps the audio in step
+static const double MAX_REFRESH_MISMATCH = 0.02;
+
+// Weight of each new queue depth in the smoothed level. The device takes
+// whole buffers at a time, so the raw depth is a sawtooth
+static const double LEVEL_SMOOTHING = 0.05;
+
+FramePacer::FramePacer() :
+    mode(TIMER), frameRate(60.0), refreshRate(0.0), maxRateAdjustment(0.005),
+    audioRate(0), audioTarget(0), audioLevel(-1.0), rateAdjustment(1.0),
+    nextFrameUs(0), lastFrameUs(0)
+{
+    resetStats();
+}
+
+bool FramePacer::parseMode(const std::string& name, Mode& mode)
+{
+    if (name == "timer") {
+        mode = TIMER;
+    } else if (name == "display") {
+        mode = DISPLAY;
+    } else if (name == "audio") {
+        mode = AUDIO;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* FramePacer::getModeName(Mode mode)
+{
+    switch (mode) {
+    case DISPLAY:
+        return "display";
+    case AUDIO:
+        return "audio";
+    default:
+        return "timer";
+    }
+}
+
+void FramePacer::setMode(Mode newMode)
+{
+    mode = newMode;
+    rateAdjustment = 1.0;
+    reset();
+}
+
+FramePacer::Mode FramePacer::getMode() const
+{
+    return mode;
+}
+
+void FramePacer::setFrameRate(double framesPerSecond)
+{
+    frameRate = framesPerSecond > 0.0 ? framesPerSecond : 60.0;
+}
+
+void FramePacer::setRefreshRate(double hertz)
+{
+    refreshRate = hertz;
+}
+
+bool FramePacer::canPaceToDisplay() const
+{
+    return refreshRate > 0.0 && std::abs(refreshRate - frameRate) <= frameRate * MAX_REFRESH_MISMATCH;
+}
+
+void FramePacer::setAudioQueue(std::function<int()> bufferedSamples, int sampleRate, int targetSamples)
+{
+    audioQueue = bufferedSamples;
+    audioRate = sampleRate;
+    audioTarget = targetSamples;
+    audioLevel = -1.0;
+    rateAdjustment = 1.0;
+}
+
+void FramePacer::setMaxRateAdjustment(double maximum)
+{
+    maxRateAdjustment = std::max(0.0, maximum);
+}
+
+void FramePacer::reset()
+{
+    nextFrameUs = 0;
+    lastFrameUs = 0;
+}
+
+uint64_t FramePacer::getPeriod() const
+{
+    if (mode == DISPLAY && canPaceToDisplay()) {
+        return (uint64_t)(1000000.0 / refreshRate + 0.5);
+    }
+    return (uint64_t)(1000000.0 / frameRate + 0.5);
+}
+
+int FramePacer::getQueueTarget() const
+{
+    if (audioTarget > 0) {
+        return audioTarget;
+    }
+    // Two frames of samples
+    return (int)(audioRate * 2 / frameRate);
+}
+
+uint64_t FramePacer::getTimeUntilFrame() const
+{
+    if (nextFrameUs == 0) {
+        return 0;
+    }
+
+    uint64_t now = nowMicros();
+    if (mode == AUDIO && audioQueue && audioRate > 0) {
+        // Run a frame as soon as the queue drops below the target, but
+        // keep going at the frame rate if the device stops taking samples
+        int buffered = audioQueue();
+        int target = getQueueTarget();
+        uint64_t limit = lastFrameUs + 2 * getPeriod();
+        if (buffered < target || now >= limit) {
+            return 0;
+        }
+        uint64_t drainUs = (uint64_t)(buffered - target) * 1000000 / audioRate;
+        return std::min(std::max(drainUs, SPIN_US), limit - now);
+    }
+
+    return now >= nextFrameUs ? 0 : nextFrameUs - now;
+}
+
+void FramePacer::waitForFrame()
+{
+    while (true) {
+        uint64_t wait = getTimeUntilFrame();
+        if (wait == 0) {
+            break;
+        }
+
+        if (mode == AUDIO) {
+            std::this_thread::sleep_for(std::chrono::microseconds(wait));
+        } else if (wait > SPIN_US) {
+            std::this_thread::sleep_for(std::chrono::microseconds(wait - SPIN_US));
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void FramePacer::beginFrame()
+{
+    uint64_t now = nowMicros();
+    uint64_t period = getPeriod();
+
+    if (lastFrameUs != 0) {
+        uint64_t interval = now - lastFrameUs;
+        uint64_t jitter = interval > period ? interval - period : period - interval;
+        statIntervals++;
+        statIntervalTotalUs += interval;
+        statIntervalMaxUs = std::max(statIntervalMaxUs, interval);
+        statJitterTotalUs += jitter;
+        statJitterMaxUs = std::max(statJitterMaxUs, jitter);
+    }
+
+    if (nextFrameUs == 0 || mode == AUDIO) {
+        nextFrameUs = now + period;
+    } else {
+        if (now > nextFrameUs + period / 2) {
+            statLateFrames++;
+        }
+        if (now > nextFrameUs + MAX_BEHIND_FRAMES * period) {
+            nextFrameUs = now + period;
+            statResyncs++;
+        } else {
+            nextFrameUs += period;
+        }
+    }
+    lastFrameUs = now;
+    statFrames++;
+
+    if (audioQueue) {
+        int buffered = audioQueue();
+        if (mode != AUDIO && audioTarget > 0) {
+            updateRateControl(buffered);
+        }
+
+        double ppm = (rateAdjustment - 1.0) * 1000000.0;
+        statAudioTotal += buffered;
+        statAudioMin = std::min(statAudioMin, buffered);
+        statAudioMax = std::max(statAudioMax, buffered);
+        statRateTotal += ppm;
+        statRateMin = std::min(statRateMin, ppm);
+        statRateMax = std::max(statRateMax, ppm);
+    }
+}
+
+void FramePacer::updateRateControl(int buffered)
+{
+    if (audioLevel < 0.0) {
+        audioLevel = buffered;
+    } else {
+        audioLevel += (buffered - audioLevel) * LEVEL_SMOOTHING;
+    }
+
+    // Below the target makes more samples per frame, above it fewer
+    double error = (audioTarget - audioLevel) / audioTarget;
+    error = std::max(-1.0, std::min(1.0, error));
+    rateAdjustment = 1.0 + error * maxRateAdjustment;
+}
+
+double FramePacer::getRateAdjustment() const
+{
+    return rateAdjustment;
+}
+
+FramePacer::Stats FramePacer::getStats() const
+{
+    Stats stats;
+    stats.mode = mode;
+    stats.periodMs = getPeriod() / 1000.0;
+    stats.frames = statFrames;
+    stats.intervalAverageMs = statIntervals ? statIntervalTotalUs / 1000.0 / statIntervals : 0.0;
+    stats.intervalMaxMs = statIntervalMaxUs / 1000.0;
+    stats.jitterAverageMs = statIntervals ? statJitterTotalUs / 1000.0 / statIntervals : 0.0;
+    stats.jitterMaxMs = statJitterMaxUs / 1000.0;
+    stats.lateFrames = statLateFrames;
+    stats.resyncs = statResyncs;
+
+    bool audio = audioQueue && statFrames > 0;
+    stats.audioTarget = (mode == AUDIO) ? getQueueTarget() : audioTarget;
+    stats.audioAverage = audio ? (double)statAudioTotal / statFrames : 0.0;
+    stats.audioMin = audio ? statAudioMin : 0;
+    stats.audioMax = audio ? statAudioMax : 0;
+    stats.rateAverage = audio ? statRateTotal / statFrames : 0.0;
+    stats.rateMin = audio ? statRateMin : 0.0;
+    stats.rateMax = audio ? statRateMax : 0.0;
+    return stats;
+}
+
+void FramePacer::resetStats()
+{
+    statFrames = 0;
+    statIntervals = 0;
+    statIntervalTotalUs = 0;
+    statIntervalMaxUs = 0;
+    statJitterTotalUs = 0;
+    statJitterMaxUs = 0;
+    statLateFrames = 0;
+    statResyncs = 0;
+    statAudioTotal = 0;
+    statAudioMin = INT32_MAX;
+    statAudioMax = 0;
+    statRateTotal = 0.0;
+    statRateMin = 1e9;
+    statRateMax = -1e9;
+}
+
+uint64_t FramePacer::nowMicros()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FramePacer::Stats::print() const
+{
+    printf("Pacing: %s %.2fHz, %llu frames, interval %.2fms avg %.2fms max, "
+           "jitter %.3fms avg %.3fms max, %llu late, %llu resyncs\n",
+           getModeName(mode), periodMs > 0.0 ? 1000.0 / periodMs : 0.0, (unsigned long long)frames,
+           intervalAverageMs, intervalMaxMs, jitterAverageMs, jitterMaxMs,
+           (unsigned long long)lateFrames, (unsigned long long)resyncs);
+    if (audioTarget > 0) {
+        printf("  audio queue %.0f avg %d-%d (target %d), rate %+.0fppm avg %+.0f to %+.0fppm\n",
+               audioAverage, audioMin, audioMax, audioTarget, rateAverage, rateMin, rateMax);
+    }
+}
@@ -0,0 +1,181 @@
+#ifndef FRAME_PACER_HPP
+#define FRAME_PACER_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/**
+ * Paces emulated frames for the SDL and GTK frontends.
+ *
+ * Frames are scheduled on a monotonic microsecond clock, each one a period
+ * after the previous deadline, so late wakeups do not add up. There are
+ * three ways to pick the period:
+ *   timer    the configured frame rate
+ *   display  the display's refresh rate, so every refresh gets one frame,
+ *            as long as it is within 2% of the frame rate
+ *   audio    whenever the audio queue drops below its target depth
+ *
+ * In the timer and display modes the audio device drains the queue at its
+ * own rate, which never quite matches the frame rate. The pacer watches
+ * the queue depth and works out a resampling ratio for the APU that makes
+ * a little more or a little less audio per frame to hold the queue at the
+ * target depth, so it neither runs dry nor grows late.
+ */
+class FramePacer {
+public:
+    enum Mode {
+        TIMER,
+        DISPLAY,
+        AUDIO
+    };
+
+    /**
+     * Timing counters since the last reset.
+     */
+    struct Stats {
+        Mode mode;
+        double periodMs;            /**< Period frames are paced at */
+        uint64_t frames;
+        double intervalAverageMs;   /**< Average time between frame starts */
+        double intervalMaxMs;       /**< Longest time between frame starts */
+        double jitterAverageMs;     /**< Average distance of the interval from the period */
+        double jitterMaxMs;         /**< Largest distance of the interval from the period */
+        uint64_t lateFrames;        /**< Frames started over half a period after their deadline */
+        uint64_t resyncs;           /**< Times the schedule was restarted after falling far behind */
+
+        int audioTarget;            /**< Target audio queue depth in samples, 0 without rate control */
+        double audioAverage;        /**< Average audio queue depth at a frame start */
+        int audioMin;
+        int audioMax;
+        double rateAverage;         /**< Average resampling adjustment, in parts per million */
+        double rateMin;
+        double rateMax;
+
+        /**
+         * Print the stats as a single line.
+         */
+        void print() const;
+    };
+
+    FramePacer();
+
+    /**
+     * Get a mode from its name ("timer", "display" or "audio").
+     * @return false if the name is unknown
+     */
+    static bool parseMode(const std::string& name, Mode& mode);
+
+    static const char* getModeName(Mode mode);
+
+    void setMode(Mode mode);
+    Mode getMode() const;
+
+    /**
+     * Set the frame rate of the timer mode, and the fallback of the
+     * display mode when the refresh rate is unknown or too far off.
+     */
+    void setFrameRate(double framesPerSecond);
+
+    /**
+     * Set the display refresh rate for the display mode (0 = unknown).
+     */
+    void setRefreshRate(double hertz);
+
+    /**
+     * Check whether the display mode can use the refresh rate. A display
+     * much faster or slower than the frame rate would change the speed of
+     * the game, so the frontends pace with the timer instead.
+     */
+    bool canPaceToDisplay() const;
+
+    /**
+     * Watch an audio queue, for the audio mode and the rate control.
+     * @param bufferedSamples Returns the number of samples queued
+     * @param sampleRate Samples played per second
+     * @param targetSamples Queue depth to hold, 0 to turn the rate control off
+     */
+    void setAudioQueue(std::function<int()> bufferedSamples, int sampleRate, int targetSamples);
+
+    /**
+     * Set how far the resampling ratio may move from 1 (default 0.005).
+     */
+    void setMaxRateAdjustment(double maximum);
+
+    /**
+     * Start the schedule again from now, e.g. after a pause.
+     */
+    void reset();
+
+    /**
+     * Get how long until the next frame is due, for frontends that can
+     * not block and have to come back later.
+     * @return microseconds, 0 if the frame is due
+     */
+    uint64_t getTimeUntilFrame() const;
+
+    /**
+     * Sleep until the next frame is due. Call beginFrame() after it.
+     */
+    void waitForFrame();
+
+    /**
+     * Start a frame: update the schedule, the rate control and the stats.
+     * Reads the audio queue, so call it where the engine may be touched.
+     */
+    void beginFrame();
+
+    /**
+     * Get the resampling ratio for the APU, 1.0 without rate control.
+     */
+    double getRateAdjustment() const;
+
+    /**
+     * Get the period frames are paced at, in microseconds.
+     */
+    uint64_t getPeriod() const;
+
+    Stats getStats() const;
+    void resetStats();
+
+    /**
+     * Get the monotonic clock the pacer runs on, in microseconds.
+     */
+    static uint64_t nowMicros();
+
+private:
+    Mode mode;
+    double frameRate;
+    double refreshRate;
+    double maxRateAdjustment;
+
+    std::function<int()> audioQueue;
+    int audioRate;
+    int audioTarget;
+    double audioLevel;          /**< Smoothed queue depth */
+    double rateAdjustment;
+
+    uint64_t nextFrameUs;       /**< Deadline of the next frame, 0 before the first one */
+    uint64_t lastFrameUs;
+
+    // Stats
+    uint64_t statFrames;
+    uint64_t statIntervals;
+    uint64_t statIntervalTotalUs;
+    uint64_t statIntervalMaxUs;
+    uint64_t statJitterTotalUs;
+    uint64_t statJitterMaxUs;
+    uint64_t statLateFrames;
+    uint64_t statResyncs;
+    uint64_t statAudioTotal;
+    int statAudioMin;
+    int statAudioMax;
+    double statRateTotal;
+    double statRateMin;
+    double statRateMax;
+
+    int getQueueTarget() const;
+    void updateRateControl(int buffered);
+};
+
+#endif // FRAME_PACER_HPP
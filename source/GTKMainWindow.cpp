@@ -1,5 +1,7 @@
 #include <SDL2/SDL.h>
 #include <algorithm>
+#include <ctime>
+#include <string>
 #include "GTKMainWindow.hpp"
 #include "Emulation/WarpNES.hpp"
 #include "Emulation/ControllerSDL.hpp"
@@ -28,13 +30,13 @@ const int GTK3MainWindow::NUM_PRESET_RESOLUTIONS = sizeof(PRESET_RESOLUTIONS) /
 GTK3MainWindow::GTK3MainWindow() 
     : window(nullptr), drawing_area(nullptr), engine(nullptr), 
       game_running(false), game_paused(false),
-      frame_timer_id(0), status_message_id(0),
+      frame_timer_id(0), rom_library("romlibrary.idx"), audio_stats_time(0), status_message_id(0),
       // SDL backend
       sdl_window(nullptr), sdl_renderer(nullptr), sdl_texture(nullptr), sdl_initialized(false),
       // Cairo backend  
       cairo_surface(nullptr), cairo_context(nullptr), cairo_buffer(nullptr), cairo_initialized(false),
       // Shared framebuffer
-      nes_framebuffer(nullptr), rgba_framebuffer(nullptr), framebuffer_width(256), framebuffer_height(240),
+      nes_framebuffer(nullptr), rgba_framebuffer(nullptr), rgba_frame(0), framebuffer_width(256), framebuffer_height(240),
       // Rendering backend - CHANGED: Make Cairo the default
       current_backend(RenderBackend::CAIRO_SOFTWARE), preferred_backend(RenderBackend::CAIRO_SOFTWARE), backend_switching_enabled(true),
       // Resolution settings - CHANGED: Enable integer scaling (pixel perfect) by default
@@ -43,8 +45,22 @@ GTK3MainWindow::GTK3MainWindow()
       force_texture_recreation(false),
       gameGenie(nullptr),
       // Filter settings
-      current_filter(FilterType::NONE), filtered_texture(nullptr), filter_buffer(nullptr), filter_scale(1)
+      current_filter(FilterType::NONE), filtered_texture(nullptr),
+      video_filters(Configuration::getFilterThreads())
 {
+    video_filters.setHQDN3DStrength(Configuration::getHqdn3dSpatialStrength(),
+                                    Configuration::getHqdn3dTemporalStrength());
+    video_filters.registerStages();
+    if (Configuration::getHqdn3dEnabled()) {
+        denoise_chain.setStages("hqdn3d");
+    }
+    governor.setEnabled(Configuration::getQualityGovernorEnabled());
+    governor.setMaxFrameSkip(Configuration::getMaxFrameSkip());
+    governor.setCanReduceFilters(!denoise_chain.isEmpty());
+    rewind_buffer.setCapacity((size_t)Configuration::getRewindBufferSize() * 1024 * 1024);
+    rewind_buffer.setKeyframeInterval(Configuration::getRewindKeyframeInterval());
+    run_ahead.setFrames(Configuration::getRunAheadFrames());
+    movie_record = false;
     strcpy(status_message, "Ready");
     
     // Allocate shared framebuffers
@@ -75,7 +91,6 @@ GTK3MainWindow::~GTK3MainWindow() {
     shutdown();
     delete[] nes_framebuffer;
     delete[] rgba_framebuffer;
-    delete[] filter_buffer;
     delete gameGenie;
 }
 
@@ -141,6 +156,11 @@ bool GTK3MainWindow::initialize() {
     gtk_widget_show_all(window);
     gtk_widget_grab_focus(window);
     
+    // Auto-detect needs the window on screen to time the backends
+    if (preferred_backend == RenderBackend::AUTO) {
+        switchRenderBackend(RenderBackend::AUTO);
+    }
+    
     char status_msg[256];
     snprintf(status_msg, sizeof(status_msg), "WarpNES GTK3 (%s) - Pixel Perfect Mode - Load a ROM to begin", 
              backend_to_string(current_backend));
@@ -158,7 +178,7 @@ RenderBackend GTK3MainWindow::getRenderBackend() const {
     return current_backend;
 }
 
-bool GTK3MainWindow::detect_best_backend() {
+bool GTK3MainWindow::detect_best_backend(bool rerun_benchmark) {
     printf("=== Auto-detecting best rendering backend ===\n");
     
     // Make sure widgets are shown before trying SDL
@@ -172,27 +192,203 @@ bool GTK3MainWindow::detect_best_backend() {
     // Small delay to ensure window is fully created
     g_usleep(100000);  // 100ms delay
     
-    // Try SDL first (hardware acceleration preferred)
-    printf("Testing SDL backend\n");
-    if (init_sdl_backend()) {
-        current_backend = RenderBackend::SDL_HARDWARE;
-        printf("SUCCESS: Using SDL hardware-accelerated rendering\n");
-        return true;
+    // Time both backends once per machine, the result is cached
+    std::string machine = get_machine_id();
+    BackendBenchmark result;
+    if (!rerun_benchmark && load_backend_benchmark(machine, result)) {
+        printf("Using cached backend benchmark for %s\n", machine.c_str());
+    } else {
+        result = run_backend_benchmark();
+        save_backend_benchmark(machine, result);
     }
+    printf("Backend benchmark: SDL %.2fms/frame, Cairo %.2fms/frame\n",
+           result.sdl_us / 1000.0, result.cairo_us / 1000.0);
     
-    printf("SDL backend failed, falling back to Cairo\n");
+    // Try the faster backend first and fall back to the other
+    bool sdl_first = result.sdl_us >= 0.0 && (result.cairo_us < 0.0 || result.sdl_us <= result.cairo_us);
+    RenderBackend order[2] = { RenderBackend::SDL_HARDWARE, RenderBackend::CAIRO_SOFTWARE };
+    if (!sdl_first) {
+        std::swap(order[0], order[1]);
+    }
     
-    // Fall back to Cairo
-    if (init_cairo_backend()) {
-        current_backend = RenderBackend::CAIRO_SOFTWARE;
-        printf("SUCCESS: Using Cairo software rendering\n");
-        return true;
+    for (RenderBackend backend : order) {
+        bool success = (backend == RenderBackend::SDL_HARDWARE) ? init_sdl_backend() : init_cairo_backend();
+        if (success) {
+            current_backend = backend;
+            printf("SUCCESS: Using %s rendering\n", backend_to_string(backend));
+            return true;
+        }
+        printf("%s backend failed\n", backend_to_string(backend));
     }
     
     printf("ERROR: No rendering backend could be initialized\n");
     return false;
 }
 
+GTK3MainWindow::BackendBenchmark GTK3MainWindow::run_backend_benchmark() {
+    printf("Benchmarking rendering backends\n");
+    
+    BackendBenchmark result;
+    result.sdl_us = benchmark_sdl_backend();
+    result.cairo_us = benchmark_cairo_backend();
+    
+    // Leave the screen black for whichever backend is picked
+    memset(nes_framebuffer, 0, 256 * 240 * sizeof(uint16_t));
+    memset(rgba_framebuffer, 0, 256 * 240 * sizeof(uint32_t));
+    rgba_frame = 0;
+    return result;
+}
+
+// Frames timed per backend, after a few untimed ones to warm up caches
+// and drivers
+static const int BENCHMARK_FRAMES = 60;
+static const int BENCHMARK_WARMUP_FRAMES = 5;
+
+/**
+ * Cost of a benchmark run per frame. A backend that blocks on vsync spends
+ * up to a frame period waiting, which is not a cost, so the CPU time is
+ * used unless the frames took longer than a period of wall time.
+ */
+static double benchmark_frame_cost(double wall_us, double cpu_us, int frames) {
+    double period_us = 1000000.0 / Configuration::getFrameRate();
+    return std::max(cpu_us / frames, wall_us / frames - period_us);
+}
+
+double GTK3MainWindow::benchmark_sdl_backend() {
+    bool was_initialized = sdl_initialized;
+    if (!was_initialized && !init_sdl_backend()) {
+        return -1.0;
+    }
+    
+    gint64 wall_start = 0;
+    std::clock_t cpu_start = 0;
+    for (int frame = 0; frame < BENCHMARK_WARMUP_FRAMES + BENCHMARK_FRAMES; frame++) {
+        if (frame == BENCHMARK_WARMUP_FRAMES) {
+            wall_start = g_get_monotonic_time();
+            cpu_start = std::clock();
+        }
+        fill_benchmark_frame(frame);
+        render_frame_sdl();
+    }
+    double wall_us = (double)(g_get_monotonic_time() - wall_start);
+    double cpu_us = (double)(std::clock() - cpu_start) * 1000000.0 / CLOCKS_PER_SEC;
+    
+    if (!was_initialized) {
+        cleanup_sdl_backend();
+    }
+    return benchmark_frame_cost(wall_us, cpu_us, BENCHMARK_FRAMES);
+}
+
+double GTK3MainWindow::benchmark_cairo_backend() {
+    GdkWindow* gdk_window = gtk_widget_get_window(drawing_area);
+    if (!gdk_window) {
+        return -1.0;
+    }
+    
+    // Paint into a surface like the window's, then wait for the display
+    // server so its share of the work is counted too
+    int width = gtk_widget_get_allocated_width(drawing_area);
+    int height = gtk_widget_get_allocated_height(drawing_area);
+    cairo_surface_t* target = gdk_window_create_similar_surface(gdk_window, CAIRO_CONTENT_COLOR, width, height);
+    cairo_t* cr = cairo_create(target);
+    GdkDisplay* display = gdk_window_get_display(gdk_window);
+    
+    gint64 wall_start = 0;
+    std::clock_t cpu_start = 0;
+    for (int frame = 0; frame < BENCHMARK_WARMUP_FRAMES + BENCHMARK_FRAMES; frame++) {
+        if (frame == BENCHMARK_WARMUP_FRAMES) {
+            wall_start = g_get_monotonic_time();
+            cpu_start = std::clock();
+        }
+        fill_benchmark_frame(frame);
+        convert_nes_to_rgba(0, 256 * 240);
+        paint_cairo_frame(cr, width, height);
+        cairo_surface_flush(target);
+        gdk_display_sync(display);
+    }
+    double wall_us = (double)(g_get_monotonic_time() - wall_start);
+    double cpu_us = (double)(std::clock() - cpu_start) * 1000000.0 / CLOCKS_PER_SEC;
+    
+    cairo_destroy(cr);
+    cairo_surface_destroy(target);
+    return benchmark_frame_cost(wall_us, cpu_us, BENCHMARK_FRAMES);
+}
+
+void GTK3MainWindow::fill_benchmark_frame(int frame) {
+    // A scrolling pattern, so every row changes every frame
+    for (int y = 0; y < 240; y++) {
+        for (int x = 0; x < 256; x++) {
+            nes_framebuffer[y * 256 + x] = (uint16_t)(((x + frame) * 0x0841) ^ ((y + frame * 3) << 5));
+        }
+    }
+}
+
+std::string GTK3MainWindow::get_machine_id() {
+    // The host and the display, since either can change which backend is faster
+    std::string machine = g_get_host_name();
+    GdkDisplay* display = gdk_display_get_default();
+    if (display) {
+        machine += "/";
+        machine += gdk_display_get_name(display);
+    }
+    for (char& c : machine) {
+        if (c == ' ' || c == '\t') {
+            c = '_';
+        }
+    }
+    return machine;
+}
+
+bool GTK3MainWindow::load_backend_benchmark(const std::string& machine, BackendBenchmark& result) {
+    FILE* file = fopen("backend_benchmark.cfg", "r");
+    if (!file) {
+        return false;
+    }
+    
+    bool found = false;
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        
+        char name[256];
+        double sdl_us, cairo_us;
+        if (sscanf(line, "%255s %lf %lf", name, &sdl_us, &cairo_us) == 3 && machine == name) {
+            result.sdl_us = sdl_us;
+            result.cairo_us = cairo_us;
+            found = true;
+        }
+    }
+    
+    fclose(file);
+    return found;
+}
+
+void GTK3MainWindow::save_backend_benchmark(const std::string& machine, const BackendBenchmark& result) {
+    // Keep the results of the other machines sharing the file
+    std::vector<std::string> lines;
+    FILE* file = fopen("backend_benchmark.cfg", "r");
+    if (file) {
+        char line[512];
+        while (fgets(line, sizeof(line), file)) {
+            char name[256];
+            if (line[0] == '#' || sscanf(line, "%255s", name) != 1 || machine == name) continue;
+            lines.push_back(line);
+        }
+        fclose(file);
+    }
+    
+    file = fopen("backend_benchmark.cfg", "w");
+    if (!file) return;
+    
+    fprintf(file, "# WarpNES GTK3 backend benchmark: machine, SDL and Cairo microseconds per frame (-1 = unavailable)\n");
+    for (const std::string& line : lines) {
+        fputs(line.c_str(), file);
+    }
+    fprintf(file, "%s %.0f %.0f\n", machine.c_str(), result.sdl_us, result.cairo_us);
+    
+    fclose(file);
+}
+
 
 bool GTK3MainWindow::switchRenderBackend(RenderBackend new_backend) {
     if (new_backend == current_backend) {
@@ -325,6 +521,10 @@ void GTK3MainWindow::create_menubar() {
     g_signal_connect(open_item, "activate", G_CALLBACK(on_file_open), this);
     gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), open_item);
     
+    GtkWidget* library_item = gtk_menu_item_new_with_label("Open Library...");
+    g_signal_connect(library_item, "activate", G_CALLBACK(on_file_open_library), this);
+    gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), library_item);
+    
     gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), gtk_separator_menu_item_new());
     
     GtkWidget* quit_item = gtk_menu_item_new_with_label("Quit");
@@ -899,8 +1099,14 @@ void GTK3MainWindow::render_frame() {
     
     engine->render16(nes_framebuffer);
     
+    if (denoise_active()) {
+        FilterFrame frame(nes_framebuffer, 256, 240, 256 * sizeof(uint16_t), PixelFormat::RGB565);
+        denoise_chain.process(frame, frame);
+    }
+    
     if (current_backend == RenderBackend::SDL_HARDWARE) {
         render_frame_sdl();
+        rgba_frame = 0;  // The Cairo buffer falls behind while SDL draws
     } else if (current_backend == RenderBackend::CAIRO_SOFTWARE) {
         render_frame_cairo();
     }
@@ -916,34 +1122,11 @@ void GTK3MainWindow::render_frame_sdl() {
     int source_height = 240;
     
     // Apply filtering if enabled
-    if (current_filter != FilterType::NONE && filter_buffer) {
-        switch (current_filter) {
-            case FilterType::SCALE2X:
-                apply_scale2x_filter(nes_framebuffer, filter_buffer, 256, 240);
-                break;
-            case FilterType::HQ2X:
-                apply_hq2x_filter(nes_framebuffer, filter_buffer, 256, 240);
-                break;
-            case FilterType::HQ3X:
-                apply_hq3x_filter(nes_framebuffer, filter_buffer, 256, 240);
-                break;
-            case FilterType::CRT_SCANLINES:
-                apply_crt_scanlines_filter(nes_framebuffer, filter_buffer, 256, 240);
-                break;
-            case FilterType::NTSC:
-                apply_ntsc_filter(nes_framebuffer, filter_buffer, 256, 240);
-                break;
-            case FilterType::SUPER_4XSAI:  // ADD THIS CASE
-                apply_4xsai_filter(nes_framebuffer, filter_buffer, 256, 240);
-                break;
-            default:
-                break;
-        }
-        
+    if (!filter_chain.isEmpty()) {
         update_filter_texture();
         render_texture = filtered_texture;
-        source_width = 256 * filter_scale;
-        source_height = 240 * filter_scale;
+        source_width = filter_chain.getOutputWidth();
+        source_height = filter_chain.getOutputHeight();
     } else {
         // Update original texture
         void* pixels;
@@ -970,11 +1153,32 @@ void GTK3MainWindow::render_frame_sdl() {
 
 
 void GTK3MainWindow::render_frame_cairo() {
+    // Only the rows that changed since the frame in rgba_framebuffer are
+    // converted, and an unchanged frame is not drawn again. The denoiser
+    // touches every row, and a missed frame leaves the rows out of date
+    uint64_t frame = engine->getFrameNumber();
+    if (rgba_frame != 0 && frame == rgba_frame + 1 && !denoise_active()) {
+        engine->getDirtyRows().getBands(changed_rows);
+    } else {
+        changed_rows.assign(1, { 0, 240 });
+    }
+    rgba_frame = frame;
+
+    if (changed_rows.empty()) {
+        return;
+    }
+    convert_nes_to_rgba(changed_rows);
     gtk_widget_queue_draw(drawing_area);
 }
 
-void GTK3MainWindow::convert_nes_to_rgba() {
-    for (int i = 0; i < 256 * 240; i++) {
+void GTK3MainWindow::convert_nes_to_rgba(const std::vector<RowBand>& rows) {
+    for (const RowBand& band : rows) {
+        convert_nes_to_rgba(band.first * 256, band.last * 256);
+    }
+}
+
+void GTK3MainWindow::convert_nes_to_rgba(int first, int last) {
+    for (int i = first; i < last; i++) {
         uint16_t rgb565 = nes_framebuffer[i];
         
         // Extract RGB components
@@ -1006,11 +1210,16 @@ gboolean GTK3MainWindow::on_cairo_draw(GtkWidget* widget, cairo_t* cr, gpointer
         return TRUE;
     }
     
-    window_obj->convert_nes_to_rgba();
-    
+    // rgba_framebuffer is kept up to date by render_frame_cairo()
+    window_obj->paint_cairo_frame(cr, gtk_widget_get_allocated_width(widget),
+                                  gtk_widget_get_allocated_height(widget));
+    return TRUE;
+}
+
+void GTK3MainWindow::paint_cairo_frame(cairo_t* cr, int widget_width, int widget_height) {
     // Try CAIRO_FORMAT_ARGB32 first, then RGB24 if colors look wrong
     cairo_surface_t* surface = cairo_image_surface_create_for_data(
-        (unsigned char*)window_obj->rgba_framebuffer,
+        (unsigned char*)rgba_framebuffer,
         CAIRO_FORMAT_ARGB32,  // Try this format
         256, 240,
         256 * 4
@@ -1018,16 +1227,13 @@ gboolean GTK3MainWindow::on_cairo_draw(GtkWidget* widget, cairo_t* cr, gpointer
     
     if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
         cairo_surface_destroy(surface);
-        return TRUE;
+        return;
     }
     
-    int widget_width = gtk_widget_get_allocated_width(widget);
-    int widget_height = gtk_widget_get_allocated_height(widget);
-    
     double scale_x = (double)widget_width / 256.0;
     double scale_y = (double)widget_height / 240.0;
     
-    if (window_obj->maintain_aspect_ratio) {
+    if (maintain_aspect_ratio) {
         double scale = (scale_x < scale_y) ? scale_x : scale_y;
         scale_x = scale_y = scale;
     }
@@ -1043,7 +1249,7 @@ gboolean GTK3MainWindow::on_cairo_draw(GtkWidget* widget, cairo_t* cr, gpointer
     cairo_scale(cr, scale_x, scale_y);
     
     cairo_pattern_t* pattern = cairo_pattern_create_for_surface(surface);
-    if (window_obj->integer_scaling) {
+    if (integer_scaling) {
         cairo_pattern_set_filter(pattern, CAIRO_FILTER_NEAREST);
     } else {
         cairo_pattern_set_filter(pattern, CAIRO_FILTER_BILINEAR);
@@ -1055,7 +1261,6 @@ gboolean GTK3MainWindow::on_cairo_draw(GtkWidget* widget, cairo_t* cr, gpointer
     cairo_restore(cr);
     
     cairo_surface_destroy(surface);
-    return TRUE;
 }
 
 gboolean GTK3MainWindow::on_cairo_configure(GtkWidget* widget, GdkEventConfigure* event, gpointer user_data) {
@@ -1065,19 +1270,133 @@ gboolean GTK3MainWindow::on_cairo_configure(GtkWidget* widget, GdkEventConfigure
 // Game loop and timing
 gboolean GTK3MainWindow::frame_update_callback(gpointer user_data) {
     GTK3MainWindow* window = static_cast<GTK3MainWindow*>(user_data);
+    window->frame_timer_id = 0;
     
     if (!window->game_running || !window->engine) {
-        window->frame_timer_id = 0;
         return G_SOURCE_REMOVE;
     }
     
-    if (!window->game_paused) {
+    if (window->game_paused) {
+        window->pacer.reset();
+    } else if (window->pacer.getTimeUntilFrame() == 0) {
+        window->pacer.beginFrame();
+        window->engine->setAudioRateAdjustment(window->pacer.getRateAdjustment());
+        gint64 start = g_get_monotonic_time();
         window->process_input();
-        window->engine->update();
-        window->render_frame();
+        // Emulation keeps its rate when the governor skips drawing frames
+        bool render = window->governor.shouldRender();
+        window->engine->setVideoOutput(render);
+        bool rewind_enabled = Configuration::getRewindEnabled();
+        // Going back would take a movie out of step with its input
+        if (rewind_enabled && window->key_states[GDK_KEY_BackSpace] &&
+            window->movie.getMode() == InputMovie::MOVIE_IDLE) {
+            window->rewind_buffer.rewind(*window->engine);
+        }
+        window->movie.beginFrame(*window->engine);
+        window->run_ahead.runFrame(*window->engine);
+        if (rewind_enabled) {
+            window->rewind_buffer.push(*window->engine);
+        }
+        window->battery_persister.frame(*window->engine);
+        gint64 emulated = g_get_monotonic_time();
+        window->governor.addEmulatedFrames(1, emulated - start);
+
+        if (render) {
+            window->render_frame();
+            window->governor.addPresentedFrame(g_get_monotonic_time() - emulated);
+        }
+
+        bool filters_reduced = window->governor.getFiltersReduced();
+        if (window->governor.update() && window->governor.getFiltersReduced() != filters_reduced) {
+            window->apply_filter_spec();
+        }
+    }
+
+    // Periodic audio pipeline stats
+    gint64 stats_interval = (gint64)Configuration::getAudioStatsInterval() * G_USEC_PER_SEC;
+    if (stats_interval > 0) {
+        gint64 now = g_get_monotonic_time();
+        if (window->audio_stats_time == 0) {
+            window->audio_stats_time = now;
+        } else if (now - window->audio_stats_time >= stats_interval) {
+            window->engine->getAudioStats().print();
+            window->engine->resetAudioStats();
+            window->denoise_chain.printStats();
+            window->denoise_chain.resetStats();
+            window->filter_chain.printStats();
+            window->filter_chain.resetStats();
+            window->pacer.getStats().print();
+            window->pacer.resetStats();
+            if (Configuration::getRewindEnabled()) {
+                window->rewind_buffer.getStats().print();
+                window->rewind_buffer.resetStats();
+            }
+            if (window->run_ahead.getFrames() > 0) {
+                window->run_ahead.getStats().print();
+                window->run_ahead.resetStats();
+            }
+            SRAMPersister::Stats battery_stats = window->battery_persister.getStats();
+            if (battery_stats.pagesChecked > 0 || battery_stats.failures > 0) {
+                battery_stats.print();
+                window->battery_persister.resetStats();
+            }
+            window->audio_stats_time = now;
+        }
     }
     
-    return G_SOURCE_CONTINUE;
+    // Each timeout is armed for the pacer's next deadline
+    window->schedule_next_frame();
+    return G_SOURCE_REMOVE;
+}
+
+void GTK3MainWindow::start_frame_timer() {
+    if (frame_timer_id) {
+        return;
+    }
+
+    FramePacer::Mode mode;
+    if (!FramePacer::parseMode(Configuration::getFramePacing(), mode)) {
+        printf("Unknown frame pacing '%s', using timer\n", Configuration::getFramePacing().c_str());
+        mode = FramePacer::TIMER;
+    }
+
+    if (Configuration::getAudioEnabled()) {
+        int frequency = Configuration::getAudioFrequency();
+        int target = Configuration::getAudioTargetLatency() * frequency / MS_PER_SEC;
+        pacer.setAudioQueue([this]() { return engine ? engine->getBufferedAudioSamples() : 0; },
+                            frequency, target);
+        pacer.setMaxRateAdjustment(Configuration::getAudioMaxRateAdjustment());
+    } else if (mode == FramePacer::AUDIO) {
+        printf("Audio is disabled, pacing frames with the timer\n");
+        mode = FramePacer::TIMER;
+    }
+
+    // Refresh rate of the monitor the window is on, in millihertz
+    GdkWindow* gdk_window = gtk_widget_get_window(window);
+    if (gdk_window) {
+        GdkMonitor* monitor = gdk_display_get_monitor_at_window(gdk_window_get_display(gdk_window), gdk_window);
+        if (monitor) {
+            pacer.setRefreshRate(gdk_monitor_get_refresh_rate(monitor) / 1000.0);
+        }
+    }
+    pacer.setFrameRate(Configuration::getFrameRate());
+    if (mode == FramePacer::DISPLAY && !pacer.canPaceToDisplay()) {
+        printf("Display refresh rate is not close to %dHz, pacing frames with the timer\n",
+               Configuration::getFrameRate());
+        mode = FramePacer::TIMER;
+    }
+    pacer.setMode(mode);
+    governor.setBudget(pacer.getPeriod());
+
+    printf("Starting game timer, pacing frames to %s (%.2fHz)\n",
+           FramePacer::getModeName(mode), 1000000.0 / pacer.getPeriod());
+    schedule_next_frame();
+}
+
+void GTK3MainWindow::schedule_next_frame() {
+    // Paused games only poll at the frame period
+    uint64_t wait = game_paused ? pacer.getPeriod() : pacer.getTimeUntilFrame();
+    frame_timer_id = g_timeout_add((guint)((wait + 999) / 1000), frame_update_callback, this);
 }
 
 void GTK3MainWindow::process_input() {
@@ -1123,6 +1442,8 @@ void GTK3MainWindow::run(const char* rom_filename) {
         }
         
         engine->reset();
+        battery_persister.attach(*engine);
+        start_movie();
         game_running = true;
         game_paused = false;
         
@@ -1155,15 +1476,36 @@ void GTK3MainWindow::run(const char* rom_filename) {
         }
         set_status_message(status_msg);
         
-        if (!frame_timer_id) {
-            printf("Starting game timer\n");
-            frame_timer_id = g_timeout_add(17, frame_update_callback, this);
-        }
+        start_frame_timer();
     }
     
     gtk_main();
 }
 
+void GTK3MainWindow::set_movie(const char* filename, bool record) {
+    movie_file = filename;
+    movie_record = record;
+}
+
+void GTK3MainWindow::start_movie() {
+    if (movie_file.empty()) {
+        return;
+    }
+    if (movie_record) {
+        movie.startRecording(*engine);
+    } else if (movie.load(movie_file)) {
+        movie.startPlayback(*engine);
+    }
+}
+
+void GTK3MainWindow::finish_movie() {
+    if (movie.getMode() == InputMovie::MOVIE_RECORDING) {
+        movie.save(movie_file);
+    }
+    movie.stop();
+    movie_file.clear();
+}
+
 void GTK3MainWindow::shutdown() {
     game_running = false;
     
@@ -1173,6 +1515,8 @@ void GTK3MainWindow::shutdown() {
     }
     
     if (engine) {
+        finish_movie();
+        battery_persister.detach(*engine);
         delete engine;
         engine = nullptr;
     }
@@ -1309,41 +1653,137 @@ void GTK3MainWindow::on_file_open(GtkMenuItem* item, gpointer user_data) {
     
     if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
         char* filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
-        
-        if (window->game_running) {
-            window->game_running = false;
-            if (window->frame_timer_id) {
-                g_source_remove(window->frame_timer_id);
-                window->frame_timer_id = 0;
-            }
+        window->open_rom(filename);
+        g_free(filename);
+    }
+    
+    gtk_widget_destroy(dialog);
+}
+
+void GTK3MainWindow::open_rom(const char* filename) {
+    if (game_running) {
+        game_running = false;
+        if (frame_timer_id) {
+            g_source_remove(frame_timer_id);
+            frame_timer_id = 0;
         }
+    }
+    
+    if (engine) {
+        finish_movie();
+        battery_persister.detach(*engine);
+        delete engine;
+        engine = nullptr;
+    }
+    
+    engine = new WarpNES();
+    
+    if (!engine->loadROM(filename)) {
+        set_status_message("Failed to load ROM file");
+        delete engine;
+        engine = nullptr;
+    } else {
+        engine->reset();
+        battery_persister.attach(*engine);
+        rewind_buffer.clear();
+        game_running = true;
+        game_paused = false;
+        char status_msg[512];
+        snprintf(status_msg, sizeof(status_msg), "ROM loaded: %s", filename);
+        set_status_message(status_msg);
         
-        if (window->engine) {
-            delete window->engine;
-            window->engine = nullptr;
+        start_frame_timer();
+    }
+}
+
+void GTK3MainWindow::on_file_open_library(GtkMenuItem* item, gpointer user_data) {
+    GTK3MainWindow* window = static_cast<GTK3MainWindow*>(user_data);
+    
+    GtkWidget* chooser = gtk_file_chooser_dialog_new("Open ROM Library",
+                                                    GTK_WINDOW(window->window),
+                                                    GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER,
+                                                    "_Cancel", GTK_RESPONSE_CANCEL,
+                                                    "_Open", GTK_RESPONSE_ACCEPT,
+                                                    nullptr);
+    if (gtk_dialog_run(GTK_DIALOG(chooser)) != GTK_RESPONSE_ACCEPT) {
+        gtk_widget_destroy(chooser);
+        return;
+    }
+    char* directory = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(chooser));
+    gtk_widget_destroy(chooser);
+    
+    // Only ROMs added or changed since the last scan are read
+    bool scanned = window->rom_library.scan(directory);
+    g_free(directory);
+    if (!scanned) {
+        window->set_status_message("Failed to read ROM library folder");
+        return;
+    }
+    window->rom_library.getStats().print();
+    
+    GtkWidget* dialog = gtk_dialog_new_with_buttons("ROM Library",
+                                                    GTK_WINDOW(window->window),
+                                                    GTK_DIALOG_MODAL,
+                                                    "_Cancel", GTK_RESPONSE_CANCEL,
+                                                    "_Open", GTK_RESPONSE_ACCEPT,
+                                                    nullptr);
+    gtk_window_set_default_size(GTK_WINDOW(dialog), 640, 480);
+    
+    // Name, mapper, PRG KB, CHR KB, battery, index into the library
+    GtkListStore* store = gtk_list_store_new(6, G_TYPE_STRING, G_TYPE_INT, G_TYPE_INT,
+                                             G_TYPE_INT, G_TYPE_BOOLEAN, G_TYPE_INT);
+    const std::vector<ROMLibrary::Entry>& entries = window->rom_library.getEntries();
+    for (size_t i = 0; i < entries.size(); i++) {
+        const ROMLibrary::Entry& entry = entries[i];
+        if (!entry.valid) {
+            continue;
         }
-        
-        window->engine = new WarpNES();
-        
-        if (!window->engine->loadROM(filename)) {
-            window->set_status_message("Failed to load ROM file");
-            delete window->engine;
-            window->engine = nullptr;
-        } else {
-            window->engine->reset();
-            window->game_running = true;
-            window->game_paused = false;
-            char status_msg[512];
-            snprintf(status_msg, sizeof(status_msg), "ROM loaded: %s", filename);
-            window->set_status_message(status_msg);
-            
-            if (!window->frame_timer_id) {
-                printf("Starting game timer from file open\n");
-                window->frame_timer_id = g_timeout_add(17, frame_update_callback, window);
-            }
+        GtkTreeIter iter;
+        gtk_list_store_append(store, &iter);
+        gtk_list_store_set(store, &iter,
+                           0, entry.getName().c_str(),
+                           1, (int)entry.mapper,
+                           2, entry.prgPages * 16,
+                           3, entry.chrPages * 8,
+                           4, (entry.flags & ROMLibrary::FLAG_BATTERY) != 0,
+                           5, (int)i,
+                           -1);
+    }
+    
+    GtkWidget* tree = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
+    g_object_unref(store);
+    const char* titles[] = { "Name", "Mapper", "PRG KB", "CHR KB" };
+    for (int column = 0; column < 4; column++) {
+        gtk_tree_view_append_column(GTK_TREE_VIEW(tree),
+            gtk_tree_view_column_new_with_attributes(titles[column], gtk_cell_renderer_text_new(),
+                                                     "text", column, nullptr));
+    }
+    gtk_tree_view_append_column(GTK_TREE_VIEW(tree),
+        gtk_tree_view_column_new_with_attributes("Battery", gtk_cell_renderer_toggle_new(),
+                                                 "active", 4, nullptr));
+    gtk_tree_view_set_search_column(GTK_TREE_VIEW(tree), 0);
+    
+    // Double-clicking a row opens it like the Open button
+    g_signal_connect_swapped(tree, "row-activated", G_CALLBACK(gtk_window_activate_default), dialog);
+    gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_ACCEPT);
+    
+    GtkWidget* scrolled = gtk_scrolled_window_new(nullptr, nullptr);
+    gtk_container_add(GTK_CONTAINER(scrolled), tree);
+    gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(GTK_DIALOG(dialog))), scrolled, TRUE, TRUE, 0);
+    gtk_widget_show_all(dialog);
+    
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+        GtkTreeModel* model;
+        GtkTreeIter iter;
+        GtkTreeSelection* selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(tree));
+        if (gtk_tree_selection_get_selected(selection, &model, &iter)) {
+            int index;
+            gtk_tree_model_get(model, &iter, 5, &index, -1);
+            std::string path = entries[index].path;
+            gtk_widget_destroy(dialog);
+            window->open_rom(path.c_str());
+            return;
         }
-        
-        g_free(filename);
     }
     
     gtk_widget_destroy(dialog);
@@ -1454,6 +1894,10 @@ void GTK3MainWindow::show_rendering_dialog() {
     GtkWidget* cairo_radio = gtk_radio_button_new_with_label(group, "Cairo Software");
     gtk_box_pack_start(GTK_BOX(vbox), cairo_radio, FALSE, FALSE, 0);
     
+    // Auto-detect uses the cached benchmark unless asked to time again
+    GtkWidget* benchmark_check = gtk_check_button_new_with_label("Benchmark the backends again (Auto-detect)");
+    gtk_box_pack_start(GTK_BOX(vbox), benchmark_check, FALSE, FALSE, 0);
+    
     // Set current selection
     switch (preferred_backend) {
         case RenderBackend::AUTO:
@@ -1480,7 +1924,27 @@ void GTK3MainWindow::show_rendering_dialog() {
             new_backend = RenderBackend::CAIRO_SOFTWARE;
         }
         
-        if (new_backend != current_backend) {
+        bool rerun_benchmark = new_backend == RenderBackend::AUTO &&
+                               gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(benchmark_check));
+        
+        if (rerun_benchmark) {
+            bool was_running = game_running;
+            game_running = false;
+            
+            if (current_backend == RenderBackend::SDL_HARDWARE) {
+                cleanup_sdl_backend();
+            } else if (current_backend == RenderBackend::CAIRO_SOFTWARE) {
+                cleanup_cairo_backend();
+            }
+            if (detect_best_backend(true)) {
+                char msg[256];
+                snprintf(msg, sizeof(msg), "Benchmarked backends, using %s", backend_to_string(current_backend));
+                set_status_message(msg);
+            }
+            
+            game_running = was_running;
+            gtk_widget_queue_draw(drawing_area);
+        } else if (new_backend != current_backend) {
             bool was_running = game_running;
             if (was_running) {
                 game_running = false;
@@ -1730,8 +2194,8 @@ void GTK3MainWindow::load_video_settings() {
                 integer_scaling = (strcmp(value, "true") == 0);
             } else if (strcmp(key, "preferred_backend") == 0) {
                 preferred_backend = string_to_backend(value);
-                // CHANGED: If AUTO is loaded, convert it to Cairo
-                if (preferred_backend == RenderBackend::AUTO) {
+                // Unknown names fall back to Cairo, AUTO picks by benchmark
+                if (preferred_backend == RenderBackend::AUTO && strcmp(value, "AUTO") != 0) {
                     preferred_backend = RenderBackend::CAIRO_SOFTWARE;
                 }
             } else if (strcmp(key, "backend_switching_enabled") == 0) {
@@ -1760,7 +2224,7 @@ void GTK3MainWindow::save_video_settings() {
     switch (preferred_backend) {
         case RenderBackend::SDL_HARDWARE: backend_str = "SDL_HARDWARE"; break;
         case RenderBackend::CAIRO_SOFTWARE: backend_str = "CAIRO_SOFTWARE"; break;
-        case RenderBackend::AUTO: backend_str = "CAIRO_SOFTWARE"; break;  // CHANGED: Auto now defaults to Cairo
+        case RenderBackend::AUTO: backend_str = "AUTO"; break;
     }
     fprintf(file, "preferred_backend=%s\n", backend_str);
     fprintf(file, "backend_switching_enabled=%s\n", backend_switching_enabled ? "true" : "false");
@@ -1807,137 +2271,28 @@ uint32_t GTK3MainWindow::rgb565_to_rgb888(uint16_t color) {
     return (0xFF << 24) | (r << 16) | (g << 8) | b;
 }
 
-void GTK3MainWindow::apply_scale2x_filter(uint16_t* input, uint32_t* output, int width, int height) {
-    // Simple Scale2x algorithm
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            uint16_t C = input[y * width + x];  // Current pixel
-            
-            // Get neighbors (with bounds checking)
-            uint16_t A = (y > 0) ? input[(y-1) * width + x] : C;           // Above
-            uint16_t B = (x < width-1) ? input[y * width + (x+1)] : C;     // Right
-            uint16_t D = (x > 0) ? input[y * width + (x-1)] : C;           // Left
-            uint16_t E = (y < height-1) ? input[(y+1) * width + x] : C;    // Below
-            
-            uint32_t color = rgb565_to_rgb888(C);
-            
-            // Scale2x logic
-            int out_y = y * 2;
-            int out_x = x * 2;
-            int out_width = width * 2;
-            
-            if (A != E && D != B) {
-                output[out_y * out_width + out_x] = (D == A) ? rgb565_to_rgb888(A) : color;
-                output[out_y * out_width + (out_x + 1)] = (A == B) ? rgb565_to_rgb888(A) : color;
-                output[(out_y + 1) * out_width + out_x] = (D == E) ? rgb565_to_rgb888(E) : color;
-                output[(out_y + 1) * out_width + (out_x + 1)] = (E == B) ? rgb565_to_rgb888(E) : color;
-            } else {
-                // No scaling pattern, just duplicate
-                output[out_y * out_width + out_x] = color;
-                output[out_y * out_width + (out_x + 1)] = color;
-                output[(out_y + 1) * out_width + out_x] = color;
-                output[(out_y + 1) * out_width + (out_x + 1)] = color;
-            }
-        }
-    }
-}
-
-void GTK3MainWindow::apply_hq2x_filter(uint16_t* input, uint32_t* output, int width, int height) {
-    // Simplified hq2x-style filter
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            // Get 3x3 neighborhood
-            uint16_t w[9];
-            for (int dy = -1; dy <= 1; dy++) {
-                for (int dx = -1; dx <= 1; dx++) {
-                    int ny = y + dy;
-                    int nx = x + dx;
-                    
-                    // Clamp to bounds
-                    if (ny < 0) ny = 0;
-                    if (ny >= height) ny = height - 1;
-                    if (nx < 0) nx = 0;
-                    if (nx >= width) nx = width - 1;
-                    
-                    w[(dy + 1) * 3 + (dx + 1)] = input[ny * width + nx];
-                }
-            }
-            
-            uint32_t colors[9];
-            for (int i = 0; i < 9; i++) {
-                colors[i] = rgb565_to_rgb888(w[i]);
-            }
-            
-            // hq2x pattern matching (simplified)
-            uint32_t c = colors[4]; // Center pixel
-            int out_y = y * 2;
-            int out_x = x * 2;
-            int out_width = width * 2;
-            
-            // Check for diagonal patterns and smooth accordingly
-            bool diag1 = (w[0] == w[8]) && (w[0] != w[4]);
-            bool diag2 = (w[2] == w[6]) && (w[2] != w[4]);
-            
-            if (diag1 || diag2) {
-                // Apply smoothing
-                uint32_t blend1 = colors[1]; // Top
-                uint32_t blend2 = colors[3]; // Left
-                uint32_t blend3 = colors[5]; // Right
-                uint32_t blend4 = colors[7]; // Bottom
-                
-                output[out_y * out_width + out_x] = c;
-                output[out_y * out_width + (out_x + 1)] = blend1;
-                output[(out_y + 1) * out_width + out_x] = blend2;
-                output[(out_y + 1) * out_width + (out_x + 1)] = c;
-            } else {
-                // Simple duplication
-                output[out_y * out_width + out_x] = c;
-                output[out_y * out_width + (out_x + 1)] = c;
-                output[(out_y + 1) * out_width + out_x] = c;
-                output[(out_y + 1) * out_width + (out_x + 1)] = c;
-            }
-        }
-    }
-}
-
-void GTK3MainWindow::apply_hq3x_filter(uint16_t* input, uint32_t* output, int width, int height) {
-    // Simplified hq3x implementation
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            uint32_t color = rgb565_to_rgb888(input[y * width + x]);
-            
-            // For now, just do a simple 3x scale
-            // A full hq3x would require extensive pattern matching
-            int out_y = y * 3;
-            int out_x = x * 3;
-            int out_width = width * 3;
-            
-            for (int dy = 0; dy < 3; dy++) {
-                for (int dx = 0; dx < 3; dx++) {
-                    output[(out_y + dy) * out_width + (out_x + dx)] = color;
-                }
-            }
-        }
-    }
-}
-
 void GTK3MainWindow::update_filter_texture() {
-    if (!sdl_renderer || !filter_buffer) return;
+    if (!sdl_renderer || filter_chain.isEmpty()) return;
     
-    int output_width = 256 * filter_scale;
-    int output_height = 240 * filter_scale;
+    FilterFrame input(nes_framebuffer, 256, 240, 256 * sizeof(uint16_t), PixelFormat::RGB565);
     
+    // The texture is dropped whenever the filter changes
     if (!filtered_texture) {
-        filtered_texture = SDL_CreateTexture(sdl_renderer, SDL_PIXELFORMAT_ARGB8888,
+        if (!filter_chain.prepare(input.width, input.height, input.format)) return;
+        filtered_texture = SDL_CreateTexture(sdl_renderer,
+                                           filter_chain.getOutputFormat() == PixelFormat::ARGB8888 ?
+                                               SDL_PIXELFORMAT_ARGB8888 : SDL_PIXELFORMAT_RGB565,
                                            SDL_TEXTUREACCESS_STREAMING,
-                                           output_width, output_height);
+                                           filter_chain.getOutputWidth(), filter_chain.getOutputHeight());
         if (!filtered_texture) return;
     }
     
+    // The last stage writes straight into the texture
     void* pixels;
     int pitch;
     if (SDL_LockTexture(filtered_texture, NULL, &pixels, &pitch) == 0) {
-        memcpy(pixels, filter_buffer, output_width * output_height * sizeof(uint32_t));
+        filter_chain.process(input, FilterFrame(pixels, filter_chain.getOutputWidth(), filter_chain.getOutputHeight(),
+                                                pitch, filter_chain.getOutputFormat()));
         SDL_UnlockTexture(filtered_texture);
     }
 }
@@ -1945,43 +2300,37 @@ void GTK3MainWindow::update_filter_texture() {
 void GTK3MainWindow::setFilter(FilterType filter) {
     current_filter = filter;
     
-    // Clean up old filter resources
-    if (filtered_texture) {
-        SDL_DestroyTexture(filtered_texture);
-        filtered_texture = nullptr;
-    }
-    
-    delete[] filter_buffer;
-    filter_buffer = nullptr;
-    
     // Set up new filter
     switch (filter) {
-        case FilterType::NONE:
-            filter_scale = 1;
+        case FilterType::SCALE2X:
+            filter_spec = "scale2x";
             break;
         case FilterType::HQ2X:
-        case FilterType::SCALE2X:
-        case FilterType::CRT_SCANLINES:
-            filter_scale = 2;
-            filter_buffer = new uint32_t[256 * 240 * 4]; // 2x scale
+            filter_spec = "hq2x";
             break;
         case FilterType::HQ3X:
+            filter_spec = "hq3x";
+            break;
         case FilterType::SCALE3X:
-            filter_scale = 3;
-            filter_buffer = new uint32_t[256 * 240 * 9]; // 3x scale
+            filter_spec = "rgb32,3x";
             break;
-        case FilterType::SUPER_4XSAI:  // ADD THIS CASE
-            filter_scale = 4;
-            filter_buffer = new uint32_t[256 * 240 * 16]; // 4x scale
+        case FilterType::CRT_SCANLINES:
+            filter_spec = "crt";
+            break;
+        case FilterType::SUPER_4XSAI:
+            filter_spec = "4xsai";
             break;
         case FilterType::NTSC:
-            filter_scale = 1;
-            filter_buffer = new uint32_t[256 * 240]; // Same size, different processing
+            filter_spec = "ntsc";
             break;
+        case FilterType::NONE:
         case FilterType::BILINEAR:
-            filter_scale = 1;
+            filter_spec.clear();
             break;
     }
+    governor.setCanReduceFilters(VideoFilters::getReducedChain(filter_spec) != filter_spec ||
+                                 !denoise_chain.isEmpty());
+    apply_filter_spec();
     
     // Initialize NTSC filter if needed
     if (filter == FilterType::NTSC) {
@@ -2001,124 +2350,20 @@ void GTK3MainWindow::setFilter(FilterType filter) {
     set_status_message(status_msg);
 }
 
-
-void GTK3MainWindow::apply_crt_scanlines_filter(uint16_t* input, uint32_t* output, int width, int height) {
-    const float scanline_intensity = 0.25f; // How dark the scanlines are (0.0 = invisible, 1.0 = black)
-    const float phosphor_decay = 0.95f;     // Simulates phosphor persistence
-    const float beam_width = 1.2f;          // Width of the electron beam
-    
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            uint32_t color = rgb565_to_rgb888(input[y * width + x]);
-            
-            // Extract RGB components
-            uint8_t r = (color >> 16) & 0xFF;
-            uint8_t g = (color >> 8) & 0xFF;
-            uint8_t b = color & 0xFF;
-            
-            // Apply phosphor glow effect
-            float glow_factor = 1.0f + 0.1f * sinf(x * 0.5f);
-            r = (uint8_t)(std::min(255.0f, r * glow_factor));
-            g = (uint8_t)(std::min(255.0f, g * glow_factor));
-            b = (uint8_t)(std::min(255.0f, b * glow_factor));
-            
-            // 2x scaling with scanlines
-            int out_y = y * 2;
-            int out_x = x * 2;
-            int out_width = width * 2;
-            
-            // Top row - normal brightness
-            uint32_t top_color = (0xFF << 24) | (r << 16) | (g << 8) | b;
-            output[out_y * out_width + out_x] = top_color;
-            output[out_y * out_width + (out_x + 1)] = top_color;
-            
-            // Bottom row - darkened for scanline effect
-            uint8_t dark_r = (uint8_t)(r * (1.0f - scanline_intensity));
-            uint8_t dark_g = (uint8_t)(g * (1.0f - scanline_intensity));
-            uint8_t dark_b = (uint8_t)(b * (1.0f - scanline_intensity));
-            uint32_t bottom_color = (0xFF << 24) | (dark_r << 16) | (dark_g << 8) | dark_b;
-            
-            output[(out_y + 1) * out_width + out_x] = bottom_color;
-            output[(out_y + 1) * out_width + (out_x + 1)] = bottom_color;
-        }
+void GTK3MainWindow::apply_filter_spec() {
+    // Clean up old filter resources
+    if (filtered_texture) {
+        SDL_DestroyTexture(filtered_texture);
+        filtered_texture = nullptr;
     }
+    
+    // The cheap stages give the same output size, so only the texture
+    // has to be made again
+    filter_chain.setStages(governor.getFiltersReduced() ? VideoFilters::getReducedChain(filter_spec) : filter_spec);
 }
 
-// NTSC Composite filter implementation
-void GTK3MainWindow::apply_ntsc_filter(uint16_t* input, uint32_t* output, int width, int height) {
-    // NTSC composite video simulation
-    const float color_bleeding = 0.15f;     // How much colors bleed into adjacent pixels
-    const float dot_crawl = 0.08f;          // Simulates dot crawl artifact
-    const float rainbow_banding = 0.12f;    // Rainbow banding on high contrast edges
-    const float chroma_resolution = 0.6f;   // Chroma resolution vs luma
-    
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            uint32_t center_color = rgb565_to_rgb888(input[y * width + x]);
-            
-            // Get neighboring pixels for blending
-            uint32_t left_color = (x > 0) ? 
-                rgb565_to_rgb888(input[y * width + (x - 1)]) : center_color;
-            uint32_t right_color = (x < width - 1) ? 
-                rgb565_to_rgb888(input[y * width + (x + 1)]) : center_color;
-            
-            // Extract RGB components
-            uint8_t r = (center_color >> 16) & 0xFF;
-            uint8_t g = (center_color >> 8) & 0xFF;
-            uint8_t b = center_color & 0xFF;
-            
-            // Convert to YIQ color space (simplified)
-            float y_luma = 0.299f * r + 0.587f * g + 0.114f * b;
-            float i_chroma = 0.596f * r - 0.274f * g - 0.322f * b;
-            float q_chroma = 0.211f * r - 0.523f * g + 0.312f * b;
-            
-            // Apply chroma resolution reduction
-            i_chroma *= chroma_resolution;
-            q_chroma *= chroma_resolution;
-            
-            // Add NTSC artifacts
-            float phase = (x + y * 3) * 0.5f; // NTSC color carrier phase
-            
-            // Dot crawl effect
-            float dot_crawl_offset = dot_crawl * sinf(phase * 2.0f);
-            i_chroma += dot_crawl_offset;
-            
-            // Color bleeding from adjacent pixels
-            uint8_t left_r = (left_color >> 16) & 0xFF;
-            uint8_t left_g = (left_color >> 8) & 0xFF;
-            uint8_t left_b = left_color & 0xFF;
-            
-            uint8_t right_r = (right_color >> 16) & 0xFF;
-            uint8_t right_g = (right_color >> 8) & 0xFF;
-            uint8_t right_b = right_color & 0xFF;
-            
-            r = (uint8_t)(r * (1.0f - color_bleeding) + 
-                         (left_r + right_r) * 0.5f * color_bleeding);
-            g = (uint8_t)(g * (1.0f - color_bleeding) + 
-                         (left_g + right_g) * 0.5f * color_bleeding);
-            b = (uint8_t)(b * (1.0f - color_bleeding) + 
-                         (left_b + right_b) * 0.5f * color_bleeding);
-            
-            // Rainbow banding on high contrast edges
-            if (abs(r - left_r) > 50 || abs(r - right_r) > 50) {
-                float rainbow_phase = phase + x * 0.3f;
-                r = (uint8_t)std::min(255.0f, r + rainbow_banding * 50.0f * sinf(rainbow_phase));
-                g = (uint8_t)std::min(255.0f, g + rainbow_banding * 50.0f * sinf(rainbow_phase + 2.0f));
-                b = (uint8_t)std::min(255.0f, b + rainbow_banding * 50.0f * sinf(rainbow_phase + 4.0f));
-            }
-            
-            // Apply gamma correction for NTSC
-            apply_gamma_correction(&center_color, ntsc_settings.gamma);
-            
-            // Add some random noise to simulate analog signal
-            float noise = ((rand() % 100) / 100.0f - 0.5f) * 0.02f;
-            r = (uint8_t)std::max(0.0f, std::min(255.0f, r + noise * 255.0f));
-            g = (uint8_t)std::max(0.0f, std::min(255.0f, g + noise * 255.0f));
-            b = (uint8_t)std::max(0.0f, std::min(255.0f, b + noise * 255.0f));
-            
-            output[y * width + x] = (0xFF << 24) | (r << 16) | (g << 8) | b;
-        }
-    }
+bool GTK3MainWindow::denoise_active() const {
+    return !denoise_chain.isEmpty() && !governor.getFiltersReduced();
 }
 
 // Helper functions for NTSC filter
@@ -2128,241 +2373,13 @@ void GTK3MainWindow::init_ntsc_filter() {
     ntsc_settings.saturation = 0.0f;
     ntsc_settings.contrast = 0.0f;
     ntsc_settings.brightness = 0.0f;
-    ntsc_settings.gamma = 1.8f;          // Typical CRT gamma
     ntsc_settings.sharpness = 0.2f;
     ntsc_settings.resolution = 0.7f;
     ntsc_settings.artifacts = 0.0f;
     ntsc_settings.fringing = 0.0f;
     ntsc_settings.bleed = 0.0f;
-}
-
-uint32_t GTK3MainWindow::apply_ntsc_artifacts(uint32_t color, int x, int y) {
-    // Apply NTSC-specific color artifacts
-    uint8_t r = (color >> 16) & 0xFF;
-    uint8_t g = (color >> 8) & 0xFF;
-    uint8_t b = color & 0xFF;
-    
-    // Simulate NTSC color carrier interference
-    float phase = (x * 3.579545f + y * 0.1f); // NTSC color subcarrier frequency
-    
-    // Add color fringing
-    float fringe_offset = ntsc_settings.fringing * sinf(phase);
-    r = (uint8_t)std::max(0.0f, std::min(255.0f, r + fringe_offset * 20.0f));
-    g = (uint8_t)std::max(0.0f, std::min(255.0f, g + fringe_offset * 15.0f));
-    b = (uint8_t)std::max(0.0f, std::min(255.0f, b + fringe_offset * 10.0f));
-    
-    return (0xFF << 24) | (r << 16) | (g << 8) | b;
-}
-
-uint32_t GTK3MainWindow::blend_colors(uint32_t color1, uint32_t color2, float ratio) {
-    // Blend two RGBA colors
-    uint8_t r1 = (color1 >> 16) & 0xFF;
-    uint8_t g1 = (color1 >> 8) & 0xFF;
-    uint8_t b1 = color1 & 0xFF;
-    
-    uint8_t r2 = (color2 >> 16) & 0xFF;
-    uint8_t g2 = (color2 >> 8) & 0xFF;
-    uint8_t b2 = color2 & 0xFF;
-    
-    uint8_t r = (uint8_t)(r1 * (1.0f - ratio) + r2 * ratio);
-    uint8_t g = (uint8_t)(g1 * (1.0f - ratio) + g2 * ratio);
-    uint8_t b = (uint8_t)(b1 * (1.0f - ratio) + b2 * ratio);
-    
-    return (0xFF << 24) | (r << 16) | (g << 8) | b;
-}
-
-void GTK3MainWindow::apply_gamma_correction(uint32_t* color, float gamma) {
-    // Apply gamma correction to simulate CRT monitor characteristics
-    uint8_t r = (*color >> 16) & 0xFF;
-    uint8_t g = (*color >> 8) & 0xFF;
-    uint8_t b = *color & 0xFF;
-    
-    // Normalize to 0-1 range
-    float rf = r / 255.0f;
-    float gf = g / 255.0f;
-    float bf = b / 255.0f;
-    
-    // Apply gamma correction
-    rf = powf(rf, 1.0f / gamma);
-    gf = powf(gf, 1.0f / gamma);
-    bf = powf(bf, 1.0f / gamma);
-    
-    // Convert back to 0-255 range
-    r = (uint8_t)(rf * 255.0f);
-    g = (uint8_t)(gf * 255.0f);
-    b = (uint8_t)(bf * 255.0f);
-    
-    *color = (0xFF << 24) | (r << 16) | (g << 8) | b;
-}
-
-void GTK3MainWindow::apply_4xsai_filter(uint16_t* input, uint32_t* output, int width, int height) {
-    // 4xSaI (4x Scale and Interpolate) filter
-    // Creates 4x4 output for each input pixel using sophisticated interpolation
-    
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            // Get 3x3 neighborhood with bounds checking
-            uint32_t colors[9];
-            for (int dy = -1; dy <= 1; dy++) {
-                for (int dx = -1; dx <= 1; dx++) {
-                    int ny = y + dy;
-                    int nx = x + dx;
-                    
-                    // Clamp to bounds
-                    if (ny < 0) ny = 0;
-                    if (ny >= height) ny = height - 1;
-                    if (nx < 0) nx = 0;
-                    if (nx >= width) nx = width - 1;
-                    
-                    colors[(dy + 1) * 3 + (dx + 1)] = rgb565_to_rgb888(input[ny * width + nx]);
-                }
-            }
-            
-            // Name the colors for clarity:
-            //  0 | 1 | 2
-            // -----------
-            //  3 | 4 | 5  
-            // -----------
-            //  6 | 7 | 8
-            
-            uint32_t c0 = colors[0], c1 = colors[1], c2 = colors[2];
-            uint32_t c3 = colors[3], c4 = colors[4], c5 = colors[5];
-            uint32_t c6 = colors[6], c7 = colors[7], c8 = colors[8];
-            
-            // Output 4x4 block
-            int out_y = y * 4;
-            int out_x = x * 4;
-            int out_width = width * 4;
-            
-            // 4xSaI algorithm - determine output pixels based on edge patterns
-            uint32_t product1a, product1b, product2a, product2b;
-            
-            // Top-left quadrant
-            if (colors_equal(c3, c1) && !colors_equal(c3, c5)) {
-                product1a = interpolate_4xsai(c3, c3, c4, c1);
-            } else if (colors_equal(c5, c1) && !colors_equal(c3, c5)) {
-                product1a = interpolate_4xsai(c5, c1, c4, c5);
-            } else if (colors_equal(c3, c5) && !colors_equal(c3, c1)) {
-                product1a = c4;
-            } else {
-                product1a = interpolate_4xsai(c1, c3, c4, c5);
-            }
-            
-            // Top-right quadrant  
-            if (colors_equal(c1, c5) && !colors_equal(c1, c7)) {
-                product1b = interpolate_4xsai(c1, c1, c4, c5);
-            } else if (colors_equal(c7, c5) && !colors_equal(c1, c7)) {
-                product1b = interpolate_4xsai(c7, c5, c4, c7);
-            } else if (colors_equal(c1, c7) && !colors_equal(c1, c5)) {
-                product1b = c4;
-            } else {
-                product1b = interpolate_4xsai(c5, c1, c4, c7);
-            }
-            
-            // Bottom-left quadrant
-            if (colors_equal(c3, c7) && !colors_equal(c3, c1)) {
-                product2a = interpolate_4xsai(c3, c7, c4, c3);
-            } else if (colors_equal(c1, c7) && !colors_equal(c3, c1)) {
-                product2a = interpolate_4xsai(c1, c7, c4, c1);
-            } else if (colors_equal(c3, c1) && !colors_equal(c3, c7)) {
-                product2a = c4;
-            } else {
-                product2a = interpolate_4xsai(c7, c3, c4, c1);
-            }
-            
-            // Bottom-right quadrant
-            if (colors_equal(c5, c7) && !colors_equal(c5, c3)) {
-                product2b = interpolate_4xsai(c5, c7, c4, c5);
-            } else if (colors_equal(c3, c7) && !colors_equal(c5, c3)) {
-                product2b = interpolate_4xsai(c3, c7, c4, c3);
-            } else if (colors_equal(c5, c3) && !colors_equal(c5, c7)) {
-                product2b = c4;
-            } else {
-                product2b = interpolate_4xsai(c7, c5, c4, c3);
-            }
-            
-            // Additional refinement for smoother results
-            uint32_t product1a_refined = product1a;
-            uint32_t product1b_refined = product1b;
-            uint32_t product2a_refined = product2a;
-            uint32_t product2b_refined = product2b;
-            
-            // Apply edge-directed interpolation
-            if (!colors_equal(c1, c5) && !colors_equal(c3, c7)) {
-                if (colors_equal(c3, c1)) {
-                    product1a_refined = mix_colors(product1a, c3, 0.75f);
-                }
-                if (colors_equal(c1, c5)) {
-                    product1b_refined = mix_colors(product1b, c1, 0.75f);
-                }
-                if (colors_equal(c3, c7)) {
-                    product2a_refined = mix_colors(product2a, c3, 0.75f);
-                }
-                if (colors_equal(c5, c7)) {
-                    product2b_refined = mix_colors(product2b, c5, 0.75f);
-                }
-            }
-            
-            // Output the 4x4 block
-            // Top half
-            output[out_y * out_width + out_x] = product1a_refined;
-            output[out_y * out_width + (out_x + 1)] = mix_colors(product1a_refined, product1b_refined, 0.5f);
-            output[out_y * out_width + (out_x + 2)] = mix_colors(product1b_refined, product1a_refined, 0.5f);
-            output[out_y * out_width + (out_x + 3)] = product1b_refined;
-            
-            output[(out_y + 1) * out_width + out_x] = mix_colors(product1a_refined, product2a_refined, 0.5f);
-            output[(out_y + 1) * out_width + (out_x + 1)] = mix_colors(c4, product1a_refined, 0.7f);
-            output[(out_y + 1) * out_width + (out_x + 2)] = mix_colors(c4, product1b_refined, 0.7f);
-            output[(out_y + 1) * out_width + (out_x + 3)] = mix_colors(product1b_refined, product2b_refined, 0.5f);
-            
-            // Bottom half
-            output[(out_y + 2) * out_width + out_x] = mix_colors(product2a_refined, product1a_refined, 0.5f);
-            output[(out_y + 2) * out_width + (out_x + 1)] = mix_colors(c4, product2a_refined, 0.7f);
-            output[(out_y + 2) * out_width + (out_x + 2)] = mix_colors(c4, product2b_refined, 0.7f);
-            output[(out_y + 2) * out_width + (out_x + 3)] = mix_colors(product2b_refined, product1b_refined, 0.5f);
-            
-            output[(out_y + 3) * out_width + out_x] = product2a_refined;
-            output[(out_y + 3) * out_width + (out_x + 1)] = mix_colors(product2a_refined, product2b_refined, 0.5f);
-            output[(out_y + 3) * out_width + (out_x + 2)] = mix_colors(product2b_refined, product2a_refined, 0.5f);
-            output[(out_y + 3) * out_width + (out_x + 3)] = product2b_refined;
-        }
-    }
-}
 
-uint32_t GTK3MainWindow::interpolate_4xsai(uint32_t c1, uint32_t c2, uint32_t c3, uint32_t c4) {
-    // Advanced 4-point interpolation for smoother results
-    uint8_t r1 = (c1 >> 16) & 0xFF, g1 = (c1 >> 8) & 0xFF, b1 = c1 & 0xFF;
-    uint8_t r2 = (c2 >> 16) & 0xFF, g2 = (c2 >> 8) & 0xFF, b2 = c2 & 0xFF;
-    uint8_t r3 = (c3 >> 16) & 0xFF, g3 = (c3 >> 8) & 0xFF, b3 = c3 & 0xFF;
-    uint8_t r4 = (c4 >> 16) & 0xFF, g4 = (c4 >> 8) & 0xFF, b4 = c4 & 0xFF;
-    
-    // Weighted average with emphasis on the center pixel
-    uint8_t r = (r1 + r2 + (r3 * 2) + r4) / 5;
-    uint8_t g = (g1 + g2 + (g3 * 2) + g4) / 5;
-    uint8_t b = (b1 + b2 + (b3 * 2) + b4) / 5;
-    
-    return (0xFF << 24) | (r << 16) | (g << 8) | b;
-}
-
-uint32_t GTK3MainWindow::mix_colors(uint32_t c1, uint32_t c2, float ratio) {
-    // Linear interpolation between two colors
-    uint8_t r1 = (c1 >> 16) & 0xFF, g1 = (c1 >> 8) & 0xFF, b1 = c1 & 0xFF;
-    uint8_t r2 = (c2 >> 16) & 0xFF, g2 = (c2 >> 8) & 0xFF, b2 = c2 & 0xFF;
-    
-    uint8_t r = (uint8_t)(r1 * (1.0f - ratio) + r2 * ratio);
-    uint8_t g = (uint8_t)(g1 * (1.0f - ratio) + g2 * ratio);
-    uint8_t b = (uint8_t)(b1 * (1.0f - ratio) + b2 * ratio);
-    
-    return (0xFF << 24) | (r << 16) | (g << 8) | b;
-}
-
-bool GTK3MainWindow::colors_equal(uint32_t c1, uint32_t c2) {
-    // Check if colors are similar enough to be considered equal
-    // Allow small differences to account for compression artifacts
-    uint8_t r1 = (c1 >> 16) & 0xFF, g1 = (c1 >> 8) & 0xFF, b1 = c1 & 0xFF;
-    uint8_t r2 = (c2 >> 16) & 0xFF, g2 = (c2 >> 8) & 0xFF, b2 = c2 & 0xFF;
-    
-    return (abs(r1 - r2) < 8) && (abs(g1 - g2) < 8) && (abs(b1 - b2) < 8);
+    video_filters.setupNTSC(ntsc_settings);
 }
 
 void GTK3MainWindow::on_game_genie_codes(GtkMenuItem* item, gpointer user_data) {
@@ -2810,15 +2827,68 @@ int main(int argc, char* argv[]) {
     printf("WarpNES GTK3 NES Emulator\n");
     
     const char* rom_filename = nullptr;
+    bool benchmark_states = false;
+    bool benchmark_clones = false;
+    const char* movie_filename = nullptr;
+    bool record_movie = false;
+    bool benchmark_movie = false;
     
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--neszapper") == 0) {
             printf("NES Zapper support noted (not yet implemented)\n");
+        } else if (strcmp(argv[i], "--benchmark-filters") == 0) {
+            VideoFilters::benchmark(300);
+            return 0;
+        } else if (strcmp(argv[i], "--benchmark-library") == 0 && i + 1 < argc) {
+            ROMLibrary::benchmark(argv[i + 1]);
+            return 0;
+        } else if (strcmp(argv[i], "--benchmark-states") == 0) {
+            benchmark_states = true;
+        } else if (strcmp(argv[i], "--benchmark-clones") == 0) {
+            benchmark_clones = true;
+        } else if ((strcmp(argv[i], "--record-movie") == 0 || strcmp(argv[i], "--play-movie") == 0 ||
+                    strcmp(argv[i], "--benchmark-movie") == 0) && i + 1 < argc) {
+            record_movie = strcmp(argv[i], "--record-movie") == 0;
+            benchmark_movie = strcmp(argv[i], "--benchmark-movie") == 0;
+            movie_filename = argv[++i];
         } else if (argv[i][0] != '-') {
             rom_filename = argv[i];
         }
     }
     
+    if (benchmark_states) {
+        WarpNES engine;
+        if (!rom_filename || !engine.loadROM(rom_filename)) {
+            fprintf(stderr, "--benchmark-states needs a ROM to run\n");
+            return 1;
+        }
+        engine.reset();
+        engine.benchmarkStates(600);
+        return 0;
+    }
+    
+    if (benchmark_clones) {
+        WarpNES engine;
+        if (!rom_filename || !engine.loadROM(rom_filename)) {
+            fprintf(stderr, "--benchmark-clones needs a ROM to run\n");
+            return 1;
+        }
+        engine.reset();
+        engine.benchmarkClones(256);
+        return 0;
+    }
+    
+    if (benchmark_movie) {
+        WarpNES engine;
+        if (!rom_filename || !engine.loadROM(rom_filename)) {
+            fprintf(stderr, "--benchmark-movie needs the movie's ROM to run\n");
+            return 1;
+        }
+        engine.reset();
+        InputMovie::benchmark(engine, movie_filename);
+        return 0;
+    }
+    
     GTK3MainWindow main_window;
     
     if (!main_window.initialize()) {
@@ -2828,6 +2898,10 @@ int main(int argc, char* argv[]) {
     
     printf("GTK3 window initialized successfully\n");
     
+    if (movie_filename) {
+        main_window.set_movie(movie_filename, record_movie);
+    }
+    
     if (rom_filename) {
         printf("Loading ROM: %s\n", rom_filename);
         main_window.run(rom_filename);
@@ -9,11 +9,20 @@
 #include <cstdio>
 #include <unordered_map>
 #include <chrono>
+#include <string>
 #include <thread>
 #include <vector>
 #include "Emulation/ControllerSDL.hpp"
 #include "Emulation/PPU.hpp"
 #include "Emulation/GameGenie.hpp"
+#include "FramePacer.hpp"
+#include "InputMovie.hpp"
+#include "QualityGovernor.hpp"
+#include "RewindBuffer.hpp"
+#include "ROMLibrary.hpp"
+#include "RunAhead.hpp"
+#include "SRAMPersister.hpp"
+#include "VideoFilters.hpp"
 
 
 // Forward declarations
@@ -48,6 +57,12 @@ public:
     bool initialize();
     void run(const char* rom_filename);
     void shutdown();
+
+    /**
+     * Record or play back an input movie from the first frame of the ROM
+     * run next. A recording is written when the ROM is closed.
+     */
+    void set_movie(const char* filename, bool record);
     PPU* getPPU() { return engine ? engine->getPPU() : nullptr; }
     
     // Rendering backend control
@@ -89,6 +104,8 @@ private:
     // Shared framebuffer (converted from NES RGB565 to appropriate format)
     uint16_t* nes_framebuffer;    // Raw NES data (RGB565)
     uint32_t* rgba_framebuffer;   // Converted RGBA data
+    uint64_t rgba_frame;          // PPU frame in rgba_framebuffer, 0 for none
+    std::vector<RowBand> changed_rows;
     int framebuffer_width;
     int framebuffer_height;
     
@@ -119,6 +136,16 @@ private:
     
     // Timing
     guint frame_timer_id;
+    FramePacer pacer;
+    QualityGovernor governor;       // Turns filters off and skips frames when the host is too slow
+    RewindBuffer rewind_buffer;     // Past frames, stepped back through while backspace is held
+    RunAhead run_ahead;             // Shows frames ahead of the real one to hide input lag
+    InputMovie movie;               // Input recorded or played back from the command line
+    std::string movie_file;
+    bool movie_record;
+    SRAMPersister battery_persister; // Writes the battery file in the background
+    ROMLibrary rom_library;         // Index of the ROM folders opened, kept between runs
+    gint64 audio_stats_time;
     
     // Status messages
     char status_message[256];
@@ -146,7 +173,20 @@ private:
     bool init_cairo_backend();
     void cleanup_sdl_backend();
     void cleanup_cairo_backend();
-    bool detect_best_backend();
+    bool detect_best_backend(bool rerun_benchmark = false);
+    
+    // Backend benchmark, timing convert + upload + present of synthetic frames
+    struct BackendBenchmark {
+        double sdl_us;              // Cost per frame, negative if the backend is unavailable
+        double cairo_us;
+    };
+    BackendBenchmark run_backend_benchmark();
+    double benchmark_sdl_backend();
+    double benchmark_cairo_backend();
+    void fill_benchmark_frame(int frame);
+    std::string get_machine_id();
+    bool load_backend_benchmark(const std::string& machine, BackendBenchmark& result);
+    void save_backend_benchmark(const std::string& machine, const BackendBenchmark& result);
     
     // Resolution management
     void apply_resolution(int width, int height);
@@ -161,14 +201,21 @@ private:
     void render_frame();
     void render_frame_sdl();
     void render_frame_cairo();
-    void convert_nes_to_rgba();  // Convert RGB565 to RGBA32
+    void convert_nes_to_rgba(const std::vector<RowBand>& rows);  // Convert RGB565 to RGBA32
+    void convert_nes_to_rgba(int first, int last);                // Convert pixels [first, last)
     
     // Cairo-specific rendering callbacks
     static gboolean on_cairo_draw(GtkWidget* widget, cairo_t* cr, gpointer user_data);
     static gboolean on_cairo_configure(GtkWidget* widget, GdkEventConfigure* event, gpointer user_data);
+    void paint_cairo_frame(cairo_t* cr, int width, int height);  // Scale rgba_framebuffer onto cr
     
     // Game loop and timing
     static gboolean frame_update_callback(gpointer user_data);
+    void start_frame_timer();       // Configure the pacer and arm the first frame
+    void schedule_next_frame();     // Arm a timeout for the pacer's next deadline
+    void start_movie();             // Start the movie on a freshly loaded ROM
+    void finish_movie();            // Write a recording out and stop
+    void open_rom(const char* filename); // Replace the running game with a ROM file
     
     // Input handling
     static gboolean on_key_press(GtkWidget* widget, GdkEventKey* event, gpointer user_data);
@@ -178,6 +225,7 @@ private:
     
     // Menu callbacks
     static void on_file_open(GtkMenuItem* item, gpointer user_data);
+    static void on_file_open_library(GtkMenuItem* item, gpointer user_data);
     static void on_file_quit(GtkMenuItem* item, gpointer user_data);
     static void on_game_reset(GtkMenuItem* item, gpointer user_data);
     static void on_game_pause(GtkMenuItem* item, gpointer user_data);
@@ -212,15 +260,13 @@ private:
 
     FilterType current_filter;
     SDL_Texture* filtered_texture;
-    uint32_t* filter_buffer;
-    int filter_scale;
+    VideoFilters video_filters;
+    FilterChain filter_chain;
+    FilterChain denoise_chain;      // Runs in place on the PPU frame, for both backends
+    std::string filter_spec;        // Stages of the selected filter
     
-    // Filter implementations
-    void apply_hq2x_filter(uint16_t* input, uint32_t* output, int width, int height);
-    void apply_hq3x_filter(uint16_t* input, uint32_t* output, int width, int height);
-    void apply_scale2x_filter(uint16_t* input, uint32_t* output, int width, int height);
-    void apply_crt_scanlines_filter(uint16_t* input, uint32_t* output, int width, int height);  // NEW
-    void apply_ntsc_filter(uint16_t* input, uint32_t* output, int width, int height);          // NEW
+    void apply_filter_spec();       // Build filter_chain from filter_spec at the governor's quality
+    bool denoise_active() const;
     
     void update_filter_texture();
     uint32_t rgb565_to_rgb888(uint16_t color);
@@ -228,27 +274,9 @@ private:
     void show_filters_dialog();
     
     // NTSC filter helper functions
-    struct NTSCSettings {
-        float hue = 0.0f;
-        float saturation = 0.0f;
-        float contrast = 0.0f;
-        float brightness = 0.0f;
-        float gamma = 1.8f;
-        float sharpness = 0.2f;
-        float resolution = 0.7f;
-        float artifacts = 0.0f;
-        float fringing = 0.0f;
-        float bleed = 0.0f;
-    } ntsc_settings;
+    NTSCSettings ntsc_settings;
     
     void init_ntsc_filter();
-    uint32_t apply_ntsc_artifacts(uint32_t color, int x, int y);
-    uint32_t blend_colors(uint32_t color1, uint32_t color2, float ratio);
-    void apply_gamma_correction(uint32_t* color, float gamma);
-    void apply_4xsai_filter(uint16_t* input, uint32_t* output, int width, int height);
-    uint32_t interpolate_4xsai(uint32_t c1, uint32_t c2, uint32_t c3, uint32_t c4);
-    uint32_t mix_colors(uint32_t c1, uint32_t c2, float ratio);
-    bool colors_equal(uint32_t c1, uint32_t c2);
 
     static void on_game_genie_codes(GtkMenuItem* item, gpointer user_data);
     void show_game_genie_dialog();
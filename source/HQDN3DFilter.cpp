@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <cmath>
+
+#include "HQDN3DFilter.hpp"
+#include "VideoFilters.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HQDN3D_AVX2
+#include <immintrin.h>
+#endif
+
+// The strengths are scaled to the reference filter's parameters, so the
+// defaults of 0.4 and 0.6 match its usual 4 and 6
+static const float STRENGTH_SCALE = 10.0f;
+
+/**
+ * Lookup tables for the 5 and 6-bit channels: expanding to 8 bits, and
+ * rounding 8 bits back down.
+ */
+struct ChannelTables {
+    uint8_t expand5[32];
+    uint8_t expand6[64];
+    uint8_t reduce5[256];
+    uint8_t reduce6[256];
+
+    ChannelTables()
+    {
+        for (int i = 0; i < 32; i++) {
+            expand5[i] = (i << 3) | (i >> 2);
+        }
+        for (int i = 0; i < 64; i++) {
+            expand6[i] = (i << 2) | (i >> 4);
+        }
+        for (int i = 0; i < 256; i++) {
+            reduce5[i] = (i * 31 + 127) / 255;
+            reduce6[i] = (i * 63 + 127) / 255;
+        }
+    }
+};
+
+static const ChannelTables channelTables;
+
+/**
+ * Move current towards previous by the amount the table gives for their difference.
+ */
+static inline int32_t lowpass(int32_t previous, int32_t current, const int16_t* coefs)
+{
+    return std::max(0, current + coefs[(previous - current) >> 4]);
+}
+
+HQDN3DFilter::HQDN3DFilter(float spatialStrength, float temporalStrength) :
+    width(0), height(0), hasFrame(false)
+{
+    setup(spatialStrength, temporalStrength);
+}
+
+void HQDN3DFilter::buildCoefs(int16_t* coefs, float strength)
+{
+    // A difference of 25% of the strength keeps a quarter of its weight
+    double distance = std::min(252.0, (double)strength * STRENGTH_SCALE);
+    double gamma = log(0.25) / log(1.0 - distance / 255.0 - 0.00001);
+
+    for (int i = -(256 << LUT_BITS); i < (256 << LUT_BITS); i++) {
+        // Middle of the range of 8.8 differences that map to this entry
+        double difference = ((i << (9 - LUT_BITS)) + (1 << (8 - LUT_BITS)) - 1) / 512.0;
+        double similarity = std::max(0.0, 1.0 - fabs(difference) / 255.0);
+        coefs[(256 << LUT_BITS) + i] = (int16_t)lrint(pow(similarity, gamma) * 256.0 * difference);
+    }
+    coefs[LUT_SIZE] = 0;
+}
+
+void HQDN3DFilter::setup(float spatialStrength, float temporalStrength)
+{
+    buildCoefs(spatialCoefs, spatialStrength);
+    buildCoefs(temporalCoefs, temporalStrength);
+}
+
+void HQDN3DFilter::reset()
+{
+    hasFrame = false;
+}
+
+#if defined(HQDN3D_AVX2)
+__attribute__((target("avx2")))
+static inline __m256i lowpassAVX2(__m256i previous, __m256i current, const int16_t* coefs)
+{
+    __m256i index = _mm256_srai_epi32(_mm256_sub_epi32(previous, current), 4);
+    __m256i coef = _mm256_i32gather_epi32((const int*)coefs, index, 2);
+    coef = _mm256_srai_epi32(_mm256_slli_epi32(coef, 16), 16);
+    return _mm256_max_epi32(_mm256_add_epi32(current, coef), _mm256_setzero_si256());
+}
+
+/**
+ * The vertical and temporal passes over a row, 8 channels at a time.
+ * @return the number of channels done
+ */
+__attribute__((target("avx2")))
+static int verticalTemporalAVX2(const int32_t* spatial, int32_t* line, uint16_t* frame, uint8_t* output,
+                                int count, bool firstRow, const int16_t* spatialCoefs, const int16_t* temporalCoefs)
+{
+    const __m256i round = _mm256_set1_epi32(128);
+    const __m256i max = _mm256_set1_epi32(255);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i value = _mm256_loadu_si256((const __m256i*)(spatial + i));
+        if (!firstRow) {
+            value = lowpassAVX2(_mm256_loadu_si256((const __m256i*)(line + i)), value, spatialCoefs);
+        }
+        _mm256_storeu_si256((__m256i*)(line + i), value);
+
+        __m256i previous = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(frame + i)));
+        value = lowpassAVX2(previous, value, temporalCoefs);
+
+        // Packing works within 128-bit lanes, gather the low halves together
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(value, value), 0x08);
+        _mm_storeu_si128((__m128i*)(frame + i), _mm256_castsi256_si128(packed));
+
+        __m256i level = _mm256_min_epi32(_mm256_srli_epi32(_mm256_add_epi32(value, round), 8), max);
+        __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(level, level), 0x08);
+        __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_castsi256_si128(words));
+        _mm_storel_epi64((__m128i*)(output + i), bytes);
+    }
+    return i;
+}
+#endif
+
+void HQDN3DFilter::filter(const uint16_t* input, uint16_t* output, int frameWidth, int frameHeight)
+{
+    if (frameWidth != width || frameHeight != height) {
+        width = frameWidth;
+        height = frameHeight;
+        rowInput.resize(width * 3);
+        rowSpatial.resize(width * 3);
+        lineAccumulator.resize(width * 3);
+        frameAccumulator.resize(width * height * 3);
+        rowOutput.resize(width * 3);
+        hasFrame = false;
+    }
+
+    const int count = width * 3;
+    const int16_t* spatial = spatialCoefs + (256 << LUT_BITS);
+    const int16_t* temporal = temporalCoefs + (256 << LUT_BITS);
+#if defined(HQDN3D_AVX2)
+    const bool useAVX2 = VideoFilters::isAVX2Enabled();
+#endif
+
+    for (int y = 0; y < height; y++) {
+        const uint16_t* src = input + y * width;
+        int32_t* in = rowInput.data();
+        for (int x = 0; x < width; x++) {
+            uint16_t color = src[x];
+            in[x * 3] = channelTables.expand5[color >> 11] << 8;
+            in[x * 3 + 1] = channelTables.expand6[(color >> 5) & 0x3F] << 8;
+            in[x * 3 + 2] = channelTables.expand5[color & 0x1F] << 8;
+        }
+
+        uint16_t* frame = frameAccumulator.data() + y * count;
+        if (!hasFrame) {
+            std::copy(in, in + count, frame);
+        }
+
+        // Horizontal pass, each value depends on the one to its left. The
+        // first row has nothing above it, so its first pixel is filtered
+        // against itself like the reference filter does
+        int32_t* row = rowSpatial.data();
+        for (int c = 0; c < 3; c++) {
+            row[c] = (y == 0) ? lowpass(in[c], in[c], spatial) : in[c];
+        }
+        for (int i = 3; i < count; i++) {
+            row[i] = lowpass(row[i - 3], in[i], spatial);
+        }
+
+        // Vertical pass against the row above, then temporal against the
+        // previous frame; both are independent across the row
+        int32_t* line = lineAccumulator.data();
+        uint8_t* out = rowOutput.data();
+        int i = 0;
+#if defined(HQDN3D_AVX2)
+        if (useAVX2) {
+            i = verticalTemporalAVX2(row, line, frame, out, count, y == 0, spatial, temporal);
+        }
+#endif
+        for (; i < count; i++) {
+            int32_t value = (y == 0) ? row[i] : lowpass(line[i], row[i], spatial);
+            line[i] = value;
+            value = lowpass(frame[i], value, temporal);
+            frame[i] = value;
+            out[i] = std::min(255, (value + 128) >> 8);
+        }
+
+        uint16_t* dst = output + y * width;
+        for (int x = 0; x < width; x++) {
+            dst[x] = (channelTables.reduce5[out[x * 3]] << 11) |
+                     (channelTables.reduce6[out[x * 3 + 1]] << 5) |
+                     channelTables.reduce5[out[x * 3 + 2]];
+        }
+    }
+
+    hasFrame = true;
+}
@@ -0,0 +1,62 @@
+#ifndef HQDN3D_FILTER_HPP
+#define HQDN3D_FILTER_HPP
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * High quality 3D denoiser (hqdn3d).
+ *
+ * Each pixel is low-pass filtered against its left neighbour, the pixel
+ * above and the same pixel in the previous output frame. How much of a
+ * difference gets smoothed away is looked up in a table built from the
+ * strength, so small differences (noise) are removed while edges are
+ * kept. The filter keeps its own accumulated previous frame, so every
+ * instance has to see consecutive frames of one video.
+ */
+class HQDN3DFilter {
+public:
+    /**
+     * @param spatialStrength Smoothing within a frame, 0 (none) to 1
+     * @param temporalStrength Smoothing between frames, 0 (none) to 1
+     */
+    HQDN3DFilter(float spatialStrength = 0.4f, float temporalStrength = 0.6f);
+
+    /**
+     * Rebuild the coefficient tables for new strengths.
+     */
+    void setup(float spatialStrength, float temporalStrength);
+
+    /**
+     * Forget the previous frame, e.g. after a reset or a state load.
+     */
+    void reset();
+
+    /**
+     * Filter an RGB565 frame. The input and output may be the same buffer.
+     */
+    void filter(const uint16_t* input, uint16_t* output, int width, int height);
+
+private:
+    static const int LUT_BITS = 4;                  /**< Fractional bits of a difference kept for the lookup */
+    static const int LUT_SIZE = 2 * (256 << LUT_BITS);
+
+    // One spare entry so the AVX2 gathers, which read 32 bits, stay inside
+    int16_t spatialCoefs[LUT_SIZE + 1];
+    int16_t temporalCoefs[LUT_SIZE + 1];
+
+    int width;
+    int height;
+    bool hasFrame;
+
+    // Channels are interleaved (R, G, B per pixel) in 8.8 fixed point
+    std::vector<int32_t> rowInput;
+    std::vector<int32_t> rowSpatial;    /**< Row after the horizontal pass */
+    std::vector<int32_t> lineAccumulator;
+    std::vector<uint16_t> frameAccumulator;
+    std::vector<uint8_t> rowOutput;
+
+    static void buildCoefs(int16_t* coefs, float strength);
+};
+
+#endif // HQDN3D_FILTER_HPP
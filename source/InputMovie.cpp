@@ -0,0 +1,412 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "InputMovie.hpp"
+#include "Emulation/ControllerSDL.hpp"
+#include "Emulation/WarpNES.hpp"
+
+// The file is a header, the input of every frame, then the keyframes,
+// each its frame number, size and save state. Values are stored in host
+// byte order like save states.
+static const char MOVIE_MAGIC[8] = { 'N', 'E', 'S', 'M', 'O', 'V', 'I', 'E' };
+static const uint32_t MOVIE_VERSION = 1;
+static const size_t FRAME_INPUT_SIZE = 7;
+
+static uint64_t nowMicros()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * FNV-1a hash, to tell ROMs and states apart.
+ */
+static uint32_t checksum(const uint8_t* data, size_t length, uint32_t hash = 2166136261u)
+{
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+template <typename T>
+static void writeValue(std::ofstream& file, const T& value)
+{
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool readValue(std::ifstream& file, T& value)
+{
+    return (bool)file.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+InputMovie::InputMovie() :
+    mode(MOVIE_IDLE), keyframeInterval(600), position(0), romChecksum(0), zapperEnabled(false)
+{
+}
+
+void InputMovie::setKeyframeInterval(int frames)
+{
+    keyframeInterval = std::max(1, frames);
+}
+
+bool InputMovie::startRecording(WarpNES& engine)
+{
+    mode = MOVIE_IDLE;
+    position = 0;
+    inputs.clear();
+    keyframes.clear();
+    if (!engine.isROMLoaded() || !addKeyframe(engine)) {
+        printf("Could not start recording a movie: no ROM loaded\n");
+        return false;
+    }
+    romChecksum = getROMChecksum(engine);
+    zapperEnabled = engine.isZapperEnabled();
+    mode = MOVIE_RECORDING;
+    return true;
+}
+
+bool InputMovie::startPlayback(WarpNES& engine)
+{
+    if (keyframes.empty()) {
+        printf("Could not play the movie: it is empty\n");
+        return false;
+    }
+    if (getROMChecksum(engine) != romChecksum) {
+        printf("Could not play the movie: it was recorded with another ROM\n");
+        return false;
+    }
+
+    engine.enableZapper(zapperEnabled);
+    if (!loadKeyframe(engine, keyframes[0])) {
+        return false;
+    }
+    position = 0;
+    mode = MOVIE_PLAYING;
+    return true;
+}
+
+void InputMovie::stop()
+{
+    mode = MOVIE_IDLE;
+}
+
+bool InputMovie::beginFrame(WarpNES& engine)
+{
+    if (mode == MOVIE_RECORDING) {
+        if (position > 0 && position % keyframeInterval == 0) {
+            addKeyframe(engine);
+        }
+        FrameInput input;
+        captureInput(engine, input);
+        inputs.push_back(input);
+        position++;
+        return true;
+    }
+
+    if (mode == MOVIE_PLAYING) {
+        if (position >= inputs.size()) {
+            printf("Movie finished after %u frames\n", position);
+            mode = MOVIE_IDLE;
+            return false;
+        }
+        applyInput(engine, inputs[position]);
+        position++;
+        return true;
+    }
+
+    return false;
+}
+
+bool InputMovie::seek(WarpNES& engine, uint32_t frame)
+{
+    if (mode == MOVIE_RECORDING || keyframes.empty() || getROMChecksum(engine) != romChecksum) {
+        return false;
+    }
+    frame = std::min(frame, getFrameCount());
+
+    // The last keyframe at or before the frame
+    auto it = std::upper_bound(keyframes.begin(), keyframes.end(), frame,
+                               [](uint32_t value, const Keyframe& keyframe) { return value < keyframe.frame; });
+    const Keyframe& keyframe = *(it - 1);
+    engine.enableZapper(zapperEnabled);
+    if (!loadKeyframe(engine, keyframe)) {
+        return false;
+    }
+
+    engine.setAudioOutput(false);
+    for (uint32_t i = keyframe.frame; i < frame; i++) {
+        engine.setVideoOutput(i + 1 == frame);
+        applyInput(engine, inputs[i]);
+        engine.update();
+    }
+    engine.setVideoOutput(true);
+    engine.setAudioOutput(true);
+
+    position = frame;
+    mode = MOVIE_PLAYING;
+    return true;
+}
+
+bool InputMovie::save(const std::string& filename) const
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        printf("Could not write movie %s\n", filename.c_str());
+        return false;
+    }
+
+    file.write(MOVIE_MAGIC, sizeof(MOVIE_MAGIC));
+    writeValue(file, MOVIE_VERSION);
+    writeValue(file, romChecksum);
+    writeValue(file, (uint8_t)zapperEnabled);
+    writeValue(file, (uint32_t)keyframeInterval);
+    writeValue(file, (uint32_t)inputs.size());
+    writeValue(file, (uint32_t)keyframes.size());
+
+    for (const FrameInput& input : inputs) {
+        writeValue(file, input.buttons[0]);
+        writeValue(file, input.buttons[1]);
+        writeValue(file, input.zapper);
+        writeValue(file, input.zapperX);
+        writeValue(file, input.zapperY);
+    }
+    for (const Keyframe& keyframe : keyframes) {
+        writeValue(file, keyframe.frame);
+        writeValue(file, (uint32_t)keyframe.state.size());
+        file.write(reinterpret_cast<const char*>(keyframe.state.data()), keyframe.state.size());
+    }
+
+    if (!file) {
+        printf("Could not write movie %s\n", filename.c_str());
+        return false;
+    }
+    printf("Movie written to %s: %zu frames, %zu keyframes\n", filename.c_str(), inputs.size(), keyframes.size());
+    return true;
+}
+
+bool InputMovie::load(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        printf("Could not open movie %s\n", filename.c_str());
+        return false;
+    }
+    std::streamoff fileSize = file.tellg();
+    file.seekg(0);
+
+    char magic[sizeof(MOVIE_MAGIC)];
+    uint32_t version, checksumValue, interval, frameCount, keyframeCount;
+    uint8_t zapper;
+    if (!file.read(magic, sizeof(magic)) || memcmp(magic, MOVIE_MAGIC, sizeof(magic)) != 0 ||
+        !readValue(file, version) || version != MOVIE_VERSION) {
+        printf("%s is not a movie of this version\n", filename.c_str());
+        return false;
+    }
+    if (!readValue(file, checksumValue) || !readValue(file, zapper) || !readValue(file, interval) ||
+        !readValue(file, frameCount) || !readValue(file, keyframeCount) ||
+        (uint64_t)frameCount * FRAME_INPUT_SIZE > (uint64_t)fileSize) {
+        printf("Movie %s is damaged\n", filename.c_str());
+        return false;
+    }
+
+    std::vector<FrameInput> newInputs(frameCount);
+    for (FrameInput& input : newInputs) {
+        if (!readValue(file, input.buttons[0]) || !readValue(file, input.buttons[1]) ||
+            !readValue(file, input.zapper) || !readValue(file, input.zapperX) || !readValue(file, input.zapperY)) {
+            printf("Movie %s is damaged\n", filename.c_str());
+            return false;
+        }
+    }
+
+    // Keyframes have to start at the first frame and stay in order
+    std::vector<Keyframe> newKeyframes;
+    for (uint32_t i = 0; i < keyframeCount; i++) {
+        Keyframe keyframe;
+        uint32_t size;
+        if (!readValue(file, keyframe.frame) || !readValue(file, size) || size > (uint64_t)fileSize ||
+            keyframe.frame > frameCount ||
+            (newKeyframes.empty() ? keyframe.frame != 0 : keyframe.frame <= newKeyframes.back().frame)) {
+            printf("Movie %s is damaged\n", filename.c_str());
+            return false;
+        }
+        keyframe.state.resize(size);
+        if (!file.read(reinterpret_cast<char*>(keyframe.state.data()), size)) {
+            printf("Movie %s is damaged\n", filename.c_str());
+            return false;
+        }
+        newKeyframes.push_back(std::move(keyframe));
+    }
+    if (newKeyframes.empty()) {
+        printf("Movie %s has no start state\n", filename.c_str());
+        return false;
+    }
+
+    mode = MOVIE_IDLE;
+    position = 0;
+    romChecksum = checksumValue;
+    zapperEnabled = zapper != 0;
+    keyframeInterval = std::max<uint32_t>(interval, 1);
+    inputs = std::move(newInputs);
+    keyframes = std::move(newKeyframes);
+    return true;
+}
+
+InputMovie::Mode InputMovie::getMode() const
+{
+    return mode;
+}
+
+uint32_t InputMovie::getPosition() const
+{
+    return position;
+}
+
+uint32_t InputMovie::getFrameCount() const
+{
+    return (uint32_t)inputs.size();
+}
+
+void InputMovie::benchmark(WarpNES& engine, const std::string& filename)
+{
+    InputMovie movie;
+    if (!movie.load(filename) || !movie.startPlayback(engine)) {
+        return;
+    }
+    uint32_t frames = movie.getFrameCount();
+    if (frames == 0) {
+        printf("Movie %s has no frames\n", filename.c_str());
+        return;
+    }
+
+    // Play straight through without output, keeping a checksum of the
+    // state before each seek target
+    const int SEEKS = 8;
+    uint32_t targets[SEEKS];
+    uint32_t expected[SEEKS];
+    for (int i = 0; i < SEEKS; i++) {
+        targets[i] = (uint32_t)((uint64_t)frames * (SEEKS - i) / (SEEKS + 1));
+    }
+    std::vector<uint8_t> state(engine.getStateSize());
+
+    engine.setVideoOutput(false);
+    engine.setAudioOutput(false);
+    uint64_t start = nowMicros();
+    for (uint32_t frame = 0; frame <= frames; frame++) {
+        for (int i = 0; i < SEEKS; i++) {
+            if (targets[i] == frame) {
+                engine.saveState(state.data(), state.size());
+                expected[i] = checksum(state.data(), state.size());
+            }
+        }
+        if (frame < frames) {
+            movie.beginFrame(engine);
+            engine.update();
+        }
+    }
+    uint64_t replayUs = nowMicros() - start;
+    engine.setVideoOutput(true);
+    engine.setAudioOutput(true);
+
+    engine.saveState(state.data(), state.size());
+    uint32_t finalChecksum = checksum(state.data(), state.size());
+
+    // Seek back to each target, furthest first
+    uint64_t seekTotalUs = 0;
+    uint64_t seekMaxUs = 0;
+    int mismatches = 0;
+    for (int i = 0; i < SEEKS; i++) {
+        uint64_t seekStart = nowMicros();
+        movie.seek(engine, targets[i]);
+        uint64_t us = nowMicros() - seekStart;
+        seekTotalUs += us;
+        seekMaxUs = std::max(seekMaxUs, us);
+
+        engine.saveState(state.data(), state.size());
+        if (checksum(state.data(), state.size()) != expected[i]) {
+            mismatches++;
+        }
+    }
+
+    printf("Movie benchmark: %u frames, %zu keyframes\n", frames, movie.keyframes.size());
+    printf("  replay %.2fms per frame (%.0f frames/s), final state checksum %08x\n",
+           replayUs / 1000.0 / frames, frames * 1000000.0 / std::max<uint64_t>(replayUs, 1), finalChecksum);
+    printf("  seek %.2fms avg %.2fms max, %d of %d seeks reached a different state\n",
+           seekTotalUs / 1000.0 / SEEKS, seekMaxUs / 1000.0, mismatches, SEEKS);
+}
+
+bool InputMovie::addKeyframe(WarpNES& engine)
+{
+    Keyframe keyframe;
+    keyframe.frame = position;
+    keyframe.state.resize(engine.getStateSize());
+    if (keyframe.state.empty() || engine.saveState(keyframe.state.data(), keyframe.state.size()) == 0) {
+        return false;
+    }
+    keyframes.push_back(std::move(keyframe));
+    return true;
+}
+
+bool InputMovie::loadKeyframe(WarpNES& engine, const Keyframe& keyframe)
+{
+    if (!engine.loadState(keyframe.state.data(), keyframe.state.size())) {
+        printf("Could not load the movie's state at frame %u\n", keyframe.frame);
+        mode = MOVIE_IDLE;
+        return false;
+    }
+    return true;
+}
+
+void InputMovie::captureInput(WarpNES& engine, FrameInput& input)
+{
+    // Port 1 reads player 1 of the first controller, port 2 player 2 of
+    // the second
+    Controller& controller1 = engine.getController1();
+    Controller& controller2 = engine.getController2();
+    input.buttons[0] = 0;
+    input.buttons[1] = 0;
+    for (int button = 0; button < 8; button++) {
+        if (controller1.getButtonState(PLAYER_1, (ControllerButton)button)) {
+            input.buttons[0] |= 1 << button;
+        }
+        if (controller2.getButtonState(PLAYER_2, (ControllerButton)button)) {
+            input.buttons[1] |= 1 << button;
+        }
+    }
+
+    Zapper& zapper = engine.getZapper();
+    input.zapper = (zapper.isTriggerPressed() ? ZAPPER_TRIGGER : 0) |
+                   (zapper.isLightDetected() ? ZAPPER_LIGHT : 0);
+    input.zapperX = (int16_t)zapper.getMouseX();
+    input.zapperY = (int16_t)zapper.getMouseY();
+}
+
+void InputMovie::applyInput(WarpNES& engine, const FrameInput& input)
+{
+    Controller& controller1 = engine.getController1();
+    Controller& controller2 = engine.getController2();
+    for (int button = 0; button < 8; button++) {
+        controller1.setButtonState(PLAYER_1, (ControllerButton)button, (input.buttons[0] & (1 << button)) != 0);
+        controller2.setButtonState(PLAYER_2, (ControllerButton)button, (input.buttons[1] & (1 << button)) != 0);
+    }
+
+    // Light is stored as it was sensed, the frame it was sensed on is
+    // not part of the movie
+    Zapper& zapper = engine.getZapper();
+    zapper.setMousePosition(input.zapperX, input.zapperY);
+    zapper.setTriggerPressed((input.zapper & ZAPPER_TRIGGER) != 0);
+    zapper.setLightDetected((input.zapper & ZAPPER_LIGHT) != 0);
+}
+
+uint32_t InputMovie::getROMChecksum(WarpNES& engine)
+{
+    uint32_t hash = checksum(engine.getPRGROM(), engine.getPRGSize());
+    if (engine.nesHeader.chrROMPages > 0) {
+        hash = checksum(engine.getCHR(), engine.nesHeader.chrROMPages * 8192, hash);
+    }
+    return hash;
+}
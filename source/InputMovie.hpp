@@ -0,0 +1,121 @@
+#ifndef INPUT_MOVIE_HPP
+#define INPUT_MOVIE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class WarpNES;
+
+/**
+ * Records the input of every frame so a run of a game can be played back
+ * exactly, for reproducing bugs, checking the emulation has not changed
+ * and benchmarking.
+ *
+ * A movie holds both controllers' buttons and the Zapper for each frame,
+ * together with a save state every keyframe interval, the first taken
+ * when recording starts. Playback loads the first state and feeds the
+ * input back frame by frame. Seeking loads the nearest state at or before
+ * the frame and runs the rest of the way without sound or drawing.
+ */
+class InputMovie {
+public:
+    enum Mode {
+        MOVIE_IDLE,
+        MOVIE_RECORDING,
+        MOVIE_PLAYING
+    };
+
+    /**
+     * What is fed to the engine for one frame.
+     */
+    struct FrameInput {
+        uint8_t buttons[2];         /**< Each controller's buttons, bit n for ControllerButton n */
+        uint8_t zapper;             /**< ZAPPER_TRIGGER and ZAPPER_LIGHT */
+        int16_t zapperX;
+        int16_t zapperY;
+    };
+
+    static const uint8_t ZAPPER_TRIGGER = 0x01;
+    static const uint8_t ZAPPER_LIGHT = 0x02;
+
+    InputMovie();
+
+    /**
+     * Set the number of frames between the save states in a movie being
+     * recorded.
+     */
+    void setKeyframeInterval(int frames);
+
+    /**
+     * Start recording from the engine's current state, dropping whatever
+     * the movie held.
+     */
+    bool startRecording(WarpNES& engine);
+
+    /**
+     * Start playing the movie from its first frame.
+     */
+    bool startPlayback(WarpNES& engine);
+
+    /**
+     * Stop recording or playing. The movie is kept.
+     */
+    void stop();
+
+    /**
+     * Call before every frame. When recording, the input the frontend has
+     * set is stored; when playing, the frame's input replaces it. Playback
+     * stops after the last frame.
+     * @return true if the movie is recording or playing this frame
+     */
+    bool beginFrame(WarpNES& engine);
+
+    /**
+     * Go to a frame of the movie, so that the next frame run is that one,
+     * and start playing from there. The last frame run on the way is drawn.
+     */
+    bool seek(WarpNES& engine, uint32_t frame);
+
+    bool save(const std::string& filename) const;
+    bool load(const std::string& filename);
+
+    Mode getMode() const;
+
+    /**
+     * Get the frame that beginFrame() works on next.
+     */
+    uint32_t getPosition() const;
+
+    uint32_t getFrameCount() const;
+
+    /**
+     * Play a movie back as fast as possible on a loaded ROM and print the
+     * replay speed, a checksum of the final state for regression checks,
+     * the cost of seeking and whether seeking reached the same states as
+     * playing straight through.
+     */
+    static void benchmark(WarpNES& engine, const std::string& filename);
+
+private:
+    struct Keyframe {
+        uint32_t frame;
+        std::vector<uint8_t> state;
+    };
+
+    Mode mode;
+    int keyframeInterval;
+    uint32_t position;
+    uint32_t romChecksum;
+    bool zapperEnabled;
+    std::vector<FrameInput> inputs;
+    std::vector<Keyframe> keyframes;
+
+    bool addKeyframe(WarpNES& engine);
+    bool loadKeyframe(WarpNES& engine, const Keyframe& keyframe);
+    static void captureInput(WarpNES& engine, FrameInput& input);
+    static void applyInput(WarpNES& engine, const FrameInput& input);
+    static uint32_t getROMChecksum(WarpNES& engine);
+};
+
+#endif // INPUT_MOVIE_HPP
@@ -4,49 +4,45 @@
 #include <vector>
 #include <signal.h>
 #include <thread>
+#include <mutex>
+#include <atomic>
+#include <map>
 #include <chrono>
 #include <unistd.h>
 #include <cstring>
+#include <cstdlib>
 
 #include <SDL2/SDL.h>
 
-#include "Emulation/WarpNES.hpp"
+#include "Emulation/NSFEngine.hpp"
+#include "NSFRenderer.hpp"
+#include "NSFScanner.hpp"
 #include "Configuration.hpp"
 #include "Constants.hpp"
 
-// NSF file structure
-struct NSFHeader {
-    char magic[5];          // "NESM" + 0x1A
-    uint8_t version;        // Version number
-    uint8_t total_songs;    // Total number of songs
-    uint8_t starting_song;  // Starting song (1-based)
-    uint16_t load_addr;     // Load address
-    uint16_t init_addr;     // Init address
-    uint16_t play_addr;     // Play address
-    char title[32];         // Song title
-    char artist[32];        // Artist name
-    char copyright[32];     // Copyright info
-    uint16_t ntsc_speed;    // NTSC speed (1/1000000 sec ticks)
-    uint8_t bankswitch[8];  // Bankswitch init values
-    uint16_t pal_speed;     // PAL speed
-    uint8_t pal_ntsc_bits;  // PAL/NTSC bits
-    uint8_t extra_sound;    // Extra sound chip support
-    uint8_t expansion[4];   // Expansion (reserved)
-    // ROM data follows...
-};
-
 class NSFPlayer {
 private:
-    WarpNES* engine;
+    NSFEngine* engine;
+    std::mutex engine_mutex;
     NSFHeader header;
     bool is_loaded;
     bool is_playing;
     bool is_paused;
-    int current_song;
+    int current_song;   // Changed by the input and emulation threads, under engine_mutex
     std::vector<uint8_t> nsf_data;
     std::thread emulation_thread;
     bool emulation_running;
     
+    // Track lengths, found by scanning the songs in the background
+    std::string nsf_filename;
+    NSFScanner scanner;
+    std::thread scan_thread;
+    std::atomic<bool> scan_running;
+    std::mutex info_mutex;
+    std::map<int, NSFTrackInfo> track_info;
+    int song_frames;    // Frames played of current_song, under engine_mutex
+    bool auto_advance;
+    
     static void audioCallback(void* userdata, uint8_t* buffer, int len) {
         NSFPlayer* player = static_cast<NSFPlayer*>(userdata);
         if (player->engine && player->is_playing && !player->is_paused) {
@@ -59,7 +55,8 @@ private:
 
 public:
     NSFPlayer() : engine(nullptr), is_loaded(false), is_playing(false), 
-                  is_paused(false), current_song(1), emulation_running(false) {
+                  is_paused(false), current_song(1), emulation_running(false),
+                  scan_running(false), song_frames(0), auto_advance(true) {
         memset(&header, 0, sizeof(header));
     }
     
@@ -68,54 +65,115 @@ public:
     }
     
     bool loadNSF(const std::string& filename) {
-        // Read NSF file first to get header info
-        FILE* file = fopen(filename.c_str(), "rb");
-        if (!file) {
-            std::cerr << "Error: Could not open NSF file" << std::endl;
-            return false;
-        }
-        
-        // Read and validate NSF header
-        if (fread(&header, sizeof(header), 1, file) != 1) {
-            std::cerr << "Error: Could not read NSF header" << std::endl;
-            fclose(file);
-            return false;
-        }
+        // The NSF engine runs only the 6502 and APU, no PPU is needed
+        engine = new NSFEngine();
         
-        // Verify NSF magic
-        if (strncmp(header.magic, "NESM\x1A", 5) != 0) {
-            std::cerr << "Error: Invalid NSF file format" << std::endl;
-            fclose(file);
-            return false;
-        }
-        
-        fclose(file);
-        
-        // Now initialize WarpNES engine
-        engine = new WarpNES();
-        
-        // Load NSF file using WarpNES NSF support
-        if (!engine->loadNSF(filename.c_str())) {
+        if (!engine->loadNSF(filename)) {
             std::cerr << "Error: Could not load NSF file into engine" << std::endl;
             delete engine;
             engine = nullptr;
             return false;
         }
         
-        current_song = header.starting_song;
+        header = engine->getHeader();
+        current_song = engine->getCurrentSong();
         if (current_song == 0) current_song = 1; // Ensure valid song number
         is_loaded = true;
+        nsf_filename = filename;
         
         std::cout << "NSF file loaded successfully" << std::endl;
+        
+        startScan();
         return true;
     }
     
+    void startScan() {
+        scan_running = true;
+        scan_thread = std::thread([this]() {
+            // Start with the current song so playback can use it soonest
+            int first = current_song;
+            for (int i = 0; i < header.total_songs && scan_running; i++) {
+                int song = (first - 1 + i) % header.total_songs + 1;
+                NSFTrackInfo info = scanner.getTrackInfo(nsf_filename, song);
+                
+                std::lock_guard<std::mutex> lock(info_mutex);
+                track_info[song] = info;
+            }
+        });
+    }
+    
+    std::string formatFrames(int frames) {
+        int seconds = frames / Configuration::getFrameRate();
+        char text[16];
+        snprintf(text, sizeof(text), "%d:%02d", seconds / 60, seconds % 60);
+        return text;
+    }
+    
+    std::string describeTrack(int song) {
+        std::lock_guard<std::mutex> lock(info_mutex);
+        auto it = track_info.find(song);
+        if (it == track_info.end()) {
+            return "scanning...";
+        }
+        
+        const NSFTrackInfo& info = it->second;
+        switch (info.end) {
+            case NSFTrackEnd::LOOP:
+                return formatFrames(info.lengthFrames) + " (loops from " + formatFrames(info.introFrames) + ")";
+            case NSFTrackEnd::SILENCE:
+                return formatFrames(info.lengthFrames);
+            default:
+                return "unknown";
+        }
+    }
+    
+    // Called with engine_mutex held
+    bool isSongFinished() {
+        std::lock_guard<std::mutex> lock(info_mutex);
+        auto it = track_info.find(current_song);
+        if (it == track_info.end()) {
+            return false;
+        }
+        int play_frames = it->second.getPlayFrames(2);
+        return play_frames > 0 && song_frames >= play_frames;
+    }
+    
+    void toggleAutoAdvance() {
+        auto_advance = !auto_advance;
+        std::cout << "Auto advance " << (auto_advance ? "on" : "off") << std::endl;
+    }
+    
     void initializeSong(int song_number) {
         if (!engine || song_number < 1 || song_number > header.total_songs) return;
         
-        engine->initNSFSong(song_number);
+        std::lock_guard<std::mutex> lock(engine_mutex);
+        startSong(song_number);
+    }
+    
+    // Called with engine_mutex held
+    void startSong(int song_number) {
+        engine->initSong(song_number);
         current_song = song_number;
-        std::cout << "Initialized song " << song_number << std::endl;
+        song_frames = 0;
+        std::cout << "Initialized song " << song_number << " - length " << describeTrack(song_number) << std::endl;
+    }
+    
+    // Move from the current song under the lock, as the emulation thread
+    // also moves on when a song ends
+    void changeSong(int offset) {
+        if (!engine) return;
+        
+        std::lock_guard<std::mutex> lock(engine_mutex);
+        int song_number = current_song + offset;
+        if (song_number >= 1 && song_number <= header.total_songs) {
+            startSong(song_number);
+            std::cout << "Switched to song " << song_number << "/" << static_cast<int>(header.total_songs) << std::endl;
+        }
+    }
+    
+    int getCurrentSong() {
+        std::lock_guard<std::mutex> lock(engine_mutex);
+        return current_song;
     }
     
     bool initializeAudio() {
@@ -125,7 +183,7 @@ public:
         }
         
         SDL_AudioSpec desiredSpec;
-        desiredSpec.freq = 44800;
+        desiredSpec.freq = Configuration::getAudioFrequency();
         desiredSpec.format = AUDIO_S8;
         desiredSpec.channels = 1;
         desiredSpec.samples = 2048;
@@ -150,7 +208,7 @@ public:
         is_playing = true;
         is_paused = false;
         SDL_PauseAudio(0);
-        std::cout << "Playing song " << current_song << "/" << static_cast<int>(header.total_songs) << std::endl;
+        std::cout << "Playing song " << getCurrentSong() << "/" << static_cast<int>(header.total_songs) << std::endl;
         
         // Start the emulation loop
         startEmulationLoop();
@@ -163,24 +221,44 @@ void startEmulationLoop() {
     
     emulation_running = true;
     emulation_thread = std::thread([this]() {
-        // Calculate NSF timing
-        double nsf_period_ms = header.ntsc_speed / 1000.0;
-        if (nsf_period_ms <= 0) {
-            nsf_period_ms = 16.667;
-        }
+        // The engine schedules play calls from ntsc_speed itself,
+        // so the loop only has to keep pace with the frame rate
+        double frame_period_ms = 1000.0 / Configuration::getFrameRate();
         
         int progStartTime = SDL_GetTicks();
         int frame = 0;
         
         while (emulation_running && is_playing) {
             if (engine && !is_paused) {
-                // Call update() once per frame, just like SDL version
-                engine->update();
+                bool playlist_ended = false;
+                {
+                    // Call update() once per frame, just like SDL version
+                    std::lock_guard<std::mutex> lock(engine_mutex);
+                    engine->update();
+                    song_frames++;
+                    
+                    // Move on once the track has played through its loop
+                    // twice or gone silent
+                    if (auto_advance && isSongFinished()) {
+                        if (current_song < header.total_songs) {
+                            startSong(current_song + 1);
+                            std::cout << "Switched to song " << current_song << "/" << static_cast<int>(header.total_songs) << std::endl;
+                        } else {
+                            std::cout << "End of playlist" << std::endl;
+                            startSong(1);
+                            playlist_ended = true;
+                        }
+                    }
+                }
+                if (playlist_ended) {
+                    is_paused = true;
+                    SDL_PauseAudio(1);
+                }
             }
             
             // Frame timing (same pattern as SDL)
             int now = SDL_GetTicks();
-            int delay = progStartTime + int(double(frame) * nsf_period_ms) - now;
+            int delay = progStartTime + int(double(frame) * frame_period_ms) - now;
             if (delay > 0) {
                 SDL_Delay(delay);
             } else {
@@ -219,26 +297,17 @@ void startEmulationLoop() {
     }
     
     void nextSong() {
-        if (current_song < header.total_songs) {
-            current_song++;
-            initializeSong(current_song);
-            std::cout << "Switched to song " << current_song << "/" << static_cast<int>(header.total_songs) << std::endl;
-        }
+        changeSong(1);
     }
     
     void prevSong() {
-        if (current_song > 1) {
-            current_song--;
-            initializeSong(current_song);
-            std::cout << "Switched to song " << current_song << "/" << static_cast<int>(header.total_songs) << std::endl;
-        }
+        changeSong(-1);
     }
     
     void selectSong(int song_num) {
         if (song_num >= 1 && song_num <= header.total_songs) {
-            current_song = song_num;
-            initializeSong(current_song);
-            std::cout << "Selected song " << current_song << "/" << static_cast<int>(header.total_songs) << std::endl;
+            initializeSong(song_num);
+            std::cout << "Selected song " << song_num << "/" << static_cast<int>(header.total_songs) << std::endl;
         } else {
             std::cout << "Invalid song number. Valid range: 1-" << static_cast<int>(header.total_songs) << std::endl;
         }
@@ -257,7 +326,9 @@ void startEmulationLoop() {
         std::cout << "Version: " << static_cast<int>(header.version) << std::endl;
         std::cout << "Total Songs: " << static_cast<int>(header.total_songs) << std::endl;
         std::cout << "Starting Song: " << static_cast<int>(header.starting_song) << std::endl;
-        std::cout << "Current Song: " << current_song << std::endl;
+        int song = getCurrentSong();
+        std::cout << "Current Song: " << song << std::endl;
+        std::cout << "Song Length: " << describeTrack(song) << std::endl;
         std::cout << "Load Address: $" << std::hex << header.load_addr << std::endl;
         std::cout << "Init Address: $" << std::hex << header.init_addr << std::endl;
         std::cout << "Play Address: $" << std::hex << header.play_addr << std::endl;
@@ -272,6 +343,7 @@ void startEmulationLoop() {
         std::cout << "n/+ - Next song" << std::endl;
         std::cout << "b/- - Previous song" << std::endl;
         std::cout << "1-9 - Select song number" << std::endl;
+        std::cout << "a - Toggle auto advance to the next song" << std::endl;
         std::cout << "i - Show file information" << std::endl;
         std::cout << "h/? - Show this help" << std::endl;
         std::cout << "q - Quit" << std::endl;
@@ -287,6 +359,11 @@ void startEmulationLoop() {
             stop();
         }
         
+        scan_running = false;
+        if (scan_thread.joinable()) {
+            scan_thread.join();
+        }
+        
         if (engine) {
             delete engine;
             engine = nullptr;
@@ -309,16 +386,87 @@ void signalHandler(int signal) {
     exit(0);
 }
 
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options] <nsf_file>" << std::endl;
+    std::cout << "NSF Player - A command-line Nintendo Sound Format player using WarpNES" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --wav             Render to WAV files instead of playing" << std::endl;
+    std::cout << "  --song N          Song to render (default: all songs)" << std::endl;
+    std::cout << "  --seconds S       Length of each rendered song (default: 150)" << std::endl;
+    std::cout << "  --jobs N          Number of render threads (default: all cores)" << std::endl;
+    std::cout << "  --output PREFIX   Output file prefix (default: NSF file name)" << std::endl;
+    std::cout << "  --auto-length     Trim rendered songs to their detected length" << std::endl;
+    std::cout << "  --loops N         Loops to render with --auto-length (default: 2)" << std::endl;
+}
+
 int main(int argc, char** argv) {
-    if (argc < 2) {
-        std::cout << "Usage: " << argv[0] << " <nsf_file>" << std::endl;
-        std::cout << "NSF Player - A command-line Nintendo Sound Format player using WarpNES" << std::endl;
+    bool render_wav = false;
+    std::vector<int> render_songs;
+    double render_seconds = 150.0;
+    int render_jobs = 0;
+    std::string output_prefix;
+    bool auto_length = false;
+    int render_loops = 2;
+    const char* nsf_file = nullptr;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--wav") {
+            render_wav = true;
+        } else if (arg == "--song" && i + 1 < argc) {
+            render_songs.push_back(atoi(argv[++i]));
+        } else if (arg == "--seconds" && i + 1 < argc) {
+            render_seconds = atof(argv[++i]);
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            render_jobs = atoi(argv[++i]);
+        } else if (arg == "--output" && i + 1 < argc) {
+            output_prefix = argv[++i];
+        } else if (arg == "--auto-length") {
+            auto_length = true;
+        } else if (arg == "--loops" && i + 1 < argc) {
+            render_loops = atoi(argv[++i]);
+        } else if (arg[0] == '-') {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            printUsage(argv[0]);
+            return -1;
+        } else {
+            nsf_file = argv[i];
+        }
+    }
+    
+    if (!nsf_file) {
+        printUsage(argv[0]);
         return -1;
     }
     
-    // Initialize configuration (needed by WarpNES)
+    // Initialize configuration (needed by the APU)
     Configuration::initialize("config.ini");
     
+    // Offline rendering doesn't need an audio device
+    if (render_wav) {
+        if (output_prefix.empty()) {
+            output_prefix = nsf_file;
+            size_t slash = output_prefix.find_last_of("/\\");
+            if (slash != std::string::npos) {
+                output_prefix = output_prefix.substr(slash + 1);
+            }
+            size_t dot = output_prefix.find_last_of('.');
+            if (dot != std::string::npos) {
+                output_prefix = output_prefix.substr(0, dot);
+            }
+        }
+        
+        NSFScanner scanner;
+        NSFRenderer renderer(nsf_file, output_prefix);
+        renderer.setDuration(render_seconds);
+        renderer.setThreadCount(render_jobs);
+        if (auto_length) {
+            renderer.setAutoLength(&scanner, render_loops);
+        }
+        return renderer.renderSongs(render_songs) ? 0 : -1;
+    }
+    
     // Set up signal handling
     signal(SIGINT, signalHandler);
     signal(SIGTERM, signalHandler);
@@ -327,8 +475,8 @@ int main(int argc, char** argv) {
     g_player = &player;
     
     // Load NSF file
-    if (!player.loadNSF(argv[1])) {
-        std::cerr << "Failed to load NSF file: " << argv[1] << std::endl;
+    if (!player.loadNSF(nsf_file)) {
+        std::cerr << "Failed to load NSF file: " << nsf_file << std::endl;
         return -1;
     }
     
@@ -339,7 +487,7 @@ int main(int argc, char** argv) {
     }
     
     // Print initial information
-    std::cout << "NSF Player - Loaded: " << argv[1] << std::endl;
+    std::cout << "NSF Player - Loaded: " << nsf_file << std::endl;
     player.printInfo();
     player.printHelp();
     
@@ -381,6 +529,10 @@ int main(int argc, char** argv) {
                 player.selectSong(command - '0');
                 break;
                 
+            case 'a':
+                player.toggleAutoAdvance();
+                break;
+                
             case 'i':
                 player.printInfo();
                 break;
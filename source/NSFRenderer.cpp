@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "NSFRenderer.hpp"
+#include "NSFScanner.hpp"
+#include "Emulation/NSFEngine.hpp"
+#include "Emulation/APU.hpp"
+#include "Configuration.hpp"
+
+NSFRenderer::NSFRenderer(const std::string& nsfFilename, const std::string& outputPrefix)
+    : nsfFilename(nsfFilename), outputPrefix(outputPrefix), duration(150.0), threadCount(0),
+      scanner(nullptr), loopCount(2)
+{
+}
+
+void NSFRenderer::setDuration(double seconds)
+{
+    duration = seconds;
+}
+
+void NSFRenderer::setThreadCount(int threads)
+{
+    threadCount = threads;
+}
+
+void NSFRenderer::setAutoLength(NSFScanner* scanner, int loops)
+{
+    this->scanner = scanner;
+    loopCount = loops;
+}
+
+std::string NSFRenderer::getOutputFilename(int song) const
+{
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), "_%02d.wav", song);
+    return outputPrefix + suffix;
+}
+
+NSFRenderResult NSFRenderer::renderSong(int song)
+{
+    NSFRenderResult result;
+    result.song = song;
+    result.filename = getOutputFilename(song);
+    result.audioSeconds = 0.0;
+    result.wallSeconds = 0.0;
+    result.success = false;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    int sampleRate = Configuration::getAudioFrequency();
+    int frameRate = Configuration::getFrameRate();
+    long totalFrames = (long)(duration * frameRate);
+
+    if (scanner) {
+        int playFrames = scanner->getTrackInfo(nsfFilename, song).getPlayFrames(loopCount);
+        if (playFrames > 0) {
+            totalFrames = playFrames;
+        }
+    }
+
+    // Offline so samples are made with audio disabled and N threads don't
+    // print over the progress. Loading inits the song, so init runs once
+    NSFEngine engine(true);
+    if (song < 1 || song > 255 || !engine.loadNSF(nsfFilename, (uint8_t)song)) {
+        return result;
+    }
+
+    std::vector<uint8_t> samples;
+    samples.reserve((size_t)totalFrames * sampleRate / frameRate + AUDIO_BUFFER_LENGTH);
+
+    APU* apu = engine.getAPU();
+    for (long frame = 0; frame < totalFrames; frame++) {
+        engine.update();
+
+        int count = apu->getBufferedSampleCount();
+        size_t offset = samples.size();
+        samples.resize(offset + count);
+        engine.audioCallback(&samples[offset], count);
+    }
+
+    result.success = writeWAV(result.filename, samples, sampleRate);
+    result.audioSeconds = (double)samples.size() / sampleRate;
+    result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    return result;
+}
+
+bool NSFRenderer::renderSongs(std::vector<int> songs)
+{
+    if (songs.empty()) {
+        NSFEngine engine(true);
+        if (!engine.loadNSF(nsfFilename)) {
+            return false;
+        }
+        for (int song = 1; song <= engine.getHeader().total_songs; song++) {
+            songs.push_back(song);
+        }
+    }
+
+    int threads = threadCount;
+    if (threads <= 0) {
+        threads = (int)std::thread::hardware_concurrency();
+    }
+    threads = std::max(1, std::min(threads, (int)songs.size()));
+
+    std::cout << "Rendering " << songs.size() << " song(s) of "
+              << (scanner ? "detected length" : std::to_string(duration) + "s")
+              << " on " << threads << " thread(s)" << std::endl;
+
+    std::vector<NSFRenderResult> results(songs.size());
+    std::atomic<size_t> nextSong(0);
+    std::mutex printMutex;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    // Each worker owns its engine, songs are handed out one at a time
+    auto worker = [&]() {
+        size_t index;
+        while ((index = nextSong++) < songs.size()) {
+            NSFRenderResult result = renderSong(songs[index]);
+            results[index] = result;
+
+            std::lock_guard<std::mutex> lock(printMutex);
+            if (result.success) {
+                printf("Song %d: %.1fs rendered in %.3fs (%.1fx realtime) -> %s\n",
+                       result.song, result.audioSeconds, result.wallSeconds,
+                       result.realtimeFactor(), result.filename.c_str());
+            } else {
+                printf("Song %d: FAILED\n", result.song);
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 0; i < threads; i++) {
+        pool.emplace_back(worker);
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    double audioSeconds = 0.0;
+    bool success = true;
+    for (const auto& result : results) {
+        audioSeconds += result.audioSeconds;
+        success = success && result.success;
+    }
+
+    printf("Total: %.1fs of audio in %.3fs (%.1fx realtime)\n", audioSeconds, wallSeconds,
+           wallSeconds > 0.0 ? audioSeconds / wallSeconds : 0.0);
+    return success;
+}
+
+static void writeLE16(FILE* file, uint16_t value)
+{
+    uint8_t bytes[2] = { (uint8_t)(value & 0xFF), (uint8_t)(value >> 8) };
+    fwrite(bytes, 1, 2, file);
+}
+
+static void writeLE32(FILE* file, uint32_t value)
+{
+    uint8_t bytes[4] = { (uint8_t)(value & 0xFF), (uint8_t)((value >> 8) & 0xFF),
+                         (uint8_t)((value >> 16) & 0xFF), (uint8_t)(value >> 24) };
+    fwrite(bytes, 1, 4, file);
+}
+
+bool NSFRenderer::writeWAV(const std::string& filename, const std::vector<uint8_t>& samples, int sampleRate)
+{
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Error: Could not create " << filename << std::endl;
+        return false;
+    }
+
+    uint32_t dataSize = (uint32_t)samples.size();
+
+    // RIFF header
+    fwrite("RIFF", 1, 4, file);
+    writeLE32(file, 36 + dataSize);
+    fwrite("WAVE", 1, 4, file);
+
+    // Format chunk: PCM, mono, 8 bits per sample
+    fwrite("fmt ", 1, 4, file);
+    writeLE32(file, 16);
+    writeLE16(file, 1);
+    writeLE16(file, 1);
+    writeLE32(file, sampleRate);
+    writeLE32(file, sampleRate);
+    writeLE16(file, 1);
+    writeLE16(file, 8);
+
+    // Data chunk
+    fwrite("data", 1, 4, file);
+    writeLE32(file, dataSize);
+    size_t written = fwrite(samples.data(), 1, samples.size(), file);
+
+    bool ok = (written == samples.size()) && !ferror(file);
+    fclose(file);
+    return ok;
+}
@@ -0,0 +1,84 @@
+#ifndef NSF_RENDERER_HPP
+#define NSF_RENDERER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class NSFScanner;
+
+/**
+ * Result of rendering one song to a WAV file.
+ */
+struct NSFRenderResult {
+    int song;              /**< Song number (1-based) */
+    std::string filename;  /**< Output WAV file */
+    double audioSeconds;   /**< Length of the rendered audio */
+    double wallSeconds;    /**< Time taken to render it */
+    bool success;
+
+    /**
+     * Seconds of audio produced per second of wall clock time.
+     */
+    double realtimeFactor() const {
+        return wallSeconds > 0.0 ? audioSeconds / wallSeconds : 0.0;
+    }
+};
+
+/**
+ * Offline NSF to WAV renderer.
+ * Runs the NSF engine as fast as it will go without an audio device,
+ * spreading songs across worker threads with one engine per thread.
+ */
+class NSFRenderer {
+public:
+    NSFRenderer(const std::string& nsfFilename, const std::string& outputPrefix);
+
+    /**
+     * Set the length of each rendered song in seconds.
+     */
+    void setDuration(double seconds);
+
+    /**
+     * Set the number of worker threads (0 = one per hardware thread).
+     */
+    void setThreadCount(int threads);
+
+    /**
+     * Trim each song to its detected length instead of a fixed duration.
+     * Songs whose length can't be detected still use the fixed duration.
+     * @param scanner Scanner used to find song lengths, nullptr to disable
+     * @param loops Times a looping song plays its loop
+     */
+    void setAutoLength(NSFScanner* scanner, int loops);
+
+    /**
+     * Render a single song on the calling thread.
+     * @param song Song number (1-based)
+     */
+    NSFRenderResult renderSong(int song);
+
+    /**
+     * Render a list of songs in parallel, printing a line per track.
+     * @param songs Song numbers (1-based), empty for all songs
+     * @return true if every song rendered successfully
+     */
+    bool renderSongs(std::vector<int> songs);
+
+    /**
+     * Write 8-bit unsigned mono PCM samples to a WAV file.
+     */
+    static bool writeWAV(const std::string& filename, const std::vector<uint8_t>& samples, int sampleRate);
+
+private:
+    std::string nsfFilename;
+    std::string outputPrefix;
+    double duration;
+    int threadCount;
+    NSFScanner* scanner;
+    int loopCount;
+
+    std::string getOutputFilename(int song) const;
+};
+
+#endif // NSF_RENDERER_HPP
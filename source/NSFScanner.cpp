@@ -0,0 +1,257 @@
+#include <cstdio>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "NSFScanner.hpp"
+#include "Emulation/NSFEngine.hpp"
+#include "Emulation/APU.hpp"
+#include "Configuration.hpp"
+
+// FNV-1a parameters
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+static const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+// Frames of play calls that make up one loop search window
+static const int WINDOW_FRAMES = 120;
+
+// Shortest loop that is accepted, shorter repeats are sustained notes
+static const int MIN_LOOP_FRAMES = 4 * 60;
+
+// Seconds of flat output that count as the end of a track
+static const int SILENCE_SECONDS = 3;
+
+// Largest peak-to-peak swing of a frame's samples that counts as silence
+static const int SILENCE_THRESHOLD = 2;
+
+int NSFTrackInfo::getPlayFrames(int loops) const
+{
+    switch (end) {
+    case NSFTrackEnd::LOOP:
+        return introFrames + loopFrames * loops;
+    case NSFTrackEnd::SILENCE:
+        return lengthFrames;
+    default:
+        return 0;
+    }
+}
+
+NSFScanner::NSFScanner(const std::string& cacheFilename)
+    : cacheFilename(cacheFilename), maxSeconds(600), cacheLoaded(false)
+{
+}
+
+void NSFScanner::setMaxSeconds(int seconds)
+{
+    maxSeconds = seconds;
+}
+
+uint64_t NSFScanner::hashFile(const std::string& filename)
+{
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (!file) {
+        return 0;
+    }
+
+    uint64_t hash = FNV_OFFSET_BASIS;
+    uint8_t buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            hash = (hash ^ buffer[i]) * FNV_PRIME;
+        }
+    }
+
+    fclose(file);
+    return hash;
+}
+
+NSFTrackInfo NSFScanner::getTrackInfo(const std::string& nsfFilename, int song)
+{
+    uint64_t fileHash = hashFile(nsfFilename);
+
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        if (!cacheLoaded) {
+            loadCache();
+        }
+        auto it = cache.find(std::make_pair(fileHash, song));
+        if (it != cache.end()) {
+            return it->second;
+        }
+    }
+
+    // Scan without holding the lock so other songs can scan in parallel
+    NSFTrackInfo info = scanSong(nsfFilename, song);
+
+    if (fileHash != 0) {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        cache[std::make_pair(fileHash, song)] = info;
+        appendCache(fileHash, info);
+    }
+    return info;
+}
+
+NSFTrackInfo NSFScanner::scanSong(const std::string& nsfFilename, int song)
+{
+    NSFTrackInfo info;
+    info.song = song;
+    info.end = NSFTrackEnd::UNKNOWN;
+    info.introFrames = 0;
+    info.loopFrames = 0;
+    info.lengthFrames = 0;
+
+    // Offline so it neither prints over the player nor depends on audio
+    // being enabled for the samples silence detection reads
+    NSFEngine engine(true);
+    if (!engine.loadNSF(nsfFilename, (uint8_t)song)) {
+        return info;
+    }
+
+    int frameRate = Configuration::getFrameRate();
+    int maxFrames = maxSeconds * frameRate;
+    int silenceFrames = SILENCE_SECONDS * frameRate;
+
+    // Loop search works on play calls, which needn't line up with frames
+    double framesPerPlay = (double)engine.getPlayPeriod() / NSFEngine::CYCLES_PER_FRAME;
+    int windowPlays = (int)(WINDOW_FRAMES / framesPerPlay);
+    int minLoopPlays = (int)(MIN_LOOP_FRAMES / framesPerPlay);
+
+    std::vector<uint64_t> playHashes;
+    std::unordered_map<uint64_t, int> windows; // Window hash -> last play of its first occurrence
+
+    int candidatePeriod = 0;
+    int candidateMatches = 0;
+    bool loopFound = false;
+    int silentRun = 0;
+    bool heardSound = false;
+
+    APU* apu = engine.getAPU();
+    uint8_t samples[AUDIO_BUFFER_LENGTH];
+
+    for (int frame = 0; frame < maxFrames && !loopFound; frame++) {
+        engine.update();
+
+        // Silence: the output has to stay flat for a few seconds after
+        // the track has made some sound
+        int count = apu->getBufferedSampleCount();
+        engine.audioCallback(samples, count);
+        uint8_t low = 255;
+        uint8_t high = 0;
+        for (int i = 0; i < count; i++) {
+            if (samples[i] < low) low = samples[i];
+            if (samples[i] > high) high = samples[i];
+        }
+        if (count > 0 && high - low > SILENCE_THRESHOLD) {
+            heardSound = true;
+            silentRun = 0;
+        } else if (heardSound && ++silentRun >= silenceFrames) {
+            info.end = NSFTrackEnd::SILENCE;
+            info.lengthFrames = frame - silentRun + 1;
+            return info;
+        }
+
+        // Loop: once a window of play calls repeats, every following call
+        // has to match the one a period earlier for a whole period
+        for (uint64_t hash : engine.getPlayWriteHashes()) {
+            playHashes.push_back(hash);
+            int play = (int)playHashes.size() - 1;
+
+            if (candidatePeriod > 0) {
+                if (hash != playHashes[play - candidatePeriod]) {
+                    candidatePeriod = 0;
+                } else if (++candidateMatches >= candidatePeriod) {
+                    loopFound = true;
+                    break;
+                }
+                continue;
+            }
+
+            if (play < windowPlays - 1) {
+                continue;
+            }
+
+            uint64_t windowHash = FNV_OFFSET_BASIS;
+            for (int i = play - windowPlays + 1; i <= play; i++) {
+                windowHash = (windowHash ^ playHashes[i]) * FNV_PRIME;
+            }
+
+            auto it = windows.find(windowHash);
+            if (it == windows.end()) {
+                windows[windowHash] = play;
+            } else if (play - it->second >= minLoopPlays) {
+                candidatePeriod = play - it->second;
+                candidateMatches = 0;
+            }
+        }
+    }
+
+    if (!loopFound) {
+        return info;
+    }
+
+    // Walk back to the earliest play call the repetition holds from
+    int period = candidatePeriod;
+    int last = (int)playHashes.size() - 1;
+    int start = last - period;
+    while (start > 0 && playHashes[start - 1] == playHashes[start - 1 + period]) {
+        start--;
+    }
+
+    // A loop body with the same writes on every call is a drone, not music
+    bool constant = true;
+    for (int i = start + 1; i < start + period && constant; i++) {
+        constant = playHashes[i] == playHashes[start];
+    }
+    if (constant) {
+        return info;
+    }
+
+    info.end = NSFTrackEnd::LOOP;
+    info.introFrames = (int)(start * framesPerPlay + 0.5);
+    info.loopFrames = (int)(period * framesPerPlay + 0.5);
+    info.lengthFrames = info.introFrames + info.loopFrames;
+    return info;
+}
+
+void NSFScanner::loadCache()
+{
+    cacheLoaded = true;
+
+    FILE* file = fopen(cacheFilename.c_str(), "r");
+    if (!file) {
+        return;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        unsigned long long fileHash;
+        int song, end, intro, loop, length;
+        if (sscanf(line, "%llx %d %d %d %d %d", &fileHash, &song, &end, &intro, &loop, &length) != 6) {
+            continue;
+        }
+
+        NSFTrackInfo info;
+        info.song = song;
+        info.end = (NSFTrackEnd)end;
+        info.introFrames = intro;
+        info.loopFrames = loop;
+        info.lengthFrames = length;
+        cache[std::make_pair((uint64_t)fileHash, song)] = info;
+    }
+
+    fclose(file);
+}
+
+void NSFScanner::appendCache(uint64_t fileHash, const NSFTrackInfo& info)
+{
+    FILE* file = fopen(cacheFilename.c_str(), "a");
+    if (!file) {
+        std::cerr << "Warning: Could not write NSF track cache " << cacheFilename << std::endl;
+        return;
+    }
+
+    fprintf(file, "%016llx %d %d %d %d %d\n", (unsigned long long)fileHash, info.song,
+            (int)info.end, info.introFrames, info.loopFrames, info.lengthFrames);
+    fclose(file);
+}
@@ -0,0 +1,82 @@
+#ifndef NSF_SCANNER_HPP
+#define NSF_SCANNER_HPP
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+/**
+ * How the end of a track was found.
+ */
+enum class NSFTrackEnd {
+    UNKNOWN,  /**< Neither a loop nor silence was found in the scan window */
+    LOOP,     /**< The APU write stream repeats */
+    SILENCE   /**< The output went silent */
+};
+
+/**
+ * Length information for one song of an NSF.
+ */
+struct NSFTrackInfo {
+    int song;            /**< Song number (1-based) */
+    NSFTrackEnd end;     /**< How the end was detected */
+    int introFrames;     /**< Frames before the loop starts */
+    int loopFrames;      /**< Length of the loop in frames */
+    int lengthFrames;    /**< Frames until silence, or intro + one loop */
+
+    /**
+     * Get the number of frames a track should play for.
+     * @param loops Times a looping track should play its loop
+     * @return Frames to play, or 0 if the length is unknown
+     */
+    int getPlayFrames(int loops) const;
+};
+
+/**
+ * Headless NSF track length scanner.
+ * Runs a song at full speed, fingerprints the APU register writes of each
+ * play call and looks for either a repeating stream (a loop) or a stretch of
+ * silent output. Results are cached on disk per file content hash.
+ */
+class NSFScanner {
+public:
+    /**
+     * @param cacheFilename File the scan results are stored in
+     */
+    NSFScanner(const std::string& cacheFilename = "nsftracks.cache");
+
+    /**
+     * Set how many seconds of a song to scan before giving up.
+     */
+    void setMaxSeconds(int seconds);
+
+    /**
+     * Get the length of a song, scanning it if it isn't cached.
+     * Safe to call from several threads at once.
+     * @param nsfFilename NSF file
+     * @param song Song number (1-based)
+     */
+    NSFTrackInfo getTrackInfo(const std::string& nsfFilename, int song);
+
+    /**
+     * Hash the contents of a file (FNV-1a, 64 bit).
+     * @return The hash, or 0 if the file could not be read
+     */
+    static uint64_t hashFile(const std::string& filename);
+
+private:
+    std::string cacheFilename;
+    int maxSeconds;
+
+    std::mutex cacheMutex;
+    bool cacheLoaded;
+    std::map<std::pair<uint64_t, int>, NSFTrackInfo> cache;
+
+    NSFTrackInfo scanSong(const std::string& nsfFilename, int song);
+    void loadCache();
+    void appendCache(uint64_t fileHash, const NSFTrackInfo& info);
+};
+
+#endif // NSF_SCANNER_HPP
@@ -0,0 +1,310 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "NTSCFilter.hpp"
+
+extern const uint32_t* paletteRGB;
+
+// Composite levels for the four luminance rows of the palette, in volts
+static const float SIGNAL_LOW[4] = { 0.228f, 0.312f, 0.552f, 0.880f };
+static const float SIGNAL_HIGH[4] = { 0.616f, 0.840f, 1.100f, 1.100f };
+static const float SIGNAL_BLACK = 0.312f;
+static const float SIGNAL_WHITE = 1.100f;
+
+// The signal is modelled in ticks of half a master clock: a pixel lasts
+// 8 ticks and a subcarrier cycle 12, so pixels start on one of 3 phases
+static const int TICKS_PER_PIXEL = 8;
+static const int TICKS_PER_CYCLE = 12;
+
+// Decode windows cover ticks [-WINDOW_RADIUS, WINDOW_RADIUS) around the
+// centre of the output pixel
+static const int WINDOW_RADIUS = 24;
+
+// Rotates the demodulator so decoded hues line up with the built-in palette
+static const float HUE_OFFSET_TICKS = 4.0f;
+
+// Kernel entries pack R, G and B into 20-bit fields, in 1/16 of an 8-bit
+// step, offset by a bias so the sum over all taps never goes negative
+static const int FIXED_SCALE = 16;
+static const int FIELD_BIAS = 8192;
+static const uint64_t FIELD_MASK = 0xFFFFF;
+
+static const float PI = 3.14159265f;
+
+uint8_t NTSCFilter::rgb565ToIndex[65536];
+bool NTSCFilter::indexTableBuilt = false;
+
+/**
+ * Composite signal of a palette entry, split into its average level and
+ * the amplitude of the square wave carrying the hue.
+ */
+struct ColorSignal {
+    float luma;
+    float chroma;
+    int hue;
+
+    ColorSignal(int index)
+    {
+        hue = index & 0x0F;
+        int level = (index >> 4) & 0x03;
+        if (hue > 13) {
+            level = 1;
+        }
+
+        float low = SIGNAL_LOW[level];
+        float high = SIGNAL_HIGH[level];
+        if (hue == 0) {
+            low = high;
+        } else if (hue > 12) {
+            high = low;
+        }
+
+        low = (low - SIGNAL_BLACK) / (SIGNAL_WHITE - SIGNAL_BLACK);
+        high = (high - SIGNAL_BLACK) / (SIGNAL_WHITE - SIGNAL_BLACK);
+        luma = (low + high) * 0.5f;
+        chroma = (high - low) * 0.5f;
+    }
+
+    /**
+     * Get the square wave part of the signal at an absolute tick.
+     */
+    float wave(int tick) const
+    {
+        return ((hue + tick) % TICKS_PER_CYCLE < TICKS_PER_CYCLE / 2) ? chroma : -chroma;
+    }
+};
+
+/**
+ * Decode weights for every tick of the window, each set summing to 1.
+ */
+struct DecodeWindows {
+    float luma[2 * WINDOW_RADIUS];
+    float chroma[2 * WINDOW_RADIUS];
+
+    DecodeWindows(const NTSCSettings& settings)
+    {
+        // Luma is a box over whole subcarrier cycles so a flat colour has
+        // no dot pattern, blending 1 and 2 cycles for the resolution and
+        // subtracting a 3 cycle box for the sharpness
+        float narrow = (settings.resolution + 1.0f) * 0.5f;
+        float sharpen = settings.sharpness * 0.5f;
+        for (int i = 0; i < 2 * WINDOW_RADIUS; i++) {
+            int r = i - WINDOW_RADIUS;
+            float box = narrow * boxWeight(r, 12) + (1.0f - narrow) * boxWeight(r, 24);
+            luma[i] = (1.0f + sharpen) * box - sharpen * boxWeight(r, 36);
+        }
+
+        // Chroma has much less bandwidth, a raised cosine 2-4 cycles wide
+        int length = 36 + (int)std::lround(std::max(-1.0f, std::min(1.0f, settings.bleed)) * 6.0f) * 2;
+        float total = 0.0f;
+        for (int i = 0; i < 2 * WINDOW_RADIUS; i++) {
+            int r = i - WINDOW_RADIUS;
+            chroma[i] = 0.0f;
+            if (r >= -length / 2 && r < length / 2) {
+                chroma[i] = 0.5f - 0.5f * cosf(2.0f * PI * (r + length / 2 + 0.5f) / length);
+            }
+            total += chroma[i];
+        }
+        for (float& weight : chroma) {
+            weight /= total;
+        }
+    }
+
+    static float boxWeight(int r, int length)
+    {
+        return (r >= -length / 2 && r < length / 2) ? 1.0f / length : 0.0f;
+    }
+};
+
+/**
+ * Decode the contribution of one input pixel to an output pixel.
+ * @param phase Subcarrier phase the output pixel starts on
+ * @param offset Position of the input pixel relative to the output pixel
+ * @param rgb Receives the contribution in 8-bit units
+ */
+static void decodeContribution(const DecodeWindows& windows, const NTSCSettings& settings,
+                               const ColorSignal& signal, int phase, int offset, float rgb[3])
+{
+    float artifactScale = 1.0f + settings.artifacts;
+    float fringeScale = 1.0f + settings.fringing;
+    float hueShift = settings.hue * PI;
+
+    float y = 0.0f, i = 0.0f, q = 0.0f;
+    int centreTick = phase * (TICKS_PER_CYCLE / 3) + TICKS_PER_PIXEL / 2;
+    for (int r = offset * TICKS_PER_PIXEL - TICKS_PER_PIXEL / 2; r < (offset + 1) * TICKS_PER_PIXEL - TICKS_PER_PIXEL / 2; r++) {
+        if (r < -WINDOW_RADIUS || r >= WINDOW_RADIUS) {
+            continue;
+        }
+
+        int tick = ((centreTick + r) % TICKS_PER_CYCLE + TICKS_PER_CYCLE) % TICKS_PER_CYCLE;
+        float wave = signal.wave(tick);
+        float angle = PI * (tick + HUE_OFFSET_TICKS) / 6.0f + hueShift;
+
+        y += windows.luma[r + WINDOW_RADIUS] * (signal.luma + artifactScale * wave);
+
+        float carrier = windows.chroma[r + WINDOW_RADIUS] * (fringeScale * signal.luma + wave);
+        i += 2.0f * carrier * cosf(angle);
+        q += 2.0f * carrier * sinf(angle);
+    }
+
+    float saturation = 1.0f + settings.saturation;
+    i *= saturation;
+    q *= saturation;
+
+    rgb[0] = 255.0f * (y + 0.956f * i + 0.621f * q);
+    rgb[1] = 255.0f * (y - 0.272f * i - 0.647f * q);
+    rgb[2] = 255.0f * (y - 1.106f * i + 1.703f * q);
+}
+
+static uint64_t packContribution(const float rgb[3])
+{
+    uint64_t packed = 0;
+    for (int c = 0; c < 3; c++) {
+        int value = (int)std::lround(rgb[c] * FIXED_SCALE);
+        value = std::max(-FIELD_BIAS, std::min(FIELD_BIAS, value));
+        packed = (packed << 20) | (uint64_t)(value + FIELD_BIAS);
+    }
+    return packed;
+}
+
+NTSCFilter::NTSCFilter() :
+    framePhase(0)
+{
+    setup(NTSCSettings());
+}
+
+void NTSCFilter::buildIndexTable()
+{
+    uint16_t palette16[COLORS];
+    for (int i = 0; i < COLORS; i++) {
+        uint32_t color = paletteRGB[i];
+        palette16[i] = ((color & 0xF80000) >> 8) | ((color & 0x00FC00) >> 5) | ((color & 0x0000F8) >> 3);
+    }
+
+    // Colours not in the palette should not come out of the PPU, but map
+    // them to their nearest entry anyway
+    for (int color = 0; color < 65536; color++) {
+        int r = (color >> 11) << 3, g = ((color >> 5) & 0x3F) << 2, b = (color & 0x1F) << 3;
+        int best = 0x0F;
+        int bestDistance = 0x7FFFFFFF;
+        for (int i = 0; i < COLORS; i++) {
+            int pr = (palette16[i] >> 11) << 3, pg = ((palette16[i] >> 5) & 0x3F) << 2, pb = (palette16[i] & 0x1F) << 3;
+            int distance = (r - pr) * (r - pr) + (g - pg) * (g - pg) + (b - pb) * (b - pb);
+            if (distance < bestDistance) {
+                best = i;
+                bestDistance = distance;
+            }
+        }
+        rgb565ToIndex[color] = best;
+    }
+
+    // Several entries are black, use the standard one
+    rgb565ToIndex[palette16[0x0F]] = 0x0F;
+
+    indexTableBuilt = true;
+}
+
+void NTSCFilter::setup(const NTSCSettings& settings)
+{
+    if (!indexTableBuilt) {
+        buildIndexTable();
+    }
+
+    // Decoding at neutral hue and saturation must give back the palette
+    // for flat areas, the difference is folded into the centre tap
+    NTSCSettings neutral = settings;
+    neutral.hue = 0.0f;
+    neutral.saturation = 0.0f;
+
+    DecodeWindows windows(settings);
+    for (int phase = 0; phase < PHASES; phase++) {
+        for (int color = 0; color < COLORS; color++) {
+            ColorSignal signal(color);
+
+            float flat[3] = { 0.0f, 0.0f, 0.0f };
+            for (int tap = 0; tap < TAPS; tap++) {
+                float rgb[3];
+                decodeContribution(windows, neutral, signal, phase, tap - TAPS / 2, rgb);
+                for (int c = 0; c < 3; c++) {
+                    flat[c] += rgb[c];
+                }
+            }
+
+            uint32_t palette = paletteRGB[color];
+            float correction[3] = {
+                ((palette >> 16) & 0xFF) - flat[0],
+                ((palette >> 8) & 0xFF) - flat[1],
+                (palette & 0xFF) - flat[2]
+            };
+
+            for (int tap = 0; tap < TAPS; tap++) {
+                // Taps run from the rightmost input pixel to the leftmost,
+                // matching the order filterRows() reads them in
+                int offset = TAPS / 2 - tap;
+                float rgb[3];
+                decodeContribution(windows, settings, signal, phase, offset, rgb);
+                if (offset == 0) {
+                    for (int c = 0; c < 3; c++) {
+                        rgb[c] += correction[c];
+                    }
+                }
+                kernels[phase][color][tap] = packContribution(rgb);
+            }
+        }
+    }
+
+    float gain = 1.0f + settings.contrast;
+    float offset = settings.brightness * 64.0f;
+    for (int i = 0; i < 4096; i++) {
+        float level = i / (float)FIXED_SCALE * gain + offset;
+        outputLevels[i] = (uint8_t)std::max(0.0f, std::min(255.0f, level + 0.5f));
+    }
+}
+
+int NTSCFilter::nextFramePhase()
+{
+    framePhase ^= 1;
+    return framePhase;
+}
+
+void NTSCFilter::filterRows(const uint16_t* input, uint32_t* output, int width,
+                            int firstRow, int lastRow, int framePhase) const
+{
+    const int pad = TAPS / 2;
+    std::vector<uint8_t> indices(width + 2 * pad);
+
+    for (int y = firstRow; y < lastRow; y++) {
+        const uint16_t* src = input + y * width;
+        uint8_t* row = indices.data() + pad;
+        for (int x = 0; x < width; x++) {
+            row[x] = rgb565ToIndex[src[x]];
+        }
+        for (int i = 1; i <= pad; i++) {
+            row[-i] = row[0];
+            row[width - 1 + i] = row[width - 1];
+        }
+
+        // Each line starts a third of a cycle later, each pixel two thirds
+        int phase = (y + framePhase) % PHASES;
+        uint32_t* out = output + y * width;
+        for (int x = 0; x < width; x++) {
+            const uint64_t (*kernel)[TAPS] = kernels[phase];
+            const uint8_t* in = row + x + pad;
+            uint64_t sum = kernel[in[0]][0] + kernel[in[-1]][1] + kernel[in[-2]][2] + kernel[in[-3]][3] +
+                           kernel[in[-4]][4] + kernel[in[-5]][5] + kernel[in[-6]][6];
+
+            int channels[3];
+            for (int c = 0; c < 3; c++) {
+                int value = (int)((sum >> (40 - 20 * c)) & FIELD_MASK) - TAPS * FIELD_BIAS;
+                channels[c] = outputLevels[std::max(0, std::min(4095, value))];
+            }
+            out[x] = (0xFF << 24) | (channels[0] << 16) | (channels[1] << 8) | channels[2];
+
+            phase += 2;
+            if (phase >= PHASES) {
+                phase -= PHASES;
+            }
+        }
+    }
+}
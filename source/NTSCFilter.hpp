@@ -0,0 +1,72 @@
+#ifndef NTSC_FILTER_HPP
+#define NTSC_FILTER_HPP
+
+#include <cstdint>
+
+/**
+ * Adjustments for the NTSC filter. Every value ranges from -1 to +1,
+ * with 0 as the neutral setting.
+ */
+struct NTSCSettings {
+    float hue = 0.0f;          /**< -1 = -180 degrees, +1 = +180 degrees */
+    float saturation = 0.0f;   /**< -1 = grayscale, +1 = oversaturated */
+    float contrast = 0.0f;
+    float brightness = 0.0f;
+    float sharpness = 0.2f;    /**< Luma edge enhancement */
+    float resolution = 0.7f;   /**< Luma bandwidth, -1 = blurry, +1 = sharp */
+    float artifacts = 0.0f;    /**< Chroma leaking into luma (dot patterns), -1 = none */
+    float fringing = 0.0f;     /**< Luma edges leaking into chroma (rainbows), -1 = none */
+    float bleed = 0.0f;        /**< Chroma bandwidth, -1 = sharp colour edges, +1 = smeared */
+};
+
+/**
+ * NTSC composite video filter.
+ *
+ * The filter works on NES palette indices rather than RGB, so artifacts
+ * depend on the actual composite signal of each colour. For every palette
+ * entry and each of the three subcarrier phases a pixel can start on, the
+ * setup decodes the entry's signal and stores its contribution to the
+ * output pixels around it. Filtering a pixel is then a sum of seven table
+ * entries, each holding packed R, G and B, followed by a clamp.
+ */
+class NTSCFilter {
+public:
+    NTSCFilter();
+
+    /**
+     * Rebuild the kernel tables for new settings.
+     */
+    void setup(const NTSCSettings& settings);
+
+    /**
+     * Filter rows [firstRow, lastRow) of a frame. The output has the
+     * same size as the input.
+     * @param input RGB565 frame from the PPU
+     * @param framePhase Subcarrier phase of the frame (0 or 1)
+     */
+    void filterRows(const uint16_t* input, uint32_t* output, int width,
+                    int firstRow, int lastRow, int framePhase) const;
+
+    /**
+     * Get the subcarrier phase for the next frame. The NES shortens every
+     * other frame by a dot, so the phase alternates and the dot pattern
+     * crawls like it does on a TV.
+     */
+    int nextFramePhase();
+
+private:
+    static const int PHASES = 3;
+    static const int COLORS = 64;
+    static const int TAPS = 7;     /**< Input pixels contributing to an output pixel */
+
+    uint64_t kernels[PHASES][COLORS][TAPS];
+    uint8_t outputLevels[4096];    /**< Clamped channel (1/16 steps) to 8-bit, with contrast and brightness */
+    int framePhase;
+
+    static uint8_t rgb565ToIndex[65536];
+    static bool indexTableBuilt;
+
+    static void buildIndexTable();
+};
+
+#endif // NTSC_FILTER_HPP
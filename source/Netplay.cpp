@@ -0,0 +1,711 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "Netplay.hpp"
+#include "Emulation/ControllerSDL.hpp"
+#include "Emulation/SaveState.hpp"
+#include "Emulation/WarpNES.hpp"
+
+// A packet is a header, then the local buttons of a run of frames, one
+// byte each. Values are little-endian, the two machines may differ.
+//   0  'W' 'N' version
+//   3  first frame without the other player's buttons (the ack)
+//   7  the local checksum frame, or NO_FRAME
+//  11  the local checksum
+//  15  first frame of buttons
+//  19  frame count
+//  20  buttons
+static const uint8_t PACKET_VERSION = 1;
+static const size_t PACKET_HEADER_SIZE = 20;
+static const uint32_t MAX_PACKET_FRAMES = 64;
+
+// Frames between the state checksums compared with the other player
+static const uint32_t CHECKSUM_INTERVAL = 60;
+
+// Past this the buttons arrive too late to hide however fast the network
+static const int MAX_INPUT_DELAY = 8;
+
+// A frame period, for counting the frames a rollback made late
+static const double FRAME_BUDGET_US = 1000000.0 / 60.0;
+
+static uint64_t nowMicros()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * FNV-1a hash, the same as movies use to compare states.
+ */
+static uint32_t checksum(const uint8_t* data, size_t length, uint32_t hash = 2166136261u)
+{
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Hash a save state without its host chunks, so players whose sound runs
+ * at another rate or is paced differently still agree.
+ */
+static uint32_t gameChecksum(const std::vector<uint8_t>& state)
+{
+    uint32_t hash = 2166136261u;
+    StateReader reader(state.data(), state.size());
+    uint32_t id;
+    while (reader.nextChunk(id)) {
+        if (!WarpNES::isHostStateChunk(id)) {
+            hash = checksum(reinterpret_cast<const uint8_t*>(&id), sizeof(id), hash);
+            hash = checksum(reader.getChunkData(), reader.getChunkRemaining(), hash);
+        }
+    }
+    return hash;
+}
+
+static void putUint32(uint8_t* data, uint32_t value)
+{
+    data[0] = (uint8_t)value;
+    data[1] = (uint8_t)(value >> 8);
+    data[2] = (uint8_t)(value >> 16);
+    data[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t getUint32(const uint8_t* data)
+{
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static void setButtons(Controller& controller, Player player, uint8_t buttons)
+{
+    for (int button = 0; button < 8; button++) {
+        controller.setButtonState(player, (ControllerButton)button, (buttons & (1 << button)) != 0);
+    }
+}
+
+#if defined(_WIN32)
+typedef SOCKET SocketHandle;
+static const intptr_t NO_SOCKET = (intptr_t)INVALID_SOCKET;
+#else
+typedef int SocketHandle;
+static const intptr_t NO_SOCKET = -1;
+#endif
+
+UDPTransport::UDPTransport() :
+    socketHandle(NO_SOCKET)
+{
+}
+
+UDPTransport::~UDPTransport()
+{
+    close();
+}
+
+bool UDPTransport::open(int localPort, const std::string& peerHost, int peerPort)
+{
+    close();
+#if defined(_WIN32)
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        return false;
+    }
+#endif
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* peer = nullptr;
+    std::string port = std::to_string(peerPort);
+    if (getaddrinfo(peerHost.c_str(), port.c_str(), &hints, &peer) != 0 || !peer) {
+        printf("Netplay: Error - Could not find %s\n", peerHost.c_str());
+#if defined(_WIN32)
+        WSACleanup();
+#endif
+        return false;
+    }
+
+    SocketHandle handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    socketHandle = (intptr_t)handle;
+    if (socketHandle == NO_SOCKET) {
+        freeaddrinfo(peer);
+#if defined(_WIN32)
+        WSACleanup();
+#endif
+        return false;
+    }
+
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons((uint16_t)localPort);
+
+    // Sending to one address also filters out packets from anyone else
+    bool ok = bind(handle, (const sockaddr*)&local, sizeof(local)) == 0 &&
+              connect(handle, peer->ai_addr, (int)peer->ai_addrlen) == 0;
+    freeaddrinfo(peer);
+
+#if defined(_WIN32)
+    u_long nonBlocking = 1;
+    ok = ok && ioctlsocket(handle, FIONBIO, &nonBlocking) == 0;
+#else
+    ok = ok && fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK) == 0;
+#endif
+    if (!ok) {
+        printf("Netplay: Error - Could not use UDP port %d\n", localPort);
+        close();
+        return false;
+    }
+    return true;
+}
+
+void UDPTransport::close()
+{
+    if (socketHandle == NO_SOCKET) {
+        return;
+    }
+#if defined(_WIN32)
+    closesocket((SocketHandle)socketHandle);
+    WSACleanup();
+#else
+    ::close((SocketHandle)socketHandle);
+#endif
+    socketHandle = NO_SOCKET;
+}
+
+void UDPTransport::send(const uint8_t* data, size_t size)
+{
+    if (socketHandle != NO_SOCKET) {
+        ::send((SocketHandle)socketHandle, (const char*)data, (int)size, 0);
+    }
+}
+
+size_t UDPTransport::receive(uint8_t* buffer, size_t capacity)
+{
+    if (socketHandle == NO_SOCKET) {
+        return 0;
+    }
+    // Errors, such as the other player not listening yet, are taken as
+    // nothing having arrived
+    int size = (int)recv((SocketHandle)socketHandle, (char*)buffer, (int)capacity, 0);
+    return size > 0 ? (size_t)size : 0;
+}
+
+LoopbackLink::LoopbackLink(double latencyMs, double jitterMs, int lossPercent, uint32_t seed) :
+    latencyMs(latencyMs), jitterMs(jitterMs), lossPercent(lossPercent), now(0.0), random(seed),
+    sent(0), lost(0)
+{
+    for (int i = 0; i < 2; i++) {
+        ends[i].link = this;
+        ends[i].index = i;
+    }
+}
+
+NetTransport& LoopbackLink::getEnd(int index)
+{
+    return ends[index];
+}
+
+void LoopbackLink::setTime(double ms)
+{
+    now = ms;
+}
+
+uint64_t LoopbackLink::getSent() const
+{
+    return sent;
+}
+
+uint64_t LoopbackLink::getLost() const
+{
+    return lost;
+}
+
+void LoopbackLink::End::send(const uint8_t* data, size_t size)
+{
+    link->sent++;
+    if ((int)(link->random() % 100) < link->lossPercent) {
+        link->lost++;
+        return;
+    }
+    Packet packet;
+    packet.arrival = link->now + link->latencyMs +
+                     link->jitterMs * (link->random() % 1000) / 1000.0;
+    packet.data.assign(data, data + size);
+    link->inFlight[1 - index].push_back(std::move(packet));
+}
+
+size_t LoopbackLink::End::receive(uint8_t* buffer, size_t capacity)
+{
+    // The first to arrive, jitter may have it overtake others
+    std::vector<Packet>& packets = link->inFlight[index];
+    auto next = std::min_element(packets.begin(), packets.end(),
+                                 [](const Packet& a, const Packet& b) { return a.arrival < b.arrival; });
+    if (next == packets.end() || next->arrival > link->now) {
+        return 0;
+    }
+    size_t size = std::min(capacity, next->data.size());
+    memcpy(buffer, next->data.data(), size);
+    packets.erase(next);
+    return size;
+}
+
+NetplaySession::NetplaySession() :
+    transport(nullptr), player(0), inputDelay(0)
+{
+    resetStats();
+}
+
+void NetplaySession::start(NetTransport* transport, int player, int inputDelay)
+{
+    this->transport = transport;
+    this->player = player ? 1 : 0;
+    this->inputDelay = std::min(std::max(inputDelay, 0), MAX_INPUT_DELAY);
+
+    // No one presses anything in the frames before the delay
+    for (int i = 0; i < HISTORY; i++) {
+        bool before = i < this->inputDelay;
+        inputs[i].localFrame = before ? i : NO_FRAME;
+        inputs[i].local = 0;
+        inputs[i].remoteFrame = before ? i : NO_FRAME;
+        inputs[i].remote = 0;
+        inputs[i].used = 0;
+    }
+    frame = 0;
+    localNext = remoteNext = peerNext = this->inputDelay;
+    rollbackFrom = NO_FRAME;
+    lastRemote = 0;
+    for (int i = 0; i <= MAX_ROLLBACK; i++) {
+        stateFrames[i] = NO_FRAME;
+    }
+    nextChecksumFrame = CHECKSUM_INTERVAL;
+    localChecksums.clear();
+    remoteChecksums.clear();
+    lastLocalChecksum.frame = NO_FRAME;
+    lastLocalChecksum.value = 0;
+}
+
+void NetplaySession::stop()
+{
+    transport = nullptr;
+}
+
+bool NetplaySession::isActive() const
+{
+    return transport != nullptr;
+}
+
+bool NetplaySession::runFrame(WarpNES& engine, uint8_t buttons)
+{
+    if (!transport) {
+        return false;
+    }
+    uint64_t start = nowMicros();
+    applyPackets(engine);
+
+    if (frame >= remoteNext + MAX_ROLLBACK) {
+        sendInputs();
+        statStalls++;
+        return false;
+    }
+
+    InputSlot& local = slot(localNext);
+    local.localFrame = localNext;
+    local.local = buttons;
+    localNext++;
+    sendInputs();
+
+    saveFrameState(engine, frame);
+    runInputs(engine, frame);
+    frame++;
+    setButtons(engine.getController1(), PLAYER_1, buttons);
+
+    uint64_t elapsed = nowMicros() - start;
+    statFrames++;
+    statTotalUs += elapsed;
+    statMaxUs = std::max(statMaxUs, elapsed);
+    if (elapsed > FRAME_BUDGET_US) {
+        statOverBudget++;
+    }
+    return true;
+}
+
+void NetplaySession::synchronize(WarpNES& engine)
+{
+    if (!transport) {
+        return;
+    }
+    applyPackets(engine);
+    sendInputs();
+}
+
+bool NetplaySession::isSynchronized() const
+{
+    return remoteNext >= frame;
+}
+
+uint32_t NetplaySession::getFrame() const
+{
+    return frame;
+}
+
+uint8_t NetplaySession::captureButtons(WarpNES& engine)
+{
+    Controller& controller = engine.getController1();
+    uint8_t buttons = 0;
+    for (int button = 0; button < 8; button++) {
+        if (controller.getButtonState(PLAYER_1, (ControllerButton)button)) {
+            buttons |= 1 << button;
+        }
+    }
+    return buttons;
+}
+
+void NetplaySession::applyPackets(WarpNES& engine)
+{
+    receivePackets();
+    if (rollbackFrom != NO_FRAME) {
+        rollback(engine);
+    }
+    updateChecksums();
+}
+
+NetplaySession::InputSlot& NetplaySession::slot(uint32_t frame)
+{
+    return inputs[frame % HISTORY];
+}
+
+void NetplaySession::receivePackets()
+{
+    uint8_t data[PACKET_HEADER_SIZE + MAX_PACKET_FRAMES];
+    size_t size;
+    while ((size = transport->receive(data, sizeof(data))) > 0) {
+        statReceived++;
+        readPacket(data, size);
+    }
+}
+
+void NetplaySession::readPacket(const uint8_t* data, size_t size)
+{
+    if (size < PACKET_HEADER_SIZE || data[0] != 'W' || data[1] != 'N' || data[2] != PACKET_VERSION) {
+        return;
+    }
+    uint32_t ack = getUint32(data + 3);
+    Checksum remoteChecksum;
+    remoteChecksum.frame = getUint32(data + 7);
+    remoteChecksum.value = getUint32(data + 11);
+    uint32_t first = getUint32(data + 15);
+    uint32_t count = std::min<uint32_t>(data[19], (uint32_t)(size - PACKET_HEADER_SIZE));
+
+    peerNext = std::max(peerNext, std::min(ack, localNext));
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t remoteFrame = first + i;
+        if (remoteFrame < remoteNext || remoteFrame >= remoteNext + HISTORY) {
+            continue;
+        }
+        InputSlot& input = slot(remoteFrame);
+        input.remoteFrame = remoteFrame;
+        input.remote = data[PACKET_HEADER_SIZE + i];
+    }
+
+    // Confirm the frames that now have no gap before them, and note the
+    // first one that already ran with a wrong guess
+    while (slot(remoteNext).remoteFrame == remoteNext) {
+        InputSlot& input = slot(remoteNext);
+        if (remoteNext < frame && input.used != input.remote) {
+            rollbackFrom = std::min(rollbackFrom, remoteNext);
+        }
+        lastRemote = input.remote;
+        remoteNext++;
+    }
+
+    if (remoteChecksum.frame != NO_FRAME &&
+        (remoteChecksums.empty() || remoteChecksum.frame > remoteChecksums.back().frame)) {
+        remoteChecksums.push_back(remoteChecksum);
+        compareChecksums();
+    }
+}
+
+void NetplaySession::sendInputs()
+{
+    // Every packet carries all the buttons not yet acknowledged, so a lost
+    // one costs nothing once the next arrives
+    uint32_t first = std::max(peerNext, localNext > MAX_PACKET_FRAMES ? localNext - MAX_PACKET_FRAMES : 0u);
+    uint32_t count = localNext > first ? std::min(localNext - first, MAX_PACKET_FRAMES) : 0;
+
+    packet.resize(PACKET_HEADER_SIZE + count);
+    packet[0] = 'W';
+    packet[1] = 'N';
+    packet[2] = PACKET_VERSION;
+    putUint32(&packet[3], remoteNext);
+    putUint32(&packet[7], lastLocalChecksum.frame);
+    putUint32(&packet[11], lastLocalChecksum.value);
+    putUint32(&packet[15], first);
+    packet[19] = (uint8_t)count;
+    for (uint32_t i = 0; i < count; i++) {
+        packet[PACKET_HEADER_SIZE + i] = slot(first + i).local;
+    }
+    transport->send(packet.data(), packet.size());
+    statSent++;
+}
+
+void NetplaySession::rollback(WarpNES& engine)
+{
+    uint32_t from = rollbackFrom;
+    rollbackFrom = NO_FRAME;
+    int index = from % (MAX_ROLLBACK + 1);
+    if (stateFrames[index] != from) {
+        // Can not happen while the game waits at MAX_ROLLBACK
+        printf("Netplay: Error - No state to roll back to frame %u\n", from);
+        return;
+    }
+
+    uint64_t start = nowMicros();
+    uint8_t buttons = captureButtons(engine);
+    engine.loadState(states[index].data(), states[index].size());
+    bool video = engine.getVideoOutput();
+    engine.setVideoOutput(false);
+    engine.setAudioOutput(false);
+    for (uint32_t resimulate = from; resimulate < frame; resimulate++) {
+        if (resimulate != from) {
+            saveFrameState(engine, resimulate);
+        }
+        runInputs(engine, resimulate);
+    }
+    engine.setAudioOutput(true);
+    engine.setVideoOutput(video);
+    setButtons(engine.getController1(), PLAYER_1, buttons);
+
+    uint64_t elapsed = nowMicros() - start;
+    uint32_t depth = frame - from;
+    statRollbacks++;
+    statResimulated += depth;
+    statMaxDepth = std::max(statMaxDepth, depth);
+    statDepthCounts[std::min<uint32_t>(depth, MAX_ROLLBACK)]++;
+    statResimulateUs += elapsed;
+    statResimulateMaxUs = std::max(statResimulateMaxUs, elapsed);
+}
+
+void NetplaySession::runInputs(WarpNES& engine, uint32_t runFrame)
+{
+    InputSlot& input = slot(runFrame);
+    uint8_t local = input.localFrame == runFrame ? input.local : 0;
+    input.used = input.remoteFrame == runFrame ? input.remote : lastRemote;
+
+    setButtons(engine.getController1(), PLAYER_1, player == 0 ? local : input.used);
+    setButtons(engine.getController2(), PLAYER_2, player == 0 ? input.used : local);
+    engine.update();
+}
+
+void NetplaySession::saveFrameState(WarpNES& engine, uint32_t stateFrame)
+{
+    int index = stateFrame % (MAX_ROLLBACK + 1);
+    size_t size = engine.getStateSize();
+    states[index].resize(size);
+    stateFrames[index] = engine.saveState(states[index].data(), size) == size ? stateFrame : NO_FRAME;
+}
+
+void NetplaySession::updateChecksums()
+{
+    // A state is final once every frame before it has the real buttons
+    while (nextChecksumFrame < frame && nextChecksumFrame <= remoteNext) {
+        int index = nextChecksumFrame % (MAX_ROLLBACK + 1);
+        if (stateFrames[index] == nextChecksumFrame) {
+            lastLocalChecksum.frame = nextChecksumFrame;
+            lastLocalChecksum.value = gameChecksum(states[index]);
+            localChecksums.push_back(lastLocalChecksum);
+        }
+        nextChecksumFrame += CHECKSUM_INTERVAL;
+    }
+    compareChecksums();
+}
+
+void NetplaySession::compareChecksums()
+{
+    for (auto remote = remoteChecksums.begin(); remote != remoteChecksums.end();) {
+        auto local = std::find_if(localChecksums.begin(), localChecksums.end(),
+                                  [&](const Checksum& c) { return c.frame == remote->frame; });
+        if (local == localChecksums.end()) {
+            if (localChecksums.empty() || remote->frame > localChecksums.back().frame) {
+                ++remote;   // Not reached here yet
+            } else {
+                remote = remoteChecksums.erase(remote);
+            }
+            continue;
+        }
+        statChecksums++;
+        if (local->value != remote->value) {
+            statDesyncs++;
+            printf("Netplay: Desync at frame %u, the games no longer match\n", remote->frame);
+        }
+        localChecksums.erase(localChecksums.begin(), local + 1);
+        remote = remoteChecksums.erase(remote);
+    }
+}
+
+NetplaySession::Stats NetplaySession::getStats() const
+{
+    Stats stats;
+    stats.frames = statFrames;
+    stats.stalls = statStalls;
+    stats.rollbacks = statRollbacks;
+    stats.resimulatedFrames = statResimulated;
+    stats.maxDepth = statMaxDepth;
+    for (int i = 0; i <= MAX_ROLLBACK; i++) {
+        stats.depthCounts[i] = statDepthCounts[i];
+    }
+    stats.averageUs = statFrames ? (double)statTotalUs / statFrames : 0.0;
+    stats.maxUs = (double)statMaxUs;
+    stats.resimulateAverageUs = statRollbacks ? (double)statResimulateUs / statRollbacks : 0.0;
+    stats.resimulateMaxUs = (double)statResimulateMaxUs;
+    stats.overBudget = statOverBudget;
+    stats.packetsSent = statSent;
+    stats.packetsReceived = statReceived;
+    stats.checksums = statChecksums;
+    stats.desyncs = statDesyncs;
+    return stats;
+}
+
+void NetplaySession::resetStats()
+{
+    statFrames = 0;
+    statStalls = 0;
+    statRollbacks = 0;
+    statResimulated = 0;
+    statMaxDepth = 0;
+    for (int i = 0; i <= MAX_ROLLBACK; i++) {
+        statDepthCounts[i] = 0;
+    }
+    statTotalUs = 0;
+    statMaxUs = 0;
+    statResimulateUs = 0;
+    statResimulateMaxUs = 0;
+    statOverBudget = 0;
+    statSent = 0;
+    statReceived = 0;
+    statChecksums = 0;
+    statDesyncs = 0;
+}
+
+void NetplaySession::Stats::print() const
+{
+    printf("Netplay: %llu frames, %llu waited, %llu rollbacks %.2f frames avg %u max, "
+           "rollback %.2fms avg %.2fms max, frame %.2fms avg %.2fms max, %llu over budget, "
+           "%llu packets sent %llu received, %llu checksums %llu desyncs\n",
+           (unsigned long long)frames, (unsigned long long)stalls, (unsigned long long)rollbacks,
+           rollbacks ? (double)resimulatedFrames / rollbacks : 0.0, maxDepth,
+           resimulateAverageUs / 1000.0, resimulateMaxUs / 1000.0, averageUs / 1000.0, maxUs / 1000.0,
+           (unsigned long long)overBudget, (unsigned long long)packetsSent,
+           (unsigned long long)packetsReceived, (unsigned long long)checksums, (unsigned long long)desyncs);
+}
+
+/**
+ * Buttons for the benchmark's players, held for a few frames at a time
+ * like a person would.
+ */
+static uint8_t benchmarkButtons(int player, uint32_t frame)
+{
+    uint8_t key[5] = { (uint8_t)player, (uint8_t)(frame / 6), (uint8_t)(frame / 6 >> 8),
+                       (uint8_t)(frame / 6 >> 16), (uint8_t)(frame / 6 >> 24) };
+    // Start pauses most games, so it is left alone
+    return (uint8_t)checksum(key, sizeof(key)) & ~(1 << BUTTON_START);
+}
+
+void NetplaySession::benchmarkLoopback(WarpNES& engine, int frames, double latencyMs, int lossPercent)
+{
+    const int delay = 2;
+    const double periodMs = 1000.0 / 60.0;
+
+    std::unique_ptr<WarpNES> peer(engine.clone());
+    std::unique_ptr<WarpNES> reference(engine.clone());
+    if (!peer || !reference) {
+        printf("Netplay loopback: Error - Could not clone the engine\n");
+        return;
+    }
+    WarpNES* engines[2] = { &engine, peer.get() };
+    LoopbackLink link(latencyMs, latencyMs / 4, lossPercent);
+    NetplaySession sessions[2];
+    // The players' sound runs at different rates, as when their pacers
+    // disagree, which must not show as a desync
+    const double rates[2] = { 0.995, 1.005 };
+    for (int i = 0; i < 2; i++) {
+        engines[i]->setAudioOutput(false);
+        engines[i]->setAudioRateAdjustment(rates[i]);
+        sessions[i].start(&link.getEnd(i), i, delay);
+    }
+
+    printf("Netplay loopback: %d frames, %.0fms latency, %d%% loss, %d frames input delay\n",
+           frames, latencyMs, lossPercent, delay);
+
+    // Both players run a frame each period, then stop at the end and wait
+    // for the last buttons to arrive
+    int tick = 0;
+    while (sessions[0].getFrame() < (uint32_t)frames || sessions[1].getFrame() < (uint32_t)frames ||
+           !sessions[0].isSynchronized() || !sessions[1].isSynchronized()) {
+        link.setTime(tick++ * periodMs);
+        for (int i = 0; i < 2; i++) {
+            uint32_t next = sessions[i].getFrame();
+            if (next < (uint32_t)frames) {
+                sessions[i].runFrame(*engines[i], benchmarkButtons(i, next + delay));
+            } else {
+                sessions[i].synchronize(*engines[i]);
+            }
+        }
+        if (tick > frames * 10) {
+            printf("  Error - the sessions stopped making progress\n");
+            break;
+        }
+    }
+
+    // The same buttons without a network in between
+    reference->setAudioOutput(false);
+    for (int i = 0; i < frames; i++) {
+        setButtons(reference->getController1(), PLAYER_1, i >= delay ? benchmarkButtons(0, i) : 0);
+        setButtons(reference->getController2(), PLAYER_2, i >= delay ? benchmarkButtons(1, i) : 0);
+        reference->update();
+    }
+
+    std::vector<uint8_t> expected(reference->getStateSize());
+    expected.resize(reference->saveState(expected.data(), expected.size()));
+    for (int i = 0; i < 2; i++) {
+        Stats stats = sessions[i].getStats();
+        std::vector<uint8_t> state(engines[i]->getStateSize());
+        state.resize(engines[i]->saveState(state.data(), state.size()));
+        printf("  player %d: %s the game run without a network\n    ", i + 1,
+               gameChecksum(state) == gameChecksum(expected) ? "matches" : "DOES NOT match");
+        stats.print();
+        if (stats.desyncs > 0) {
+            printf("    Error - %llu desyncs reported with sound at %.3fx\n",
+                   (unsigned long long)stats.desyncs, rates[i]);
+        }
+        printf("    rollback depth:");
+        for (int depth = 1; depth <= MAX_ROLLBACK; depth++) {
+            printf(" %d:%llu", depth, (unsigned long long)stats.depthCounts[depth]);
+        }
+        printf("\n");
+    }
+    printf("  link: %llu packets, %llu lost\n", (unsigned long long)link.getSent(),
+           (unsigned long long)link.getLost());
+
+    engines[0]->setAudioOutput(true);
+    engines[0]->setAudioRateAdjustment(1.0);
+}
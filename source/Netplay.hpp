@@ -0,0 +1,279 @@
+#ifndef NETPLAY_HPP
+#define NETPLAY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+class WarpNES;
+
+/**
+ * Carries netplay packets to the other player. Packets may be lost,
+ * repeated or arrive out of order.
+ */
+class NetTransport {
+public:
+    virtual ~NetTransport() {}
+
+    virtual void send(const uint8_t* data, size_t size) = 0;
+
+    /**
+     * Take the next packet that has arrived, without waiting.
+     * @return Its size, 0 if none has arrived
+     */
+    virtual size_t receive(uint8_t* buffer, size_t capacity) = 0;
+};
+
+/**
+ * A non-blocking UDP socket sending to one other player.
+ */
+class UDPTransport : public NetTransport {
+public:
+    UDPTransport();
+    ~UDPTransport();
+
+    /**
+     * Listen on a local port and send to the other player's address.
+     */
+    bool open(int localPort, const std::string& peerHost, int peerPort);
+
+    void close();
+
+    void send(const uint8_t* data, size_t size) override;
+    size_t receive(uint8_t* buffer, size_t capacity) override;
+
+private:
+    intptr_t socketHandle;          /**< A SOCKET on Windows, a descriptor elsewhere */
+};
+
+/**
+ * Two transports joined in memory, for running both players in one
+ * process. Packets are delayed and dropped as a network would. The link
+ * runs on a clock the caller advances, so a test runs as fast as the
+ * engines do and the same seed loses the same packets.
+ */
+class LoopbackLink {
+public:
+    /**
+     * @param latencyMs Time each packet takes one way
+     * @param jitterMs Up to this much more at random, reordering packets
+     * @param lossPercent Chance of a packet being dropped
+     */
+    LoopbackLink(double latencyMs, double jitterMs, int lossPercent, uint32_t seed = 1);
+
+    /**
+     * Get one end of the link, 0 or 1.
+     */
+    NetTransport& getEnd(int index);
+
+    /**
+     * Set the time on the link's clock, packets due by then can be received.
+     */
+    void setTime(double ms);
+
+    uint64_t getSent() const;
+
+    uint64_t getLost() const;
+
+private:
+    struct Packet {
+        double arrival;
+        std::vector<uint8_t> data;
+    };
+
+    class End : public NetTransport {
+    public:
+        LoopbackLink* link;
+        int index;
+
+        void send(const uint8_t* data, size_t size) override;
+        size_t receive(uint8_t* buffer, size_t capacity) override;
+    };
+
+    double latencyMs;
+    double jitterMs;
+    int lossPercent;
+    double now;
+    std::mt19937 random;
+    End ends[2];
+    std::vector<Packet> inFlight[2];    /**< Packets on their way to each end */
+    uint64_t sent;
+    uint64_t lost;
+};
+
+/**
+ * Two players on different machines playing one game, with rollback.
+ *
+ * Both machines run the whole game and only the controllers are sent.
+ * The local buttons are used a few frames after they are pressed and
+ * sent straight away, so with a short round trip they arrive in time.
+ * When the other player's buttons for a frame have not arrived, they are
+ * guessed to be the last ones that did, and the frame runs anyway. If
+ * the guess turns out wrong, the state from before that frame is loaded
+ * and the frames since are run again, without drawing or sound, with the
+ * buttons really pressed. The game stops to wait rather than go further
+ * than MAX_ROLLBACK frames past the last buttons received. Both machines
+ * exchange a checksum of the state every second to catch a desync.
+ */
+class NetplaySession {
+public:
+    /**
+     * Frames run past the other player's last buttons before waiting.
+     */
+    static const int MAX_ROLLBACK = 8;
+
+    /**
+     * Counters since the last reset.
+     */
+    struct Stats {
+        uint64_t frames;            /**< Frames run */
+        uint64_t stalls;            /**< Frames not run waiting for the other player */
+        uint64_t rollbacks;
+        uint64_t resimulatedFrames;
+        uint32_t maxDepth;          /**< Most frames run again at once */
+        uint64_t depthCounts[MAX_ROLLBACK + 1]; /**< Rollbacks by the number of frames run again */
+        double averageUs;           /**< Average time of a frame, with any rollback */
+        double maxUs;               /**< Longest time of a frame, with any rollback */
+        double resimulateAverageUs; /**< Average time of a rollback, loading and running again */
+        double resimulateMaxUs;
+        uint64_t overBudget;        /**< Frames that took longer than a frame period */
+        uint64_t packetsSent;
+        uint64_t packetsReceived;
+        uint64_t checksums;         /**< State checksums compared with the other player */
+        uint64_t desyncs;           /**< Checksums that did not match */
+
+        /**
+         * Print the stats as a single line.
+         */
+        void print() const;
+    };
+
+    NetplaySession();
+
+    /**
+     * Start a session. Both players must have the same ROM loaded and
+     * reset, the same input delay, and be player 1 and player 2.
+     * @param player 0 to play as player 1, 1 as player 2
+     * @param inputDelay Frames between pressing a button and it being used
+     */
+    void start(NetTransport* transport, int player, int inputDelay);
+
+    void stop();
+
+    bool isActive() const;
+
+    /**
+     * Run the next frame of the game, rolling back first if the other
+     * player's buttons showed a guess was wrong. Call once per frame period
+     * even when a frame is not run, to keep the packets flowing. The
+     * local player's buttons on controller 1 are left as given, the way
+     * the frontend reads the keyboard.
+     * @param buttons The local player's buttons, bit n for ControllerButton n
+     * @return false if the frame was not run, waiting for the other player
+     */
+    bool runFrame(WarpNES& engine, uint8_t buttons);
+
+    /**
+     * Exchange packets and roll back if needed without running a frame,
+     * for when the game is held, such as while paused.
+     */
+    void synchronize(WarpNES& engine);
+
+    /**
+     * Check whether the other player's buttons have arrived for every
+     * frame run, so the game is where it is on the other machine.
+     */
+    bool isSynchronized() const;
+
+    /**
+     * Get the next frame to be run, counting from the start of the session.
+     */
+    uint32_t getFrame() const;
+
+    /**
+     * Get the buttons held on player 1 of controller 1, where the frontends
+     * put the local player.
+     */
+    static uint8_t captureButtons(WarpNES& engine);
+
+    Stats getStats() const;
+
+    void resetStats();
+
+    /**
+     * Play two sessions against each other over a loopback link, the
+     * engine against a clone of itself, with changing buttons on both
+     * sides and sound at a different rate on each, and print the rollback
+     * stats and any desyncs.
+     */
+    static void benchmarkLoopback(WarpNES& engine, int frames, double latencyMs, int lossPercent);
+
+private:
+    /**
+     * The buttons of one frame.
+     */
+    struct InputSlot {
+        uint32_t localFrame;        /**< The frame local holds, NO_FRAME for none */
+        uint8_t local;
+        uint32_t remoteFrame;       /**< The frame remote holds, NO_FRAME for none */
+        uint8_t remote;
+        uint8_t used;               /**< The other player's buttons the frame was last run with */
+    };
+
+    struct Checksum {
+        uint32_t frame;
+        uint32_t value;
+    };
+
+    static const uint32_t NO_FRAME = 0xFFFFFFFF;
+    static const int HISTORY = 128;
+
+    NetTransport* transport;
+    int player;
+    int inputDelay;
+    uint32_t frame;                 /**< The next frame to run */
+    uint32_t localNext;             /**< The first frame without local buttons */
+    uint32_t remoteNext;            /**< The first frame without the other player's buttons */
+    uint32_t peerNext;              /**< The first frame without local buttons the other player has */
+    uint32_t rollbackFrom;          /**< The first frame run with a wrong guess, NO_FRAME for none */
+    uint8_t lastRemote;
+    InputSlot inputs[HISTORY];
+    std::vector<uint8_t> states[MAX_ROLLBACK + 1]; /**< The state before each of the last frames */
+    uint32_t stateFrames[MAX_ROLLBACK + 1];         /**< The frame each state is before */
+    uint32_t nextChecksumFrame;
+    std::vector<Checksum> localChecksums;
+    std::vector<Checksum> remoteChecksums;
+    Checksum lastLocalChecksum;
+    std::vector<uint8_t> packet;
+
+    uint64_t statFrames;
+    uint64_t statStalls;
+    uint64_t statRollbacks;
+    uint64_t statResimulated;
+    uint32_t statMaxDepth;
+    uint64_t statDepthCounts[MAX_ROLLBACK + 1];
+    uint64_t statTotalUs;
+    uint64_t statMaxUs;
+    uint64_t statResimulateUs;
+    uint64_t statResimulateMaxUs;
+    uint64_t statOverBudget;
+    uint64_t statSent;
+    uint64_t statReceived;
+    uint64_t statChecksums;
+    uint64_t statDesyncs;
+
+    void applyPackets(WarpNES& engine);
+    InputSlot& slot(uint32_t frame);
+    void receivePackets();
+    void readPacket(const uint8_t* data, size_t size);
+    void sendInputs();
+    void rollback(WarpNES& engine);
+    void runInputs(WarpNES& engine, uint32_t frame);
+    void saveFrameState(WarpNES& engine, uint32_t frame);
+    void updateChecksums();
+    void compareChecksums();
+};
+
+#endif // NETPLAY_HPP
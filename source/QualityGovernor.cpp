@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <cstdio>
+
+#include "QualityGovernor.hpp"
+
+// Emulated frames measured before each decision
+static const uint64_t WINDOW_FRAMES = 30;
+
+// Share of the budget a frame may use before quality steps down
+static const double DEGRADE_LOAD = 0.9;
+
+// Share of the budget a frame may use at the level above for quality to
+// step back up, and the share used when the filters' cost is not known yet
+static const double RESTORE_LOAD = 0.75;
+static const double RESTORE_FILTERS_LOAD = 0.5;
+
+// Calm windows needed before a restore, doubled each time a restore has
+// to be undone straight away, up to the limit
+static const int RESTORE_WINDOWS = 4;
+static const int MAX_RESTORE_WINDOWS = 64;
+
+// Windows a restore has to hold for the wait to go back to the minimum
+static const int STABLE_WINDOWS = 16;
+
+QualityGovernor::QualityGovernor() :
+    enabled(true), canReduceFilters(false), parallel(false), budgetUs(16667), maxFrameSkip(3),
+    level(0), emulatedFrames(0), emulationUs(0), presentedFrames(0), presentationUs(0),
+    settling(false), fullCostUs(0.0), filterCostUs(-1.0),
+    calmWindows(0), restoreWindows(RESTORE_WINDOWS), windowsSinceRestore(STABLE_WINDOWS),
+    emulationBound(false), frameSkip(0), skippedInRow(0)
+{
+}
+
+void QualityGovernor::setBudget(uint64_t frameUs)
+{
+    budgetUs = std::max<uint64_t>(frameUs, 1);
+}
+
+void QualityGovernor::setMaxFrameSkip(int frames)
+{
+    maxFrameSkip = std::max(0, frames);
+    level = std::min(level, getMaxLevel());
+    updateFrameSkip();
+}
+
+void QualityGovernor::setCanReduceFilters(bool canReduce)
+{
+    if (canReduce == canReduceFilters) {
+        return;
+    }
+
+    // Keep the same amount of frame skipping
+    int skip = getFrameSkip();
+    canReduceFilters = canReduce;
+    if (level > 0) {
+        level = skip + (canReduceFilters ? 1 : 0);
+    }
+    level = std::min(level, getMaxLevel());
+    updateFrameSkip();
+}
+
+void QualityGovernor::setParallel(bool isParallel)
+{
+    parallel = isParallel;
+}
+
+void QualityGovernor::setEnabled(bool isEnabled)
+{
+    enabled = isEnabled;
+    if (!enabled) {
+        level = 0;
+        updateFrameSkip();
+    }
+}
+
+void QualityGovernor::addEmulatedFrames(uint64_t frames, uint64_t us)
+{
+    emulatedFrames += frames;
+    emulationUs += us;
+}
+
+void QualityGovernor::addPresentedFrame(uint64_t us)
+{
+    presentedFrames++;
+    presentationUs += us;
+}
+
+bool QualityGovernor::update()
+{
+    if (emulatedFrames < WINDOW_FRAMES) {
+        return false;
+    }
+
+    // Presentation is spread over every emulated frame, so skipping
+    // frames brings its share down
+    double emulation = (double)emulationUs / emulatedFrames;
+    double presentation = (double)presentationUs / emulatedFrames;
+    double cost = parallel ? std::max(emulation, presentation) : emulation + presentation;
+
+    emulatedFrames = 0;
+    emulationUs = 0;
+    presentedFrames = 0;
+    presentationUs = 0;
+
+    // The first window after a change is a mix of both levels
+    if (!enabled || settling) {
+        settling = false;
+        return false;
+    }
+
+    // Work out what the expensive filters cost from the first window
+    // without them
+    if (getFiltersReduced() && getFrameSkip() == 0 && filterCostUs < 0.0) {
+        filterCostUs = std::max(0.0, fullCostUs - cost);
+    }
+
+    windowsSinceRestore++;
+    if (windowsSinceRestore == STABLE_WINDOWS) {
+        restoreWindows = RESTORE_WINDOWS;
+    }
+
+    if (cost > budgetUs * DEGRADE_LOAD) {
+        calmWindows = 0;
+        if (level >= getMaxLevel()) {
+            return false;
+        }
+        // Skipping saves drawing and presenting frames, not running them,
+        // so with emulation alone over budget it would only drop frames
+        bool skipNext = level + 1 > (canReduceFilters ? 1 : 0);
+        if (skipNext && emulation > budgetUs * DEGRADE_LOAD) {
+            if (!emulationBound) {
+                printf("Quality held at level %d: emulation alone took %.2fms of %.2fms\n",
+                       level, emulation / 1000.0, budgetUs / 1000.0);
+                emulationBound = true;
+            }
+            return false;
+        }
+        emulationBound = false;
+        // A restore that did not last means the host is on the edge
+        if (windowsSinceRestore <= 1) {
+            restoreWindows = std::min(restoreWindows * 2, MAX_RESTORE_WINDOWS);
+        }
+        if (level == 0 && canReduceFilters) {
+            fullCostUs = cost;
+            filterCostUs = -1.0;
+        }
+        setLevel(level + 1, cost);
+        return true;
+    }
+
+    emulationBound = false;
+    if (level == 0) {
+        return false;
+    }
+
+    // Estimate the cost at the level above
+    int skip = getFrameSkip();
+    bool fits;
+    if (skip > 0) {
+        double upPresentation = presentation * (skip + 1) / skip;
+        double upCost = parallel ? std::max(emulation, upPresentation) : emulation + upPresentation;
+        fits = upCost < budgetUs * RESTORE_LOAD;
+    } else if (filterCostUs >= 0.0) {
+        fits = cost + filterCostUs < budgetUs * RESTORE_LOAD;
+    } else {
+        fits = cost < budgetUs * RESTORE_FILTERS_LOAD;
+    }
+
+    if (!fits) {
+        calmWindows = 0;
+        return false;
+    }
+    if (++calmWindows < restoreWindows) {
+        return false;
+    }
+
+    calmWindows = 0;
+    windowsSinceRestore = 0;
+    setLevel(level - 1, cost);
+    return true;
+}
+
+int QualityGovernor::getLevel() const
+{
+    return level;
+}
+
+bool QualityGovernor::getFiltersReduced() const
+{
+    return canReduceFilters && level >= 1;
+}
+
+int QualityGovernor::getFrameSkip() const
+{
+    return std::max(0, level - (canReduceFilters ? 1 : 0));
+}
+
+bool QualityGovernor::shouldRender()
+{
+    if (skippedInRow < frameSkip) {
+        skippedInRow++;
+        return false;
+    }
+    skippedInRow = 0;
+    return true;
+}
+
+int QualityGovernor::getMaxLevel() const
+{
+    return maxFrameSkip + (canReduceFilters ? 1 : 0);
+}
+
+void QualityGovernor::setLevel(int newLevel, double cost)
+{
+    bool restoring = newLevel < level;
+    level = newLevel;
+    settling = true;
+    updateFrameSkip();
+
+    char state[64];
+    int skip = getFrameSkip();
+    if (skip > 0) {
+        snprintf(state, sizeof(state), "presenting 1 of %d frames", skip + 1);
+    } else if (getFiltersReduced()) {
+        snprintf(state, sizeof(state), "expensive filters off");
+    } else {
+        snprintf(state, sizeof(state), "full quality");
+    }
+    printf("Quality %s to level %d (%s): frames took %.2fms of %.2fms\n",
+           restoring ? "restored" : "reduced", level, state, cost / 1000.0, budgetUs / 1000.0);
+}
+
+void QualityGovernor::updateFrameSkip()
+{
+    frameSkip = getFrameSkip();
+}
@@ -0,0 +1,115 @@
+#ifndef QUALITY_GOVERNOR_HPP
+#define QUALITY_GOVERNOR_HPP
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Trades video quality for speed when the host can not keep up.
+ *
+ * The frontend reports the time spent emulating and presenting frames.
+ * Every window of frames the governor compares the cost of a frame with
+ * the frame period and steps down a level when it is over budget:
+ *   0          full quality
+ *   1          expensive filters (NTSC, hq2x, hq3x, 4xSaI, hqdn3d) swapped for cheap ones
+ *   2 and up   only every second, third, ... frame is drawn and presented
+ * Emulation and audio always run at full rate, skipped frames are run
+ * without the PPU drawing them. As that only saves drawing and presenting,
+ * frames are not skipped while running the game alone is over budget.
+ * Quality comes back one
+ * level at a time once there is headroom, waiting longer after every
+ * restore that had to be undone, so a host on the edge does not flip
+ * back and forth. Every change is logged.
+ */
+class QualityGovernor {
+public:
+    QualityGovernor();
+
+    /**
+     * Set the time one frame may take, in microseconds.
+     */
+    void setBudget(uint64_t frameUs);
+
+    /**
+     * Set the largest number of frames skipped between presented ones.
+     */
+    void setMaxFrameSkip(int frames);
+
+    /**
+     * Set whether the frontend has expensive filters to turn off. Without
+     * them the governor goes straight to skipping frames.
+     */
+    void setCanReduceFilters(bool canReduce);
+
+    /**
+     * Set whether emulation and presentation run on separate threads, in
+     * which case the slower of the two has to fit the budget rather than
+     * both together.
+     */
+    void setParallel(bool parallel);
+
+    void setEnabled(bool enabled);
+
+    /**
+     * Report frames emulated and the time they took.
+     */
+    void addEmulatedFrames(uint64_t frames, uint64_t us);
+
+    /**
+     * Report a presented frame and the time filtering and presenting it took.
+     */
+    void addPresentedFrame(uint64_t us);
+
+    /**
+     * Step the level when a window of frames is complete.
+     * @return true if the level changed
+     */
+    bool update();
+
+    int getLevel() const;
+
+    bool getFiltersReduced() const;
+
+    /**
+     * Get the number of frames skipped between presented ones.
+     */
+    int getFrameSkip() const;
+
+    /**
+     * Check whether the next frame to be emulated should be drawn and
+     * presented, counting it either way. Call once before each frame. It
+     * may be called from another thread than the rest, as long as it is
+     * always the same one.
+     */
+    bool shouldRender();
+
+private:
+    bool enabled;
+    bool canReduceFilters;
+    bool parallel;
+    uint64_t budgetUs;
+    int maxFrameSkip;
+    int level;
+
+    // Current window
+    uint64_t emulatedFrames;
+    uint64_t emulationUs;
+    uint64_t presentedFrames;
+    uint64_t presentationUs;
+
+    bool settling;              /**< Level changed during the current window */
+    double fullCostUs;          /**< Frame cost when the filters were turned off */
+    double filterCostUs;        /**< What the filters cost, negative until measured */
+    int calmWindows;            /**< Windows in a row with headroom */
+    int restoreWindows;         /**< Calm windows needed before quality comes back */
+    int windowsSinceRestore;
+    bool emulationBound;        /**< Skipping was held back as emulation alone is over budget */
+    std::atomic<int> frameSkip; /**< getFrameSkip(), for shouldRender() */
+    int skippedInRow;           /**< Frames shouldRender() skipped since the last drawn one */
+
+    int getMaxLevel() const;
+    void setLevel(int newLevel, double cost);
+    void updateFrameSkip();
+};
+
+#endif // QUALITY_GOVERNOR_HPP
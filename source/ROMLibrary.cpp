@@ -0,0 +1,373 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "ROMLibrary.hpp"
+#include "Emulation/AtomicFile.hpp"
+#include "Emulation/WarpNES.hpp"
+
+namespace fs = std::filesystem;
+
+// The index is a header, then each entry with its path before the fixed
+// size fields. Values are stored in host byte order like save states, an
+// index from another machine is just rebuilt.
+static const char INDEX_MAGIC[8] = { 'N', 'E', 'S', 'L', 'I', 'B', 'R', 'Y' };
+static const uint32_t INDEX_VERSION = 1;
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+/**
+ * FNV-1a hash, the same as movies use to tell ROMs apart.
+ */
+static uint32_t checksum(const uint8_t* data, size_t length, uint32_t hash = 2166136261u)
+{
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+template <typename T>
+static void putValue(std::vector<uint8_t>& out, const T& value)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+static bool getValue(const std::vector<uint8_t>& in, size_t& offset, T& value)
+{
+    if (in.size() - offset < sizeof(T)) {
+        return false;
+    }
+    memcpy(&value, &in[offset], sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+static bool isROMFile(const fs::path& path)
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return (char)std::tolower(c); });
+    return extension == ".nes";
+}
+
+std::string ROMLibrary::Entry::getName() const
+{
+    return fs::path(path).filename().string();
+}
+
+ROMLibrary::ROMLibrary(const std::string& indexFile) :
+    indexFile(indexFile), indexLoaded(false)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool ROMLibrary::scan(const std::string& directory, int threads)
+{
+    Clock::time_point start = Clock::now();
+    memset(&stats, 0, sizeof(stats));
+    if (!indexLoaded) {
+        loadIndex();
+        indexLoaded = true;
+    }
+
+    std::error_code error;
+    fs::path root = fs::absolute(directory, error).lexically_normal();
+    if (error || !fs::is_directory(root, error)) {
+        return false;
+    }
+    if (!root.has_filename()) {
+        root = root.parent_path();
+    }
+
+    std::unordered_map<std::string, size_t> known;
+    for (size_t i = 0; i < entries.size(); i++) {
+        known[entries[i].path] = i;
+    }
+
+    // List the ROMs, keeping what the index has for those that have not
+    // changed since it was saved
+    std::vector<size_t> changed;
+    found.clear();
+    fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, error);
+    if (error) {
+        return false;
+    }
+    for (; !error && it != fs::recursive_directory_iterator(); it.increment(error)) {
+        std::error_code fileError;
+        if (!it->is_regular_file(fileError) || !isROMFile(it->path())) {
+            continue;
+        }
+        Entry entry;
+        entry.path = it->path().string();
+        entry.size = it->file_size(fileError);
+        entry.modified = (int64_t)it->last_write_time(fileError).time_since_epoch().count();
+        if (fileError) {
+            continue;
+        }
+
+        auto cached = known.find(entry.path);
+        if (cached != known.end() && entries[cached->second].size == entry.size &&
+            entries[cached->second].modified == entry.modified) {
+            found.push_back(entries[cached->second]);
+            stats.cached++;
+        } else {
+            changed.push_back(found.size());
+            found.push_back(entry);
+        }
+    }
+    // Entries the walk did not reach may still be there
+    bool complete = !error;
+    if (!complete) {
+        printf("Library: Error - Stopped listing %s: %s\n", root.string().c_str(), error.message().c_str());
+    }
+    stats.walkMs = millisSince(start);
+
+    // Read the rest on a pool of threads, each taking the next file left
+    Clock::time_point scanStart = Clock::now();
+    int count = threads > 0 ? threads : (int)std::max(1u, std::thread::hardware_concurrency());
+    count = (int)std::min<size_t>(count, changed.size());
+    std::atomic<size_t> next(0);
+    std::atomic<uint64_t> bytesRead(0);
+    auto work = [&]() {
+        std::vector<uint8_t> buffer;
+        uint64_t bytes = 0;
+        size_t index;
+        while ((index = next++) < changed.size()) {
+            scanFile(found[changed[index]], buffer, bytes);
+        }
+        bytesRead += bytes;
+    };
+    std::vector<std::thread> pool;
+    for (int i = 1; i < count; i++) {
+        pool.emplace_back(work);
+    }
+    if (count > 0) {
+        work();
+    }
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+    stats.scanMs = millisSince(scanStart);
+
+    std::sort(found.begin(), found.end(),
+              [](const Entry& a, const Entry& b) { return a.path < b.path; });
+
+    // Entries under other directories stay in the index, those under this
+    // one that were not found are gone after a complete walk
+    std::unordered_set<std::string> foundPaths;
+    for (const Entry& entry : found) {
+        foundPaths.insert(entry.path);
+    }
+    std::string prefix = root.string() + (char)fs::path::preferred_separator;
+    std::vector<Entry> merged;
+    for (const Entry& entry : entries) {
+        if (entry.path.compare(0, prefix.size(), prefix) != 0) {
+            merged.push_back(entry);
+        } else if (!foundPaths.count(entry.path)) {
+            if (complete) {
+                stats.removed++;
+            } else {
+                merged.push_back(entry);
+            }
+        }
+    }
+    merged.insert(merged.end(), found.begin(), found.end());
+    entries.swap(merged);
+
+    stats.files = found.size();
+    stats.scanned = changed.size();
+    stats.bytesRead = bytesRead;
+    stats.threads = count;
+    if (complete && (stats.scanned > 0 || stats.removed > 0)) {
+        if (!saveIndex()) {
+            printf("Library: Error - Could not save index to %s\n", indexFile.c_str());
+        }
+    }
+    stats.totalMs = millisSince(start);
+    return true;
+}
+
+void ROMLibrary::scanFile(Entry& entry, std::vector<uint8_t>& buffer, uint64_t& bytesRead)
+{
+    entry.valid = false;
+    entry.mapper = 0;
+    entry.prgPages = 0;
+    entry.chrPages = 0;
+    entry.flags = 0;
+    entry.prgHash = 0;
+    entry.chrHash = 0;
+
+    std::ifstream file(entry.path, std::ios::binary);
+    uint8_t header[16];
+    if (!file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+        return;
+    }
+    bytesRead += sizeof(header);
+
+    WarpNES::NESHeader info;
+    bool ines2 = false;
+    if (!WarpNES::readNESHeader(header, info, &ines2)) {
+        return;
+    }
+    entry.mapper = info.mapper;
+    entry.prgPages = info.prgROMPages;
+    entry.chrPages = info.chrROMPages;
+    entry.flags = (info.mirroring ? FLAG_VERTICAL : 0) | (info.battery ? FLAG_BATTERY : 0) |
+                  (info.trainer ? FLAG_TRAINER : 0) | (ines2 ? FLAG_INES2 : 0);
+
+    size_t prgSize = (size_t)info.prgROMPages * 16384;
+    size_t chrSize = (size_t)info.chrROMPages * 8192;
+    if (prgSize == 0 || sizeof(header) + (info.trainer ? 512 : 0) + prgSize + chrSize > entry.size) {
+        return;
+    }
+    if (info.trainer) {
+        file.seekg(512, std::ios::cur);
+    }
+
+    buffer.resize(std::max(prgSize, chrSize));
+    if (!file.read(reinterpret_cast<char*>(buffer.data()), prgSize)) {
+        return;
+    }
+    entry.prgHash = checksum(buffer.data(), prgSize);
+    if (chrSize > 0) {
+        if (!file.read(reinterpret_cast<char*>(buffer.data()), chrSize)) {
+            return;
+        }
+        entry.chrHash = checksum(buffer.data(), chrSize);
+    }
+    bytesRead += prgSize + chrSize;
+    entry.valid = true;
+}
+
+bool ROMLibrary::loadIndex()
+{
+    std::ifstream file(indexFile, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::streamoff fileSize = file.tellg();
+    if (fileSize <= 0) {
+        return false;
+    }
+    std::vector<uint8_t> data((size_t)fileSize);
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(data.data()), data.size())) {
+        return false;
+    }
+
+    size_t offset = sizeof(INDEX_MAGIC);
+    uint32_t version, count;
+    if (data.size() < offset || memcmp(data.data(), INDEX_MAGIC, offset) != 0 ||
+        !getValue(data, offset, version) || version != INDEX_VERSION ||
+        !getValue(data, offset, count)) {
+        return false;
+    }
+
+    std::vector<Entry> loaded;
+    loaded.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        Entry entry;
+        uint16_t length;
+        uint8_t valid;
+        if (!getValue(data, offset, length) || data.size() - offset < length) {
+            return false;
+        }
+        entry.path.assign(reinterpret_cast<const char*>(&data[offset]), length);
+        offset += length;
+        if (!getValue(data, offset, entry.size) || !getValue(data, offset, entry.modified) ||
+            !getValue(data, offset, valid) || !getValue(data, offset, entry.mapper) ||
+            !getValue(data, offset, entry.prgPages) || !getValue(data, offset, entry.chrPages) ||
+            !getValue(data, offset, entry.flags) || !getValue(data, offset, entry.prgHash) ||
+            !getValue(data, offset, entry.chrHash)) {
+            return false;
+        }
+        entry.valid = valid != 0;
+        loaded.push_back(entry);
+    }
+    entries.swap(loaded);
+    return true;
+}
+
+bool ROMLibrary::saveIndex() const
+{
+    std::vector<uint8_t> data(INDEX_MAGIC, INDEX_MAGIC + sizeof(INDEX_MAGIC));
+    putValue(data, INDEX_VERSION);
+    uint32_t count = 0;
+    putValue(data, count);
+    for (const Entry& entry : entries) {
+        if (entry.path.size() > 0xFFFF) {
+            continue;
+        }
+        putValue(data, (uint16_t)entry.path.size());
+        data.insert(data.end(), entry.path.begin(), entry.path.end());
+        putValue(data, entry.size);
+        putValue(data, entry.modified);
+        putValue(data, (uint8_t)(entry.valid ? 1 : 0));
+        putValue(data, entry.mapper);
+        putValue(data, entry.prgPages);
+        putValue(data, entry.chrPages);
+        putValue(data, entry.flags);
+        putValue(data, entry.prgHash);
+        putValue(data, entry.chrHash);
+        count++;
+    }
+    memcpy(&data[sizeof(INDEX_MAGIC) + sizeof(INDEX_VERSION)], &count, sizeof(count));
+
+    // Written the same way as battery files, a crash leaves the old index
+    return writeFileAtomically(indexFile, data.data(), data.size());
+}
+
+const std::vector<ROMLibrary::Entry>& ROMLibrary::getEntries() const
+{
+    return found;
+}
+
+ROMLibrary::Stats ROMLibrary::getStats() const
+{
+    return stats;
+}
+
+void ROMLibrary::benchmark(const std::string& directory)
+{
+    const char* benchmarkIndex = "romlibrary_benchmark.idx";
+    std::remove(benchmarkIndex);
+
+    ROMLibrary cold(benchmarkIndex);
+    if (!cold.scan(directory)) {
+        printf("Library: Error - Could not read %s\n", directory.c_str());
+        return;
+    }
+    printf("Without an index:\n  ");
+    cold.getStats().print();
+
+    ROMLibrary warm(benchmarkIndex);
+    warm.scan(directory);
+    printf("With the index:\n  ");
+    warm.getStats().print();
+
+    std::remove(benchmarkIndex);
+}
+
+void ROMLibrary::Stats::print() const
+{
+    printf("Library: %zu ROMs, %zu from index, %zu read (%.1fMB) on %d threads, %zu removed, "
+           "%.1fms (list %.1fms, read %.1fms)\n",
+           files, cached, scanned, bytesRead / (1024.0 * 1024.0), threads, removed,
+           totalMs, walkMs, scanMs);
+}
@@ -0,0 +1,100 @@
+#ifndef ROM_LIBRARY_HPP
+#define ROM_LIBRARY_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * An index of the iNES ROMs in a directory and its subdirectories.
+ *
+ * Scanning reads the header of each ROM and hashes its PRG-ROM and
+ * CHR-ROM on a pool of threads. The results are kept in an index file,
+ * so the next scan only reads the ROMs that were added, or whose size or
+ * modification time changed, and a large library opens at once.
+ */
+class ROMLibrary {
+public:
+    /**
+     * A ROM file in the library.
+     */
+    struct Entry {
+        std::string path;
+        uint64_t size;
+        int64_t modified;           /**< Modification time, only compared for equality */
+        bool valid;                 /**< The file has an iNES header and all of its ROM */
+        uint8_t mapper;
+        uint8_t prgPages;           /**< 16KB PRG-ROM pages */
+        uint8_t chrPages;           /**< 8KB CHR-ROM pages, 0 for CHR-RAM */
+        uint8_t flags;              /**< FLAG_* */
+        uint32_t prgHash;           /**< FNV-1a of the PRG-ROM */
+        uint32_t chrHash;           /**< FNV-1a of the CHR-ROM, 0 without one */
+
+        std::string getName() const;
+    };
+
+    static const uint8_t FLAG_VERTICAL = 0x01;
+    static const uint8_t FLAG_BATTERY = 0x02;
+    static const uint8_t FLAG_TRAINER = 0x04;
+    static const uint8_t FLAG_INES2 = 0x08;
+
+    /**
+     * Counters of the last scan.
+     */
+    struct Stats {
+        size_t files;               /**< ROM files found */
+        size_t cached;              /**< Files taken from the index unread */
+        size_t scanned;             /**< Files read and hashed */
+        size_t removed;             /**< Index entries of files that are gone */
+        uint64_t bytesRead;
+        int threads;
+        double totalMs;
+        double walkMs;              /**< Time to list the directory */
+        double scanMs;              /**< Time to read the changed files */
+
+        /**
+         * Print the stats as a single line.
+         */
+        void print() const;
+    };
+
+    /**
+     * @param indexFile Where the index is kept between runs
+     */
+    ROMLibrary(const std::string& indexFile);
+
+    /**
+     * Index a directory, reading only new and changed ROMs, and save the
+     * index if anything changed. If listing stops partway, the ROMs it
+     * reached are found but the index is neither pruned nor saved.
+     * @param threads Threads reading ROMs, 0 for one per CPU
+     * @return false if the directory can not be listed
+     */
+    bool scan(const std::string& directory, int threads = 0);
+
+    /**
+     * Get the ROMs found by the last scan, sorted by path.
+     */
+    const std::vector<Entry>& getEntries() const;
+
+    Stats getStats() const;
+
+    /**
+     * Scan a directory with no index, then again with the index it left,
+     * and print both.
+     */
+    static void benchmark(const std::string& directory);
+
+private:
+    std::string indexFile;
+    std::vector<Entry> entries;     /**< The whole index, of every directory scanned */
+    std::vector<Entry> found;       /**< The last scan */
+    bool indexLoaded;
+    Stats stats;
+
+    bool loadIndex();
+    bool saveIndex() const;
+    static void scanFile(Entry& entry, std::vector<uint8_t>& buffer, uint64_t& bytesRead);
+};
+
+#endif // ROM_LIBRARY_HPP
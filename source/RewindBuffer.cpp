@@ -0,0 +1,421 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "RewindBuffer.hpp"
+#include "Emulation/WarpNES.hpp"
+
+// The packed format is a series of sequences, each a token byte holding
+// the literal count in the high nibble and the match length less
+// MIN_MATCH in the low one (15 meaning more length bytes follow), the
+// literals, then a 16-bit offset back to the match. The last sequence
+// only has literals.
+static const int HASH_BITS = 12;
+static const size_t MIN_MATCH = 4;
+static const size_t MAX_OFFSET = 65535;
+
+static uint64_t nowMicros()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t read32(const uint8_t* data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static uint64_t read64(const uint8_t* data)
+{
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+/**
+ * Count the bytes two strings have in common, up to a limit.
+ */
+static size_t countMatching(const uint8_t* a, const uint8_t* b, size_t limit)
+{
+    size_t length = 0;
+    while (length + 8 <= limit && read64(a + length) == read64(b + length)) {
+        length += 8;
+    }
+    while (length < limit && a[length] == b[length]) {
+        length++;
+    }
+    return length;
+}
+
+/**
+ * XOR a buffer with another in place.
+ */
+static void xorBytes(uint8_t* data, const uint8_t* with, size_t length)
+{
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t value = read64(data + i) ^ read64(with + i);
+        memcpy(data + i, &value, sizeof(value));
+    }
+    for (; i < length; i++) {
+        data[i] ^= with[i];
+    }
+}
+
+static uint32_t hashSequence(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static uint8_t* writeLength(uint8_t* out, size_t length)
+{
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = (uint8_t)length;
+    return out;
+}
+
+static bool readLength(const uint8_t*& in, const uint8_t* end, size_t& length)
+{
+    uint8_t byte;
+    do {
+        if (in == end) {
+            return false;
+        }
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+/**
+ * Write a sequence, or the final literals when the match length is 0.
+ */
+static uint8_t* writeSequence(uint8_t* out, const uint8_t* literals, size_t literalLength,
+                              size_t offset, size_t matchLength)
+{
+    size_t matchCode = matchLength > 0 ? matchLength - MIN_MATCH : 0;
+    *out++ = (uint8_t)((std::min<size_t>(literalLength, 15) << 4) | std::min<size_t>(matchCode, 15));
+    if (literalLength >= 15) {
+        out = writeLength(out, literalLength - 15);
+    }
+    memcpy(out, literals, literalLength);
+    out += literalLength;
+
+    if (matchLength == 0) {
+        return out;
+    }
+    *out++ = (uint8_t)(offset & 0xFF);
+    *out++ = (uint8_t)(offset >> 8);
+    if (matchCode >= 15) {
+        out = writeLength(out, matchCode - 15);
+    }
+    return out;
+}
+
+static bool unpackBlock(const uint8_t* in, size_t inLength, uint8_t* out, size_t outLength)
+{
+    const uint8_t* end = in + inLength;
+    size_t position = 0;
+
+    while (in < end) {
+        uint8_t token = *in++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(in, end, literalLength)) {
+            return false;
+        }
+        if (literalLength > (size_t)(end - in) || literalLength > outLength - position) {
+            return false;
+        }
+        memcpy(out + position, in, literalLength);
+        in += literalLength;
+        position += literalLength;
+        if (in == end) {
+            break;
+        }
+
+        if (end - in < 2) {
+            return false;
+        }
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        size_t matchLength = (token & 15) + MIN_MATCH;
+        if ((token & 15) == 15 && !readLength(in, end, matchLength)) {
+            return false;
+        }
+        if (offset == 0 || offset > position || matchLength > outLength - position) {
+            return false;
+        }
+
+        // A match may overlap the bytes it writes, a run of one byte
+        // being the common case in a delta
+        uint8_t* to = out + position;
+        const uint8_t* from = to - offset;
+        if (offset >= matchLength) {
+            memcpy(to, from, matchLength);
+        } else if (offset == 1) {
+            memset(to, *from, matchLength);
+        } else {
+            for (size_t i = 0; i < matchLength; i++) {
+                to[i] = from[i];
+            }
+        }
+        position += matchLength;
+    }
+
+    return position == outLength;
+}
+
+RewindBuffer::RewindBuffer() :
+    capacity(64 * 1024 * 1024), keyframeInterval(60), framesSinceKeyframe(0),
+    memoryUsed(0), stateSize(0), keyframeValid(false), hashTable(1 << HASH_BITS)
+{
+    resetStats();
+}
+
+void RewindBuffer::setCapacity(size_t bytes)
+{
+    capacity = bytes;
+    while (memoryUsed > capacity && !entries.empty()) {
+        dropOldest();
+    }
+}
+
+void RewindBuffer::setKeyframeInterval(int frames)
+{
+    keyframeInterval = std::max(1, frames);
+}
+
+void RewindBuffer::clear()
+{
+    entries.clear();
+    memoryUsed = 0;
+    framesSinceKeyframe = 0;
+    keyframeValid = false;
+}
+
+void RewindBuffer::push(const WarpNES& engine)
+{
+    uint64_t start = nowMicros();
+
+    size_t size = engine.getStateSize();
+    if (size != stateSize) {
+        clear();
+        stateSize = size;
+        state.resize(size);
+        keyframe.resize(size);
+    }
+    if (size == 0 || engine.saveState(state.data(), size) != size) {
+        return;
+    }
+
+    bool isKeyframe = !keyframeValid || framesSinceKeyframe + 1 >= keyframeInterval;
+    if (isKeyframe) {
+        memcpy(keyframe.data(), state.data(), size);
+        keyframeValid = true;
+        framesSinceKeyframe = 0;
+    } else {
+        xorBytes(state.data(), keyframe.data(), size);
+        framesSinceKeyframe++;
+    }
+
+    size_t length = pack(state.data(), size);
+    Entry entry;
+    entry.keyframe = isKeyframe;
+    entry.data.assign(packed.begin(), packed.begin() + length);
+    entries.push_back(std::move(entry));
+    memoryUsed += length + sizeof(Entry);
+
+    while (memoryUsed > capacity && !entries.empty()) {
+        dropOldest();
+    }
+
+    uint64_t us = nowMicros() - start;
+    if (isKeyframe) {
+        statKeyframes++;
+        statKeyframeBytes += length;
+    } else {
+        statDeltas++;
+        statDeltaBytes += length;
+    }
+    statEncodeTotalUs += us;
+    statEncodeMaxUs = std::max(statEncodeMaxUs, us);
+}
+
+bool RewindBuffer::rewind(WarpNES& engine)
+{
+    if (entries.size() < 2) {
+        return false;
+    }
+    uint64_t start = nowMicros();
+
+    // The newest state is the frame on screen and the one before it is
+    // about to be run again, so load the one before that
+    bool more = entries.size() > 2;
+    popNewest();
+    if (more) {
+        popNewest();
+    }
+    if (!unpackNewest() || !engine.loadState(state.data(), stateSize)) {
+        clear();
+        return false;
+    }
+
+    framesSinceKeyframe = 0;
+    for (auto it = entries.rbegin(); it != entries.rend() && !it->keyframe; ++it) {
+        framesSinceKeyframe++;
+    }
+
+    statRewinds++;
+    statDecodeTotalUs += nowMicros() - start;
+    return more;
+}
+
+size_t RewindBuffer::getFrameCount() const
+{
+    return entries.size();
+}
+
+void RewindBuffer::popNewest()
+{
+    if (entries.back().keyframe) {
+        keyframeValid = false;
+    }
+    memoryUsed -= entries.back().data.size() + sizeof(Entry);
+    entries.pop_back();
+}
+
+void RewindBuffer::dropOldest()
+{
+    // Frames after the keyframe are no use without it
+    do {
+        memoryUsed -= entries.front().data.size() + sizeof(Entry);
+        entries.pop_front();
+    } while (!entries.empty() && !entries.front().keyframe);
+
+    if (entries.empty()) {
+        keyframeValid = false;
+        framesSinceKeyframe = 0;
+    }
+}
+
+bool RewindBuffer::unpack(const Entry& entry, std::vector<uint8_t>& output)
+{
+    return unpackBlock(entry.data.data(), entry.data.size(), output.data(), stateSize);
+}
+
+bool RewindBuffer::unpackNewest()
+{
+    const Entry& newest = entries.back();
+    if (newest.keyframe) {
+        if (!unpack(newest, keyframe)) {
+            return false;
+        }
+        keyframeValid = true;
+        memcpy(state.data(), keyframe.data(), stateSize);
+        return true;
+    }
+
+    if (!keyframeValid) {
+        auto it = entries.rbegin();
+        while (!it->keyframe) {
+            ++it;
+        }
+        if (!unpack(*it, keyframe)) {
+            return false;
+        }
+        keyframeValid = true;
+    }
+    if (!unpack(newest, state)) {
+        return false;
+    }
+    xorBytes(state.data(), keyframe.data(), stateSize);
+    return true;
+}
+
+size_t RewindBuffer::pack(const uint8_t* input, size_t length)
+{
+    // Worst case is all literals
+    packed.resize(length + length / 255 + 16);
+    std::fill(hashTable.begin(), hashTable.end(), 0);
+
+    uint8_t* out = packed.data();
+    size_t anchor = 0;
+    size_t position = 0;
+    while (position + MIN_MATCH <= length) {
+        uint32_t sequence = read32(input + position);
+        uint32_t& slot = hashTable[hashSequence(sequence)];
+        size_t candidate = slot;    // Position + 1, 0 when empty
+        slot = (uint32_t)(position + 1);
+
+        if (candidate == 0 || position + 1 - candidate > MAX_OFFSET ||
+            read32(input + candidate - 1) != sequence) {
+            // Move faster through data that does not compress
+            position += 1 + ((position - anchor) >> 6);
+            continue;
+        }
+
+        size_t match = candidate - 1;
+        size_t matchLength = MIN_MATCH + countMatching(input + match + MIN_MATCH, input + position + MIN_MATCH,
+                                                       length - position - MIN_MATCH);
+        out = writeSequence(out, input + anchor, position - anchor, position - match, matchLength);
+        position += matchLength;
+        anchor = position;
+    }
+
+    out = writeSequence(out, input + anchor, length - anchor, 0, 0);
+    return out - packed.data();
+}
+
+RewindBuffer::Stats RewindBuffer::getStats() const
+{
+    Stats stats;
+    stats.frames = entries.size();
+    stats.memoryUsed = memoryUsed;
+    stats.capacity = capacity;
+    stats.stateSize = stateSize;
+    stats.keyframes = statKeyframes;
+    stats.deltas = statDeltas;
+    stats.keyframeAverage = statKeyframes ? (double)statKeyframeBytes / statKeyframes : 0.0;
+    stats.deltaAverage = statDeltas ? (double)statDeltaBytes / statDeltas : 0.0;
+    uint64_t pushed = statKeyframes + statDeltas;
+    stats.encodeAverageUs = pushed ? (double)statEncodeTotalUs / pushed : 0.0;
+    stats.encodeMaxUs = (double)statEncodeMaxUs;
+    stats.rewinds = statRewinds;
+    stats.decodeAverageUs = statRewinds ? (double)statDecodeTotalUs / statRewinds : 0.0;
+    return stats;
+}
+
+void RewindBuffer::resetStats()
+{
+    statKeyframes = 0;
+    statKeyframeBytes = 0;
+    statDeltas = 0;
+    statDeltaBytes = 0;
+    statEncodeTotalUs = 0;
+    statEncodeMaxUs = 0;
+    statRewinds = 0;
+    statDecodeTotalUs = 0;
+}
+
+double RewindBuffer::Stats::getBytesPerFrame() const
+{
+    uint64_t pushed = keyframes + deltas;
+    return pushed ? (keyframeAverage * keyframes + deltaAverage * deltas) / pushed : 0.0;
+}
+
+void RewindBuffer::Stats::print() const
+{
+    printf("Rewind: %zu frames in %.1fKB of %.1fKB, %.0f bytes/frame "
+           "(keyframes %.0f, deltas %.0f, state %zu), encode %.1fus avg %.1fus max, "
+           "%llu rewinds %.1fus avg\n",
+           frames, memoryUsed / 1024.0, capacity / 1024.0, getBytesPerFrame(),
+           keyframeAverage, deltaAverage, stateSize, encodeAverageUs, encodeMaxUs,
+           (unsigned long long)rewinds, decodeAverageUs);
+}
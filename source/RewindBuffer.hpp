@@ -0,0 +1,123 @@
+#ifndef REWIND_BUFFER_HPP
+#define REWIND_BUFFER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+class WarpNES;
+
+/**
+ * Keeps a save state of every frame so the SDL and GTK frontends can run
+ * the game backwards.
+ *
+ * Every keyframe interval a state is stored whole; the frames in between
+ * are stored as the XOR of their state with the keyframe's, which is zero
+ * wherever nothing changed. Both are packed with a small LZ77 codec in the
+ * style of LZ4, so a frame typically takes a few hundred bytes. When the
+ * buffer goes over its memory limit the oldest keyframe and the frames
+ * that depend on it are dropped together.
+ */
+class RewindBuffer {
+public:
+    /**
+     * Counters since the last reset.
+     */
+    struct Stats {
+        size_t frames;              /**< Frames in the buffer */
+        size_t memoryUsed;          /**< Bytes the buffer holds */
+        size_t capacity;            /**< Bytes the buffer may hold */
+        size_t stateSize;           /**< Bytes of an uncompressed state */
+        uint64_t keyframes;         /**< Keyframes stored */
+        uint64_t deltas;            /**< Delta frames stored */
+        double keyframeAverage;     /**< Average bytes of a stored keyframe */
+        double deltaAverage;        /**< Average bytes of a stored delta frame */
+        double encodeAverageUs;     /**< Average time to snapshot and pack a frame */
+        double encodeMaxUs;         /**< Longest time to snapshot and pack a frame */
+        uint64_t rewinds;           /**< Frames stepped back */
+        double decodeAverageUs;     /**< Average time to unpack and load a frame */
+
+        /**
+         * Average bytes stored per frame.
+         */
+        double getBytesPerFrame() const;
+
+        /**
+         * Print the stats as a single line.
+         */
+        void print() const;
+    };
+
+    RewindBuffer();
+
+    /**
+     * Set the memory the buffer may use, in bytes.
+     */
+    void setCapacity(size_t bytes);
+
+    /**
+     * Set the number of frames between keyframes.
+     */
+    void setKeyframeInterval(int frames);
+
+    /**
+     * Drop every stored frame.
+     */
+    void clear();
+
+    /**
+     * Store the engine's state after a frame.
+     */
+    void push(const WarpNES& engine);
+
+    /**
+     * Go back so that the next frame the engine runs is the one before the
+     * last one pushed. Running and pushing that frame as usual then shows
+     * the game one frame further back each time.
+     * @return false once the oldest frame is reached
+     */
+    bool rewind(WarpNES& engine);
+
+    size_t getFrameCount() const;
+
+    Stats getStats() const;
+
+    void resetStats();
+
+private:
+    struct Entry {
+        bool keyframe;
+        std::vector<uint8_t> data;
+    };
+
+    std::deque<Entry> entries;
+    size_t capacity;
+    int keyframeInterval;
+    int framesSinceKeyframe;
+    size_t memoryUsed;
+    size_t stateSize;
+
+    std::vector<uint8_t> state;     /**< The state being stored or loaded */
+    std::vector<uint8_t> keyframe;  /**< The newest keyframe, unpacked */
+    bool keyframeValid;             /**< Whether keyframe holds the newest stored keyframe */
+    std::vector<uint8_t> packed;
+    std::vector<uint32_t> hashTable;
+
+    uint64_t statKeyframes;
+    uint64_t statKeyframeBytes;
+    uint64_t statDeltas;
+    uint64_t statDeltaBytes;
+    uint64_t statEncodeTotalUs;
+    uint64_t statEncodeMaxUs;
+    uint64_t statRewinds;
+    uint64_t statDecodeTotalUs;
+
+    void popNewest();
+    void dropOldest();
+    bool unpack(const Entry& entry, std::vector<uint8_t>& output);
+    bool unpackNewest();
+    size_t pack(const uint8_t* input, size_t length);
+};
+
+#endif // REWIND_BUFFER_HPP
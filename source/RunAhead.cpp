@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "RunAhead.hpp"
+#include "Emulation/WarpNES.hpp"
+
+// Run-ahead past this hides more lag than games have and costs a frame each
+static const int MAX_FRAMES = 4;
+
+static uint64_t nowMicros()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+RunAhead::RunAhead() :
+    frames(0)
+{
+    resetStats();
+}
+
+void RunAhead::setFrames(int count)
+{
+    frames = std::min(std::max(count, 0), MAX_FRAMES);
+}
+
+int RunAhead::getFrames() const
+{
+    return frames;
+}
+
+void RunAhead::runFrame(WarpNES& engine)
+{
+    size_t size = engine.getStateSize();
+    if (frames == 0 || size == 0) {
+        engine.update();
+        return;
+    }
+    uint64_t start = nowMicros();
+
+    // The frame shown is the last one ahead, drawn only if the caller wants it
+    bool video = engine.getVideoOutput();
+    engine.setVideoOutput(false);
+    engine.update();
+
+    uint64_t saveStart = nowMicros();
+    state.resize(size);
+    if (engine.saveState(state.data(), size) != size) {
+        // Nothing to come back to, so the frames ahead can not be run
+        engine.setVideoOutput(video);
+        return;
+    }
+
+    uint64_t aheadStart = nowMicros();
+    engine.setAudioOutput(false);
+    for (int i = 1; i <= frames; i++) {
+        engine.setVideoOutput(video && i == frames);
+        engine.update();
+    }
+    engine.setAudioOutput(true);
+
+    uint64_t loadStart = nowMicros();
+    engine.loadState(state.data(), size);
+    engine.setVideoOutput(video);
+
+    uint64_t end = nowMicros();
+    statFrames++;
+    statTotalUs += end - start;
+    statMaxUs = std::max(statMaxUs, end - start);
+    statSaveUs += aheadStart - saveStart;
+    statAheadUs += loadStart - aheadStart;
+    statLoadUs += end - loadStart;
+}
+
+RunAhead::Stats RunAhead::getStats() const
+{
+    Stats stats;
+    stats.frames = frames;
+    stats.hostFrames = statFrames;
+    stats.averageUs = statFrames ? (double)statTotalUs / statFrames : 0.0;
+    stats.maxUs = (double)statMaxUs;
+    stats.saveAverageUs = statFrames ? (double)statSaveUs / statFrames : 0.0;
+    stats.aheadAverageUs = statFrames ? (double)statAheadUs / statFrames : 0.0;
+    stats.loadAverageUs = statFrames ? (double)statLoadUs / statFrames : 0.0;
+    return stats;
+}
+
+void RunAhead::resetStats()
+{
+    statFrames = 0;
+    statTotalUs = 0;
+    statMaxUs = 0;
+    statSaveUs = 0;
+    statAheadUs = 0;
+    statLoadUs = 0;
+}
+
+void RunAhead::Stats::print() const
+{
+    printf("Run-ahead: %d frames, %llu frames run, %.2fms avg %.2fms max per frame "
+           "(snapshot %.1fus, frames ahead %.2fms, restore %.1fus)\n",
+           frames, (unsigned long long)hostFrames, averageUs / 1000.0, maxUs / 1000.0,
+           saveAverageUs, aheadAverageUs / 1000.0, loadAverageUs);
+}
@@ -0,0 +1,70 @@
+#ifndef RUN_AHEAD_HPP
+#define RUN_AHEAD_HPP
+
+#include <cstdint>
+#include <vector>
+
+class WarpNES;
+
+/**
+ * Hides the frames of lag most games have between reading the controller
+ * and showing the result.
+ *
+ * Each frame runs the real frame with sound but without drawing, takes a
+ * snapshot, runs the frames ahead with the same input without sound,
+ * drawing only the last of them, and loads the snapshot again. What is on
+ * screen is then that many frames ahead of the game, while the sound, the
+ * save states and the rewind buffer all follow the real frame.
+ */
+class RunAhead {
+public:
+    /**
+     * Counters since the last reset.
+     */
+    struct Stats {
+        int frames;                 /**< Frames run ahead */
+        uint64_t hostFrames;        /**< Frames run */
+        double averageUs;           /**< Average time to run a frame and the frames ahead */
+        double maxUs;               /**< Longest time to run a frame and the frames ahead */
+        double saveAverageUs;       /**< Average time to snapshot the real frame */
+        double aheadAverageUs;      /**< Average time to run the frames ahead */
+        double loadAverageUs;       /**< Average time to load the snapshot back */
+
+        /**
+         * Print the stats as a single line.
+         */
+        void print() const;
+    };
+
+    RunAhead();
+
+    /**
+     * Set the number of frames run ahead, 0 to turn run-ahead off.
+     */
+    void setFrames(int count);
+
+    int getFrames() const;
+
+    /**
+     * Run one frame of the engine, leaving it on the real frame and its
+     * frame buffer showing the frame furthest ahead.
+     */
+    void runFrame(WarpNES& engine);
+
+    Stats getStats() const;
+
+    void resetStats();
+
+private:
+    int frames;
+    std::vector<uint8_t> state;
+
+    uint64_t statFrames;
+    uint64_t statTotalUs;
+    uint64_t statMaxUs;
+    uint64_t statSaveUs;
+    uint64_t statAheadUs;
+    uint64_t statLoadUs;
+};
+
+#endif // RUN_AHEAD_HPP
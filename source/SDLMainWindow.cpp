@@ -1,5 +1,12 @@
+#include <atomic>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <SDL2/SDL.h>
 
@@ -8,20 +15,92 @@
 #include "Configuration.hpp"
 #include "Constants.hpp"
 // Include the generated ROM header
-#include "SDLCacheScaling.hpp"
+#include "FilterChain.hpp"
+#include "FramePacer.hpp"
+#include "InputMovie.hpp"
+#include "Netplay.hpp"
+#include "QualityGovernor.hpp"
+#include "RewindBuffer.hpp"
+#include "RunAhead.hpp"
+#include "SRAMPersister.hpp"
+#include "StateFileQueue.hpp"
+#include "TripleBuffer.hpp"
+#include "VideoFilters.hpp"
+
+/**
+ * A finished frame handed from the emulation thread to the render thread.
+ */
+struct VideoFrame {
+    uint16_t pixels[RENDER_WIDTH * RENDER_HEIGHT];
+    uint64_t number;        /**< PPU frame number */
+    DirtyRows dirtyRows;    /**< Rows that differ from the PPU frame before it */
+};
 
-static SDLScalingCache* scalingCache = nullptr;
 static SDL_Window* window;
 static SDL_Renderer* renderer;
 static SDL_Texture* texture;
 static SDL_Texture* scanlineTexture;
 static WarpNES* smbEngine = nullptr;
-static uint32_t renderBuffer[RENDER_WIDTH * RENDER_HEIGHT];
-static uint16_t renderBuffer16[RENDER_WIDTH * RENDER_HEIGHT];  // ADD: 16-bit buffer
-static uint32_t filteredBuffer[RENDER_WIDTH * RENDER_HEIGHT];
-static uint32_t prevFrameBuffer[RENDER_WIDTH * RENDER_HEIGHT];
 static bool msaaEnabled = false;
 
+// Optional filter chain between the PPU and the texture, empty unless
+// video.filter_chain is set
+static FilterChain filterChain;
+static std::string filterSpec;
+static VideoFilters* videoFilters = nullptr;
+
+// Emulation runs on its own thread and publishes frames through the triple
+// buffer. The mutex is held by the emulation thread while it runs a frame
+// and by the main thread while it feeds input or saves/loads states.
+static TripleBuffer<VideoFrame> frames;
+static std::mutex engineMutex;
+static std::atomic<bool> emulationRunning(false);
+static std::atomic<uint64_t> emulationTimeUs(0);
+static std::atomic<uint64_t> emulatedFrames(0);
+static std::atomic<uint64_t> skippedFrames(0);
+
+// Lowers the video quality when emulating and presenting take longer than
+// the frame period, which the two threads share on small hosts. The
+// emulation thread only calls shouldRender(), the rest is the main thread's.
+static QualityGovernor governor;
+
+// Schedules the emulation thread's frames and the APU's resampling ratio.
+// Its stats are read under engineMutex.
+static FramePacer pacer;
+
+// Snapshots of past frames, stepped back through while the rewind key is
+// held. Both are used under engineMutex.
+static RewindBuffer rewindBuffer;
+static bool rewinding = false;
+
+// Runs frames ahead of the real one to take out the game's input lag,
+// used under engineMutex.
+static RunAhead runAhead;
+
+// Input movie given on the command line, recorded or played back from
+// the first frame. Used under engineMutex.
+static InputMovie movie;
+static std::string movieFile;
+static bool movieRecording = false;
+
+// Saves the battery file in the background while the game runs, used
+// under engineMutex.
+static SRAMPersister batteryPersister;
+
+// Reads and writes the F5-F8 save states in the background. States read
+// are loaded at the start of the emulation thread's next frame.
+static StateFileQueue stateFiles;
+
+// Netplay session given on the command line, used under engineMutex.
+// While it runs only the buttons may change the game, so resetting,
+// rewinding and loading states are turned off.
+static NetplaySession netplay;
+static UDPTransport netplayTransport;
+static int netplayPlayer = -1;
+static int netplayLocalPort = 0;
+static std::string netplayHost;
+static int netplayPeerPort = 0;
+
 // Internal controller state
 struct InternalController {
     bool buttonA = false;
@@ -204,27 +283,6 @@ struct InternalController {
 
 static InternalController controller;
 
-// ADD: Conversion function from 16-bit RGB565 to 32-bit ARGB8888
-static void convertRGB565ToARGB8888(const uint16_t* src, uint32_t* dst, int width, int height)
-{
-    for (int i = 0; i < width * height; i++) {
-        uint16_t pixel16 = src[i];
-        
-        // Extract RGB565 components
-        uint8_t r = (pixel16 >> 11) & 0x1F;  // 5 bits
-        uint8_t g = (pixel16 >> 5) & 0x3F;   // 6 bits  
-        uint8_t b = pixel16 & 0x1F;          // 5 bits
-        
-        // Scale to 8-bit (same as DOS version)
-        r = (r << 3) | (r >> 2);  // 5-bit to 8-bit
-        g = (g << 2) | (g >> 4);  // 6-bit to 8-bit  
-        b = (b << 3) | (b >> 2);  // 5-bit to 8-bit
-        
-        // Pack into ARGB8888 format
-        dst[i] = (0xFF << 24) | (r << 16) | (g << 8) | b;
-    }
-}
-
 /**
  * SDL Audio callback function.
  */
@@ -278,7 +336,46 @@ static bool initialize()
         return false;
     }
 
-    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, RENDER_WIDTH, RENDER_HEIGHT);
+    // Set up the filter chain, falling back to unfiltered frames if it is
+    // invalid. The denoiser goes first so it sees the PPU's own pixels
+    filterSpec = Configuration::getFilterChain();
+    if (Configuration::getHqdn3dEnabled())
+    {
+        filterSpec = filterSpec.empty() ? "hqdn3d" : "hqdn3d," + filterSpec;
+    }
+    if (!filterSpec.empty())
+    {
+        videoFilters = new VideoFilters(Configuration::getFilterThreads());
+        videoFilters->setHQDN3DStrength(Configuration::getHqdn3dSpatialStrength(),
+                                        Configuration::getHqdn3dTemporalStrength());
+        videoFilters->registerStages();
+        filterChain.setTargetSize(RENDER_WIDTH * Configuration::getRenderScale(),
+                                  RENDER_HEIGHT * Configuration::getRenderScale());
+        if (!filterChain.setStages(filterSpec) ||
+            !filterChain.prepare(RENDER_WIDTH, RENDER_HEIGHT, PixelFormat::RGB565))
+        {
+            filterChain.clear();
+        }
+        else
+        {
+            printf("Video filters: %s (%dx%d)\n", filterChain.getDescription().c_str(),
+                   filterChain.getOutputWidth(), filterChain.getOutputHeight());
+        }
+    }
+
+    // The PPU renders RGB565, so unfiltered frames go into the texture
+    // without conversion
+    if (filterChain.isEmpty())
+    {
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB565, SDL_TEXTUREACCESS_STREAMING, RENDER_WIDTH, RENDER_HEIGHT);
+    }
+    else
+    {
+        texture = SDL_CreateTexture(renderer,
+                                    filterChain.getOutputFormat() == PixelFormat::ARGB8888 ? SDL_PIXELFORMAT_ARGB8888 : SDL_PIXELFORMAT_RGB565,
+                                    SDL_TEXTUREACCESS_STREAMING,
+                                    filterChain.getOutputWidth(), filterChain.getOutputHeight());
+    }
     if (texture == nullptr)
     {
         std::cout << "SDL_CreateTexture() failed during initialize(): " << SDL_GetError() << std::endl;
@@ -303,9 +400,6 @@ static bool initialize()
         SDL_PauseAudio(0);
     }
 
-    scalingCache = new SDLScalingCache(renderer);
-    scalingCache->initialize();
-
     // Initialize the internal controller
     controller.initializeController();
 
@@ -321,10 +415,9 @@ static void shutdown()
     // Cleanup internal controller
     controller.cleanup();
 
-    if (scalingCache) {
-        delete scalingCache;
-        scalingCache = nullptr;
-    }
+    filterChain.clear();
+    delete videoFilters;
+    videoFilters = nullptr;
 
     SDL_CloseAudio();
 
@@ -336,6 +429,132 @@ static void shutdown()
     SDL_Quit();
 }
 
+/**
+ * Emulation thread: runs and paces the engine, publishing each frame.
+ */
+static void emulationLoop(WarpNES* engine)
+{
+    pacer.reset();
+
+    while (emulationRunning)
+    {
+        pacer.waitForFrame();
+
+        Uint64 start = SDL_GetPerformanceCounter();
+        bool rendered;
+        {
+            std::lock_guard<std::mutex> lock(engineMutex);
+            pacer.beginFrame();
+            engine->setAudioRateAdjustment(pacer.getRateAdjustment());
+
+            // The PPU renders straight into the frame being published, and
+            // not at all for the frames the governor skips
+            VideoFrame& frame = frames.getWriteBuffer();
+            engine->setFrameOutputBuffer(frame.pixels);
+            engine->setVideoOutput(governor.shouldRender());
+
+            if (netplay.isActive())
+            {
+                // Nothing new to show while waiting for the other player
+                if (!netplay.runFrame(*engine, NetplaySession::captureButtons(*engine)))
+                {
+                    continue;
+                }
+            }
+            else
+            {
+                // Going back would take a movie out of step with its input
+                if (rewinding && movie.getMode() == InputMovie::MOVIE_IDLE)
+                {
+                    rewindBuffer.rewind(*engine);
+                }
+                stateFiles.applyLoads(*engine);
+                movie.beginFrame(*engine);
+
+                runAhead.runFrame(*engine);
+                if (Configuration::getRewindEnabled())
+                {
+                    rewindBuffer.push(*engine);
+                }
+            }
+            batteryPersister.frame(*engine);
+            emulatedFrames++;
+            rendered = engine->getVideoOutput();
+            if (rendered)
+            {
+                frame.number = engine->getFrameNumber();
+                frame.dirtyRows = engine->getDirtyRows();
+            }
+        }
+        if (rendered)
+        {
+            frames.publish();
+        }
+        else
+        {
+            skippedFrames++;
+        }
+        emulationTimeUs += (SDL_GetPerformanceCounter() - start) * 1000000 / SDL_GetPerformanceFrequency();
+    }
+}
+
+/**
+ * Swap the filter chain between the configured stages and cheap ones with
+ * the same output, for the quality governor.
+ */
+static void setFiltersReduced(bool reduced)
+{
+    std::string spec = reduced ? VideoFilters::getReducedChain(filterSpec) : filterSpec;
+    if (!filterChain.setStages(spec) ||
+        !filterChain.prepare(RENDER_WIDTH, RENDER_HEIGHT, PixelFormat::RGB565))
+    {
+        printf("Could not set up video filters \"%s\"\n", spec.c_str());
+        filterChain.setStages(filterSpec);
+    }
+}
+
+/**
+ * Set up the frame pacer from the configuration.
+ */
+static void initPacer(WarpNES& engine)
+{
+    FramePacer::Mode mode;
+    if (!FramePacer::parseMode(Configuration::getFramePacing(), mode))
+    {
+        printf("Unknown frame pacing '%s', using timer\n", Configuration::getFramePacing().c_str());
+        mode = FramePacer::TIMER;
+    }
+
+    if (Configuration::getAudioEnabled())
+    {
+        int frequency = Configuration::getAudioFrequency();
+        int target = Configuration::getAudioTargetLatency() * frequency / MS_PER_SEC;
+        pacer.setAudioQueue([&engine]() { return engine.getBufferedAudioSamples(); }, frequency, target);
+        pacer.setMaxRateAdjustment(Configuration::getAudioMaxRateAdjustment());
+    }
+    else if (mode == FramePacer::AUDIO)
+    {
+        printf("Audio is disabled, pacing frames with the timer\n");
+        mode = FramePacer::TIMER;
+    }
+
+    SDL_DisplayMode displayMode;
+    if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window), &displayMode) == 0)
+    {
+        pacer.setRefreshRate(displayMode.refresh_rate);
+    }
+    pacer.setFrameRate(Configuration::getFrameRate());
+    if (mode == FramePacer::DISPLAY && !pacer.canPaceToDisplay())
+    {
+        printf("Display refresh rate is not close to %dHz, pacing frames with the timer\n",
+               Configuration::getFrameRate());
+        mode = FramePacer::TIMER;
+    }
+    pacer.setMode(mode);
+
+    printf("Pacing frames to %s (%.2fHz)\n", FramePacer::getModeName(mode), 1000000.0 / pacer.getPeriod());
+}
+
 // UPDATED: mainLoop function with 16-bit bridge
 static void mainLoop(const char* romFilename)
 {
@@ -351,6 +570,30 @@ static void mainLoop(const char* romFilename)
 
     printf("ROM loaded successfully\n");
     engine.reset();
+    batteryPersister.attach(engine);
+
+    if (netplayPlayer >= 0)
+    {
+        if (!netplayTransport.open(netplayLocalPort, netplayHost, netplayPeerPort))
+        {
+            return;
+        }
+        netplay.start(&netplayTransport, netplayPlayer, Configuration::getNetplayInputDelay());
+        printf("Netplay: player %d, port %d, sending to %s:%d\n", netplayPlayer + 1,
+               netplayLocalPort, netplayHost.c_str(), netplayPeerPort);
+    }
+
+    if (!movieFile.empty())
+    {
+        if (movieRecording)
+        {
+            movie.startRecording(engine);
+        }
+        else if (movie.load(movieFile))
+        {
+            movie.startPlayback(engine);
+        }
+    }
 
     // Get the controller from the engine (like in your working SDLMain.cpp)
     Controller& controller1 = engine.getController1();
@@ -367,11 +610,30 @@ static void mainLoop(const char* romFilename)
     }
 
     bool running = true;
-    int progStartTime = SDL_GetTicks();
-    int frame = 0;
+
+    int audioStatsInterval = Configuration::getAudioStatsInterval() * MS_PER_SEC;
+    int audioStatsTime = SDL_GetTicks();
+    uint64_t presentedFrames = 0;
+    uint64_t unchangedFrames = 0;
+    uint64_t presentTimeUs = 0;
+
+    governor.setEnabled(Configuration::getQualityGovernorEnabled());
+    governor.setMaxFrameSkip(Configuration::getMaxFrameSkip());
+    governor.setCanReduceFilters(!filterChain.isEmpty() && VideoFilters::getReducedChain(filterSpec) != filterSpec);
+    governor.setParallel(SDL_GetCPUCount() > 1);
+    bool filtersReduced = false;
+    uint64_t governorFrames = 0;
+    uint64_t governorTimeUs = 0;
+
+    // Only the rows that changed since the frame in the texture are
+    // filtered and uploaded, and identical frames are not presented again
+    // unless the window needs repainting
+    uint64_t textureFrame = 0;
+    bool repaint = true;
+    std::vector<RowBand> changedRows;
+    std::vector<RowBand> textureRows;
     
     // Key state tracking for toggle functions
-    static bool optimizedScalingKeyPressed = false;
     static bool f11KeyPressed = false;
     static bool fKeyPressed = false;
     static bool f5KeyPressed = false;
@@ -380,9 +642,21 @@ static void mainLoop(const char* romFilename)
     static bool f8KeyPressed = false;
     
     printf("Using 16-bit rendering bridge\n");
+
+    initPacer(engine);
+    governor.setBudget(pacer.getPeriod());
+    rewindBuffer.setCapacity((size_t)Configuration::getRewindBufferSize() * 1024 * 1024);
+    rewindBuffer.setKeyframeInterval(Configuration::getRewindKeyframeInterval());
+    runAhead.setFrames(Configuration::getRunAheadFrames());
+
+    emulationRunning = true;
+    std::thread emulationThread(emulationLoop, &engine);
     
     while (running)
     {
+        // Input and engine commands are applied between emulated frames
+        std::unique_lock<std::mutex> engineLock(engineMutex);
+
         SDL_Event event;
         while (SDL_PollEvent(&event))
         {
@@ -397,6 +671,9 @@ static void mainLoop(const char* romFilename)
                 case SDL_WINDOWEVENT_CLOSE:
                     running = false;
                     break;
+                default:
+                    repaint = true;
+                    break;
                 }
                 break;
             // Process joystick events (same as your working version)
@@ -472,7 +749,7 @@ static void mainLoop(const char* romFilename)
         }
 
         // Game control keys
-        if (keys[SDL_SCANCODE_R])
+        if (keys[SDL_SCANCODE_R] && !netplay.isActive())
         {
             engine.reset();
         }
@@ -481,6 +758,12 @@ static void mainLoop(const char* romFilename)
             running = false;
             break;
         }
+
+        // Hold backspace to rewind
+        rewinding = Configuration::getRewindEnabled() && keys[SDL_SCANCODE_BACKSPACE];
+
+        // The other player's game would not load the state too
+        bool loadAllowed = !netplay.isActive();
         
         // Save/Load state handling (F5-F8 keys)
         bool shiftPressed = (keys[SDL_SCANCODE_LSHIFT] || keys[SDL_SCANCODE_RSHIFT]);
@@ -488,14 +771,11 @@ static void mainLoop(const char* romFilename)
         // F5 - Save/Load State 1
         if (keys[SDL_SCANCODE_F5] && !f5KeyPressed) {
             if (shiftPressed) {
-                if (engine.loadState("save1")) {
-                    printf("State 1 loaded\n");
-                } else {
-                    printf("Failed to load state 1\n");
+                if (loadAllowed) {
+                    stateFiles.load("save1", 1);
                 }
-            } else {
-                engine.saveState("save1");
-                printf("State 1 saved\n");
+            } else if (!stateFiles.save(engine, "save1", 1)) {
+                printf("Failed to save state 1\n");
             }
             f5KeyPressed = true;
         } else if (!keys[SDL_SCANCODE_F5]) {
@@ -505,14 +785,11 @@ static void mainLoop(const char* romFilename)
         // F6 - Save/Load State 2
         if (keys[SDL_SCANCODE_F6] && !f6KeyPressed) {
             if (shiftPressed) {
-                if (engine.loadState("save2")) {
-                    printf("State 2 loaded\n");
-                } else {
-                    printf("Failed to load state 2\n");
+                if (loadAllowed) {
+                    stateFiles.load("save2", 2);
                 }
-            } else {
-                engine.saveState("save2");
-                printf("State 2 saved\n");
+            } else if (!stateFiles.save(engine, "save2", 2)) {
+                printf("Failed to save state 2\n");
             }
             f6KeyPressed = true;
         } else if (!keys[SDL_SCANCODE_F6]) {
@@ -522,14 +799,11 @@ static void mainLoop(const char* romFilename)
         // F7 - Save/Load State 3
         if (keys[SDL_SCANCODE_F7] && !f7KeyPressed) {
             if (shiftPressed) {
-                if (engine.loadState("save3")) {
-                    printf("State 3 loaded\n");
-                } else {
-                    printf("Failed to load state 3\n");
+                if (loadAllowed) {
+                    stateFiles.load("save3", 3);
                 }
-            } else {
-                engine.saveState("save3");
-                printf("State 3 saved\n");
+            } else if (!stateFiles.save(engine, "save3", 3)) {
+                printf("Failed to save state 3\n");
             }
             f7KeyPressed = true;
         } else if (!keys[SDL_SCANCODE_F7]) {
@@ -539,14 +813,11 @@ static void mainLoop(const char* romFilename)
         // F8 - Save/Load State 4
         if (keys[SDL_SCANCODE_F8] && !f8KeyPressed) {
             if (shiftPressed) {
-                if (engine.loadState("save4")) {
-                    printf("State 4 loaded\n");
-                } else {
-                    printf("Failed to load state 4\n");
+                if (loadAllowed) {
+                    stateFiles.load("save4", 4);
                 }
-            } else {
-                engine.saveState("save4");
-                printf("State 4 saved\n");
+            } else if (!stateFiles.save(engine, "save4", 4)) {
+                printf("Failed to save state 4\n");
             }
             f8KeyPressed = true;
         } else if (!keys[SDL_SCANCODE_F8]) {
@@ -577,32 +848,141 @@ static void mainLoop(const char* romFilename)
             fKeyPressed = false;
         }
         
-        // Toggle optimized scaling (press O key)
-        if (keys[SDL_SCANCODE_O] && !optimizedScalingKeyPressed) {
-            if (scalingCache) {
-                bool enabled = scalingCache->isOptimizedScaling();
-                scalingCache->setOptimizedScaling(!enabled);
-                printf("Optimized scaling: %s\n", !enabled ? "Enabled" : "Disabled");
+        engineLock.unlock();
+
+        // Report the save states finished in the background
+        StateFileQueue::Completion stateCompletion;
+        while (stateFiles.poll(stateCompletion))
+        {
+            if (stateCompletion.ok)
+            {
+                printf("State %d %s (%.1fms)\n", stateCompletion.slot,
+                       stateCompletion.save ? "saved" : "loaded", stateCompletion.ms);
+            }
+            else
+            {
+                printf("Failed to %s state %d\n", stateCompletion.save ? "save" : "load", stateCompletion.slot);
             }
-            optimizedScalingKeyPressed = true;
-        } else if (!keys[SDL_SCANCODE_O]) {
-            optimizedScalingKeyPressed = false;
         }
 
-        // Game engine update and rendering
-        engine.update();
-        
-        // CHANGED: Use 16-bit rendering like DOS version
-        engine.render16(renderBuffer16);
-        
-        // CHANGED: Convert 16-bit to 32-bit for SDL
-        convertRGB565ToARGB8888(renderBuffer16, renderBuffer, RENDER_WIDTH, RENDER_HEIGHT);
+        // Periodic audio pipeline and thread timing stats
+        int now = SDL_GetTicks();
+        if (audioStatsInterval > 0 && now - audioStatsTime >= audioStatsInterval)
+        {
+            engine.getAudioStats().print();
+            engine.resetAudioStats();
+            printf("Video: %llu frames emulated (%.2fms avg), %llu presented (%.2fms avg), %llu unchanged, %llu skipped, %llu dropped, quality level %d\n",
+                   (unsigned long long)emulatedFrames.load(),
+                   emulatedFrames ? emulationTimeUs / 1000.0 / emulatedFrames : 0.0,
+                   (unsigned long long)presentedFrames,
+                   presentedFrames ? presentTimeUs / 1000.0 / presentedFrames : 0.0,
+                   (unsigned long long)unchangedFrames,
+                   (unsigned long long)skippedFrames.load(),
+                   (unsigned long long)frames.getDroppedCount(),
+                   governor.getLevel());
+            filterChain.printStats();
+            filterChain.resetStats();
+
+            FramePacer::Stats pacing;
+            RewindBuffer::Stats rewindStats;
+            RunAhead::Stats runAheadStats;
+            SRAMPersister::Stats batteryStats;
+            NetplaySession::Stats netplayStats;
+            {
+                std::lock_guard<std::mutex> lock(engineMutex);
+                pacing = pacer.getStats();
+                pacer.resetStats();
+                rewindStats = rewindBuffer.getStats();
+                rewindBuffer.resetStats();
+                runAheadStats = runAhead.getStats();
+                runAhead.resetStats();
+                netplayStats = netplay.getStats();
+                netplay.resetStats();
+            }
+            batteryStats = batteryPersister.getStats();
+            batteryPersister.resetStats();
+            pacing.print();
+            if (Configuration::getRewindEnabled())
+            {
+                rewindStats.print();
+            }
+            if (runAheadStats.frames > 0)
+            {
+                runAheadStats.print();
+            }
+            if (batteryStats.pagesChecked > 0 || batteryStats.failures > 0)
+            {
+                batteryStats.print();
+            }
+            if (netplay.isActive())
+            {
+                netplayStats.print();
+            }
+            audioStatsTime = now;
+        }
+
+        // Feed the governor the emulation thread's time and apply its
+        // decisions between frames
+        uint64_t emulated = emulatedFrames;
+        uint64_t emulatedUs = emulationTimeUs;
+        governor.addEmulatedFrames(emulated - governorFrames, emulatedUs - governorTimeUs);
+        governorFrames = emulated;
+        governorTimeUs = emulatedUs;
+        if (governor.update() && governor.getFiltersReduced() != filtersReduced)
+        {
+            filtersReduced = governor.getFiltersReduced();
+            setFiltersReduced(filtersReduced);
+            textureFrame = 0;
+            repaint = true;
+        }
+
+        // Wait for the emulation thread to finish a frame
+        if (!frames.acquire())
+        {
+            SDL_Delay(1);
+            continue;
+        }
+
+        const VideoFrame& frame = frames.getReadBuffer();
+
+        Uint64 presentStart = SDL_GetPerformanceCounter();
+
+        // The dirty rows only describe the step from the previous PPU
+        // frame, so after a dropped frame everything is uploaded
+        if (textureFrame != 0 && frame.number == textureFrame + 1)
+        {
+            frame.dirtyRows.getBands(changedRows);
+        }
+        else
+        {
+            changedRows.assign(1, RowBand{ 0, RENDER_HEIGHT });
+        }
+        textureFrame = frame.number;
+
+        FilterFrame input(const_cast<uint16_t*>(frame.pixels), RENDER_WIDTH, RENDER_HEIGHT,
+                          RENDER_WIDTH * sizeof(uint16_t), PixelFormat::RGB565);
+        FilterFrame output = filterChain.process(input, changedRows, textureRows);
+        if (!output.pixels)
+        {
+            textureRows.clear();
+        }
+        if (textureRows.empty() && !repaint)
+        {
+            unchangedFrames++;
+            continue;
+        }
+
+        // Upload the changed bands into the streaming texture
+        for (const RowBand& band : textureRows)
+        {
+            SDL_Rect rect = { 0, band.first, output.width, band.last - band.first };
+            SDL_UpdateTexture(texture, &rect, output.row<uint8_t>(band.first), output.pitch);
+        }
+        repaint = false;
 
         // Clear the renderer
         SDL_RenderClear(renderer);
 
-        // Original rendering code (now using converted buffer)
-        SDL_UpdateTexture(texture, NULL, renderBuffer, sizeof(uint32_t) * RENDER_WIDTH);
         SDL_RenderSetLogicalSize(renderer, RENDER_WIDTH, RENDER_HEIGHT);
         SDL_RenderCopy(renderer, texture, NULL, NULL);
 
@@ -616,29 +996,66 @@ static void mainLoop(const char* romFilename)
         // Present the rendered frame
         SDL_RenderPresent(renderer);
 
-        // Frame timing
-        int now = SDL_GetTicks();
-        int delay = progStartTime + int(double(frame) * double(MS_PER_SEC) / double(Configuration::getFrameRate())) - now;
-        if(delay > 0) 
-        {
-            SDL_Delay(delay);
-        }
-        else 
-        {
-            frame = 0;
-            progStartTime = now;
-        }
-        frame++;
+        uint64_t presentUs = (SDL_GetPerformanceCounter() - presentStart) * 1000000 / SDL_GetPerformanceFrequency();
+        governor.addPresentedFrame(presentUs);
+        presentTimeUs += presentUs;
+        presentedFrames++;
     }
+
+    emulationRunning = false;
+    emulationThread.join();
+    batteryPersister.detach(engine);
+    netplay.stop();
+    netplayTransport.close();
+
+    if (movie.getMode() == InputMovie::MOVIE_RECORDING)
+    {
+        movie.save(movieFile);
+    }
+
+    printf("Emulated %llu frames, presented %llu, dropped %llu\n",
+           (unsigned long long)emulatedFrames.load(), (unsigned long long)presentedFrames,
+           (unsigned long long)frames.getDroppedCount());
 }
 
 int main(int argc, char** argv)
 {
     if (argc < 2) {
-        std::cout << "Usage: " << argv[0] << " <rom_file>" << std::endl;
+        std::cout << "Usage: " << argv[0] << " <rom_file> [--record-movie <file> | --play-movie <file>]"
+                  << " [--netplay <player> <local port> <host> <port>]"
+                  << " [--netplay-loopback <latency ms> <loss %>]" << std::endl;
         return -1;
     }
 
+    for (int i = 2; i + 1 < argc; i++)
+    {
+        if (strcmp(argv[i], "--record-movie") == 0 || strcmp(argv[i], "--play-movie") == 0)
+        {
+            movieRecording = strcmp(argv[i], "--record-movie") == 0;
+            movieFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--netplay") == 0 && i + 4 < argc)
+        {
+            netplayPlayer = atoi(argv[i + 1]) == 2 ? 1 : 0;
+            netplayLocalPort = atoi(argv[i + 2]);
+            netplayHost = argv[i + 3];
+            netplayPeerPort = atoi(argv[i + 4]);
+            i += 4;
+        }
+        else if (strcmp(argv[i], "--netplay-loopback") == 0 && i + 2 < argc)
+        {
+            // Both players in this process over a simulated network
+            WarpNES engine;
+            if (!engine.loadROM(argv[1]))
+            {
+                return -1;
+            }
+            engine.reset();
+            NetplaySession::benchmarkLoopback(engine, 1800, atof(argv[i + 1]), atoi(argv[i + 2]));
+            return 0;
+        }
+    }
+
     if (!initialize())
     {
         std::cout << "Failed to initialize. Please check previous error messages for more information. The program will now exit.\n";
@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "SRAMPersister.hpp"
+#include "Emulation/AtomicFile.hpp"
+#include "Emulation/WarpNES.hpp"
+
+// A save is written once SRAM has been left alone this long, games write
+// a save a few bytes at a time over several frames
+static const int QUIET_MS = 1000;
+
+// ...or once it has been changing for this long, for games that keep
+// writing SRAM while they run
+static const int MAX_DELAY_MS = 10000;
+
+SRAMPersister::SRAMPersister() :
+    changed(false), queuedValid(false), writing(false), stopping(false)
+{
+    resetStats();
+    writer = std::thread(&SRAMPersister::writerLoop, this);
+}
+
+SRAMPersister::~SRAMPersister()
+{
+    if (changed) {
+        queue();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeCondition.notify_one();
+    writer.join();
+}
+
+void SRAMPersister::attach(WarpNES& engine)
+{
+    filename = engine.getSRAMFileName();
+    if (filename.empty() || !engine.getSRAM()) {
+        filename.clear();
+        return;
+    }
+    contents.assign(engine.getSRAM(), engine.getSRAM() + engine.getSRAMSize());
+
+    // Anything written before now has not been saved by anyone
+    changed = engine.takeSRAMWrites() != 0;
+    firstChange = lastChange = Clock::now();
+}
+
+void SRAMPersister::detach(WarpNES& engine)
+{
+    if (filename.empty()) {
+        return;
+    }
+    collect(engine);
+    flush();
+    filename.clear();
+}
+
+void SRAMPersister::frame(WarpNES& engine)
+{
+    if (filename.empty()) {
+        return;
+    }
+    collect(engine);
+    if (!changed) {
+        return;
+    }
+
+    Clock::time_point now = Clock::now();
+    if (now - lastChange >= std::chrono::milliseconds(QUIET_MS) ||
+        now - firstChange >= std::chrono::milliseconds(MAX_DELAY_MS)) {
+        queue();
+    }
+}
+
+void SRAMPersister::flush()
+{
+    if (changed) {
+        queue();
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [this]() { return !queuedValid && !writing; });
+}
+
+void SRAMPersister::collect(WarpNES& engine)
+{
+    uint32_t pages = engine.takeSRAMWrites();
+    if (pages == 0) {
+        return;
+    }
+
+    const uint8_t* sram = engine.getSRAM();
+    size_t size = std::min<size_t>(contents.size(), engine.getSRAMSize());
+    bool pageChanged = false;
+    uint64_t checked = 0, changedPages = 0;
+    for (uint32_t page = 0; pages != 0; page++, pages >>= 1) {
+        size_t offset = (size_t)page * WarpNES::SRAM_PAGE_SIZE;
+        if (!(pages & 1) || offset >= size) {
+            continue;
+        }
+        size_t length = std::min<size_t>(WarpNES::SRAM_PAGE_SIZE, size - offset);
+        checked++;
+        if (memcmp(&contents[offset], sram + offset, length) != 0) {
+            memcpy(&contents[offset], sram + offset, length);
+            changedPages++;
+            pageChanged = true;
+        }
+    }
+
+    if (pageChanged) {
+        Clock::time_point now = Clock::now();
+        if (!changed) {
+            firstChange = now;
+        }
+        lastChange = now;
+        changed = true;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    statPagesChecked += checked;
+    statPagesChanged += changedPages;
+}
+
+void SRAMPersister::queue()
+{
+    {
+        // A save still waiting is replaced, only the newest matters
+        std::lock_guard<std::mutex> lock(mutex);
+        queuedFilename = filename;
+        queued = contents;
+        queuedValid = true;
+    }
+    changed = false;
+    wakeCondition.notify_one();
+}
+
+void SRAMPersister::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wakeCondition.wait(lock, [this]() { return queuedValid || stopping; });
+        if (!queuedValid) {
+            break;
+        }
+
+        std::string name;
+        std::vector<uint8_t> data;
+        name.swap(queuedFilename);
+        data.swap(queued);
+        queuedValid = false;
+        writing = true;
+        lock.unlock();
+
+        Clock::time_point start = Clock::now();
+        bool written = writeFileAtomically(name, data.data(), data.size());
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if (!written) {
+            printf("SRAM: Error - Could not save battery data to %s\n", name.c_str());
+        }
+
+        lock.lock();
+        writing = false;
+        if (written) {
+            statFlushes++;
+            statWriteTotalMs += ms;
+            statWriteMaxMs = std::max(statWriteMaxMs, ms);
+        } else {
+            statFailures++;
+        }
+        doneCondition.notify_all();
+    }
+}
+
+SRAMPersister::Stats SRAMPersister::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats stats;
+    stats.pagesChecked = statPagesChecked;
+    stats.pagesChanged = statPagesChanged;
+    stats.flushes = statFlushes;
+    stats.failures = statFailures;
+    stats.writeAverageMs = statFlushes ? statWriteTotalMs / statFlushes : 0.0;
+    stats.writeMaxMs = statWriteMaxMs;
+    return stats;
+}
+
+void SRAMPersister::resetStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    statPagesChecked = 0;
+    statPagesChanged = 0;
+    statFlushes = 0;
+    statFailures = 0;
+    statWriteTotalMs = 0.0;
+    statWriteMaxMs = 0.0;
+}
+
+void SRAMPersister::Stats::print() const
+{
+    printf("Battery: %llu pages written, %llu changed, %llu saves %.2fms avg %.2fms max, %llu failed\n",
+           (unsigned long long)pagesChecked, (unsigned long long)pagesChanged,
+           (unsigned long long)flushes, writeAverageMs, writeMaxMs, (unsigned long long)failures);
+}
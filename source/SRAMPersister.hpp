@@ -0,0 +1,111 @@
+#ifndef SRAM_PERSISTER_HPP
+#define SRAM_PERSISTER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class WarpNES;
+
+/**
+ * Writes an engine's battery save in the background, so a crash loses at
+ * most a moment of progress and the emulation thread never waits on the
+ * disk.
+ *
+ * Each frame the SRAM pages the game wrote are compared with the last
+ * copy taken, and only pages that really changed are copied. Once the
+ * game has stopped changing SRAM for a moment, or has kept changing it
+ * for a while, the copy is handed to a writer thread that saves it with
+ * writeFileAtomically(). While attached the persister saves the
+ * battery file instead of the engine.
+ */
+class SRAMPersister {
+public:
+    /**
+     * Counters since the last reset.
+     */
+    struct Stats {
+        uint64_t pagesChecked;      /**< Written pages compared with the last copy */
+        uint64_t pagesChanged;      /**< Pages whose contents had changed */
+        uint64_t flushes;           /**< Battery files written */
+        uint64_t failures;          /**< Battery files that could not be written */
+        double writeAverageMs;      /**< Average time to write a battery file */
+        double writeMaxMs;          /**< Longest time to write a battery file */
+
+        /**
+         * Print the stats as a single line.
+         */
+        void print() const;
+    };
+
+    SRAMPersister();
+
+    /**
+     * Write anything not saved yet and stop the writer thread.
+     */
+    ~SRAMPersister();
+
+    /**
+     * Take over saving an engine's battery file. Does nothing if the
+     * game has no battery. Call on the thread that runs the engine.
+     */
+    void attach(WarpNES& engine);
+
+    /**
+     * Save what the engine has not saved yet, wait for it to be written
+     * and stop saving for the engine.
+     */
+    void detach(WarpNES& engine);
+
+    /**
+     * Call after every frame the engine runs, on the thread that runs it.
+     */
+    void frame(WarpNES& engine);
+
+    /**
+     * Write the battery file now if anything changed, and wait for it.
+     */
+    void flush();
+
+    Stats getStats() const;
+
+    void resetStats();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    // Used on the thread that runs the engine
+    std::string filename;
+    std::vector<uint8_t> contents;  /**< The SRAM as of the last frame */
+    bool changed;                   /**< contents differs from what was last handed to the writer */
+    Clock::time_point firstChange;
+    Clock::time_point lastChange;
+
+    // Shared with the writer thread
+    std::thread writer;
+    mutable std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    std::string queuedFilename;
+    std::vector<uint8_t> queued;
+    bool queuedValid;
+    bool writing;
+    bool stopping;
+
+    uint64_t statPagesChecked;
+    uint64_t statPagesChanged;
+    uint64_t statFlushes;
+    uint64_t statFailures;
+    double statWriteTotalMs;
+    double statWriteMaxMs;
+
+    void collect(WarpNES& engine);
+    void queue();
+    void writerLoop();
+};
+
+#endif // SRAM_PERSISTER_HPP
@@ -0,0 +1,155 @@
+#include <fstream>
+
+#include "StateFileQueue.hpp"
+#include "Emulation/AtomicFile.hpp"
+#include "Emulation/SaveState.hpp"
+#include "Emulation/WarpNES.hpp"
+
+StateFileQueue::StateFileQueue() :
+    stopping(false)
+{
+    worker = std::thread(&StateFileQueue::workerLoop, this);
+}
+
+StateFileQueue::~StateFileQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeCondition.notify_one();
+    worker.join();
+}
+
+bool StateFileQueue::save(const WarpNES& engine, const std::string& filename, int slot)
+{
+    Request request;
+    request.save = true;
+    request.slot = slot;
+    request.filename = filename;
+    request.start = Clock::now();
+    request.state.resize(engine.getStateSize());
+    size_t size = engine.saveState(request.state.data(), request.state.size());
+    if (size == 0) {
+        return false;
+    }
+    request.state.resize(size);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(std::move(request));
+    }
+    wakeCondition.notify_one();
+    return true;
+}
+
+void StateFileQueue::load(const std::string& filename, int slot)
+{
+    Request request;
+    request.save = false;
+    request.slot = slot;
+    request.filename = filename;
+    request.start = Clock::now();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(std::move(request));
+    }
+    wakeCondition.notify_one();
+}
+
+void StateFileQueue::applyLoads(WarpNES& engine)
+{
+    std::deque<Request> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (loaded.empty()) {
+            return;
+        }
+        ready.swap(loaded);
+    }
+
+    // Only the last one is left in the engine, but each is reported
+    for (const Request& request : ready) {
+        bool ok = engine.loadState(request.state.data(), request.state.size());
+        std::lock_guard<std::mutex> lock(mutex);
+        complete(request, ok);
+    }
+}
+
+bool StateFileQueue::poll(Completion& completion)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (completions.empty()) {
+        return false;
+    }
+    completion = completions.front();
+    completions.pop_front();
+    return true;
+}
+
+void StateFileQueue::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wakeCondition.wait(lock, [this]() { return !requests.empty() || stopping; });
+        if (requests.empty()) {
+            break;
+        }
+
+        Request request = std::move(requests.front());
+        requests.pop_front();
+        if (stopping && !request.save) {
+            continue;
+        }
+        lock.unlock();
+
+        bool ok = request.save ? writeFile(request.filename, request.state)
+                               : readFile(request.filename, request.state);
+
+        lock.lock();
+        if (ok && !request.save) {
+            loaded.push_back(std::move(request));
+        } else {
+            complete(request, ok);
+        }
+    }
+}
+
+void StateFileQueue::complete(const Request& request, bool ok)
+{
+    Completion completion;
+    completion.slot = request.slot;
+    completion.save = request.save;
+    completion.ok = ok;
+    completion.ms = std::chrono::duration<double, std::milli>(Clock::now() - request.start).count();
+    completions.push_back(completion);
+}
+
+bool StateFileQueue::writeFile(const std::string& filename, const std::vector<uint8_t>& state)
+{
+    // Written the same way as battery files, so a crash or a full disk
+    // leaves the slot's old state rather than a truncated one
+    return writeFileAtomically(filename, state.data(), state.size());
+}
+
+bool StateFileQueue::readFile(const std::string& filename, std::vector<uint8_t>& state)
+{
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::streamoff size = file.tellg();
+    if (size <= 0) {
+        return false;
+    }
+    state.resize((size_t)size);
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(state.data()), state.size())) {
+        return false;
+    }
+
+    // A damaged or old file fails here rather than on the emulation thread
+    StateReader reader(state.data(), state.size());
+    return reader.isValid();
+}
@@ -0,0 +1,95 @@
+#ifndef STATE_FILE_QUEUE_HPP
+#define STATE_FILE_QUEUE_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class WarpNES;
+
+/**
+ * Saves and loads save state files on a background thread, so the
+ * emulation thread never waits on the disk.
+ *
+ * Saving takes a snapshot of the engine straight away and writes it out
+ * later. Loading reads the file and checks its header in the background,
+ * and the state is put into the engine at the start of the next frame
+ * once it is ready. Requests are carried out in order, so loading a slot
+ * right after saving it loads what was saved. The files are the same as
+ * WarpNES::saveState() writes.
+ */
+class StateFileQueue {
+public:
+    /**
+     * A finished request, for the frontend to report.
+     */
+    struct Completion {
+        int slot;                   /**< The slot given with the request */
+        bool save;                  /**< A save rather than a load */
+        bool ok;
+        double ms;                  /**< Time from the request to the end */
+    };
+
+    StateFileQueue();
+
+    /**
+     * Finish the saves still queued and stop the thread. Loads not yet
+     * put into an engine are dropped.
+     */
+    ~StateFileQueue();
+
+    /**
+     * Snapshot the engine and queue writing it to a file. Call while
+     * nothing else runs the engine.
+     * @return false if there was no state to take
+     */
+    bool save(const WarpNES& engine, const std::string& filename, int slot);
+
+    /**
+     * Queue reading a state file, for applyLoads() to put into an engine.
+     */
+    void load(const std::string& filename, int slot);
+
+    /**
+     * Put the states that have finished reading into the engine. Call
+     * between frames on the thread that runs it.
+     */
+    void applyLoads(WarpNES& engine);
+
+    /**
+     * Take the oldest request that has finished.
+     * @return false if none has
+     */
+    bool poll(Completion& completion);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Request {
+        bool save;
+        int slot;
+        std::string filename;
+        std::vector<uint8_t> state;
+        Clock::time_point start;
+    };
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::deque<Request> requests;   /**< Waiting for the thread */
+    std::deque<Request> loaded;     /**< Read, waiting for applyLoads() */
+    std::deque<Completion> completions;
+    bool stopping;
+
+    void workerLoop();
+    void complete(const Request& request, bool ok);
+    static bool writeFile(const std::string& filename, const std::vector<uint8_t>& state);
+    static bool readFile(const std::string& filename, std::vector<uint8_t>& state);
+};
+
+#endif // STATE_FILE_QUEUE_HPP
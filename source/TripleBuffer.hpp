@@ -0,0 +1,99 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Lock-free single producer, single consumer triple buffer.
+ *
+ * The producer always has a buffer of its own to write into and the
+ * consumer always has a stable buffer to read from. The third buffer sits
+ * between them holding the most recently published value, so neither side
+ * ever waits for the other. A publish that overwrites a value the consumer
+ * never picked up counts as a dropped value.
+ */
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer()
+        : middle(1), writeIndex(0), readIndex(2), publishedCount(0), droppedCount(0)
+    {
+    }
+
+    /**
+     * Get the buffer the producer writes into.
+     */
+    T& getWriteBuffer()
+    {
+        return buffers[writeIndex];
+    }
+
+    /**
+     * Hand the write buffer over to the consumer and take the middle
+     * buffer as the next write buffer.
+     */
+    void publish()
+    {
+        uint8_t previous = middle.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel);
+        writeIndex = previous & INDEX_MASK;
+
+        publishedCount++;
+        if (previous & FRESH_BIT) {
+            droppedCount++;
+        }
+    }
+
+    /**
+     * Pick up the most recently published buffer, if there is a new one.
+     * @return true if the read buffer changed
+     */
+    bool acquire()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH_BIT)) {
+            return false;
+        }
+
+        uint8_t previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & INDEX_MASK;
+        return true;
+    }
+
+    /**
+     * Get the buffer the consumer reads from.
+     */
+    const T& getReadBuffer() const
+    {
+        return buffers[readIndex];
+    }
+
+    /**
+     * Get the number of buffers published.
+     */
+    uint64_t getPublishedCount() const
+    {
+        return publishedCount;
+    }
+
+    /**
+     * Get the number of published buffers that were overwritten before
+     * the consumer picked them up.
+     */
+    uint64_t getDroppedCount() const
+    {
+        return droppedCount;
+    }
+
+private:
+    static const uint8_t INDEX_MASK = 0x03;
+    static const uint8_t FRESH_BIT = 0x04;
+
+    T buffers[3];
+    std::atomic<uint8_t> middle;  /**< Index of the middle buffer, plus FRESH_BIT if unread */
+    uint8_t writeIndex;           /**< Only touched by the producer */
+    uint8_t readIndex;            /**< Only touched by the consumer */
+    std::atomic<uint64_t> publishedCount;
+    std::atomic<uint64_t> droppedCount;
+};
+
+#endif // TRIPLE_BUFFER_HPP
@@ -0,0 +1,1204 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+#include "HQDN3DFilter.hpp"
+#include "VideoFilters.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define VIDEO_FILTERS_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define VIDEO_FILTERS_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+enum SIMDLevel {
+    SIMD_NONE,
+    SIMD_SSE2,
+    SIMD_AVX2
+};
+
+static SIMDLevel detectSIMDLevel()
+{
+#if defined(VIDEO_FILTERS_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SIMD_AVX2;
+    }
+#endif
+#if defined(VIDEO_FILTERS_SSE2)
+    return SIMD_SSE2;
+#else
+    return SIMD_NONE;
+#endif
+}
+
+static const SIMDLevel detectedSIMDLevel = detectSIMDLevel();
+static SIMDLevel simdLevel = detectedSIMDLevel;
+
+//---------------------------------------------------------------------------
+// Colour conversion
+//---------------------------------------------------------------------------
+
+uint32_t VideoFilters::convertPixel(uint16_t color)
+{
+    uint8_t r = (color >> 11) & 0x1F;
+    uint8_t g = (color >> 5) & 0x3F;
+    uint8_t b = color & 0x1F;
+
+    r = (r * 255 + 15) / 31;
+    g = (g * 255 + 31) / 63;
+    b = (b * 255 + 15) / 31;
+
+    return (0xFF << 24) | (r << 16) | (g << 8) | b;
+}
+
+#if defined(VIDEO_FILTERS_SSE2)
+/**
+ * Exact x / divisor for 16-bit lanes: a reciprocal multiply that may come
+ * out one too high, corrected by checking the product.
+ */
+static inline __m128i divideSSE2(__m128i x, int divisor, int reciprocal)
+{
+    __m128i q = _mm_mulhi_epu16(x, _mm_set1_epi16((short)reciprocal));
+    __m128i tooHigh = _mm_cmpgt_epi16(_mm_mullo_epi16(q, _mm_set1_epi16((short)divisor)), x);
+    return _mm_add_epi16(q, tooHigh);
+}
+
+/**
+ * Convert 8 RGB565 pixels to ARGB8888, with the same rounding as convertPixel().
+ */
+static inline void convert8SSE2(__m128i px, __m128i& lo, __m128i& hi)
+{
+    const __m128i mask5 = _mm_set1_epi16(0x1F);
+    const __m128i mask6 = _mm_set1_epi16(0x3F);
+    const __m128i c255 = _mm_set1_epi16(255);
+
+    __m128i r = _mm_srli_epi16(px, 11);
+    __m128i g = _mm_and_si128(_mm_srli_epi16(px, 5), mask6);
+    __m128i b = _mm_and_si128(px, mask5);
+
+    r = divideSSE2(_mm_add_epi16(_mm_mullo_epi16(r, c255), _mm_set1_epi16(15)), 31, 2115);
+    g = divideSSE2(_mm_add_epi16(_mm_mullo_epi16(g, c255), _mm_set1_epi16(31)), 63, 1041);
+    b = divideSSE2(_mm_add_epi16(_mm_mullo_epi16(b, c255), _mm_set1_epi16(15)), 31, 2115);
+
+    __m128i gb = _mm_or_si128(_mm_slli_epi16(g, 8), b);
+    __m128i ar = _mm_or_si128(_mm_set1_epi16((short)0xFF00), r);
+    lo = _mm_unpacklo_epi16(gb, ar);
+    hi = _mm_unpackhi_epi16(gb, ar);
+}
+
+static void convertRowSSE2(const uint16_t* src, uint32_t* dst, int count)
+{
+    int x = 0;
+    for (; x + 8 <= count; x += 8) {
+        __m128i lo, hi;
+        convert8SSE2(_mm_loadu_si128((const __m128i*)(src + x)), lo, hi);
+        _mm_storeu_si128((__m128i*)(dst + x), lo);
+        _mm_storeu_si128((__m128i*)(dst + x + 4), hi);
+    }
+    for (; x < count; x++) {
+        dst[x] = VideoFilters::convertPixel(src[x]);
+    }
+}
+#endif
+
+#if defined(VIDEO_FILTERS_AVX2)
+__attribute__((target("avx2")))
+static inline __m256i divideAVX2(__m256i x, int divisor, int reciprocal)
+{
+    __m256i q = _mm256_mulhi_epu16(x, _mm256_set1_epi16((short)reciprocal));
+    __m256i tooHigh = _mm256_cmpgt_epi16(_mm256_mullo_epi16(q, _mm256_set1_epi16((short)divisor)), x);
+    return _mm256_add_epi16(q, tooHigh);
+}
+
+/**
+ * Convert 16 RGB565 pixels to ARGB8888 (pixels 0-7 in lo, 8-15 in hi).
+ */
+__attribute__((target("avx2")))
+static inline void convert16AVX2(__m256i px, __m256i& lo, __m256i& hi)
+{
+    const __m256i mask5 = _mm256_set1_epi16(0x1F);
+    const __m256i mask6 = _mm256_set1_epi16(0x3F);
+    const __m256i c255 = _mm256_set1_epi16(255);
+
+    __m256i r = _mm256_srli_epi16(px, 11);
+    __m256i g = _mm256_and_si256(_mm256_srli_epi16(px, 5), mask6);
+    __m256i b = _mm256_and_si256(px, mask5);
+
+    r = divideAVX2(_mm256_add_epi16(_mm256_mullo_epi16(r, c255), _mm256_set1_epi16(15)), 31, 2115);
+    g = divideAVX2(_mm256_add_epi16(_mm256_mullo_epi16(g, c255), _mm256_set1_epi16(31)), 63, 1041);
+    b = divideAVX2(_mm256_add_epi16(_mm256_mullo_epi16(b, c255), _mm256_set1_epi16(15)), 31, 2115);
+
+    __m256i gb = _mm256_or_si256(_mm256_slli_epi16(g, 8), b);
+    __m256i ar = _mm256_or_si256(_mm256_set1_epi16((short)0xFF00), r);
+
+    // Unpacking works within 128-bit lanes, put the pixels back in order
+    __m256i a = _mm256_unpacklo_epi16(gb, ar);
+    __m256i c = _mm256_unpackhi_epi16(gb, ar);
+    lo = _mm256_permute2x128_si256(a, c, 0x20);
+    hi = _mm256_permute2x128_si256(a, c, 0x31);
+}
+
+__attribute__((target("avx2")))
+static void convertRowAVX2(const uint16_t* src, uint32_t* dst, int count)
+{
+    int x = 0;
+    for (; x + 16 <= count; x += 16) {
+        __m256i lo, hi;
+        convert16AVX2(_mm256_loadu_si256((const __m256i*)(src + x)), lo, hi);
+        _mm256_storeu_si256((__m256i*)(dst + x), lo);
+        _mm256_storeu_si256((__m256i*)(dst + x + 8), hi);
+    }
+    for (; x < count; x++) {
+        dst[x] = VideoFilters::convertPixel(src[x]);
+    }
+}
+#endif
+
+void VideoFilters::convertRow(const uint16_t* src, uint32_t* dst, int count)
+{
+#if defined(VIDEO_FILTERS_AVX2)
+    if (simdLevel == SIMD_AVX2) {
+        convertRowAVX2(src, dst, count);
+        return;
+    }
+#endif
+#if defined(VIDEO_FILTERS_SSE2)
+    if (simdLevel >= SIMD_SSE2) {
+        convertRowSSE2(src, dst, count);
+        return;
+    }
+#endif
+    for (int x = 0; x < count; x++) {
+        dst[x] = convertPixel(src[x]);
+    }
+}
+
+//---------------------------------------------------------------------------
+// Row window
+//---------------------------------------------------------------------------
+
+/**
+ * Sliding window over three input rows for one stripe. Rows are padded
+ * with a copy of their edge pixel on each side and converted to ARGB8888
+ * once, so the filters can read neighbours without bounds checks.
+ * Rows above and below the frame repeat the edge rows.
+ */
+class RowWindow {
+public:
+    RowWindow(const uint16_t* input, int width, int height)
+        : input(input), width(width), height(height)
+    {
+        for (int i = 0; i < 3; i++) {
+            raw[i].resize(width + 2);
+            rgb[i].resize(width + 2);
+            loadedRow[i] = -2;
+        }
+    }
+
+    /**
+     * Make rows y-1, y and y+1 available.
+     */
+    void moveTo(int y)
+    {
+        for (int dy = -1; dy <= 1; dy++) {
+            int slot = slotOf(y + dy);
+            if (loadedRow[slot] != y + dy) {
+                load(slot, y + dy);
+            }
+        }
+        currentRow = y;
+    }
+
+    /**
+     * Get an RGB565 row relative to the current one, indexable from -1 to width.
+     */
+    const uint16_t* getRaw(int dy) const
+    {
+        return raw[slotOf(currentRow + dy)].data() + 1;
+    }
+
+    /**
+     * Get an ARGB8888 row relative to the current one, indexable from -1 to width.
+     */
+    const uint32_t* getRGB(int dy) const
+    {
+        return rgb[slotOf(currentRow + dy)].data() + 1;
+    }
+
+private:
+    const uint16_t* input;
+    int width;
+    int height;
+    int currentRow;
+    std::vector<uint16_t> raw[3];
+    std::vector<uint32_t> rgb[3];
+    int loadedRow[3];
+
+    static int slotOf(int y)
+    {
+        return (y + 3) % 3;
+    }
+
+    void load(int slot, int y)
+    {
+        int sourceRow = std::max(0, std::min(height - 1, y));
+        const uint16_t* src = input + sourceRow * width;
+        uint16_t* dst = raw[slot].data();
+
+        std::copy(src, src + width, dst + 1);
+        dst[0] = src[0];
+        dst[width + 1] = src[width - 1];
+
+        VideoFilters::convertRow(dst, rgb[slot].data(), width + 2);
+        loadedRow[slot] = y;
+    }
+};
+
+//---------------------------------------------------------------------------
+// Scale2x
+//---------------------------------------------------------------------------
+
+static void scale2xRowScalar(const RowWindow& window, uint32_t* out0, uint32_t* out1, int from, int width)
+{
+    const uint16_t* above = window.getRaw(-1);
+    const uint16_t* row = window.getRaw(0);
+    const uint16_t* below = window.getRaw(1);
+    const uint32_t* above32 = window.getRGB(-1);
+    const uint32_t* row32 = window.getRGB(0);
+    const uint32_t* below32 = window.getRGB(1);
+
+    for (int x = from; x < width; x++) {
+        uint16_t A = above[x];
+        uint16_t B = row[x + 1];
+        uint16_t D = row[x - 1];
+        uint16_t E = below[x];
+        uint32_t color = row32[x];
+
+        if (A != E && D != B) {
+            out0[2 * x] = (D == A) ? above32[x] : color;
+            out0[2 * x + 1] = (A == B) ? above32[x] : color;
+            out1[2 * x] = (D == E) ? below32[x] : color;
+            out1[2 * x + 1] = (E == B) ? below32[x] : color;
+        } else {
+            out0[2 * x] = color;
+            out0[2 * x + 1] = color;
+            out1[2 * x] = color;
+            out1[2 * x + 1] = color;
+        }
+    }
+}
+
+#if defined(VIDEO_FILTERS_SSE2)
+static inline __m128i selectSSE2(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+/**
+ * Write 8 pixel pairs (left, right) as 16 consecutive output pixels.
+ */
+static inline void storePairsSSE2(uint32_t* out, __m128i leftLo, __m128i leftHi, __m128i rightLo, __m128i rightHi)
+{
+    _mm_storeu_si128((__m128i*)(out + 0), _mm_unpacklo_epi32(leftLo, rightLo));
+    _mm_storeu_si128((__m128i*)(out + 4), _mm_unpackhi_epi32(leftLo, rightLo));
+    _mm_storeu_si128((__m128i*)(out + 8), _mm_unpacklo_epi32(leftHi, rightHi));
+    _mm_storeu_si128((__m128i*)(out + 12), _mm_unpackhi_epi32(leftHi, rightHi));
+}
+
+static void scale2xRowSSE2(const RowWindow& window, uint32_t* out0, uint32_t* out1, int width)
+{
+    const uint16_t* above = window.getRaw(-1);
+    const uint16_t* row = window.getRaw(0);
+    const uint16_t* below = window.getRaw(1);
+    const uint32_t* above32 = window.getRGB(-1);
+    const uint32_t* row32 = window.getRGB(0);
+    const uint32_t* below32 = window.getRGB(1);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i A = _mm_loadu_si128((const __m128i*)(above + x));
+        __m128i B = _mm_loadu_si128((const __m128i*)(row + x + 1));
+        __m128i D = _mm_loadu_si128((const __m128i*)(row + x - 1));
+        __m128i E = _mm_loadu_si128((const __m128i*)(below + x));
+
+        __m128i active = _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi16(A, E), _mm_cmpeq_epi16(D, B)),
+                                          _mm_set1_epi16(-1));
+        __m128i m00 = _mm_and_si128(active, _mm_cmpeq_epi16(D, A));
+        __m128i m01 = _mm_and_si128(active, _mm_cmpeq_epi16(A, B));
+        __m128i m10 = _mm_and_si128(active, _mm_cmpeq_epi16(D, E));
+        __m128i m11 = _mm_and_si128(active, _mm_cmpeq_epi16(E, B));
+
+        __m128i aLo = _mm_loadu_si128((const __m128i*)(above32 + x));
+        __m128i aHi = _mm_loadu_si128((const __m128i*)(above32 + x + 4));
+        __m128i cLo = _mm_loadu_si128((const __m128i*)(row32 + x));
+        __m128i cHi = _mm_loadu_si128((const __m128i*)(row32 + x + 4));
+        __m128i eLo = _mm_loadu_si128((const __m128i*)(below32 + x));
+        __m128i eHi = _mm_loadu_si128((const __m128i*)(below32 + x + 4));
+
+        storePairsSSE2(out0 + 2 * x,
+                       selectSSE2(_mm_unpacklo_epi16(m00, m00), aLo, cLo),
+                       selectSSE2(_mm_unpackhi_epi16(m00, m00), aHi, cHi),
+                       selectSSE2(_mm_unpacklo_epi16(m01, m01), aLo, cLo),
+                       selectSSE2(_mm_unpackhi_epi16(m01, m01), aHi, cHi));
+        storePairsSSE2(out1 + 2 * x,
+                       selectSSE2(_mm_unpacklo_epi16(m10, m10), eLo, cLo),
+                       selectSSE2(_mm_unpackhi_epi16(m10, m10), eHi, cHi),
+                       selectSSE2(_mm_unpacklo_epi16(m11, m11), eLo, cLo),
+                       selectSSE2(_mm_unpackhi_epi16(m11, m11), eHi, cHi));
+    }
+
+    scale2xRowScalar(window, out0, out1, x, width);
+}
+#endif
+
+#if defined(VIDEO_FILTERS_AVX2)
+__attribute__((target("avx2")))
+static inline __m256i selectAVX2(__m256i mask, __m256i a, __m256i b)
+{
+    return _mm256_blendv_epi8(b, a, mask);
+}
+
+/**
+ * Widen a mask of 16 16-bit lanes to two masks of 8 32-bit lanes, in pixel order.
+ */
+__attribute__((target("avx2")))
+static inline void widenMaskAVX2(__m256i mask, __m256i& lo, __m256i& hi)
+{
+    __m256i a = _mm256_unpacklo_epi16(mask, mask);
+    __m256i b = _mm256_unpackhi_epi16(mask, mask);
+    lo = _mm256_permute2x128_si256(a, b, 0x20);
+    hi = _mm256_permute2x128_si256(a, b, 0x31);
+}
+
+/**
+ * Write 8 pixel pairs (left, right) as 16 consecutive output pixels.
+ */
+__attribute__((target("avx2")))
+static inline void storePairsAVX2(uint32_t* out, __m256i left, __m256i right)
+{
+    __m256i a = _mm256_unpacklo_epi32(left, right);
+    __m256i b = _mm256_unpackhi_epi32(left, right);
+    _mm256_storeu_si256((__m256i*)out, _mm256_permute2x128_si256(a, b, 0x20));
+    _mm256_storeu_si256((__m256i*)(out + 8), _mm256_permute2x128_si256(a, b, 0x31));
+}
+
+__attribute__((target("avx2")))
+static void scale2xRowAVX2(const RowWindow& window, uint32_t* out0, uint32_t* out1, int width)
+{
+    const uint16_t* above = window.getRaw(-1);
+    const uint16_t* row = window.getRaw(0);
+    const uint16_t* below = window.getRaw(1);
+    const uint32_t* above32 = window.getRGB(-1);
+    const uint32_t* row32 = window.getRGB(0);
+    const uint32_t* below32 = window.getRGB(1);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i A = _mm256_loadu_si256((const __m256i*)(above + x));
+        __m256i B = _mm256_loadu_si256((const __m256i*)(row + x + 1));
+        __m256i D = _mm256_loadu_si256((const __m256i*)(row + x - 1));
+        __m256i E = _mm256_loadu_si256((const __m256i*)(below + x));
+
+        __m256i active = _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpeq_epi16(A, E), _mm256_cmpeq_epi16(D, B)),
+                                             _mm256_set1_epi16(-1));
+        __m256i masks[4] = {
+            _mm256_and_si256(active, _mm256_cmpeq_epi16(D, A)),
+            _mm256_and_si256(active, _mm256_cmpeq_epi16(A, B)),
+            _mm256_and_si256(active, _mm256_cmpeq_epi16(D, E)),
+            _mm256_and_si256(active, _mm256_cmpeq_epi16(E, B))
+        };
+
+        for (int half = 0; half < 2; half++) {
+            int px = x + half * 8;
+            __m256i a32 = _mm256_loadu_si256((const __m256i*)(above32 + px));
+            __m256i c32 = _mm256_loadu_si256((const __m256i*)(row32 + px));
+            __m256i e32 = _mm256_loadu_si256((const __m256i*)(below32 + px));
+
+            __m256i wide[4];
+            for (int i = 0; i < 4; i++) {
+                __m256i lo, hi;
+                widenMaskAVX2(masks[i], lo, hi);
+                wide[i] = half ? hi : lo;
+            }
+
+            storePairsAVX2(out0 + 2 * px, selectAVX2(wide[0], a32, c32), selectAVX2(wide[1], a32, c32));
+            storePairsAVX2(out1 + 2 * px, selectAVX2(wide[2], e32, c32), selectAVX2(wide[3], e32, c32));
+        }
+    }
+
+    scale2xRowScalar(window, out0, out1, x, width);
+}
+#endif
+
+static void scale2xRows(const uint16_t* input, uint32_t* output, int width, int height, int firstRow, int lastRow)
+{
+    RowWindow window(input, width, height);
+    int outWidth = width * 2;
+
+    for (int y = firstRow; y < lastRow; y++) {
+        window.moveTo(y);
+        uint32_t* out0 = output + (y * 2) * outWidth;
+        uint32_t* out1 = out0 + outWidth;
+
+#if defined(VIDEO_FILTERS_AVX2)
+        if (simdLevel == SIMD_AVX2) {
+            scale2xRowAVX2(window, out0, out1, width);
+            continue;
+        }
+#endif
+#if defined(VIDEO_FILTERS_SSE2)
+        if (simdLevel >= SIMD_SSE2) {
+            scale2xRowSSE2(window, out0, out1, width);
+            continue;
+        }
+#endif
+        scale2xRowScalar(window, out0, out1, 0, width);
+    }
+}
+
+//---------------------------------------------------------------------------
+// hq2x (simplified, diagonal smoothing only)
+//---------------------------------------------------------------------------
+
+static void hq2xRowScalar(const RowWindow& window, uint32_t* out0, uint32_t* out1, int from, int width)
+{
+    const uint16_t* above = window.getRaw(-1);
+    const uint16_t* row = window.getRaw(0);
+    const uint16_t* below = window.getRaw(1);
+    const uint32_t* above32 = window.getRGB(-1);
+    const uint32_t* row32 = window.getRGB(0);
+
+    for (int x = from; x < width; x++) {
+        uint16_t w0 = above[x - 1], w2 = above[x + 1];
+        uint16_t w4 = row[x];
+        uint16_t w6 = below[x - 1], w8 = below[x + 1];
+
+        bool diag1 = (w0 == w8) && (w0 != w4);
+        bool diag2 = (w2 == w6) && (w2 != w4);
+        uint32_t c = row32[x];
+
+        out0[2 * x] = c;
+        out0[2 * x + 1] = (diag1 || diag2) ? above32[x] : c;
+        out1[2 * x] = (diag1 || diag2) ? row32[x - 1] : c;
+        out1[2 * x + 1] = c;
+    }
+}
+
+#if defined(VIDEO_FILTERS_SSE2)
+static void hq2xRowSSE2(const RowWindow& window, uint32_t* out0, uint32_t* out1, int width)
+{
+    const uint16_t* above = window.getRaw(-1);
+    const uint16_t* row = window.getRaw(0);
+    const uint16_t* below = window.getRaw(1);
+    const uint32_t* above32 = window.getRGB(-1);
+    const uint32_t* row32 = window.getRGB(0);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i w0 = _mm_loadu_si128((const __m128i*)(above + x - 1));
+        __m128i w2 = _mm_loadu_si128((const __m128i*)(above + x + 1));
+        __m128i w4 = _mm_loadu_si128((const __m128i*)(row + x));
+        __m128i w6 = _mm_loadu_si128((const __m128i*)(below + x - 1));
+        __m128i w8 = _mm_loadu_si128((const __m128i*)(below + x + 1));
+
+        __m128i diag1 = _mm_andnot_si128(_mm_cmpeq_epi16(w0, w4), _mm_cmpeq_epi16(w0, w8));
+        __m128i diag2 = _mm_andnot_si128(_mm_cmpeq_epi16(w2, w4), _mm_cmpeq_epi16(w2, w6));
+        __m128i smooth = _mm_or_si128(diag1, diag2);
+        __m128i smoothLo = _mm_unpacklo_epi16(smooth, smooth);
+        __m128i smoothHi = _mm_unpackhi_epi16(smooth, smooth);
+
+        __m128i cLo = _mm_loadu_si128((const __m128i*)(row32 + x));
+        __m128i cHi = _mm_loadu_si128((const __m128i*)(row32 + x + 4));
+        __m128i topLo = _mm_loadu_si128((const __m128i*)(above32 + x));
+        __m128i topHi = _mm_loadu_si128((const __m128i*)(above32 + x + 4));
+        __m128i leftLo = _mm_loadu_si128((const __m128i*)(row32 + x - 1));
+        __m128i leftHi = _mm_loadu_si128((const __m128i*)(row32 + x + 3));
+
+        storePairsSSE2(out0 + 2 * x, cLo, cHi,
+                       selectSSE2(smoothLo, topLo, cLo), selectSSE2(smoothHi, topHi, cHi));
+        storePairsSSE2(out1 + 2 * x,
+                       selectSSE2(smoothLo, leftLo, cLo), selectSSE2(smoothHi, leftHi, cHi),
+                       cLo, cHi);
+    }
+
+    hq2xRowScalar(window, out0, out1, x, width);
+}
+#endif
+
+static void hq2xRows(const uint16_t* input, uint32_t* output, int width, int height, int firstRow, int lastRow)
+{
+    RowWindow window(input, width, height);
+    int outWidth = width * 2;
+
+    for (int y = firstRow; y < lastRow; y++) {
+        window.moveTo(y);
+        uint32_t* out0 = output + (y * 2) * outWidth;
+        uint32_t* out1 = out0 + outWidth;
+
+#if defined(VIDEO_FILTERS_SSE2)
+        if (simdLevel >= SIMD_SSE2) {
+            hq2xRowSSE2(window, out0, out1, width);
+            continue;
+        }
+#endif
+        hq2xRowScalar(window, out0, out1, 0, width);
+    }
+}
+
+//---------------------------------------------------------------------------
+// hq3x (simplified, plain 3x scale)
+//---------------------------------------------------------------------------
+
+static void hq3xRows(const uint16_t* input, uint32_t* output, int width, int, int firstRow, int lastRow)
+{
+    std::vector<uint32_t> row32(width);
+    int outWidth = width * 3;
+
+    for (int y = firstRow; y < lastRow; y++) {
+        VideoFilters::convertRow(input + y * width, row32.data(), width);
+
+        uint32_t* out = output + (y * 3) * outWidth;
+        for (int x = 0; x < width; x++) {
+            uint32_t color = row32[x];
+            out[3 * x] = color;
+            out[3 * x + 1] = color;
+            out[3 * x + 2] = color;
+        }
+        std::copy(out, out + outWidth, out + outWidth);
+        std::copy(out, out + outWidth, out + 2 * outWidth);
+    }
+}
+
+//---------------------------------------------------------------------------
+// CRT scanlines
+//---------------------------------------------------------------------------
+
+static void crtScanlinesRows(const uint16_t* input, uint32_t* output, int width, int, int firstRow, int lastRow)
+{
+    const float scanline_intensity = 0.25f; // How dark the scanlines are (0.0 = invisible, 1.0 = black)
+
+    // Phosphor glow only depends on the column
+    std::vector<float> glow(width);
+    for (int x = 0; x < width; x++) {
+        glow[x] = 1.0f + 0.1f * sinf(x * 0.5f);
+    }
+
+    std::vector<uint32_t> row32(width);
+    int outWidth = width * 2;
+
+    for (int y = firstRow; y < lastRow; y++) {
+        VideoFilters::convertRow(input + y * width, row32.data(), width);
+
+        uint32_t* out0 = output + (y * 2) * outWidth;
+        uint32_t* out1 = out0 + outWidth;
+
+        for (int x = 0; x < width; x++) {
+            uint32_t color = row32[x];
+            uint8_t r = (color >> 16) & 0xFF;
+            uint8_t g = (color >> 8) & 0xFF;
+            uint8_t b = color & 0xFF;
+
+            r = (uint8_t)(std::min(255.0f, r * glow[x]));
+            g = (uint8_t)(std::min(255.0f, g * glow[x]));
+            b = (uint8_t)(std::min(255.0f, b * glow[x]));
+
+            // Top row - normal brightness
+            uint32_t top_color = (0xFF << 24) | (r << 16) | (g << 8) | b;
+            out0[2 * x] = top_color;
+            out0[2 * x + 1] = top_color;
+
+            // Bottom row - darkened for scanline effect
+            uint8_t dark_r = (uint8_t)(r * (1.0f - scanline_intensity));
+            uint8_t dark_g = (uint8_t)(g * (1.0f - scanline_intensity));
+            uint8_t dark_b = (uint8_t)(b * (1.0f - scanline_intensity));
+            uint32_t bottom_color = (0xFF << 24) | (dark_r << 16) | (dark_g << 8) | dark_b;
+            out1[2 * x] = bottom_color;
+            out1[2 * x + 1] = bottom_color;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+// Super 4xSaI
+//---------------------------------------------------------------------------
+
+static uint32_t interpolate4xSaI(uint32_t c1, uint32_t c2, uint32_t c3, uint32_t c4)
+{
+    // Weighted average with emphasis on the center pixel
+    uint8_t r1 = (c1 >> 16) & 0xFF, g1 = (c1 >> 8) & 0xFF, b1 = c1 & 0xFF;
+    uint8_t r2 = (c2 >> 16) & 0xFF, g2 = (c2 >> 8) & 0xFF, b2 = c2 & 0xFF;
+    uint8_t r3 = (c3 >> 16) & 0xFF, g3 = (c3 >> 8) & 0xFF, b3 = c3 & 0xFF;
+    uint8_t r4 = (c4 >> 16) & 0xFF, g4 = (c4 >> 8) & 0xFF, b4 = c4 & 0xFF;
+
+    uint8_t r = (r1 + r2 + (r3 * 2) + r4) / 5;
+    uint8_t g = (g1 + g2 + (g3 * 2) + g4) / 5;
+    uint8_t b = (b1 + b2 + (b3 * 2) + b4) / 5;
+
+    return (0xFF << 24) | (r << 16) | (g << 8) | b;
+}
+
+static uint32_t mixColors(uint32_t c1, uint32_t c2, float ratio)
+{
+    uint8_t r1 = (c1 >> 16) & 0xFF, g1 = (c1 >> 8) & 0xFF, b1 = c1 & 0xFF;
+    uint8_t r2 = (c2 >> 16) & 0xFF, g2 = (c2 >> 8) & 0xFF, b2 = c2 & 0xFF;
+
+    uint8_t r = (uint8_t)(r1 * (1.0f - ratio) + r2 * ratio);
+    uint8_t g = (uint8_t)(g1 * (1.0f - ratio) + g2 * ratio);
+    uint8_t b = (uint8_t)(b1 * (1.0f - ratio) + b2 * ratio);
+
+    return (0xFF << 24) | (r << 16) | (g << 8) | b;
+}
+
+static bool colorsEqual(uint32_t c1, uint32_t c2)
+{
+    // Colors within a small distance count as equal
+    uint8_t r1 = (c1 >> 16) & 0xFF, g1 = (c1 >> 8) & 0xFF, b1 = c1 & 0xFF;
+    uint8_t r2 = (c2 >> 16) & 0xFF, g2 = (c2 >> 8) & 0xFF, b2 = c2 & 0xFF;
+
+    return (abs(r1 - r2) < 8) && (abs(g1 - g2) < 8) && (abs(b1 - b2) < 8);
+}
+
+static void super4xSaIRows(const uint16_t* input, uint32_t* output, int width, int height, int firstRow, int lastRow)
+{
+    RowWindow window(input, width, height);
+    int outWidth = width * 4;
+
+    for (int y = firstRow; y < lastRow; y++) {
+        window.moveTo(y);
+        const uint32_t* above = window.getRGB(-1);
+        const uint32_t* row = window.getRGB(0);
+        const uint32_t* below = window.getRGB(1);
+        uint32_t* out = output + (y * 4) * outWidth;
+
+        for (int x = 0; x < width; x++) {
+            //  0 | 1 | 2
+            //  3 | 4 | 5
+            //  6 | 7 | 8
+            uint32_t c1 = above[x];
+            uint32_t c3 = row[x - 1], c4 = row[x], c5 = row[x + 1];
+            uint32_t c7 = below[x];
+
+            uint32_t product1a, product1b, product2a, product2b;
+
+            // Top-left quadrant
+            if (colorsEqual(c3, c1) && !colorsEqual(c3, c5)) {
+                product1a = interpolate4xSaI(c3, c3, c4, c1);
+            } else if (colorsEqual(c5, c1) && !colorsEqual(c3, c5)) {
+                product1a = interpolate4xSaI(c5, c1, c4, c5);
+            } else if (colorsEqual(c3, c5) && !colorsEqual(c3, c1)) {
+                product1a = c4;
+            } else {
+                product1a = interpolate4xSaI(c1, c3, c4, c5);
+            }
+
+            // Top-right quadrant
+            if (colorsEqual(c1, c5) && !colorsEqual(c1, c7)) {
+                product1b = interpolate4xSaI(c1, c1, c4, c5);
+            } else if (colorsEqual(c7, c5) && !colorsEqual(c1, c7)) {
+                product1b = interpolate4xSaI(c7, c5, c4, c7);
+            } else if (colorsEqual(c1, c7) && !colorsEqual(c1, c5)) {
+                product1b = c4;
+            } else {
+                product1b = interpolate4xSaI(c5, c1, c4, c7);
+            }
+
+            // Bottom-left quadrant
+            if (colorsEqual(c3, c7) && !colorsEqual(c3, c1)) {
+                product2a = interpolate4xSaI(c3, c7, c4, c3);
+            } else if (colorsEqual(c1, c7) && !colorsEqual(c3, c1)) {
+                product2a = interpolate4xSaI(c1, c7, c4, c1);
+            } else if (colorsEqual(c3, c1) && !colorsEqual(c3, c7)) {
+                product2a = c4;
+            } else {
+                product2a = interpolate4xSaI(c7, c3, c4, c1);
+            }
+
+            // Bottom-right quadrant
+            if (colorsEqual(c5, c7) && !colorsEqual(c5, c3)) {
+                product2b = interpolate4xSaI(c5, c7, c4, c5);
+            } else if (colorsEqual(c3, c7) && !colorsEqual(c5, c3)) {
+                product2b = interpolate4xSaI(c3, c7, c4, c3);
+            } else if (colorsEqual(c5, c3) && !colorsEqual(c5, c7)) {
+                product2b = c4;
+            } else {
+                product2b = interpolate4xSaI(c7, c5, c4, c3);
+            }
+
+            // Edge-directed refinement
+            if (!colorsEqual(c1, c5) && !colorsEqual(c3, c7)) {
+                if (colorsEqual(c3, c1)) {
+                    product1a = mixColors(product1a, c3, 0.75f);
+                }
+                if (colorsEqual(c1, c5)) {
+                    product1b = mixColors(product1b, c1, 0.75f);
+                }
+                if (colorsEqual(c3, c7)) {
+                    product2a = mixColors(product2a, c3, 0.75f);
+                }
+                if (colorsEqual(c5, c7)) {
+                    product2b = mixColors(product2b, c5, 0.75f);
+                }
+            }
+
+            uint32_t* o0 = out + 4 * x;
+            uint32_t* o1 = o0 + outWidth;
+            uint32_t* o2 = o1 + outWidth;
+            uint32_t* o3 = o2 + outWidth;
+
+            o0[0] = product1a;
+            o0[1] = mixColors(product1a, product1b, 0.5f);
+            o0[2] = mixColors(product1b, product1a, 0.5f);
+            o0[3] = product1b;
+
+            o1[0] = mixColors(product1a, product2a, 0.5f);
+            o1[1] = mixColors(c4, product1a, 0.7f);
+            o1[2] = mixColors(c4, product1b, 0.7f);
+            o1[3] = mixColors(product1b, product2b, 0.5f);
+
+            o2[0] = mixColors(product2a, product1a, 0.5f);
+            o2[1] = mixColors(c4, product2a, 0.7f);
+            o2[2] = mixColors(c4, product2b, 0.7f);
+            o2[3] = mixColors(product2b, product1b, 0.5f);
+
+            o3[0] = product2a;
+            o3[1] = mixColors(product2a, product2b, 0.5f);
+            o3[2] = mixColors(product2b, product2a, 0.5f);
+            o3[3] = product2b;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+// VideoFilters
+//---------------------------------------------------------------------------
+
+VideoFilters::VideoFilters(int threads)
+    : pool(threads), hqdn3dSpatial(0.4f), hqdn3dTemporal(0.6f)
+{
+}
+
+void VideoFilters::setThreadCount(int threads)
+{
+    pool.setThreadCount(threads);
+}
+
+int VideoFilters::getThreadCount() const
+{
+    return pool.getThreadCount();
+}
+
+void VideoFilters::scale2x(const uint16_t* input, uint32_t* output, int width, int height)
+{
+    scale2x(input, output, width, height, 0, height);
+}
+
+void VideoFilters::scale2x(const uint16_t* input, uint32_t* output, int width, int height, int firstRow, int lastRow)
+{
+    pool.run(lastRow - firstRow, [&](int first, int last) {
+        scale2xRows(input, output, width, height, firstRow + first, firstRow + last);
+    });
+}
+
+void VideoFilters::hq2x(const uint16_t* input, uint32_t* output, int width, int height)
+{
+    hq2x(input, output, width, height, 0, height);
+}
+
+void VideoFilters::hq2x(const uint16_t* input, uint32_t* output, int width, int height, int firstRow, int lastRow)
+{
+    pool.run(lastRow - firstRow, [&](int first, int last) {
+        hq2xRows(input, output, width, height, firstRow + first, firstRow + last);
+    });
+}
+
+void VideoFilters::hq3x(const uint16_t* input, uint32_t* output, int width, int height)
+{
+    hq3x(input, output, width, height, 0, height);
+}
+
+void VideoFilters::hq3x(const uint16_t* input, uint32_t* output, int width, int height, int firstRow, int lastRow)
+{
+    pool.run(lastRow - firstRow, [&](int first, int last) {
+        hq3xRows(input, output, width, height, firstRow + first, firstRow + last);
+    });
+}
+
+void VideoFilters::crtScanlines(const uint16_t* input, uint32_t* output, int width, int height)
+{
+    crtScanlines(input, output, width, height, 0, height);
+}
+
+void VideoFilters::crtScanlines(const uint16_t* input, uint32_t* output, int width, int height, int firstRow, int lastRow)
+{
+    pool.run(lastRow - firstRow, [&](int first, int last) {
+        crtScanlinesRows(input, output, width, height, firstRow + first, firstRow + last);
+    });
+}
+
+void VideoFilters::super4xSaI(const uint16_t* input, uint32_t* output, int width, int height)
+{
+    super4xSaI(input, output, width, height, 0, height);
+}
+
+void VideoFilters::super4xSaI(const uint16_t* input, uint32_t* output, int width, int height, int firstRow, int lastRow)
+{
+    pool.run(lastRow - firstRow, [&](int first, int last) {
+        super4xSaIRows(input, output, width, height, firstRow + first, firstRow + last);
+    });
+}
+
+void VideoFilters::ntsc(const uint16_t* input, uint32_t* output, int width, int height)
+{
+    int framePhase = ntscFilter.nextFramePhase();
+    pool.run(height, [&](int firstRow, int lastRow) {
+        ntscFilter.filterRows(input, output, width, firstRow, lastRow, framePhase);
+    });
+}
+
+void VideoFilters::setupNTSC(const NTSCSettings& settings)
+{
+    ntscFilter.setup(settings);
+}
+
+void VideoFilters::setHQDN3DStrength(float spatial, float temporal)
+{
+    hqdn3dSpatial = spatial;
+    hqdn3dTemporal = temporal;
+}
+
+//---------------------------------------------------------------------------
+// Filter chain stages
+//---------------------------------------------------------------------------
+
+/**
+ * Runs one of the filters as a filter chain stage. The filters work on
+ * packed frames, so padded frames go through a scratch buffer.
+ */
+class VideoFilterStage : public FilterStage {
+public:
+    typedef void (VideoFilters::*Apply)(const uint16_t*, uint32_t*, int, int);
+    typedef void (VideoFilters::*ApplyRows)(const uint16_t*, uint32_t*, int, int, int, int);
+
+    /**
+     * @param applyRows Row version of the filter, or nullptr if it only takes whole frames
+     */
+    VideoFilterStage(VideoFilters& filters, const char* name, Apply apply, ApplyRows applyRows, int scale)
+        : filters(filters), name(name), apply(apply), applyRows(applyRows), scale(scale)
+    {
+    }
+
+    const char* getName() const override
+    {
+        return name;
+    }
+
+    bool configure(int inputWidth, int inputHeight, PixelFormat inputFormat, int, int,
+                   int& outputWidth, int& outputHeight, PixelFormat& outputFormat) override
+    {
+        outputWidth = inputWidth * scale;
+        outputHeight = inputHeight * scale;
+        outputFormat = PixelFormat::ARGB8888;
+        return inputFormat == PixelFormat::RGB565;
+    }
+
+    void process(const FilterFrame& input, const FilterFrame& output) override
+    {
+        const uint16_t* src = (const uint16_t*)input.pixels;
+        if (!input.isPacked()) {
+            inputScratch.resize(input.width * input.height);
+            for (int y = 0; y < input.height; y++) {
+                std::copy(input.row<uint16_t>(y), input.row<uint16_t>(y) + input.width,
+                          inputScratch.data() + y * input.width);
+            }
+            src = inputScratch.data();
+        }
+
+        if (output.isPacked()) {
+            (filters.*apply)(src, (uint32_t*)output.pixels, input.width, input.height);
+            return;
+        }
+
+        outputScratch.resize(output.width * output.height);
+        (filters.*apply)(src, outputScratch.data(), input.width, input.height);
+        for (int y = 0; y < output.height; y++) {
+            std::copy(outputScratch.data() + y * output.width, outputScratch.data() + (y + 1) * output.width,
+                      output.row<uint32_t>(y));
+        }
+    }
+
+    bool processRows(const FilterFrame& input, const FilterFrame& output, int& firstRow, int& lastRow) override
+    {
+        if (!applyRows || !input.isPacked() || !output.isPacked()) {
+            return false;
+        }
+        if (firstRow >= lastRow) {
+            return true;
+        }
+
+        // Most of the filters look one row up and down, so the rows next
+        // to a changed one change too
+        firstRow = std::max(0, firstRow - 1);
+        lastRow = std::min(input.height, lastRow + 1);
+        (filters.*applyRows)((const uint16_t*)input.pixels, (uint32_t*)output.pixels,
+                             input.width, input.height, firstRow, lastRow);
+        firstRow *= scale;
+        lastRow *= scale;
+        return true;
+    }
+
+private:
+    VideoFilters& filters;
+    const char* name;
+    Apply apply;
+    ApplyRows applyRows;
+    int scale;
+    std::vector<uint16_t> inputScratch;
+    std::vector<uint32_t> outputScratch;
+};
+
+/**
+ * Runs an hqdn3d denoiser as a filter chain stage. Every stage has its own
+ * denoiser, so each chain accumulates its own previous frame. The
+ * denoiser reads each row before writing it, so it can filter in place.
+ */
+class HQDN3DStage : public FilterStage {
+public:
+    HQDN3DStage(float spatial, float temporal)
+        : denoiser(spatial, temporal)
+    {
+    }
+
+    const char* getName() const override
+    {
+        return "hqdn3d";
+    }
+
+    bool configure(int inputWidth, int inputHeight, PixelFormat inputFormat, int, int,
+                   int& outputWidth, int& outputHeight, PixelFormat& outputFormat) override
+    {
+        outputWidth = inputWidth;
+        outputHeight = inputHeight;
+        outputFormat = PixelFormat::RGB565;
+        denoiser.reset();
+        return inputFormat == PixelFormat::RGB565;
+    }
+
+    void process(const FilterFrame& input, const FilterFrame& output) override
+    {
+        if (input.isPacked() && output.isPacked()) {
+            denoiser.filter((const uint16_t*)input.pixels, (uint16_t*)output.pixels, input.width, input.height);
+            return;
+        }
+
+        scratch.resize(input.width * input.height);
+        for (int y = 0; y < input.height; y++) {
+            std::copy(input.row<uint16_t>(y), input.row<uint16_t>(y) + input.width,
+                      scratch.data() + y * input.width);
+        }
+        denoiser.filter(scratch.data(), scratch.data(), input.width, input.height);
+        for (int y = 0; y < output.height; y++) {
+            std::copy(scratch.data() + y * output.width, scratch.data() + (y + 1) * output.width,
+                      output.row<uint16_t>(y));
+        }
+    }
+
+private:
+    HQDN3DFilter denoiser;
+    std::vector<uint16_t> scratch;
+};
+
+/**
+ * RGB565 to ARGB8888 conversion using the SIMD kernels.
+ */
+class ConvertRowStage : public FilterStage {
+public:
+    const char* getName() const override
+    {
+        return "rgb32";
+    }
+
+    bool configure(int inputWidth, int inputHeight, PixelFormat inputFormat, int, int,
+                   int& outputWidth, int& outputHeight, PixelFormat& outputFormat) override
+    {
+        outputWidth = inputWidth;
+        outputHeight = inputHeight;
+        outputFormat = PixelFormat::ARGB8888;
+        return inputFormat == PixelFormat::RGB565;
+    }
+
+    void process(const FilterFrame& input, const FilterFrame& output) override
+    {
+        for (int y = 0; y < input.height; y++) {
+            VideoFilters::convertRow(input.row<uint16_t>(y), output.row<uint32_t>(y), input.width);
+        }
+    }
+
+    bool processRows(const FilterFrame& input, const FilterFrame& output, int& firstRow, int& lastRow) override
+    {
+        for (int y = firstRow; y < lastRow; y++) {
+            VideoFilters::convertRow(input.row<uint16_t>(y), output.row<uint32_t>(y), input.width);
+        }
+        return true;
+    }
+};
+
+void VideoFilters::registerStages()
+{
+    struct Entry {
+        const char* name;
+        VideoFilterStage::Apply apply;
+        VideoFilterStage::ApplyRows applyRows;
+        int scale;
+    };
+    static const Entry entries[] = {
+        { "scale2x", &VideoFilters::scale2x, &VideoFilters::scale2x, 2 },
+        { "hq2x", &VideoFilters::hq2x, &VideoFilters::hq2x, 2 },
+        { "hq3x", &VideoFilters::hq3x, &VideoFilters::hq3x, 3 },
+        { "crt", &VideoFilters::crtScanlines, &VideoFilters::crtScanlines, 2 },
+        { "4xsai", &VideoFilters::super4xSaI, &VideoFilters::super4xSaI, 4 },
+        { "ntsc", &VideoFilters::ntsc, nullptr, 1 }
+    };
+
+    for (const Entry& entry : entries) {
+        FilterChain::registerStage(entry.name, [this, entry]() -> FilterStage* {
+            return new VideoFilterStage(*this, entry.name, entry.apply, entry.applyRows, entry.scale);
+        });
+    }
+    FilterChain::registerStage("hqdn3d", [this]() -> FilterStage* {
+        return new HQDN3DStage(hqdn3dSpatial, hqdn3dTemporal);
+    });
+    FilterChain::registerStage("rgb32", []() -> FilterStage* { return new ConvertRowStage(); });
+}
+
+std::string VideoFilters::getReducedChain(const std::string& spec)
+{
+    static const struct {
+        const char* name;
+        const char* replacement;
+    } replacements[] = {
+        { "ntsc", "rgb32" },
+        { "hq2x", "rgb32,2x" },
+        { "hq3x", "rgb32,3x" },
+        { "4xsai", "rgb32,4x" },
+        { "hqdn3d", "" }
+    };
+
+    std::string reduced;
+    bool changed = false;
+    std::stringstream stream(spec);
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
+        for (const auto& replacement : replacements) {
+            if (name == replacement.name) {
+                name = replacement.replacement;
+                changed = true;
+                break;
+            }
+        }
+        if (name.empty()) {
+            continue;
+        }
+        if (!reduced.empty()) {
+            reduced += ",";
+        }
+        reduced += name;
+    }
+    return changed ? reduced : spec;
+}
+
+void VideoFilters::setSIMDEnabled(bool enabled)
+{
+    simdLevel = enabled ? detectedSIMDLevel : SIMD_NONE;
+}
+
+bool VideoFilters::isAVX2Enabled()
+{
+    return simdLevel == SIMD_AVX2;
+}
+
+const char* VideoFilters::getSIMDName()
+{
+    switch (simdLevel) {
+    case SIMD_AVX2:
+        return "AVX2";
+    case SIMD_SSE2:
+        return "SSE2";
+    default:
+        return "scalar";
+    }
+}
+
+void VideoFilters::benchmark(int frames)
+{
+    const int width = 256;
+    const int height = 240;
+
+    // A frame with NES-like structure: flat 8x8 tiles from a small palette
+    // with some single pixel detail, so the edge checks take both paths
+    std::vector<uint16_t> input(width * height);
+    const uint16_t palette[] = { 0x0000, 0xFFFF, 0xF800, 0x07E0, 0x001F, 0x8410, 0xFD20, 0x5AEB };
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int tile = ((x / 8) * 7 + (y / 8) * 13) & 7;
+            bool detail = ((x * 5 + y * 3) % 11) == 0;
+            input[y * width + x] = palette[detail ? (tile + 3) & 7 : tile];
+        }
+    }
+    std::vector<uint32_t> output(width * height * 16);
+
+    struct Filter {
+        const char* name;
+        void (VideoFilters::*apply)(const uint16_t*, uint32_t*, int, int);
+    };
+    const Filter filters[] = {
+        { "Scale2x", &VideoFilters::scale2x },
+        { "hq2x", &VideoFilters::hq2x },
+        { "hq3x", &VideoFilters::hq3x },
+        { "CRT Scanlines", &VideoFilters::crtScanlines },
+        { "Super 4xSaI", &VideoFilters::super4xSaI },
+        { "NTSC", &VideoFilters::ntsc }
+    };
+    const int threadCounts[] = { 1, 2, 4 };
+
+    printf("Filter benchmark: %dx%d, %d frames, %s kernels, %u hardware threads\n",
+           width, height, frames, getSIMDName(), std::thread::hardware_concurrency());
+    printf("%-14s %10s %10s %10s   (ms/frame)\n", "Filter", "1 thread", "2 threads", "4 threads");
+
+    for (const Filter& filter : filters) {
+        printf("%-14s", filter.name);
+        for (int threads : threadCounts) {
+            VideoFilters filters(threads);
+            (filters.*filter.apply)(input.data(), output.data(), width, height);
+
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < frames; i++) {
+                (filters.*filter.apply)(input.data(), output.data(), width, height);
+            }
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            printf(" %10.3f", ms / frames);
+        }
+        printf("\n");
+    }
+
+    // The denoiser's passes run down the frame, so it only has one thread
+    HQDN3DFilter denoiser;
+    std::vector<uint16_t> denoised(width * height);
+    denoiser.filter(input.data(), denoised.data(), width, height);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        denoiser.filter(input.data(), denoised.data(), width, height);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("%-14s %10.3f %10s %10s\n", "hqdn3d", ms / frames, "-", "-");
+}
@@ -0,0 +1,119 @@
+#ifndef VIDEO_FILTERS_HPP
+#define VIDEO_FILTERS_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "FilterChain.hpp"
+#include "FilterWorkerPool.hpp"
+#include "NTSCFilter.hpp"
+
+/**
+ * Software video filters for the SDL and GTK frontends.
+ *
+ * Every filter reads a 16-bit RGB565 frame and writes an ARGB8888 frame
+ * scaled by the filter's factor. Frames are split into row stripes that
+ * run on a small worker pool, and the colour conversion and neighbour
+ * comparisons use SSE2/AVX2 kernels when the CPU has them.
+ */
+class VideoFilters {
+public:
+    /**
+     * @param threads Number of filter threads (0 = automatic)
+     */
+    VideoFilters(int threads = 0);
+
+    /**
+     * Set the number of filter threads (0 = automatic).
+     */
+    void setThreadCount(int threads);
+
+    /**
+     * Get the number of filter threads.
+     */
+    int getThreadCount() const;
+
+    void scale2x(const uint16_t* input, uint32_t* output, int width, int height);
+    void hq2x(const uint16_t* input, uint32_t* output, int width, int height);
+    void hq3x(const uint16_t* input, uint32_t* output, int width, int height);
+    void crtScanlines(const uint16_t* input, uint32_t* output, int width, int height);
+    void super4xSaI(const uint16_t* input, uint32_t* output, int width, int height);
+    void ntsc(const uint16_t* input, uint32_t* output, int width, int height);
+
+    /**
+     * Filter input rows [firstRow, lastRow) only, writing just the output
+     * rows they produce. The rows around the range are still read as
+     * neighbours. The NTSC filter changes phase every frame, so it has no
+     * row version.
+     */
+    void scale2x(const uint16_t* input, uint32_t* output, int width, int height, int firstRow, int lastRow);
+    void hq2x(const uint16_t* input, uint32_t* output, int width, int height, int firstRow, int lastRow);
+    void hq3x(const uint16_t* input, uint32_t* output, int width, int height, int firstRow, int lastRow);
+    void crtScanlines(const uint16_t* input, uint32_t* output, int width, int height, int firstRow, int lastRow);
+    void super4xSaI(const uint16_t* input, uint32_t* output, int width, int height, int firstRow, int lastRow);
+
+    /**
+     * Rebuild the NTSC filter tables for new settings.
+     */
+    void setupNTSC(const NTSCSettings& settings);
+
+    /**
+     * Set the strengths (0 to 1) for hqdn3d stages created from now on.
+     */
+    void setHQDN3DStrength(float spatial, float temporal);
+
+    /**
+     * Convert a row of RGB565 pixels to ARGB8888.
+     */
+    static void convertRow(const uint16_t* src, uint32_t* dst, int count);
+
+    /**
+     * Convert a single RGB565 pixel to ARGB8888.
+     */
+    static uint32_t convertPixel(uint16_t color);
+
+    /**
+     * Allow or forbid the SIMD kernels (for comparing against the scalar code).
+     */
+    static void setSIMDEnabled(bool enabled);
+
+    /**
+     * Get the name of the instruction set the kernels are using.
+     */
+    static const char* getSIMDName();
+
+    /**
+     * Check whether the AVX2 kernels are in use.
+     */
+    static bool isAVX2Enabled();
+
+    /**
+     * Register the filters as filter chain stages ("scale2x", "hq2x",
+     * "hq3x", "crt", "4xsai", "ntsc" and "hqdn3d"), and replace the "rgb32" stage
+     * with the SIMD conversion. The stages run on this object's threads,
+     * so it has to outlive every chain using them.
+     */
+    void registerStages();
+
+    /**
+     * Get a chain spec with the expensive stages swapped for cheap ones
+     * giving the same output size: "ntsc" becomes "rgb32", "hq2x",
+     * "hq3x" and "4xsai" become nearest neighbour scaling, and "hqdn3d"
+     * is dropped. A spec without expensive stages is returned as it is.
+     */
+    static std::string getReducedChain(const std::string& spec);
+
+    /**
+     * Time every filter at 1, 2 and 4 threads and print ms/frame.
+     * @param frames Number of frames to filter per measurement
+     */
+    static void benchmark(int frames);
+
+private:
+    FilterWorkerPool pool;
+    NTSCFilter ntscFilter;
+    float hqdn3dSpatial;
+    float hqdn3dTemporal;
+};
+
+#endif // VIDEO_FILTERS_HPP
@@ -184,7 +184,7 @@ AllegroMainWindow::AllegroMainWindow()
       statusMessageTimer(0), currentFrameBuffer(NULL),
       screenBuffer16(NULL), useDirectRendering(true),
       currentCaptureType(CAPTURE_NONE), currentConfigPlayer(PLAYER_1),
-      lineStartOffsets(NULL), useOptimizedScaling(true),
+      lineStartOffsets(NULL), useOptimizedScaling(true), gameOnScreen(false),
       selectedVideoOption(0), numAvailableModes(0)  // ADD THESE TWO
 #ifndef __DJGPP__
       , isFullscreen(false), windowedWidth(640), windowedHeight(480)
@@ -278,7 +278,6 @@ void AllegroMainWindow::drawGameDOSOptimized(BITMAP* target)
 
 AllegroMainWindow::~AllegroMainWindow() 
 {
-    scalingCache.cleanup();
     if (lineStartOffsets) {
         delete[] lineStartOffsets;
         lineStartOffsets = NULL;
@@ -615,6 +614,7 @@ bool AllegroMainWindow::createBuffers()
         printf("Failed to create back buffer\n");
         return false;
     }
+    gameOnScreen = false;
     
     // Allocate 16-bit screen buffer for direct rendering
     screenBuffer16 = new uint16_t[SCREEN_W * SCREEN_H];
@@ -629,38 +629,6 @@ bool AllegroMainWindow::createBuffers()
     return true;
 }
 
-AllegroMainWindow::ScalingCache::ScalingCache() 
-    : scaledBuffer(NULL), sourceToDestX(NULL), sourceToDestY(NULL), 
-      scaleFactor(0), destWidth(0), destHeight(0), 
-      destOffsetX(0), destOffsetY(0), isValid(false) 
-{
-    // Constructor body is empty - initialization is done in member initializer list
-}
-
-// ScalingCache destructor implementation
-AllegroMainWindow::ScalingCache::~ScalingCache() 
-{
-    cleanup();
-}
-
-// ScalingCache cleanup implementation
-void AllegroMainWindow::ScalingCache::cleanup() 
-{
-    if (scaledBuffer) { 
-        delete[] scaledBuffer; 
-        scaledBuffer = NULL; 
-    }
-    if (sourceToDestX) { 
-        delete[] sourceToDestX; 
-        sourceToDestX = NULL; 
-    }
-    if (sourceToDestY) { 
-        delete[] sourceToDestY; 
-        sourceToDestY = NULL; 
-    }
-    isValid = false;
-}
-
 #ifndef __DJGPP__
 // Fullscreen toggle function (Linux only):
 bool AllegroMainWindow::toggleFullscreen()
@@ -2291,6 +2259,21 @@ void AllegroMainWindow::drawControlsDialog(BITMAP* target, Player player)
 
 void AllegroMainWindow::updateAndDraw()
 {
+    // With nothing drawn over the game, only the rows that changed since
+    // the last game frame are scaled and copied to the screen
+    bool gameOnly = smbEngine && currentDialog == DIALOG_NONE && !showingMenu &&
+                    statusMessageTimer <= 0 && bitmap_color_depth(back_buffer) == 16;
+    if (gameOnly) {
+        smbEngine->renderScaledChanged16((uint16_t*)back_buffer->line[0], SCREEN_W, SCREEN_H,
+                                         !gameOnScreen, changedRows);
+        for (const RowBand& band : changedRows) {
+            blit(back_buffer, screen, 0, band.first, 0, band.first, SCREEN_W, band.last - band.first);
+        }
+        gameOnScreen = true;
+        return;
+    }
+    gameOnScreen = false;
+
     // Clear the back buffer
     clear_to_color(back_buffer, makecol(0, 0, 0));
     